@@ -0,0 +1,78 @@
+#include "Benchmark.h"
+#include "../Image/Image.h"
+#include "../Image/PixelKernels.h"
+#include "../Utils/Buffer.h"
+
+// Buffers of the size of an 8192 x 8192 image
+constexpr uint32_t IMAGE_SIDE = 8192;
+constexpr size_t PIXELS_COUNT = size_t(IMAGE_SIDE) * IMAGE_SIDE;
+constexpr uint32_t RUNS_COUNT = 5;
+
+static const char* getPolicyName(utils::AllocationPolicy policy) {
+    switch (policy) {
+        case utils::AllocationPolicy::HEAP: return "heap";
+        case utils::AllocationPolicy::ALIGNED: return "aligned";
+        case utils::AllocationPolicy::PAGES: return "pages";
+    default: return "unknown";
+    }
+}
+
+template<utils::AllocationPolicy Policy>
+static void runPolicyBenchmarks(QTextStream& out) {
+    QString name = getPolicyName(Policy);
+    uint64_t hash = 0;
+
+    // What allocating a zero image costs by itself, and together with its first pass, when the zero pages are actually touched
+    bench::report(out, bench::measure(name + ": zeroed allocation", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        auto result = utils::SizedBuffer<uint32_t, Policy>::alloc(PIXELS_COUNT);
+        hash += result.isOk() ? result.value().size() : 0;
+    }));
+    bench::report(out, bench::measure(name + ": zeroed allocation + fill", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        if (auto result = utils::SizedBuffer<uint32_t, Policy>::alloc(PIXELS_COUNT); result.isOk()) {
+            auto buffer = result.extract();
+            kernels::fill(buffer.data(), PIXELS_COUNT, Color::White._data);
+            hash += buffer.at(PIXELS_COUNT - 1);
+        }
+    }));
+
+    // A pass over the memory that is already touched, where only the TLB misses differ
+    auto result = utils::SizedBuffer<uint32_t, Policy>::alloc(PIXELS_COUNT);
+    if (!result.isOk()) {
+        out << "  Failed to allocate the buffer\n";
+        return;
+    }
+
+    auto buffer = result.extract();
+    kernels::fill(buffer.data(), PIXELS_COUNT, Color::White._data);
+    bench::report(out, bench::measure(name + ": invert pass", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        kernels::invert(buffer.data(), PIXELS_COUNT);
+    }));
+
+    bench::reportValue(out, name + ": alignment of 64", (uintptr_t(buffer.data()) % 64 == 0) ? "yes" : "no");
+    bench::reportValue(out, name + ": checksum", QString::number(hash + bench::checksum(buffer.data(), 1024), 16));
+}
+
+void bench::runAllocationBenchmarks(QTextStream& out) {
+    runPolicyBenchmarks<utils::AllocationPolicy::HEAP>(out);
+    runPolicyBenchmarks<utils::AllocationPolicy::ALIGNED>(out);
+    runPolicyBenchmarks<utils::AllocationPolicy::PAGES>(out);
+
+    // Each run gets a new image, so that the allocation is measured as well as the filling
+    report(out, measure("newImage", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        Image image;
+        image.newImage(IMAGE_SIDE, IMAGE_SIDE, Color::White).isOk();
+    }));
+
+    Image image;
+    if (!image.newImage(IMAGE_SIDE, IMAGE_SIDE, Color::White).isOk()) {
+        out << "  Failed to allocate the image\n";
+        return;
+    }
+
+    report(out, measure("image: invert pass", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        image.invertImage();
+    }));
+    report(out, measure("image: threshold pass", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        image.thresholdImage(128);
+    }));
+}
@@ -0,0 +1,170 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <QFile>
+
+// A group of benchmarks that can be run by name
+struct BenchmarkGroup {
+    const char* name;
+    void (*run)(QTextStream& out);
+};
+
+static const BenchmarkGroup BENCHMARK_GROUPS[] = {
+    { "blend", bench::runBlendBenchmarks },
+    { "polygon", bench::runPolygonBenchmarks },
+    { "fill", bench::runFillBenchmarks },
+    { "allocation", bench::runAllocationBenchmarks },
+    { "image", bench::runImageBenchmarks },
+    { "script", bench::runScriptBenchmarks },
+};
+
+// A measurement reported by a group, kept till all the groups are finished to be written as JSON
+struct GroupMeasurement {
+    QString group;
+    bench::Measurement measurement;
+};
+
+static QString s_currentGroup;
+static std::vector<GroupMeasurement> s_measurements;
+
+// The names are plain text, but may have quotes or backslashes in them
+static QString toJsonString(const QString& text) {
+    QString result = "\"";
+    for (QChar c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+
+        result += c;
+    }
+
+    return result + "\"";
+}
+
+static bool writeJson(const QString& fileName) {
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "{\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i < s_measurements.size(); i++) {
+        const bench::Measurement& measurement = s_measurements[i].measurement;
+        double itemsPerSecond = measurement.medianNs > 0 ? measurement.itemsCount / measurement.medianNs * 1e9 : 0;
+
+        out << (i == 0 ? "\n" : ",\n")
+            << "    { \"group\": " << toJsonString(s_measurements[i].group)
+            << ", \"name\": " << toJsonString(measurement.name)
+            << ", \"items\": " << QString::number(measurement.itemsCount)
+            << ", \"median_ns\": " << QString::number(measurement.medianNs, 'f', 0)
+            << ", \"min_ns\": " << QString::number(measurement.minNs, 'f', 0)
+            << ", \"items_per_second\": " << QString::number(itemsPerSecond, 'f', 0) << " }";
+    }
+
+    out << "\n  ]\n}\n";
+    out.flush();
+
+    return out.status() == QTextStream::Ok;
+}
+
+bench::Measurement bench::measure(const QString& name, uint64_t itemsCount, uint32_t runsCount, const std::function<void()>& function) {
+    return measure(name, itemsCount, runsCount, []() {}, function);
+}
+
+bench::Measurement bench::measure(const QString& name, uint64_t itemsCount, uint32_t runsCount, const std::function<void()>& setup, const std::function<void()>& function) {
+    setup();
+    function(); // Warming up the caches
+
+    std::vector<double> times;
+    times.reserve(runsCount);
+    for (uint32_t i = 0; i < runsCount; i++) {
+        setup();
+
+        auto start = std::chrono::steady_clock::now();
+        function();
+        auto end = std::chrono::steady_clock::now();
+
+        times.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    std::sort(times.begin(), times.end());
+
+    Measurement result;
+    result.name = name;
+    result.itemsCount = itemsCount;
+    result.medianNs = times.empty() ? 0 : times[times.size() / 2];
+    result.minNs = times.empty() ? 0 : times.front();
+
+    return result;
+}
+
+void bench::report(QTextStream& out, const Measurement& measurement) {
+    double itemsPerSecond = measurement.medianNs > 0 ? measurement.itemsCount / measurement.medianNs * 1e9 : 0;
+
+    out << "  " << measurement.name.leftJustified(48)
+        << QString::number(measurement.medianNs / 1e6, 'f', 3).rightJustified(10) << " ms (median)"
+        << QString::number(measurement.minNs / 1e6, 'f', 3).rightJustified(10) << " ms (min)"
+        << QString::number(itemsPerSecond / 1e6, 'f', 1).rightJustified(10) << " M/s\n";
+    out.flush();
+
+    s_measurements.push_back({ s_currentGroup, measurement });
+}
+
+void bench::reportValue(QTextStream& out, const QString& name, const QString& value) {
+    out << "  " << name.leftJustified(48) << value << "\n";
+    out.flush();
+}
+
+uint64_t bench::checksum(const uint32_t* data, size_t count) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < count; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+int bench::runBenchmarks(const QStringList& args) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    int unknown = 0;
+
+    QStringList groupNames;
+    QString jsonFileName;
+    for (qsizetype i = 0; i < args.size(); i++) {
+        if (args[i] == "--json" && i + 1 < args.size()) {
+            jsonFileName = args[++i];
+        } else {
+            groupNames.push_back(args[i]);
+        }
+    }
+
+    for (const QString& name : groupNames) {
+        auto isNamed = [&](const BenchmarkGroup& group) { return name == group.name; };
+        if (std::none_of(std::begin(BENCHMARK_GROUPS), std::end(BENCHMARK_GROUPS), isNamed)) {
+            err << "Unknown benchmark group: " << name << "\n";
+            unknown++;
+        }
+    }
+
+    for (const BenchmarkGroup& group : BENCHMARK_GROUPS) {
+        if (!groupNames.isEmpty() && !groupNames.contains(group.name)) {
+            continue;
+        }
+
+        out << group.name << ":\n";
+        s_currentGroup = group.name;
+        group.run(out);
+        out << "\n";
+    }
+
+    if (!jsonFileName.isEmpty() && !writeJson(jsonFileName)) {
+        err << "Failed to write the file: " << jsonFileName << "\n";
+        unknown++;
+    }
+
+    return unknown;
+}
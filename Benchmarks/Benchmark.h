@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+// Micro-benchmarks of the editor's internals
+// Run from the command line: --benchmark [--json file] [group1 group2 ...], all the groups are run if none is stated
+// With --json the measurements are written to the file as well, so that they can be compared across the commits
+namespace bench {
+	// The result of measuring a piece of code
+	struct Measurement {
+		QString name;
+		uint64_t itemsCount = 0; // Items (e.g. pixels) processed by a single run
+		double medianNs = 0; // Median time of a run
+		double minNs = 0; // The fastest run
+	};
+
+	// Runs the function runsCount times after a warm-up run and measures it
+	Measurement measure(const QString& name, uint64_t itemsCount, uint32_t runsCount, const std::function<void()>& function);
+
+	// The same, but the setup is run before each of the runs and is not measured
+	Measurement measure(const QString& name, uint64_t itemsCount, uint32_t runsCount, const std::function<void()>& setup, const std::function<void()>& function);
+
+	// Prints the measurement as a row: name, median and minimal time in ms, millions of items per second
+	// The measurement is kept for the JSON output as well
+	void report(QTextStream& out, const Measurement& measurement);
+
+	// Prints a named value computed from the benchmarked results,
+	// so that the work is not optimized out and the implementations can be compared
+	void reportValue(QTextStream& out, const QString& name, const QString& value);
+
+	// FNV-1a hash of the data, to compare the results of the implementations
+	uint64_t checksum(const uint32_t* data, size_t count);
+
+	// Benchmark groups
+	void runBlendBenchmarks(QTextStream& out);
+	void runPolygonBenchmarks(QTextStream& out);
+	void runFillBenchmarks(QTextStream& out);
+	void runAllocationBenchmarks(QTextStream& out);
+	void runImageBenchmarks(QTextStream& out);
+	void runScriptBenchmarks(QTextStream& out);
+
+	// Runs the groups named in the arguments (all of them if there are none), returns the number of unknown groups
+	// Writing the JSON file failing counts as an error as well
+	int runBenchmarks(const QStringList& args);
+
+	// Golden images of the drawing functions
+	// Run from the command line: --golden [--update] [--scratch directory] [file], the file is res/golden/drawing.txt if none is stated
+	// Draws the corpus of random primitives and compares each image with the recorded one (or records them with --update),
+	// returns the number of the images that differ
+	// The corpus is checked on an image kept in memory and on one kept in a scratch file in the directory (the system's temporary one by default)
+	int runGoldenImages(const QStringList& args);
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "Benchmark.h"
+#include <cmath>
+#include <random>
+#include <vector>
+#include "../Image/Color.h"
+#include "../Image/PixelKernels.h"
+
+// Full-image composites of 2048 x 2048 pixels
+constexpr uint32_t IMAGE_SIDE = 2048;
+constexpr size_t PIXELS_COUNT = size_t(IMAGE_SIDE) * IMAGE_SIDE;
+constexpr uint32_t RUNS_COUNT = 10;
+
+// The former Color::mix with its multiplication table, kept as the reference point
+// It adds the scaled over color to under without scaling under, so it is not a correct source-over
+struct TableMix {
+    uint8_t table[256][256];
+
+    TableMix() {
+        for (int i = 0; i < 256; ++i) {
+            for (int j = 0; j < 256; ++j) {
+                table[i][j] = uint8_t((i * j) / 255);
+            }
+        }
+    }
+
+    uint32_t mix(uint32_t over, uint32_t under) const {
+        uint32_t ao = over >> 24, au = under >> 24;
+        if (ao == 255 || au == 0) {
+            return over;
+        }
+
+        if (ao == 0) {
+            return under;
+        }
+
+        return under + (table[ao][over & 0xff]
+            | (uint32_t(table[ao][(over >> 8) & 0xff]) << 8)
+            | (uint32_t(table[ao][(over >> 16) & 0xff]) << 16)
+            | (uint32_t(table[ao][(over >> 24) & 0xff]) << 24));
+    }
+};
+
+// The largest difference of a channel from the exact (floating-point) source-over, for straight alpha
+static uint32_t getMaxError(const std::vector<uint32_t>& result, const std::vector<uint32_t>& under, const std::vector<uint32_t>& over) {
+    uint32_t maxError = 0;
+    for (size_t i = 0; i < result.size(); i++) {
+        double ao = (over[i] >> 24) / 255.0, au = (under[i] >> 24) / 255.0;
+        double alpha = ao + au * (1 - ao);
+
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            double co = ((over[i] >> (channel * 8)) & 0xff) / 255.0;
+            double cu = ((under[i] >> (channel * 8)) & 0xff) / 255.0;
+            double exact = channel == 3 ? alpha : (alpha > 0 ? (co * ao + cu * au * (1 - ao)) / alpha : 0);
+
+            int32_t value = int32_t((result[i] >> (channel * 8)) & 0xff);
+            uint32_t error = uint32_t(std::abs(value - int32_t(std::lround(exact * 255))));
+            maxError = error > maxError ? error : maxError;
+        }
+    }
+
+    return maxError;
+}
+
+void bench::runBlendBenchmarks(QTextStream& out) {
+    std::mt19937 random(2023);
+    std::vector<uint32_t> under(PIXELS_COUNT), over(PIXELS_COUNT), result(PIXELS_COUNT);
+    for (size_t i = 0; i < PIXELS_COUNT; i++) {
+        under[i] = random() | 0xff000000; // An opaque image, as the edited ones usually are
+        over[i] = random();
+    }
+
+    std::vector<uint32_t> underPremultiplied = under, overPremultiplied = over;
+    kernels::premultiply(underPremultiplied.data(), PIXELS_COUNT);
+    kernels::premultiply(overPremultiplied.data(), PIXELS_COUNT);
+
+    TableMix tableMix;
+    uint32_t color = Color(200, 100, 50, 128)._data;
+    uint32_t colorPremultiplied = Color(color).premultiplied()._data;
+
+    // Each run starts from the same under image, so the copying is measured separately
+    report(out, measure("copy (included in the rest)", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        kernels::copy(result.data(), under.data(), PIXELS_COUNT);
+    }));
+
+    // Image over image
+    report(out, measure("image: table mix", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        kernels::copy(result.data(), under.data(), PIXELS_COUNT);
+        for (size_t i = 0; i < PIXELS_COUNT; i++) {
+            result[i] = tableMix.mix(over[i], result[i]);
+        }
+    }));
+    reportValue(out, "image: table mix max error", QString::number(getMaxError(result, under, over)));
+
+    report(out, measure("image: Color::mix", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        kernels::copy(result.data(), under.data(), PIXELS_COUNT);
+        for (size_t i = 0; i < PIXELS_COUNT; i++) {
+            result[i] = Color::mix(over[i], result[i])._data;
+        }
+    }));
+    reportValue(out, "image: Color::mix max error", QString::number(getMaxError(result, under, over)));
+
+    report(out, measure("image: kernels::composite", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        kernels::copy(result.data(), under.data(), PIXELS_COUNT);
+        kernels::composite(result.data(), over.data(), PIXELS_COUNT);
+    }));
+    reportValue(out, "image: kernels::composite max error", QString::number(getMaxError(result, under, over)));
+
+    report(out, measure("image: kernels::compositePremultiplied", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        kernels::copy(result.data(), underPremultiplied.data(), PIXELS_COUNT);
+        kernels::compositePremultiplied(result.data(), overPremultiplied.data(), PIXELS_COUNT);
+    }));
+    reportValue(out, "image: premultiplied checksum", QString::number(checksum(result.data(), PIXELS_COUNT), 16));
+
+    // A single color over an image
+    report(out, measure("color: table mix", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        kernels::copy(result.data(), under.data(), PIXELS_COUNT);
+        for (size_t i = 0; i < PIXELS_COUNT; i++) {
+            result[i] = tableMix.mix(color, result[i]);
+        }
+    }));
+    reportValue(out, "color: table mix checksum", QString::number(checksum(result.data(), PIXELS_COUNT), 16));
+
+    report(out, measure("color: kernels::blend", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        kernels::copy(result.data(), under.data(), PIXELS_COUNT);
+        kernels::blend(result.data(), PIXELS_COUNT, color);
+    }));
+    reportValue(out, "color: kernels::blend checksum", QString::number(checksum(result.data(), PIXELS_COUNT), 16));
+
+    report(out, measure("color: kernels::blendPremultiplied", PIXELS_COUNT, RUNS_COUNT, [&]() {
+        kernels::copy(result.data(), underPremultiplied.data(), PIXELS_COUNT);
+        kernels::blendPremultiplied(result.data(), PIXELS_COUNT, colorPremultiplied);
+    }));
+    reportValue(out, "color: kernels::blendPremultiplied checksum", QString::number(checksum(result.data(), PIXELS_COUNT), 16));
+}
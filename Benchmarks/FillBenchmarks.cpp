@@ -0,0 +1,35 @@
+#include "Benchmark.h"
+#include "../Image/Image.h"
+
+// Flood fills of a 100-megapixel image
+constexpr uint32_t IMAGE_SIDE = 10000;
+constexpr uint32_t RUNS_COUNT = 3;
+
+void bench::runFillBenchmarks(QTextStream& out) {
+    Image image;
+    if (!image.newImage(IMAGE_SIDE, IMAGE_SIDE, Color::White).isOk()) {
+        out << "  Failed to allocate the image\n";
+        return;
+    }
+
+    // Dotted walls every few rows, so that the area is a single one, but its spans are short and many
+    for (uint32_t y = 0; y < IMAGE_SIDE; y += 97) {
+        for (uint32_t x = 0; x < IMAGE_SIDE; x += 3) {
+            image.atFast(x, y) = Color::Black;
+        }
+    }
+
+    uint64_t pixelsCount = uint64_t(IMAGE_SIDE) * IMAGE_SIDE;
+    Color colors[2] = { Color(255, 0, 0), Color(0, 0, 255) };
+    uint32_t run = 0;
+
+    // The colors alternate, so that each run fills the whole area again
+    report(out, measure("different color", pixelsCount, RUNS_COUNT, [&]() {
+        image.floodFill(QPoint(1, 1), colors[run++ % 2], 0);
+    }));
+
+    // The fill color is similar to the area's one, so the filled pixels are tracked in a bit mask
+    report(out, measure("similar color, tolerance 8", pixelsCount, RUNS_COUNT, [&]() {
+        image.floodFill(QPoint(1, 1), Color(colors[0].r(), colors[0].g(), uint8_t(run++ % 2)), 8);
+    }));
+}
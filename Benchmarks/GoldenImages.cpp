@@ -0,0 +1,463 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+#include <vector>
+#include <QDir>
+#include <QFile>
+#include "../Image/Image.h"
+#include "../Script/PackedValues.h"
+#include "../Utils/Rasterization.h"
+
+// The corpus of random primitives drawn by the reference implementation, so that the faster ones can be checked to draw the same pixels
+// Each case is a small image with a few primitives of a kind on it, drawn in each of the drawing modes
+// The primitives go beyond the image's borders as well, so that the clipping is checked too
+constexpr uint32_t IMAGE_SIDE = 96;
+constexpr int MARGIN = 32; // How far beyond the borders the primitives can go
+constexpr uint32_t CASES_PER_KIND = 32;
+constexpr uint32_t PRIMITIVES_PER_CASE = 8;
+
+static const char* DEFAULT_GOLDEN_FILE = "res/golden/drawing.txt";
+
+// The anti-aliased edges may change a little with any change of the coverage's computation,
+// so these cases are compared by the sums of the channels of the image's tiles, if their hashes differ
+constexpr uint32_t TILES_PER_SIDE = 4;
+constexpr uint32_t TILE_SIDE = IMAGE_SIDE / TILES_PER_SIDE;
+
+// The largest difference of a tile's mean channel value the anti-aliased cases may have, as if each of its pixels differed by a level
+constexpr double ANTIALIASED_TOLERANCE = 1;
+
+// The drawing modes each case is drawn in
+struct DrawingMode {
+    const char* name;
+    bool isAntialiased;
+    bool isPremultiplied;
+};
+
+static const DrawingMode DRAWING_MODES[] = {
+    { "straight", false, false },
+    { "straight_aa", true, false },
+    { "premultiplied", false, true },
+    { "premultiplied_aa", true, true },
+};
+
+static int randomCoordinate(std::mt19937& random) {
+    return int(random() % (IMAGE_SIDE + 2 * MARGIN)) - MARGIN;
+}
+
+// The random values are taken one by one, since the order of evaluating the arguments differs between the compilers
+static QPoint randomPoint(std::mt19937& random) {
+    int x = randomCoordinate(random);
+    int y = randomCoordinate(random);
+    return QPoint(x, y);
+}
+
+// The centers of the circles are not always in the middle of a pixel
+static QPointF randomCenter(std::mt19937& random) {
+    QPoint pixel = randomPoint(random);
+    double x = pixel.x() + (random() % 4) / 4.0;
+    double y = pixel.y() + (random() % 4) / 4.0;
+    return QPointF(x, y);
+}
+
+// Widths from 1 to maxWidth in quarters of a pixel
+static float randomWidth(std::mt19937& random, uint32_t maxWidth) {
+    return 1 + (random() % (4 * (maxWidth - 1) + 1)) / 4.0f;
+}
+
+// Half of the colors are translucent, so that the blending is checked as well
+static Color randomColor(std::mt19937& random) {
+    uint32_t data = uint32_t(random());
+    return random() % 2 == 0 ? Color(data | Color::ALPHA) : Color(data);
+}
+
+// The lines are of all slopes: random ones, as well as horizontal, vertical and diagonal ones that have fast paths of their own
+static QPoint randomLineEnd(std::mt19937& random, QPoint from) {
+    QPoint to = randomPoint(random);
+    switch (random() % 5) {
+        case 0: return QPoint(to.x(), from.y());
+        case 1: return QPoint(from.x(), to.y());
+        case 2: return from + QPoint(to.x() - from.x(), to.x() - from.x());
+        default: return to;
+    }
+}
+
+// A kind of primitives, draws one of them with the random parameters
+struct PrimitiveKind {
+    const char* name;
+    void (*draw)(Image& image, std::mt19937& random, Color color);
+};
+
+static const PrimitiveKind PRIMITIVE_KINDS[] = {
+    { "thin_line", [](Image& image, std::mt19937& random, Color color) {
+        QPoint from = randomPoint(random);
+        QPoint to = randomLineEnd(random, from);
+        image.drawLine(from, to, 1, color);
+    } },
+    { "wide_line", [](Image& image, std::mt19937& random, Color color) {
+        QPoint from = randomPoint(random);
+        QPoint to = randomLineEnd(random, from);
+        image.drawLine(from, to, randomWidth(random, 24), color);
+    } },
+    { "filled_circle", [](Image& image, std::mt19937& random, Color color) {
+        QPointF center = randomCenter(random);
+        image.fillCircle(center, randomWidth(random, 48) - 0.5f, color);
+    } },
+    { "ring", [](Image& image, std::mt19937& random, Color color) {
+        QPointF center = randomCenter(random);
+        float radius = randomWidth(random, 48);
+        image.drawCircle(center, radius, std::min(randomWidth(random, 16), radius), color);
+    } },
+    { "filled_rect", [](Image& image, std::mt19937& random, Color color) {
+        QPoint from = randomPoint(random);
+        uint32_t width = 1 + random() % IMAGE_SIDE;
+        image.fillRect(from, width, 1 + random() % IMAGE_SIDE, color);
+    } },
+    { "hollow_rect", [](Image& image, std::mt19937& random, Color color) {
+        QPoint from = randomPoint(random);
+        uint32_t width = 2 + random() % IMAGE_SIDE;
+        uint32_t height = 2 + random() % IMAGE_SIDE;
+        image.drawRect(from, width, height, randomWidth(random, std::min(width, height) / 2 + 1), color);
+    } },
+    { "grid", [](Image& image, std::mt19937& random, Color color) {
+        uint32_t columns = 1 + random() % 12;
+        uint32_t rows = 1 + random() % 12;
+        image.splitImageWithGrid(columns, rows, randomWidth(random, 6), color);
+    } },
+    { "polygon", [](Image& image, std::mt19937& random, Color color) {
+        std::vector<QPointF> points(3 + random() % 8);
+        for (QPointF& point : points) {
+            point = randomCenter(random);
+        }
+
+        image.fillPolygon(points, random() % 2 == 0 ? utils::FillRule::NON_ZERO : utils::FillRule::EVEN_ODD, color);
+    } },
+};
+
+// What is kept of a case's image
+struct GoldenImage {
+    uint64_t hash = 0;
+    std::vector<uint64_t> tileSums; // For the anti-aliased cases only
+};
+
+// The cases are seeded by their kind and index only, so that each one is the same whatever the others are
+static void drawCase(Image& image, const DrawingMode& mode, uint32_t kindIndex, uint32_t caseIndex) {
+    std::mt19937 random(kindIndex * CASES_PER_KIND + caseIndex);
+
+    // Opaque, transparent and translucent backgrounds, the blending differs for each of them
+    static const Color BACKGROUNDS[] = { Color::White, Color(0, 0, 0, 0), Color(40, 90, 160, 128) };
+    image.fillImage(BACKGROUNDS[caseIndex % std::size(BACKGROUNDS)]);
+    image.setAntialiased(mode.isAntialiased);
+
+    for (uint32_t i = 0; i < PRIMITIVES_PER_CASE; i++) {
+        Color color = randomColor(random);
+        PRIMITIVE_KINDS[kindIndex].draw(image, random, color);
+    }
+}
+
+// The colors are taken with straight alpha, so the images do not depend on how their pixels are stored
+static GoldenImage takeGoldenImage(const Image& image, bool needsTiles) {
+    std::vector<uint32_t> pixels;
+    pixels.reserve(size_t(IMAGE_SIDE) * IMAGE_SIDE);
+
+    GoldenImage result;
+    if (needsTiles) {
+        result.tileSums.resize(TILES_PER_SIDE * TILES_PER_SIDE, 0);
+    }
+
+    for (uint32_t y = 0; y < IMAGE_SIDE; y++) {
+        for (uint32_t x = 0; x < IMAGE_SIDE; x++) {
+            Color color = image.getColor(x, y);
+            pixels.push_back(color._data);
+
+            // The nearly transparent pixels change their straight colors a lot with a slight change of alpha, so the tiles are summed premultiplied
+            if (needsTiles) {
+                Color premultiplied = color.premultiplied();
+                result.tileSums[(y / TILE_SIDE) * TILES_PER_SIDE + x / TILE_SIDE] += premultiplied.r() + premultiplied.g() + premultiplied.b() + premultiplied.a();
+            }
+        }
+    }
+
+    result.hash = bench::checksum(pixels.data(), pixels.size());
+    return result;
+}
+
+static bool isWithinTolerance(const GoldenImage& golden, const GoldenImage& drawn) {
+    if (golden.tileSums.size() != drawn.tileSums.size()) {
+        return false;
+    }
+
+    double maxDifference = ANTIALIASED_TOLERANCE * TILE_SIDE * TILE_SIDE * 4;
+    for (size_t i = 0; i < golden.tileSums.size(); i++) {
+        if (std::abs(double(golden.tileSums[i]) - double(drawn.tileSums[i])) > maxDifference) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The circles' rows are also checked against the computation of the rasterizer used before the span tables, for all the radii
+// in quarters of a pixel up to CIRCLE_CHECK_RADIUS_MAX and for a few larger ones, whose rows are computed without the tables
+constexpr uint32_t CIRCLE_CHECK_RADIUS_MAX = 512;
+
+// The half-width of the circle's row as the former rasterizer computed it, in double instead of its float,
+// which is exact for these radii, while the float is exact only up to the radius of about 2900
+static int64_t getFormerHalfWidth(float radius, int64_t yDist) {
+    double radiusSqr = (radius + 0.5) * (radius + 0.5);
+    return int64_t(std::sqrt(radiusSqr - double(yDist * yDist)));
+}
+
+// Returns the number of the circles whose rows differ from the former rasterizer's ones
+static int checkCircleRows(QTextStream& err, uint32_t& checkedCount) {
+    struct Circle {
+        QPoint center;
+        float radius;
+    };
+
+    std::vector<Circle> circles;
+    for (uint32_t i = 0; i <= 4 * CIRCLE_CHECK_RADIUS_MAX; i++) {
+        for (QPoint center : { QPoint(48, 48), QPoint(0, 0), QPoint(95, -30), QPoint(-40, 130), QPoint(20, 95) }) {
+            circles.push_back({ center, i / 4.0f });
+        }
+    }
+
+    // Their edges cross the image
+    for (float radius : { 1e4f, 1e5f, 1e6f }) {
+        circles.push_back({ QPoint(48, 40 - int(radius)), radius });
+        circles.push_back({ QPoint(int(radius) - 10, 48), radius });
+        circles.push_back({ QPoint(-int(radius) + 30, int(radius) + 30), radius * 1.4143f });
+    }
+
+    int failedCount = 0;
+    for (const Circle& circle : circles) {
+        double radius = circle.radius + 0.5;
+        int64_t fromY = utils::max(int64_t(0), int64_t(std::ceil(circle.center.y() - radius)));
+        int64_t toY = utils::min(int64_t(IMAGE_SIDE) - 1, int64_t(std::floor(circle.center.y() + radius)));
+
+        utils::CircleRasterizer rast(circle.center, circle.radius, IMAGE_SIDE);
+        bool isSame = true;
+        for (int64_t y = fromY; y <= toY && isSame; y++) {
+            int64_t halfWidth = getFormerHalfWidth(circle.radius, y - circle.center.y());
+            int64_t leftX = utils::max(int64_t(0), circle.center.x() - halfWidth);
+            int64_t rightX = utils::max(int64_t(0), circle.center.x() + halfWidth);
+
+            isSame = rast.hasMore() && rast.getY() == y && rast.leftX() == leftX && rast.rightX() == rightX;
+            rast.nextRow();
+        }
+
+        if (!isSame || rast.hasMore()) {
+            err << "circle at (" << circle.center.x() << ", " << circle.center.y() << ") of radius " << circle.radius
+                << ": differs from the former rasterizer\n";
+            failedCount++;
+        }
+    }
+
+    checkedCount = uint32_t(circles.size());
+    return failedCount;
+}
+
+// The colors the scripts draw with are converted from their channels' values the same way whatever they are,
+// the ones out of int's range saturate as well and NaN is taken as 0
+// Returns the number of the conversions that differ from the expected colors
+static int checkColorConversions(QTextStream& err, uint32_t& checkedCount) {
+    constexpr float NaN = std::numeric_limits<float>::quiet_NaN();
+    constexpr float INF = std::numeric_limits<float>::infinity();
+
+    struct Conversion {
+        float channels[Float4::SIZE];
+        Color expected;
+    };
+
+    static const Conversion CONVERSIONS[] = {
+        { { 0, 127.9f, 255, 256 }, Color(0, 127, 255, 255) },
+        { { -1, -0.5f, 1e10f, 3e9f }, Color(0, 0, 255, 255) },
+        { { 2147483648.f, 4294967296.f, -3e9f, 1e30f }, Color(255, 255, 0, 255) },
+        { { NaN, 12, NaN, 200.5f }, Color(0, 12, 0, 200) },
+        { { INF, -INF, 254.99f, 0.99f }, Color(255, 0, 254, 0) },
+    };
+
+    int failedCount = 0;
+    for (const Conversion& conversion : CONVERSIONS) {
+        Color color = Float4::load(conversion.channels).toColor();
+        if (!(color == conversion.expected)) {
+            err << "color (" << conversion.channels[0] << ", " << conversion.channels[1] << ", " << conversion.channels[2] << ", "
+                << conversion.channels[3] << "): converted to " << QString::number(color._data, 16) << " instead of "
+                << QString::number(conversion.expected._data, 16) << "\n";
+            failedCount++;
+        }
+    }
+
+    checkedCount = uint32_t(std::size(CONVERSIONS));
+    return failedCount;
+}
+
+// A line per case: the name, the hash of its pixels and the sums of its tiles if any
+static std::map<QString, GoldenImage> readGoldenFile(const QString& fileName, bool& isRead) {
+    std::map<QString, GoldenImage> result;
+
+    QFile file(fileName);
+    isRead = file.open(QFile::ReadOnly | QFile::Text);
+    if (!isRead) {
+        return result;
+    }
+
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QStringList parts = in.readLine().split(' ', Qt::SkipEmptyParts);
+        if (parts.size() < 2 || parts[0].startsWith('#')) {
+            continue;
+        }
+
+        GoldenImage& golden = result[parts[0]];
+        golden.hash = parts[1].toULongLong(nullptr, 16);
+        for (qsizetype i = 2; i < parts.size(); i++) {
+            golden.tileSums.push_back(parts[i].toULongLong());
+        }
+    }
+
+    return result;
+}
+
+static bool writeGoldenFile(const QString& fileName, const std::map<QString, GoldenImage>& images) {
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "# The golden images of the drawing functions, recorded with --golden --update\n"
+        << "# Case, FNV-1a hash of its pixels (straight alpha), sums of its tiles' channels for the anti-aliased cases\n";
+
+    for (const auto& [name, golden] : images) {
+        out << name << " " << QString::number(golden.hash, 16).rightJustified(16, '0');
+        for (uint64_t sum : golden.tileSums) {
+            out << " " << QString::number(sum);
+        }
+
+        out << "\n";
+    }
+
+    out.flush();
+    return out.status() == QTextStream::Ok;
+}
+
+// The counts of the drawn images compared with the golden ones
+struct CorpusCounts {
+    uint32_t exactCount = 0;
+    uint32_t toleratedCount = 0;
+    int failedCount = 0;
+};
+
+// Draws the corpus on the image, records the drawn images if -drawnImages- is not null or compares them with the golden ones otherwise
+static CorpusCounts drawCorpus(
+    Image& image, QTextStream& err, const std::map<QString, GoldenImage>& goldenImages, std::map<QString, GoldenImage>* drawnImages
+) {
+    CorpusCounts counts;
+
+    for (const DrawingMode& mode : DRAWING_MODES) {
+        image.setPremultiplied(mode.isPremultiplied);
+
+        for (uint32_t kind = 0; kind < std::size(PRIMITIVE_KINDS); kind++) {
+            for (uint32_t i = 0; i < CASES_PER_KIND; i++) {
+                QString name = QString(PRIMITIVE_KINDS[kind].name) + "/" + mode.name + "/" + QString::number(i).rightJustified(2, '0');
+
+                drawCase(image, mode, kind, i);
+                GoldenImage drawn = takeGoldenImage(image, mode.isAntialiased);
+
+                if (drawnImages != nullptr) {
+                    (*drawnImages)[name] = std::move(drawn);
+                    continue;
+                }
+
+                auto golden = goldenImages.find(name);
+                if (golden == goldenImages.end()) {
+                    err << name << ": not recorded\n";
+                    counts.failedCount++;
+                } else if (golden->second.hash == drawn.hash) {
+                    counts.exactCount++;
+                } else if (mode.isAntialiased && isWithinTolerance(golden->second, drawn)) {
+                    counts.toleratedCount++;
+                } else {
+                    err << name << ": differs from the golden image\n";
+                    counts.failedCount++;
+                }
+            }
+        }
+    }
+
+    return counts;
+}
+
+int bench::runGoldenImages(const QStringList& args) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    bool isUpdating = false;
+    QString fileName = DEFAULT_GOLDEN_FILE;
+    QString scratchDirectory = QDir::tempPath();
+    for (int i = 0; i < args.size(); i++) {
+        if (args[i] == "--update") {
+            isUpdating = true;
+        } else if (args[i] == "--scratch" && i + 1 < args.size()) {
+            scratchDirectory = args[++i];
+        } else {
+            fileName = args[i];
+        }
+    }
+
+    if (isUpdating) {
+        Image image;
+        if (!image.newImage(IMAGE_SIDE, IMAGE_SIDE, Color::White).isOk()) {
+            err << "Failed to allocate the image\n";
+            return 1;
+        }
+
+        std::map<QString, GoldenImage> drawnImages;
+        drawCorpus(image, err, {}, &drawnImages);
+
+        if (!writeGoldenFile(fileName, drawnImages)) {
+            err << "Failed to write the file: " << fileName << "\n";
+            return 1;
+        }
+
+        out << "Recorded " << drawnImages.size() << " golden images to " << fileName << "\n";
+        return 0;
+    }
+
+    bool isRead;
+    std::map<QString, GoldenImage> goldenImages = readGoldenFile(fileName, isRead);
+    if (!isRead) {
+        err << "Failed to open file: " << fileName << "\n";
+        return 1;
+    }
+
+    // The corpus is drawn on an image kept in memory and on one kept in a scratch file, both have to draw the same pixels
+    int failedCount = 0;
+    for (const QString& directory : { QString(), scratchDirectory }) {
+        Image image;
+        image.setScratchDirectory(directory);
+        if (auto result = image.newImage(IMAGE_SIDE, IMAGE_SIDE, Color::White); !result.isOk()) {
+            err << "Failed to allocate the image: " << result.error() << "\n";
+            return 1;
+        }
+
+        CorpusCounts counts = drawCorpus(image, err, goldenImages, nullptr);
+        out << (directory.isEmpty() ? QString("Golden images (in memory): ") : "Golden images (scratch file in " + directory + "): ")
+            << counts.exactCount << " exact, " << counts.toleratedCount << " within the tolerance, " << counts.failedCount << " failed\n";
+
+        failedCount += counts.failedCount;
+    }
+
+    uint32_t circlesCount = 0;
+    int failedCirclesCount = checkCircleRows(err, circlesCount);
+    out << "Circles' rows: " << circlesCount - failedCirclesCount << " of " << circlesCount << " circles are the same as the former rasterizer's\n";
+
+    uint32_t conversionsCount = 0;
+    int failedConversionsCount = checkColorConversions(err, conversionsCount);
+    out << "Colors' conversions: " << conversionsCount - failedConversionsCount << " of " << conversionsCount << " are as expected\n";
+
+    return failedCount + failedCirclesCount + failedConversionsCount;
+}
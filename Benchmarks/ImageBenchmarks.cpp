@@ -0,0 +1,132 @@
+#include "Benchmark.h"
+#include <cmath>
+#include <numbers>
+#include <QDir>
+#include <QFile>
+#include "../Image/Image.h"
+
+// The image operations and the drawing primitives on the images from 1 to 256 megapixels
+// The larger images are run fewer times, a single run of them takes long enough to be measured well
+struct ImageSize {
+    const char* name;
+    uint32_t side;
+    uint32_t runsCount;
+};
+
+static const ImageSize IMAGE_SIZES[] = {
+    { "1 MP", 1024, 10 },
+    { "16 MP", 4096, 3 },
+    { "64 MP", 8192, 2 },
+    { "256 MP", 16384, 1 },
+};
+
+constexpr uint32_t LINES_COUNT = 256;
+constexpr float WIDE_LINE_WIDTH = 16;
+constexpr float CIRCLE_LINE_WIDTH = 16;
+constexpr uint32_t GRID_CELLS = 16;
+constexpr float GRID_LINE_WIDTH = 4;
+
+// Lines across the whole image from the top edge to the bottom one, all at different angles
+static void drawLines(Image& image, float width, Color color) {
+    uint32_t side = image.getWidth();
+    for (uint32_t i = 0; i < LINES_COUNT; i++) {
+        int fromX = int(uint64_t(side - 1) * i / LINES_COUNT);
+        image.drawLine(QPoint(fromX, 0), QPoint(int(side - 1) - fromX, int(side - 1)), width, color);
+    }
+}
+
+// The number of the pixels covered by the lines drawLines() draws
+static uint64_t getLinesArea(uint32_t side, float width) {
+    double length = 0;
+    for (uint32_t i = 0; i < LINES_COUNT; i++) {
+        int fromX = int(uint64_t(side - 1) * i / LINES_COUNT);
+        length += std::hypot(double(int(side - 1) - 2 * fromX), double(side - 1));
+    }
+
+    return uint64_t(length * width);
+}
+
+static void runSizeBenchmarks(QTextStream& out, const ImageSize& size) {
+    QString prefix = QString(size.name) + ": ";
+    uint64_t pixelsCount = uint64_t(size.side) * size.side;
+
+    bench::report(out, bench::measure(prefix + "newImage", pixelsCount, size.runsCount, [&]() {
+        Image image;
+        if (!image.newImage(size.side, size.side, Color::White).isOk()) {
+            out << "  Failed to allocate the image\n";
+        }
+    }));
+
+    Image image;
+    if (!image.newImage(size.side, size.side, Color::White).isOk()) {
+        out << "  Failed to allocate the image\n";
+        return;
+    }
+
+    // The shapes are in the middle of the image, with a margin of an eighth of it
+    uint32_t margin = size.side / 8;
+    uint32_t rectSide = size.side - 2 * margin;
+    QPointF center(size.side / 2.0, size.side / 2.0);
+    float radius = float(rectSide) / 2;
+    Color colors[2] = { Color(255, 0, 0), Color(0, 0, 255) };
+    uint32_t run = 0;
+
+    bench::report(out, bench::measure(prefix + "fillRect", uint64_t(rectSide) * rectSide, size.runsCount, [&]() {
+        image.fillRect(QPoint(margin, margin), rectSide, rectSide, colors[run++ % 2]);
+    }));
+
+    uint64_t circleArea = uint64_t(std::numbers::pi * radius * radius);
+    bench::report(out, bench::measure(prefix + "fillCircle", circleArea, size.runsCount, [&]() {
+        image.fillCircle(center, radius, colors[run++ % 2]);
+    }));
+
+    uint64_t ringArea = uint64_t(2 * std::numbers::pi * radius * CIRCLE_LINE_WIDTH);
+    bench::report(out, bench::measure(prefix + "drawCircle", ringArea, size.runsCount, [&]() {
+        image.drawCircle(center, radius, CIRCLE_LINE_WIDTH, colors[run++ % 2]);
+    }));
+
+    bench::report(out, bench::measure(prefix + "drawLine (thin)", getLinesArea(size.side, 1), size.runsCount, [&]() {
+        drawLines(image, 1, colors[run++ % 2]);
+    }));
+
+    bench::report(out, bench::measure(prefix + "drawLine (wide)", getLinesArea(size.side, WIDE_LINE_WIDTH), size.runsCount, [&]() {
+        drawLines(image, WIDE_LINE_WIDTH, colors[run++ % 2]);
+    }));
+
+    uint64_t gridArea = uint64_t(2 * (GRID_CELLS - 1) * size.side * GRID_LINE_WIDTH);
+    bench::report(out, bench::measure(prefix + "splitImageWithGrid", gridArea, size.runsCount, [&]() {
+        image.splitImageWithGrid(GRID_CELLS, GRID_CELLS, GRID_LINE_WIDTH, colors[run++ % 2]);
+    }));
+
+    // The image is opaque already, so it stays the same for the benchmarks below
+    bench::report(out, bench::measure(prefix + "channelFilter", pixelsCount, size.runsCount, [&]() {
+        image.channelFilter(Color::A, 255);
+    }));
+
+    // The shapes drawn above are on the white background, so there are edges to find
+    bench::report(out, bench::measure(prefix + "emphasizeWhiteAreas", pixelsCount, size.runsCount, [&]() {
+        image.emphasizeWhiteAreas(colors[run++ % 2]);
+    }));
+
+    QString fileName = QDir::temp().filePath("cw2_benchmark.png");
+    bench::report(out, bench::measure(prefix + "storePng", pixelsCount, size.runsCount, [&]() {
+        if (auto result = image.store(fileName); !result.isOk()) {
+            out << "  " << result.error() << "\n";
+        }
+    }));
+
+    bench::report(out, bench::measure(prefix + "openPng", pixelsCount, size.runsCount, [&]() {
+        Image opened;
+        if (auto result = opened.open(fileName); !result.isOk()) {
+            out << "  " << result.error() << "\n";
+        }
+    }));
+
+    QFile::remove(fileName);
+}
+
+void bench::runImageBenchmarks(QTextStream& out) {
+    for (const ImageSize& size : IMAGE_SIZES) {
+        runSizeBenchmarks(out, size);
+    }
+}
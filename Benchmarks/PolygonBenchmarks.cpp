@@ -0,0 +1,100 @@
+#include "Benchmark.h"
+#include <cmath>
+#include <numbers>
+#include <random>
+#include <vector>
+#include "../Image/Image.h"
+
+// Polygons filled on an image of 2048 x 2048 pixels
+constexpr uint32_t IMAGE_SIDE = 2048;
+constexpr uint32_t RUNS_COUNT = 10;
+
+// A star with the points on a circle of outerRadius and the inner corners on a circle of innerRadius
+static std::vector<QPointF> makeStar(QPointF center, uint32_t pointsCount, double outerRadius, double innerRadius) {
+    std::vector<QPointF> result;
+    for (uint32_t i = 0; i < pointsCount * 2; i++) {
+        double angle = std::numbers::pi * i / pointsCount;
+        double radius = i % 2 == 0 ? outerRadius : innerRadius;
+        result.push_back(center + QPointF(std::sin(angle) * radius, -std::cos(angle) * radius));
+    }
+
+    return result;
+}
+
+// The way a script draws a filled star-shaped polygon without fill_polygon:
+// a fan of lines from the center to every pixel along the edges
+static void fillWithLineFan(Image& image, QPointF center, const std::vector<QPointF>& points, Color color) {
+    for (size_t i = 0; i < points.size(); i++) {
+        QPointF from = points[i];
+        QPointF to = points[(i + 1) % points.size()];
+        uint32_t steps = uint32_t(std::ceil(std::max(std::abs(to.x() - from.x()), std::abs(to.y() - from.y())))) + 1;
+
+        for (uint32_t step = 0; step <= steps; step++) {
+            QPointF point = from + (to - from) * (double(step) / steps);
+            image.drawLine(center.toPoint(), point.toPoint(), 2, color);
+        }
+    }
+}
+
+// The number of pixels that differ between the images
+static uint64_t countDifferentPixels(const Image& a, const Image& b) {
+    uint64_t result = 0;
+    for (uint32_t y = 0; y < a.getHeight(); y++) {
+        for (uint32_t x = 0; x < a.getWidth(); x++) {
+            result += !(a.getColor(x, y) == b.getColor(x, y));
+        }
+    }
+
+    return result;
+}
+
+static uint64_t getChecksum(const Image& image) {
+    std::vector<uint32_t> pixels;
+    pixels.reserve(size_t(image.getWidth()) * image.getHeight());
+    for (uint32_t y = 0; y < image.getHeight(); y++) {
+        for (uint32_t x = 0; x < image.getWidth(); x++) {
+            pixels.push_back(image.getColor(x, y)._data);
+        }
+    }
+
+    return bench::checksum(pixels.data(), pixels.size());
+}
+
+void bench::runPolygonBenchmarks(QTextStream& out) {
+    Image polygonImage, fanImage;
+    if (!polygonImage.newImage(IMAGE_SIDE, IMAGE_SIDE, Color::White).isOk() || !fanImage.newImage(IMAGE_SIDE, IMAGE_SIDE, Color::White).isOk()) {
+        out << "  Failed to allocate the images\n";
+        return;
+    }
+
+    Color color = Color(200, 100, 50);
+    QPointF center(IMAGE_SIDE / 2.0, IMAGE_SIDE / 2.0);
+    std::vector<QPointF> star = makeStar(center, 5, IMAGE_SIDE * 0.45, IMAGE_SIDE * 0.18);
+    uint64_t imagePixels = uint64_t(IMAGE_SIDE) * IMAGE_SIDE; // The items are the pixels of the whole image
+
+    report(out, measure("star: fill_polygon", imagePixels, RUNS_COUNT, [&]() {
+        polygonImage.fillPolygon(star, utils::FillRule::NON_ZERO, color);
+    }));
+    report(out, measure("star: fan of lines", imagePixels, RUNS_COUNT, [&]() {
+        fillWithLineFan(fanImage, center, star, color);
+    }));
+    reportValue(out, "star: differing pixels", QString::number(countDifferentPixels(polygonImage, fanImage)));
+
+    // A self-intersecting polygon of many random vertices, the active edge table is long on every row
+    std::mt19937 random(2023);
+    std::uniform_real_distribution<double> coordinate(0, IMAGE_SIDE);
+    std::vector<QPointF> scribble;
+    for (uint32_t i = 0; i < 1000; i++) {
+        scribble.push_back(QPointF(coordinate(random), coordinate(random)));
+    }
+
+    for (utils::FillRule rule : { utils::FillRule::NON_ZERO, utils::FillRule::EVEN_ODD }) {
+        QString name = rule == utils::FillRule::NON_ZERO ? "1000 vertices, non-zero" : "1000 vertices, even-odd";
+        polygonImage.fillImage(Color::White);
+
+        report(out, measure(name, imagePixels, RUNS_COUNT, [&]() {
+            polygonImage.fillPolygon(scribble, rule, color);
+        }));
+        reportValue(out, name + " checksum", QString::number(getChecksum(polygonImage), 16));
+    }
+}
@@ -0,0 +1,239 @@
+#include "Benchmark.h"
+#include <optional>
+#include <QDir>
+#include <QFile>
+#include "../Image/Image.h"
+#include "../Script/Compiler.h"
+#include "../Script/CW2VM.h"
+#include "../Script/Compiler/Lexer.h"
+#include "../Script/Compiler/Parser.h"
+#include "../Script/Compiler/ByteCodeBuilder.h"
+
+// The stages of the CW2 toolchain on the generated scripts of growing size,
+// the VM on the micro-programs, each one stressing a single part of it, and the repository's scripts
+constexpr uint32_t RUNS_COUNT = 5;
+
+// The VM draws on an image of its own, as the offline rendering does
+constexpr uint32_t IMAGE_WIDTH = 640;
+constexpr uint32_t IMAGE_HEIGHT = 480;
+
+// The repository's scripts are animations that never finish, so they are run for a number of frames
+static const char* SCRIPTS_DIRECTORY = "res/scripts";
+constexpr uint32_t FRAMES_COUNT = 100;
+
+// The number of functions in the generated scripts, each one with its global variable and a loop calling it
+static const uint32_t GENERATED_SIZES[] = { 10, 100, 1000 };
+
+// A program with a loop of iterationsCount iterations, substituted for %1 within the source
+struct MicroProgram {
+    const char* name;
+    uint32_t iterationsCount;
+    const char* source;
+};
+
+static const MicroProgram MICRO_PROGRAMS[] = {
+    { "arithmetic loop", 1000000,
+        "let Number s = 0\n"
+        "for i in range(0, %1) {\n"
+        "\tset s to s + i * 3 % 7 - 1\n"
+        "}\n" },
+    { "function calls", 300000,
+        "def add(Number a, Number b) Number {\n"
+        "\treturn a + b\n"
+        "}\n"
+        "let Number s = 0\n"
+        "for i in range(0, %1) {\n"
+        "\tset s to add(s, i)\n"
+        "}\n" },
+    { "local and global variables", 500000,
+        "global Number g = 0\n"
+        "let Number l = 1\n"
+        "for i in range(0, %1) {\n"
+        "\tlet Number t = g + l\n"
+        "\tset g to t % 1000\n"
+        "\tset l to l + 1\n"
+        "}\n" },
+    { "color math", 300000,
+        "let Color c = Color(10, 20, 30, 255)\n"
+        "for i in range(0, %1) {\n"
+        "\tset c to (c * 1.5 + Color(1, 2, 3, 0)) / 1.6\n"
+        "}\n" },
+    { "draw-heavy loop", 5000,
+        "set_image 0\n"
+        "for i in range(0, %1) {\n"
+        "\tset_color Color(i % 256, 128, 255 - i % 256, 255)\n"
+        "\tdraw_line Point(i % Width, 0), Point(Width - i % Width, Height)\n"
+        "\tfill_circle Point(i % Width, i % Height), 4\n"
+        "}\n" },
+};
+
+static bool writeFile(const QString& fileName, const QByteArray& data) {
+    QFile file(fileName);
+    return file.open(QFile::WriteOnly) && file.write(data) == data.size();
+}
+
+// A script with all kinds of statements and expressions, so that all the stages have some work on each of its parts
+static QByteArray generateScript(uint32_t functionsCount) {
+    QString result = "set_image 0\nset_width 2\n\n";
+    for (uint32_t i = 0; i < functionsCount; i++) {
+        QString index = QString::number(i);
+        result += "global Number g" + index + " = " + index + "\n"
+            + "def f" + index + "(Number a, Point p) Number {\n"
+            + "\tlet Number r = a * " + index + " + p.x - p.y / 2\n"
+            + "\tif r > 100 {\n"
+            + "\t\tset r to r % 100\n"
+            + "\t} else {\n"
+            + "\t\tset r to abs(sin(r) * 50)\n"
+            + "\t}\n"
+            + "\treturn r\n"
+            + "}\n"
+            + "for j in range(0, 3) {\n"
+            + "\tset g" + index + " to f" + index + "(g" + index + ", Point(j, " + index + "))\n"
+            + "\tset_color Color(g" + index + " % 255, j * 80, 128, 255)\n"
+            + "\tdraw_line Point(0, 0), Point(" + index + " % Width, g" + index + ")\n"
+            + "}\n\n";
+    }
+
+    return result.toUtf8();
+}
+
+static void runToolchainBenchmarks(QTextStream& out, Image& image, uint32_t functionsCount) {
+    QString prefix = QString::number(functionsCount) + " functions: ";
+    QString scriptPath = QDir::temp().filePath("cw2_benchmark_" + QString::number(functionsCount) + ".cw2");
+
+    QByteArray source = generateScript(functionsCount);
+    std::string text = source.toStdString();
+    if (!writeFile(scriptPath, source)) {
+        out << "  Failed to write the file: " << scriptPath << "\n";
+        return;
+    }
+
+    // The stages are measured on the same source, by its size in bytes
+    uint64_t sourceSize = uint64_t(source.size());
+    bench::report(out, bench::measure(prefix + "lexer", sourceSize, RUNS_COUNT, [&]() {
+        if (auto tokens = Lexer(text).tokenize(); !tokens.isOk()) {
+            out << "  " << tokens.error() << "\n";
+        }
+    }));
+
+    auto tokens = Lexer(text).tokenize();
+    if (!tokens.isOk()) {
+        return;
+    }
+
+    // Each run parses anew into the new arena and builder, as the compiler does
+    QList<Token> allTokens = tokens.extract();
+    QList<Token> runTokens;
+    std::optional<ByteCodeBuilder> program;
+    std::optional<utils::Arena> arena;
+
+    auto prepareParsing = [&]() {
+        runTokens = allTokens;
+        program.emplace();
+        arena.emplace();
+    };
+
+    bench::report(out, bench::measure(prefix + "parser", sourceSize, RUNS_COUNT, prepareParsing, [&]() {
+        if (auto ast = Parser(std::move(runTokens), *arena, *program).parse(); !ast.isOk()) {
+            out << "  " << ast.error() << "\n";
+        }
+    }));
+
+    QList<State*> states;
+    auto prepareGeneration = [&]() {
+        prepareParsing();
+        auto ast = Parser(std::move(runTokens), *arena, *program).parse();
+        states = ast.isOk() ? ast.extract() : QList<State*>();
+    };
+
+    QString compiledPath = scriptPath + "c";
+    bench::report(out, bench::measure(prefix + "codegen", sourceSize, RUNS_COUNT, prepareGeneration, [&]() {
+        if (auto result = Compiler::generate(states, *program); !result.isOk()) {
+            out << "  " << result.error() << "\n";
+        } else if (auto result = program->buildAndStore(compiledPath); !result.isOk()) {
+            out << "  " << result.error() << "\n";
+        }
+    }));
+
+    bench::report(out, bench::measure(prefix + "whole compilation", sourceSize, RUNS_COUNT, [&]() {
+        if (auto result = Compiler(false).compile(scriptPath); !result.isOk()) {
+            out << "  " << result.error() << "\n";
+        }
+    }));
+
+    // Loading includes the verification of the bytecode, measured by the size of the compiled file
+    CW2VM vm(&image);
+    bench::report(out, bench::measure(prefix + "cw2c load", uint64_t(QFile(compiledPath).size()), RUNS_COUNT, [&]() {
+        if (auto result = vm.loadFromFile(compiledPath); !result.isOk()) {
+            out << "  " << result.error() << "\n";
+        }
+    }));
+
+    QFile::remove(scriptPath);
+    QFile::remove(compiledPath);
+}
+
+// Compiles the script and measures running it: till it is finished or for the frames count if it is set
+static void runScriptBenchmark(QTextStream& out, Image& image, const QString& name, const QString& scriptPath, uint64_t itemsCount, uint32_t framesCount) {
+    QString compiledPath = scriptPath + "c";
+    if (auto result = Compiler(false).compile(scriptPath); !result.isOk()) {
+        out << "  " << name << ": " << result.error() << "\n";
+        return;
+    }
+
+    // The loaded code is freed once the script is finished, so it is loaded anew for each run
+    CW2VM vm(&image);
+    auto load = [&]() {
+        if (auto result = vm.loadFromFile(compiledPath); !result.isOk()) {
+            out << "  " << result.error() << "\n";
+        }
+    };
+
+    bench::report(out, bench::measure(name, itemsCount, RUNS_COUNT, load, [&]() {
+        if (framesCount == 0) {
+            vm.execute();
+        } else if (auto result = vm.render(nullptr, framesCount); !result.isOk()) {
+            out << "  " << result.error() << "\n";
+        }
+    }));
+
+    QFile::remove(compiledPath);
+}
+
+void bench::runScriptBenchmarks(QTextStream& out) {
+    Image image;
+    if (!image.newImage(IMAGE_WIDTH, IMAGE_HEIGHT, Color::White).isOk()) {
+        out << "  Failed to allocate the image\n";
+        return;
+    }
+
+    for (uint32_t functionsCount : GENERATED_SIZES) {
+        runToolchainBenchmarks(out, image, functionsCount);
+    }
+
+    // The micro-programs are measured by their loops' iterations
+    for (const MicroProgram& program : MICRO_PROGRAMS) {
+        QString scriptPath = QDir::temp().filePath("cw2_benchmark_program.cw2");
+        if (!writeFile(scriptPath, QString(program.source).arg(program.iterationsCount).toUtf8())) {
+            out << "  Failed to write the file: " << scriptPath << "\n";
+            continue;
+        }
+
+        runScriptBenchmark(out, image, QString("VM: ") + program.name, scriptPath, program.iterationsCount, 0);
+        QFile::remove(scriptPath);
+    }
+
+    // The scripts are compiled in the temporary directory, so that the repository's one is left as it is
+    QDir scriptsDirectory(SCRIPTS_DIRECTORY);
+    for (const QString& fileName : scriptsDirectory.entryList({ "*.cw2" }, QDir::Files)) {
+        QString scriptPath = QDir::temp().filePath("cw2_benchmark_" + fileName);
+        QFile::remove(scriptPath);
+        if (!QFile::copy(scriptsDirectory.filePath(fileName), scriptPath)) {
+            out << "  Failed to copy the file: " << fileName << "\n";
+            continue;
+        }
+
+        runScriptBenchmark(out, image, fileName + ", " + QString::number(FRAMES_COUNT) + " frames", scriptPath, FRAMES_COUNT, FRAMES_COUNT);
+        QFile::remove(scriptPath);
+    }
+}
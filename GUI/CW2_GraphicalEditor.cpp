@@ -1,4 +1,5 @@
 #include "CW2_GraphicalEditor.h"
+#include <memory>
 #include <QtWidgets/QFileDialog>
 #include <QBoxLayout>
 #include <QFormLayout>
@@ -9,6 +10,9 @@
 #include <QLabel>
 #include <QEventLoop>
 #include <QCloseEvent>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
 #include "../Utils/ScopeExit.h"
 #include "ImageWindow.h"
 #include "HelpWindow.h"
@@ -42,10 +46,15 @@ CW2_GraphicalEditor::~CW2_GraphicalEditor() {
 
 }
 
+void CW2_GraphicalEditor::setScratchDirectory(const QString& directory) {
+    m_editScene->getImage().setScratchDirectory(directory);
+}
+
 void CW2_GraphicalEditor::loadIcons() {
     m_movingToolIcon = QIcon("res/icon/moving_tool.png");
     m_penToolIcon = QIcon("res/icon/pen_tool.png");
     m_pickToolIcon = QIcon("res/icon/pick_tool.png");
+    m_fillToolIcon = QIcon("res/icon/fill_tool.png");
 }
 
 void CW2_GraphicalEditor::setupUI() {
@@ -80,6 +89,17 @@ void CW2_GraphicalEditor::setupUI() {
     connect(m_exitAction, SIGNAL(triggered()), this, SLOT(exitFileSlot()));
 
 
+    // Edit actions
+    m_undoAction = new QAction(tr("Undo"), this);
+    m_undoAction->setShortcut(QKeySequence::Undo);
+    m_undoAction->setStatusTip(tr("Reverts the last change of the image"));
+
+
+    m_redoAction = new QAction(tr("Redo"), this);
+    m_redoAction->setShortcut(QKeySequence::Redo);
+    m_redoAction->setStatusTip(tr("Repeats the last reverted change of the image"));
+
+
     // Tool actions
     m_componentFilterAction = new QAction(tr("Filter by channel"), this);
     m_componentFilterAction->setStatusTip(tr("Sets the value of some color channel to a fixed value"));
@@ -111,6 +131,21 @@ void CW2_GraphicalEditor::setupUI() {
     connect(m_emphasizeWhiteAreas, SIGNAL(triggered()), this, SLOT(emphasizeToolSlot()));
 
 
+    m_fillToleranceAction = new QAction(tr("Fill tolerance"), this);
+    m_fillToleranceAction->setStatusTip(tr("Sets how much the colors filled by the fill tool can differ from the chosen one"));
+    connect(m_fillToleranceAction, SIGNAL(triggered()), this, SLOT(fillToleranceToolSlot()));
+
+
+    m_antialiasingAction = new QAction(tr("Anti-aliasing"), this);
+    m_antialiasingAction->setStatusTip(tr("Draws lines and circles with smooth edges"));
+    m_antialiasingAction->setCheckable(true);
+
+
+    m_premultipliedAlphaAction = new QAction(tr("Premultiplied alpha"), this);
+    m_premultipliedAlphaAction->setStatusTip(tr("Keeps the image with premultiplied alpha: blending and displaying are faster, files are not affected"));
+    m_premultipliedAlphaAction->setCheckable(true);
+
+
     // Script actions
     m_buildScriptAction = new QAction(tr("Build"), this);
     m_buildScriptAction->setStatusTip(tr("Builds the chosen cw2 script file"));
@@ -127,6 +162,16 @@ void CW2_GraphicalEditor::setupUI() {
     connect(m_runScriptAction, SIGNAL(triggered()), this, SLOT(runScriptSlot()));
 
 
+    m_renderScriptAction = new QAction(tr("Render to files"), this);
+    m_renderScriptAction->setStatusTip(tr("Runs the chosen script slot on a copy of the image and writes its updates to png files or a y4m video as fast as they are drawn"));
+    connect(m_renderScriptAction, SIGNAL(triggered()), this, SLOT(renderScriptSlot()));
+
+
+    m_framePacingAction = new QAction(tr("Frame pacing"), this);
+    m_framePacingAction->setStatusTip(tr("Shows the frame times and the missed ticks of the animated script"));
+    connect(m_framePacingAction, SIGNAL(triggered()), this, SLOT(framePacingSlot()));
+
+
     // Separate actions
     m_imageAction = new QAction(tr("Image"), this);
     m_imageAction->setStatusTip(tr("Information about the image"));
@@ -149,6 +194,11 @@ void CW2_GraphicalEditor::setupUI() {
     m_fileMenu->addAction(m_exitAction);
 
 
+    m_editMenu = menuBar()->addMenu(tr("Edit"));
+    m_editMenu->addAction(m_undoAction);
+    m_editMenu->addAction(m_redoAction);
+
+
     m_toolsMenu = menuBar()->addMenu(tr("Tools"));
     m_toolsMenu->addAction(m_componentFilterAction);
     m_toolsMenu->addAction(m_imageSplitAction);
@@ -156,12 +206,19 @@ void CW2_GraphicalEditor::setupUI() {
     m_toolsMenu->addAction(m_drawCircleAction);
     m_toolsMenu->addAction(m_drawRectAction);
     m_toolsMenu->addAction(m_emphasizeWhiteAreas);
+    m_toolsMenu->addAction(m_fillToleranceAction);
+    m_toolsMenu->addSeparator();
+    m_toolsMenu->addAction(m_antialiasingAction);
+    m_toolsMenu->addAction(m_premultipliedAlphaAction);
 
 
     m_scriptMenu = menuBar()->addMenu(tr("Script"));
     m_scriptMenu->addAction(m_buildScriptAction);
     m_scriptMenu->addAction(m_buildAndRunScriptAction);
     m_scriptMenu->addAction(m_runScriptAction);
+    m_scriptMenu->addAction(m_renderScriptAction);
+    m_scriptMenu->addSeparator();
+    m_scriptMenu->addAction(m_framePacingAction);
 
 
     menuBar()->addAction(m_imageAction);
@@ -185,11 +242,17 @@ void CW2_GraphicalEditor::setupUI() {
     m_pickToolButton->setShortcut(Qt::Key_3);
     m_pickToolButton->setWhatsThis("Allows to pick a color from the image");
 
+    m_fillToolButton = new QRadioButton();
+    m_fillToolButton->setIcon(m_fillToolIcon);
+    m_fillToolButton->setShortcut(Qt::Key_4);
+    m_fillToolButton->setWhatsThis("Allows to fill an area of similar color with the current color");
+
 
     m_toolActionsGroup = new QButtonGroup();
     m_toolActionsGroup->addButton(m_movingToolButton, (int)ToolType::MOVING);
     m_toolActionsGroup->addButton(m_penToolButton, (int)ToolType::PEN);
     m_toolActionsGroup->addButton(m_pickToolButton, (int)ToolType::PICK_COLOR);
+    m_toolActionsGroup->addButton(m_fillToolButton, (int)ToolType::FILL);
     connect(m_toolActionsGroup, SIGNAL(idClicked(int)), this, SLOT(toolButtonClickedSlot(int)));
 
 
@@ -201,6 +264,7 @@ void CW2_GraphicalEditor::setupUI() {
     actionLayout->addWidget(m_movingToolButton, 0, Qt::AlignLeft);
     actionLayout->addWidget(m_penToolButton, 0, Qt::AlignLeft);
     actionLayout->addWidget(m_pickToolButton, 0, Qt::AlignLeft);
+    actionLayout->addWidget(m_fillToolButton, 0, Qt::AlignLeft);
     actionLayout->addWidget(createVerticalLine(2, "color: rgba(0, 5, 5, 25%)"), 0, Qt::AlignLeft);
     actionLayout->addWidget(m_currentColorLabel);
 
@@ -217,6 +281,10 @@ void CW2_GraphicalEditor::setupUI() {
     m_editScene->setParentView(m_editView);
 
     connect(m_currentColorLabel, SIGNAL(colorChanged(Color)), m_editScene, SLOT(onColorChanged(Color)));
+    connect(m_antialiasingAction, SIGNAL(toggled(bool)), m_editScene, SLOT(onAntialiasingToggled(bool)));
+    connect(m_premultipliedAlphaAction, SIGNAL(toggled(bool)), m_editScene, SLOT(onPremultipliedAlphaToggled(bool)));
+    connect(m_undoAction, SIGNAL(triggered()), m_editScene, SLOT(onUndo()));
+    connect(m_redoAction, SIGNAL(triggered()), m_editScene, SLOT(onRedo()));
 
     m_toolWidthSlider = new EditSlider(nullptr, Qt::Vertical, 1, 512, 1);
     m_toolWidthSlider->setFixedWidth(45);
@@ -348,19 +416,30 @@ void CW2_GraphicalEditor::openFileSlot() {
         return;
     }
 
-    disableWindow();
-    at_scope_exit{ enableWindow(); };
-
-    openProgressDialog(this, "Opening a file: " + fileName);
-    at_scope_exit{ closeProgressDialog(); };
+    // The image is loaded in background and replaces the current one only when it is ready
+    auto image = std::make_shared<Image>();
+    image->setScratchDirectory(m_editScene->getImage().getScratchDirectory());
+    runWithProgressDialog(
+        this,
+        "Opening a file: " + fileName,
+        [image, fileName](utils::ProgressToken& token) {
+            return image->open(fileName, &token);
+        },
+        [this, image, fileName](utils::Result<Void> result) {
+            if (!result.isOk()) {
+                errorMessage(result.error());
+                return;
+            }
 
-    if (auto result = m_editScene->openImage(fileName); !result.isOk()) {
-        errorMessage(result.error());
-        return;
-    }
+            if (auto openResult = m_editScene->setOpenedImage(std::move(*image)); !openResult.isOk()) {
+                errorMessage(openResult.error());
+                return;
+            }
 
-    m_currentColorLabel->setOpenColorChoiceOnClick(true);
-    setWindowTitle(QString(fileName) + " : " + tr(BASIC_TITLE));
+            m_currentColorLabel->setOpenColorChoiceOnClick(true);
+            setWindowTitle(QString(fileName) + " : " + tr(BASIC_TITLE));
+        }
+    );
 }
 
 void CW2_GraphicalEditor::saveFileSlot() {
@@ -383,12 +462,7 @@ void CW2_GraphicalEditor::saveFileSlot() {
         return;
     }
 
-    openProgressDialog(this, "Saving the file: " + fileName);
-    at_scope_exit{ closeProgressDialog(); };
-    
-    if (auto result = m_editScene->saveImage(fileName); !result.isOk()) {
-        errorMessage(result.error());
-    }
+    saveImageInBackground(fileName);
 }
 
 void CW2_GraphicalEditor::saveAsFileSlot() {
@@ -407,12 +481,37 @@ void CW2_GraphicalEditor::saveAsFileSlot() {
         "Image (*.png);;Image (*.jpg);;Image (*.jpeg);;Windows Bitmap (*.bmp)"
     );
 
-    openProgressDialog(this, "Saving the file: " + fileName);
-    at_scope_exit{ closeProgressDialog(); };
+    if (fileName.isEmpty()) { // Nothing chosen
+        return;
+    }
+
+    saveImageInBackground(fileName);
+}
 
-    if (auto result = m_editScene->saveImage(fileName); !result.isOk()) {
+void CW2_GraphicalEditor::saveImageInBackground(const QString& fileName) {
+    // A copy is saved, so that the image can be changed meanwhile
+    auto image = std::make_shared<Image>();
+    if (auto result = m_editScene->getImage().copyTo(*image); !result.isOk()) {
         errorMessage(result.error());
+        return;
     }
+
+    uint64_t version = m_editScene->getImageVersion();
+    runWithProgressDialog(
+        this,
+        "Saving the file: " + fileName,
+        [image, fileName](utils::ProgressToken& token) {
+            return image->store(fileName, &token);
+        },
+        [this, image, version](utils::Result<Void> result) {
+            if (!result.isOk()) {
+                errorMessage(result.error());
+                return;
+            }
+
+            m_editScene->onImageCopySaved(*image, version);
+        }
+    );
 }
 
 void CW2_GraphicalEditor::exitFileSlot() {
@@ -481,7 +580,25 @@ void CW2_GraphicalEditor::splitToolSlot() {
 
         QString path = dialog->getFilePathEditValue(pathId);
 
-        m_editScene->splitImageIntoSubimages(N, M, path);
+        // The files are stored from a copy in background, so that the image can be changed meanwhile
+        auto image = std::make_shared<Image>();
+        if (auto result = m_editScene->getImage().copyTo(*image); !result.isOk()) {
+            errorMessage(result.error());
+            return;
+        }
+
+        runWithProgressDialog(
+            this,
+            "Splitting into subimages: " + path,
+            [image, N, M, path](utils::ProgressToken& token) {
+                return image->splitImageIntoSubimages(N, M, path, &token);
+            },
+            [this](utils::Result<Void> result) {
+                if (!result.isOk()) {
+                    errorMessage(result.error());
+                }
+            }
+        );
     }
 }
 
@@ -614,7 +731,50 @@ void CW2_GraphicalEditor::emphasizeToolSlot() {
     if (dialog->exec() == QDialog::Accepted) {
         Color color = dialog->getColorLabelValue(colorId);
 
-        m_editScene->emphasizeWhiteAreas(color);
+        // The areas are emphasized on a copy in background, the copy replaces the image once it is ready
+        auto image = std::make_shared<Image>();
+        if (auto result = m_editScene->getImage().copyTo(*image); !result.isOk()) {
+            errorMessage(result.error());
+            return;
+        }
+
+        uint64_t version = m_editScene->getImageVersion();
+        runWithProgressDialog(
+            this,
+            "Emphasizing white areas",
+            [image, color](utils::ProgressToken& token) -> utils::Result<Void> {
+                image->emphasizeWhiteAreas(color, &token);
+                if (token.isCancelled()) {
+                    return utils::Failure("Emphasizing white areas is cancelled");
+                }
+
+                return utils::Success();
+            },
+            [this, image, version](utils::Result<Void> result) {
+                if (!result.isOk()) {
+                    errorMessage(result.error());
+                    return;
+                }
+
+                if (!m_editScene->onImageCopyChanged("Emphasize white areas", *image, version)) {
+                    errorMessage("The image was changed while its white areas were emphasized, the result is dropped.");
+                }
+            }
+        );
+    }
+}
+
+void CW2_GraphicalEditor::fillToleranceToolSlot() {
+    CustomInputDialog* dialog = new CustomInputDialog(this, "Fill tolerance");
+
+    EditSlider* toleranceSlider = new EditSlider(nullptr, Qt::Horizontal, 0, 255, 1);
+    toleranceSlider->setValue(m_editScene->getFillTolerance());
+    int toleranceId = dialog->addEditSlider("Maximal channel difference:", toleranceSlider);
+
+    dialog->finishSetupUI();
+
+    if (dialog->exec() == QDialog::Accepted) {
+        m_editScene->setFillTolerance((uint8_t)dialog->getEditSliderValue(toleranceId));
     }
 }
 
@@ -706,6 +866,119 @@ void CW2_GraphicalEditor::runScriptSlot() {
     }
 }
 
+void CW2_GraphicalEditor::renderScriptSlot() {
+    if (!m_editScene->isImageOpened()) {
+        errorMessage("No image opened. Nowhere to execute the script on.");
+        return;
+    }
+
+    CustomInputDialog* dialog = new CustomInputDialog(this, "Rendering a script");
+
+    int fileId = dialog->addFilePathEdit("CW2 compiled script file:", new FilePathEdit(nullptr, "", "CW2 compiled script (*.cw2c)", false));
+    int directoryId = dialog->addFilePathEdit("Output directory:", new FilePathEdit(nullptr, QDir::currentPath()));
+    int isVideoId = dialog->addCheckBox("Write a y4m video instead of png files", new QCheckBox());
+
+    EditSlider* framesSlider = new EditSlider(nullptr, Qt::Horizontal, 1, 10000, 1);
+    framesSlider->setValue(250);
+    int framesId = dialog->addEditSlider("Frames count:", framesSlider);
+
+    EditSlider* frameRateSlider = new EditSlider(nullptr, Qt::Horizontal, 1, 120, 1);
+    frameRateSlider->setValue(25);
+    int frameRateId = dialog->addEditSlider("Frame rate:", frameRateSlider);
+
+    dialog->finishSetupUI();
+
+    if (dialog->exec() != QDialog::Accepted) {
+        return;
+    }
+
+    QString scriptPath = dialog->getFilePathEditValue(fileId);
+    QString directory = dialog->getFilePathEditValue(directoryId);
+    bool isVideo = dialog->getCheckBoxValue(isVideoId);
+    uint32_t framesCount = uint32_t(dialog->getEditSliderValue(framesId));
+    float frameRate = float(dialog->getEditSliderValue(frameRateId));
+
+    // The video is named after the script, the png files are named after the frames
+    FrameRecorder::Format format = isVideo ? FrameRecorder::Format::Y4M : FrameRecorder::Format::PNG_SEQUENCE;
+    QString outputPath = isVideo ? QDir(directory).filePath(QFileInfo(scriptPath).completeBaseName() + ".y4m") : directory;
+
+    // The script draws on a copy, so that the image can be changed meanwhile
+    auto image = std::make_shared<Image>();
+    if (auto result = m_editScene->getImage().copyTo(*image); !result.isOk()) {
+        errorMessage(result.error());
+        return;
+    }
+
+    runWithProgressDialog(
+        this,
+        "Rendering the script: " + scriptPath,
+        [image, scriptPath, outputPath, format, framesCount, frameRate](utils::ProgressToken& token) -> utils::Result<Void> {
+            CW2VM vm(image.get());
+            if (auto result = vm.loadFromFile(scriptPath); !result.isOk()) {
+                return result.extractError();
+            }
+
+            FrameRecorder recorder;
+            if (auto result = recorder.open(outputPath, format, image->getWidth(), image->getHeight(), frameRate); !result.isOk()) {
+                return result.extractError();
+            }
+
+            // The frames already added are written anyway, the rendering error is the one to report
+            auto renderResult = vm.render(&recorder, framesCount, &token);
+            auto finishResult = recorder.finish();
+            if (!renderResult.isOk()) {
+                return renderResult.extractError();
+            } else if (!finishResult.isOk()) {
+                return finishResult.extractError();
+            }
+
+            return utils::Success();
+        },
+        [this, outputPath](utils::Result<Void> result) {
+            if (!result.isOk()) {
+                errorMessage(result.error());
+                return;
+            }
+
+            QMessageBox msg;
+            msg.information(this, "CW2 rendering", "Rendering finished: the frames are stored to " + outputPath);
+        }
+    );
+}
+
+void CW2_GraphicalEditor::framePacingSlot() {
+    if (m_cw2VM == nullptr || m_cw2VM->getFramePacingReport().framesCount == 0) {
+        errorMessage("No frames shown yet. Run a script that sets frame_rate and updates the image.");
+        return;
+    }
+
+    QString report = m_cw2VM->getFramePacingReport().toText();
+
+    QMessageBox msg(QMessageBox::Information, "Frame pacing", report, QMessageBox::Save | QMessageBox::Close, this);
+    if (msg.exec() != QMessageBox::Save) {
+        return;
+    }
+
+    QString fileName = QFileDialog::getSaveFileName(
+        this,
+        tr("Select the file where to save the report"),
+        QDir::currentPath(),
+        "Text file (*.txt)"
+    );
+
+    if (fileName.isEmpty()) { // Nothing chosen
+        return;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        errorMessage("Failed to open file: " + fileName);
+        return;
+    }
+
+    QTextStream(&file) << report << "\n";
+}
+
 void CW2_GraphicalEditor::imageSlot() {
     if (!m_editScene->isImageOpened()) {
         errorMessage("No image opened. Open an image or create a new one before using this menu.");
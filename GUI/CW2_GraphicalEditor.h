@@ -25,6 +25,7 @@ private:
 
     // The upper menus
     QMenu* m_fileMenu;
+    QMenu* m_editMenu;
     QMenu* m_toolsMenu;
     QMenu* m_scriptMenu;
 
@@ -35,6 +36,10 @@ private:
     QAction* m_saveAsFileAction;
     QAction* m_exitAction;
 
+    // Actions in the edit menu
+    QAction* m_undoAction;
+    QAction* m_redoAction;
+
     // Actions in the tool menu
     QAction* m_componentFilterAction;
     QAction* m_imageSplitAction;
@@ -42,11 +47,16 @@ private:
     QAction* m_drawCircleAction;
     QAction* m_drawRectAction;
     QAction* m_emphasizeWhiteAreas;
+    QAction* m_fillToleranceAction;
+    QAction* m_antialiasingAction;
+    QAction* m_premultipliedAlphaAction;
 
     // Actions in the script menu
     QAction* m_buildScriptAction;
     QAction* m_buildAndRunScriptAction;
     QAction* m_runScriptAction;
+    QAction* m_renderScriptAction;
+    QAction* m_framePacingAction;
 
     // Independent buttons in the upper menubar
     QAction* m_imageAction;
@@ -58,6 +68,7 @@ private:
     QRadioButton* m_movingToolButton;
     QRadioButton* m_penToolButton;
     QRadioButton* m_pickToolButton;
+    QRadioButton* m_fillToolButton;
 
     ColorLabel* m_currentColorLabel;
 
@@ -73,6 +84,7 @@ private:
     QIcon m_movingToolIcon;
     QIcon m_penToolIcon;
     QIcon m_pickToolIcon;
+    QIcon m_fillToolIcon;
 
     size_t m_disableWindowCounter = 0;
 
@@ -81,6 +93,9 @@ public:
     CW2_GraphicalEditor(QWidget *parent = nullptr);
     ~CW2_GraphicalEditor();
 
+    // The images created and opened afterwards keep their pixels in scratch files in the directory, or in memory if it is empty
+    void setScratchDirectory(const QString& directory);
+
 private:
     void loadIcons();
     void setupUI();
@@ -93,6 +108,9 @@ private:
     void disableWindow();
     void enableWindow();
 
+    // Saves a copy of the current image on the thread pool
+    void saveImageInBackground(const QString& fileName);
+
 private slots:
     // File slots
     void newFileSlot();
@@ -108,11 +126,14 @@ private slots:
     void circleToolSlot();
     void rectToolSlot();
     void emphasizeToolSlot();
+    void fillToleranceToolSlot();
 
     // Script slots
     void buildScriptSlot();
     void buildAndRunScriptSlot();
     void runScriptSlot();
+    void renderScriptSlot();
+    void framePacingSlot();
 
     // Independent slots
     void imageSlot();
@@ -4,10 +4,14 @@
 #include <QScrollBar>
 #include <QGraphicsItem>
 #include "../Utils/MathUtils.h"
+#include "../Utils/Trace.h"
 
 constexpr qreal MAX_ZOOM_OUT = 1000;
 constexpr qreal MAX_ZOOM_IN = 0.01;
 
+// How long the image must not change before the history is compressed, in milliseconds
+constexpr int HISTORY_COMPRESSION_DELAY = 1000;
+
 ImageEditScene::ImageEditScene(
 	QObject* parent,
 	QLabel* isSavedHint,
@@ -20,7 +24,8 @@ ImageEditScene::ImageEditScene(
 	m_pixelUnderCursorHint(pixelHint),
 	m_imageSizeHint(sizeHint),
 	m_colorLabel(colorLabel) {
-	
+	m_historyCompressionTimer.setSingleShot(true);
+	connect(&m_historyCompressionTimer, &QTimer::timeout, this, &ImageEditScene::onHistoryCompressionTimeout);
 }
 
 // Addidng and setting up the QGraphicsView
@@ -59,42 +64,53 @@ utils::Result<Void> ImageEditScene::newImage(QSize size, Color fillColor) {
 	return updateImage();
 }
 
-// Opens a new image
-// If failed, returns false, otherwise true
-utils::Result<Void> ImageEditScene::openImage(const QString& fileName) {
+// Opens an already loaded image
+utils::Result<Void> ImageEditScene::setOpenedImage(Image&& image) {
 	clear();
-	if (auto result = m_image.open(fileName); !result.isOk()) {
-		return result;
-	}
+	m_image = std::move(image);
 
 	onImageOpen(false, m_image.getSize());
 
 	return updateImage();
 }
 
-// Saves the image to the file.
-// Returns true on success and false otherwise.
-utils::Result<Void> ImageEditScene::saveImage(const QString& fileName) {
-	assert(m_isImageOpened);
+// The saved copy might be outdated, if the image was changed or another one was opened meanwhile
+void ImageEditScene::onImageCopySaved(const Image& savedCopy, uint64_t version) {
+	if (version != m_imageVersion) {
+		return;
+	}
 
+	m_image.copyFileInfoFrom(savedCopy);
 	onImageSave();
-	return m_image.store(fileName);
+}
+
+bool ImageEditScene::onImageCopyChanged(const QString& stepName, Image& changedCopy, uint64_t version) {
+	if (version != m_imageVersion) {
+		return false;
+	}
+
+	m_history.beginStep(stepName);
+	m_image.copyFrom(changedCopy);
+	m_history.endStep();
+
+	onImageChange();
+	return true;
 }
 
 void ImageEditScene::channelFilter(bool red, bool green, bool blue, bool alpha, uint8_t value) {
 	Color::Channel channel = Color::getChannel(red, green, blue, alpha);
 
+	m_history.beginStep("Filter by channel");
 	m_image.channelFilter(channel, value);
+	m_history.endStep();
 
 	onImageChange();
 }
 
-void ImageEditScene::splitImageIntoSubimages(uint32_t N, uint32_t M, const QString& basicName) {
-	m_image.splitImageIntoSubimages(N, M, basicName);
-}
-
 void ImageEditScene::splitImageWithGrid(uint32_t N, uint32_t M, float lineWidth, Color color) {
+	m_history.beginStep("Split image with grid");
 	m_image.splitImageWithGrid(N, M, lineWidth, color);
+	m_history.endStep();
 
 	onImageChange();
 }
@@ -107,7 +123,9 @@ void ImageEditScene::drawComplexCircle(
 	Color fillColor,
 	bool needsFill
 ) {
+	m_history.beginStep("Draw circle");
 	m_image.drawComplexCircle(center, radius, lineWidth, lineColor, fillColor, needsFill);
+	m_history.endStep();
 
 	onImageChange();
 }
@@ -120,13 +138,9 @@ void ImageEditScene::drawSquareWithDiagonals(
 	Color fillColor,
 	bool needsFill
 ) {
+	m_history.beginStep("Draw square");
 	m_image.drawSquareWithDiagonals(from, side, lineWidth, lineColor, fillColor, needsFill);
-
-	onImageChange();
-}
-
-void ImageEditScene::emphasizeWhiteAreas(Color lineColor) {
-	m_image.emphasizeWhiteAreas(lineColor);
+	m_history.endStep();
 
 	onImageChange();
 }
@@ -136,6 +150,14 @@ void ImageEditScene::setToolType(ToolType toolType) {
 	m_currentTool = toolType;
 }
 
+void ImageEditScene::setFillTolerance(uint8_t tolerance) {
+	m_fillTolerance = tolerance;
+}
+
+uint8_t ImageEditScene::getFillTolerance() const {
+	return m_fillTolerance;
+}
+
 void ImageEditScene::moveImageBy(QPointF offset) {
 	for (QGraphicsItem* it : m_pView->items()) {
 		it->moveBy(offset.x(), offset.y());
@@ -189,6 +211,10 @@ Image& ImageEditScene::getImage() {
 	return m_image;
 }
 
+uint64_t ImageEditScene::getImageVersion() const {
+	return m_imageVersion;
+}
+
 bool ImageEditScene::isImageOpened() const {
 	return m_isImageOpened;
 }
@@ -211,6 +237,14 @@ bool ImageEditScene::isOnImage(QPoint point, qreal accuracy) const {
 
 void ImageEditScene::onImageOpen(bool isNewImage, QSize imageSize) {
 	m_isImageOpened = true;
+	m_imageVersion++;
+
+	m_image.setAntialiased(m_isAntialiased);
+	m_image.setPremultiplied(m_isPremultiplied);
+
+	// The steps of the previous image cannot be applied to this one
+	m_image.setHistory(&m_history);
+	m_history.reset(imageSize.width(), imageSize.height());
 
 	m_imageRect = QRectF(QPointF(0, 0), imageSize);
 	setSceneRect(QRectF(0, 0, imageSize.width(), imageSize.height()));
@@ -253,31 +287,82 @@ void ImageEditScene::onCursorMove(QPointF pos) {
 }
 
 void ImageEditScene::onImageChange() {
+	m_imageVersion++;
+
 	if (m_isImageSaved || m_isImageSavedHint->text().isEmpty()) {
 		m_isImageSavedHint->setText("<b><font color='red'>Unsaved changes!</font></b>");
 		m_isImageSaved = false;
 	}
 
+	m_historyCompressionTimer.start(HISTORY_COMPRESSION_DELAY);
 	update();
 }
 
+// Compresses the history by parts, so that the editor is not blocked for long
+void ImageEditScene::onHistoryCompressionTimeout() {
+	if (m_history.compressSome()) {
+		m_historyCompressionTimer.start(0);
+	}
+}
+
 void ImageEditScene::onToolRadiusChanged(int radius) {
 	m_toolRadius = radius;
 }
 
+void ImageEditScene::onAntialiasingToggled(bool isAntialiased) {
+	m_isAntialiased = isAntialiased;
+	m_image.setAntialiased(isAntialiased);
+}
+
+void ImageEditScene::onPremultipliedAlphaToggled(bool isPremultiplied) {
+	m_isPremultiplied = isPremultiplied;
+	if (!m_isImageOpened) {
+		return;
+	}
+
+	// The pixels are converted, so the displayed image has to be recreated
+	// It cannot fail, since the image is opened
+	m_image.setPremultiplied(isPremultiplied);
+	clear();
+	updateImage().isOk();
+}
+
+void ImageEditScene::onUndo() {
+	if (m_isLMBPressed || !m_history.undo(m_image)) {
+		return;
+	}
+
+	onImageChange();
+}
+
+void ImageEditScene::onRedo() {
+	if (m_isLMBPressed || !m_history.redo(m_image)) {
+		return;
+	}
+
+	onImageChange();
+}
+
 void ImageEditScene::onToolPress(QPointF pos) {
 	bool isUpdateRequired = false;
 
 	pos -= m_imageRect.topLeft();
 	switch (m_currentTool) {
 		case ToolType::PEN:
+			m_history.beginStep("Pen"); // Ended once the button is released
 			m_image.fillCircle(pos.toPoint(), m_toolRadius / 2, m_toolColor);
 			isUpdateRequired = true;
 			break;
 		case ToolType::PICK_COLOR:
-			m_toolColor = m_image.at(pos.x(), pos.y());
+			m_toolColor = m_image.getColor(pos.x(), pos.y());
 			m_colorLabel->setColor(m_toolColor);
 			break;
+		case ToolType::FILL:
+			m_history.beginStep("Fill");
+			m_image.floodFill(pos.toPoint(), m_toolColor, m_fillTolerance);
+			m_history.endStep();
+			isUpdateRequired = true;
+			break;
 	default: break;
 	}
 
@@ -321,6 +406,8 @@ void ImageEditScene::onToolRelease(QPointF pos) {
 }
 
 utils::Result<Void> ImageEditScene::updateImage() {
+	trace_scope("ImageEditScene::updateImage");
+
 	auto qimageResult = m_image.toQImage();
 	if (!qimageResult.isOk()) {
 		return qimageResult.extractError();
@@ -450,6 +537,9 @@ void ImageEditScene::mouseReleaseEvent(QGraphicsSceneMouseEvent* event) {
 		if (isOnImage(event->scenePos().toPoint())) {
 			onToolRelease(event->scenePos());
 		}
+
+		// The stroke is over even if the button is released out of the image
+		m_history.endStep();
 	}
 
 	event->accept();
@@ -2,9 +2,11 @@
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QLabel>
+#include <QTimer>
 #include "ColorLabel.h"
 #include "../Utils/Result.h"
 #include "../Image/Image.h"
+#include "../Image/ImageHistory.h"
 #include "ToolType.h"
 
 // The class responsible for operating of the image edit area (the image itself)
@@ -15,8 +17,11 @@ class ImageEditScene final : public QGraphicsScene {
 private:
 	QGraphicsView* m_pView = nullptr;
 	Image m_image;
+	ImageHistory m_history;
+	QTimer m_historyCompressionTimer; // Compresses the history once the image is not changed for a while
 
 	bool m_isImageSaved = true;
+	uint64_t m_imageVersion = 0; // Changes whenever the image is changed or another image is opened
 
 	QList<QCursor> m_cursorsHistory; // The views of the cursor
 	QPointF m_oldMousePos;
@@ -31,6 +36,10 @@ private:
 	Color m_toolColor = Color::Black;
 
 	float m_toolRadius = 10.f;
+	uint8_t m_fillTolerance = 32; // How much the colors of the pixels filled by the fill tool can differ from the chosen one
+
+	bool m_isAntialiased = false; // Applied to every image opened
+	bool m_isPremultiplied = false; // Applied to every image opened
 	
 	
 	// The hints at the bottom of the window from the parenting MainWindow
@@ -49,8 +58,17 @@ public:
 public:
 	void clearScene();
 	utils::Result<Void> newImage(QSize size, Color fillColor);
-	utils::Result<Void> openImage(const QString& fileName);
-	utils::Result<Void> saveImage(const QString& fileName);
+
+	// Replaces the current image with the one opened beforehand (e.g. in background)
+	utils::Result<Void> setOpenedImage(Image&& image);
+
+	// Called when a copy of the image made at the version is saved
+	// The image is marked as saved only if it was not changed since the copy was made
+	void onImageCopySaved(const Image& savedCopy, uint64_t version);
+
+	// Called when a copy of the image made at the version is changed (e.g. in background)
+	// The copy replaces the image as a single step of the history only if the image was not changed since the copy was made, returns whether it did
+	bool onImageCopyChanged(const QString& stepName, Image& changedCopy, uint64_t version);
 
 	// Required features
 	// Transmitted to the image
@@ -58,9 +76,6 @@ public:
 	// Changes all the pixel's channel to some value
 	void channelFilter(bool red, bool green, bool blue, bool alpha, uint8_t value);
 
-	// Splits the image into NxM subimages and saves each one to a separate file (-path-/-basicName-_X_Y.png)
-	void splitImageIntoSubimages(uint32_t N, uint32_t M, const QString& basicPath);
-
 	// Draws a grid splitting image into NxM parts
 	void splitImageWithGrid(uint32_t N, uint32_t M, float lineWidth, Color color);
 
@@ -70,13 +85,13 @@ public:
 	// Draws a square and its diagonals and fills it with a color if needsFill
 	void drawSquareWithDiagonals(QPoint from, uint32_t side, float lineWidth, Color lineColor, Color fillColor, bool needsFill);
 
-	// Wraps all the white areas on the image with a line of lineColor
-	void emphasizeWhiteAreas(Color lineColor);
-
 	
 	// Changes the current tool
 	void setToolType(ToolType toolType);
 
+	void setFillTolerance(uint8_t tolerance);
+	uint8_t getFillTolerance() const;
+
 	// Moves the image within the scene
 	void moveImageBy(QPointF offset);
 	void tryMoveImageBy(QPointF offset);
@@ -86,6 +101,7 @@ public:
 	void popCursor();
 
 	Image& getImage();
+	uint64_t getImageVersion() const;
 	QRectF getImageRect(QSize imageSize);
 	bool isOnImage(QPoint pointOnScene, qreal accuracy = 1) const;
 
@@ -98,6 +114,7 @@ private: // own triggers
 	void onImageSave(); // Called whenever an image is saved
 	void onCursorMove(QPointF pos); // Called whenever the cursor is moved
 	void onImageChange(); // Called whenever the image is changes (or if a new image is created)
+	void onHistoryCompressionTimeout();
 
 	void onToolPress(QPointF pos); // Called whenever LMB is pressed with a drawing tool chosen
 	void onToolMove(QPointF pos); // Called whenever mouse is moved with a drawing tool chosen while LMB is pressed
@@ -108,6 +125,10 @@ private: // own triggers
 public slots:
 	void onColorChanged(Color newColor);
 	void onToolRadiusChanged(int radius);
+	void onAntialiasingToggled(bool isAntialiased);
+	void onPremultipliedAlphaToggled(bool isPremultiplied);
+	void onUndo();
+	void onRedo();
 
 public: // events
 	void wheelEvent(QGraphicsSceneWheelEvent* event) override;
@@ -1,32 +1,63 @@
 #include "ProgressDialog.h"
+#include <memory>
+#include <QCoreApplication>
+#include <QPointer>
+#include <QThreadPool>
+#include <QTimer>
 
-QProgressDialog* g_progressDialog = nullptr;
-bool g_isProgressDialogOpen = false;
-
-void openProgressDialog(QWidget* parent, QString name, int max_val) {
-	assert(!g_isProgressDialogOpen && "Cannot open progress dialog twice");
-
-    g_isProgressDialogOpen = true;
-    g_progressDialog = new QProgressDialog(name, "No cancel", 0, max_val, parent);
-    g_progressDialog->setWindowModality(Qt::WindowModal);
-    g_progressDialog->setCancelButton(0);
-    g_progressDialog->setWindowFlags(g_progressDialog->windowFlags() & ~Qt::WindowCloseButtonHint);
-    g_progressDialog->setAutoClose(false);
-    g_progressDialog->setValue(0);
-    g_progressDialog->setMinimumDuration(500);
-    g_progressDialog->show();
-}
+// How often the dialog checks the progress of its task, in milliseconds
+constexpr int PROGRESS_UPDATE_INTERVAL = 50;
 
-void closeProgressDialog() {
-    assert(g_isProgressDialogOpen && "Cannot close progress dialog if it is not opened");
-    
-    g_isProgressDialogOpen = false;
+void runWithProgressDialog(QWidget* parent, const QString& name, BackgroundTask task, BackgroundTaskCallback onFinished) {
+    // Shared by the dialog and the task, so that it lives as long as any of them
+    auto token = std::make_shared<utils::ProgressToken>();
 
-    if (!g_progressDialog->wasCanceled()) {
-        g_progressDialog->close();
-    }
-}
+    QProgressDialog* dialog = new QProgressDialog(name, "Cancel", 0, 100, parent);
+    dialog->setAutoClose(false);
+    dialog->setAutoReset(false);
+    dialog->setValue(0);
+    dialog->setMinimumDuration(500);
+
+    QObject::connect(dialog, &QProgressDialog::canceled, [token]() {
+        token->cancel();
+    });
+
+    // Nobody waits for the result once the dialog is destroyed together with its parent, so the task may stop as well
+    QObject::connect(dialog, &QObject::destroyed, [token]() {
+        token->cancel();
+    });
+
+    // The task only writes its progress to the token, and the dialog checks it from time to time
+    QTimer* timer = new QTimer(dialog);
+    QObject::connect(timer, &QTimer::timeout, dialog, [dialog, token]() {
+        if (!dialog->wasCanceled()) {
+            dialog->setValue(token->getProgress());
+        }
+    });
+
+    timer->start(PROGRESS_UPDATE_INTERVAL);
+
+    // The dialog is destroyed together with its parent, which may happen before the task is finished
+    QPointer<QProgressDialog> guardedDialog = dialog;
+    QThreadPool::globalInstance()->start([guardedDialog, token, task = std::move(task), onFinished = std::move(onFinished)]() {
+        auto result = task(*token);
+        bool isOk = result.isOk();
+        QString error = isOk ? QString() : result.error();
+
+        // Back to the GUI thread through the application, which outlives the dialog, and the dialog is only checked there
+        // The call is dropped if the dialog is already destroyed, since the parent the callback refers to is gone as well
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [guardedDialog, onFinished, isOk, error]() {
+            if (guardedDialog.isNull()) {
+                return;
+            }
+
+            guardedDialog->deleteLater();
 
-void progressCallbackFunc(double progress) {
-	g_progressDialog->setValue(progress);
+            if (isOk) {
+                onFinished(utils::Success());
+            } else {
+                onFinished(utils::Failure(error));
+            }
+        }, Qt::QueuedConnection);
+    });
 }
@@ -1,12 +1,17 @@
 #pragma once
+#include <functional>
 #include <QProgressDialog>
+#include "../Utils/Result.h"
+#include "../Utils/ProgressToken.h"
 
-// For using, g_progressDialog must be initialized first
-extern QProgressDialog* g_progressDialog;
-extern bool g_isProgressDialogOpen;
+// A long operation to be run in background
+// Reports its progress to the token and checks whether it was cancelled
+using BackgroundTask = std::function<utils::Result<Void>(utils::ProgressToken& token)>;
 
-void openProgressDialog(QWidget* parent, QString name, int max_val = 101);
-void closeProgressDialog();
+// Receives the result of a background task, called in the GUI thread
+using BackgroundTaskCallback = std::function<void(utils::Result<Void> result)>;
 
-// Then the callback function can be passed on somewhere
-void progressCallbackFunc(double progress);
\ No newline at end of file
+// Runs the task on the thread pool while showing a progress dialog with the "Cancel" button
+// The window stays responsive, and several tasks can run at the same time, each one with its own dialog and token
+// onFinished is not called if the parent is destroyed before the task is finished
+void runWithProgressDialog(QWidget* parent, const QString& name, BackgroundTask task, BackgroundTaskCallback onFinished);
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Color.h"
+#include "PixelKernels.h"
 #include "../Utils/MathUtils.h"
 
 const Color Color::White = Color(255, 255, 255);
@@ -19,9 +20,6 @@ const Color Color::Purple = Color(128, 0, 128);
 const Color Color::Navy = Color(0, 0, 128);
 const Color Color::Olive = Color(128, 128, 0);
 
-// Some constants to accelerate color mixing
-uint8_t g_multblTable[256][256];
-
 Color::Channel Color::getChannel(bool red, bool green, bool blue, bool alpha) {
     uint32_t result = 0;
     if (red) {
@@ -82,15 +80,6 @@ bool Color::operator==(Color other) const {
     return _data == other._data;
 }
 
-void Color::initColorModule() {
-    for (int i = 0; i < 256; ++i) {
-        for (int j = 0; j < 256; ++j) {
-            int k = (i * j) / 255;
-            g_multblTable[i][j] = (uint8_t)k;
-        }
-    }
-}
-
 uint8_t& Color::r() {
     return *(((uint8_t*)&_data) + 2);
 }
@@ -140,6 +129,20 @@ Color Color::multiplyBy(float by) const {
     return res;
 }
 
+Color Color::premultiplied() const {
+    Color result(_data);
+    kernels::premultiply(&result._data, 1);
+
+    return result;
+}
+
+Color Color::unpremultiplied() const {
+    Color result(_data);
+    kernels::unpremultiply(&result._data, 1);
+
+    return result;
+}
+
 void Color::mix(Color over) {
     _data = mix(over, *this)._data;
 }
@@ -154,12 +157,11 @@ Color Color::mix(Color over, Color under) {
         return under;
     }
 
-    // Quick algorythm
-    // Just what the heck it does?
-    return under._data + ((g_multblTable[ao][over._data & 0xff]) |
-        (((uint32_t)g_multblTable[ao][(over._data >> 8) & 0xff]) << 8) |
-        (((uint32_t)g_multblTable[ao][(over._data >> 16) & 0xff]) << 16) |
-        (((uint32_t)g_multblTable[ao][(over._data >> 24) & 0xff]) << 24));
+    // Both have straight alpha, they are composited as premultiplied ones, so that under is scaled by its own alpha as well
+    Color result = under;
+    kernels::composite(&result._data, &over._data, 1);
+
+    return result;
 }
 
 void Color::setColorWithMask(ChannelMask mask, Color color) {
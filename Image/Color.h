@@ -32,9 +32,6 @@ struct Color {
 	Color(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255); // Initializing with channels
 
 	bool operator==(Color other) const;
-	
-	// Initializing some internal tables
-	static void initColorModule();
 	 
 	// Instead of field access
 	// Allows to make internal channels representation independent from the interface
@@ -58,11 +55,16 @@ struct Color {
 	// Returns a color with RGB channels multiplied by -by-, but no more than 255
 	Color multiplyBy(float by) const;
 
+	// Returns the color with RGB channels multiplied by alpha (premultiplied alpha)
+	Color premultiplied() const;
+
+	// Returns the straight-alpha color from a premultiplied one
+	Color unpremultiplied() const;
+
 	// Overlaying the current color with another one
-	// Works strange, better not touch it for now
 	void mix(Color over);
 
-	// Mixing 2 colors as if over is overlayed over under
+	// Mixing 2 colors as if over is overlayed over under (source-over, straight alpha)
 	// If over has alpha = 255 it just replaces under
 	static Color mix(Color over, Color under);
 
@@ -0,0 +1,236 @@
+#include "FrameRecorder.h"
+#include <algorithm>
+#include <cmath>
+#include <QDir>
+#include <QThread>
+#include "../Utils/MathUtils.h"
+
+// The full-range BT.601 weights the C420jpeg color space of y4m uses, multiplied by 256
+constexpr int LUMA_RED = 77;
+constexpr int LUMA_GREEN = 150;
+constexpr int LUMA_BLUE = 29;
+
+constexpr int BLUE_DIFF_RED = -43;
+constexpr int BLUE_DIFF_GREEN = -85;
+constexpr int BLUE_DIFF_BLUE = 128;
+
+constexpr int RED_DIFF_RED = 128;
+constexpr int RED_DIFF_GREEN = -107;
+constexpr int RED_DIFF_BLUE = -21;
+
+static inline uint8_t toChroma(int red, int green, int blue, int redWeight, int greenWeight, int blueWeight) {
+    return uint8_t(utils::clamp(((redWeight * red + greenWeight * green + blueWeight * blue + 128) >> 8) + 128, 0, 255));
+}
+
+FrameRecorder::FrameRecorder() {
+    int threadsCount = std::max(QThread::idealThreadCount(), 1);
+    m_encoders.setMaxThreadCount(threadsCount);
+
+    // Enough for all the encoders to be busy while the next frames are waiting, yet the memory for the frames is limited
+    m_maxFramesInFlight = uint32_t(2 * threadsCount);
+}
+
+FrameRecorder::~FrameRecorder() {
+    // The encoders refer to the recorder
+    m_encoders.waitForDone();
+}
+
+utils::Result<Void> FrameRecorder::open(const QString& path, Format format, uint32_t width, uint32_t height, float frameRate) {
+    if (width == 0 || height == 0) {
+        return utils::Failure("Cannot record the frames of an empty image");
+    } else if (!(frameRate > 0)) {
+        return utils::Failure("The frame rate of the recording must be positive");
+    }
+
+    m_format = format;
+    m_path = path;
+    m_width = width;
+    m_height = height;
+    m_framesCount = 0;
+    m_nextFrameToWrite = 0;
+    m_error.clear();
+
+    if (format == Format::PNG_SEQUENCE) {
+        if (!QDir().mkpath(path)) {
+            return utils::Failure("Failed to create the directory: " + path);
+        }
+
+        return utils::Success();
+    }
+
+    m_videoFile.setFileName(path);
+    if (!m_videoFile.open(QFile::WriteOnly | QFile::Truncate)) {
+        return utils::Failure("Failed to open file: " + path);
+    }
+
+    // The frame rate is a fraction, so that the fractional rates are kept as well
+    QByteArray header = "YUV4MPEG2 W" + QByteArray::number(width)
+        + " H" + QByteArray::number(height)
+        + " F" + QByteArray::number(qint64(std::round(frameRate * 1000))) + ":1000"
+        + " Ip A1:1 C420jpeg\n";
+
+    if (m_videoFile.write(header) != header.size()) {
+        m_videoFile.close();
+        return utils::Failure("Failed to write the file: " + path);
+    }
+
+    return utils::Success();
+}
+
+utils::Result<Void> FrameRecorder::addFrame(const Image& image) {
+    if (image.getWidth() != m_width || image.getHeight() != m_height) {
+        return utils::Failure("All the recorded frames must be of the same size");
+    }
+
+    Image* frame = new Image();
+    if (auto result = image.copyTo(*frame); !result.isOk()) {
+        delete frame;
+        return result.extractError();
+    }
+
+    uint32_t index;
+    {
+        std::unique_lock lock(m_mutex);
+        m_frameFinished.wait(lock, [this]() { return m_framesInFlight < m_maxFramesInFlight || !m_error.isEmpty(); });
+
+        if (!m_error.isEmpty()) {
+            delete frame;
+            return utils::Failure(m_error);
+        }
+
+        m_framesInFlight++;
+        index = m_framesCount++;
+    }
+
+    if (m_format == Format::PNG_SEQUENCE) {
+        m_encoders.start([this, frame, index]() { encodePng(frame, index); });
+    } else {
+        m_encoders.start([this, frame, index]() { encodeY4m(frame, index); });
+    }
+
+    return utils::Success();
+}
+
+utils::Result<Void> FrameRecorder::finish() {
+    m_encoders.waitForDone();
+
+    if (m_videoFile.isOpen()) {
+        m_videoFile.close();
+    }
+
+    if (!m_error.isEmpty()) {
+        return utils::Failure(m_error);
+    }
+
+    return utils::Success();
+}
+
+uint32_t FrameRecorder::getFramesCount() const {
+    return m_framesCount;
+}
+
+void FrameRecorder::encodePng(Image* frame, uint32_t index) {
+    QString fileName = QDir(m_path).filePath(QString("frame_%1.png").arg(index, 5, 10, QChar('0')));
+
+    auto result = frame->store(fileName);
+    delete frame;
+
+    finishFrame(std::move(result));
+}
+
+void FrameRecorder::encodeY4m(Image* frame, uint32_t index) {
+    static const QByteArray FRAME_HEADER = "FRAME\n";
+
+    uint32_t chromaWidth = (m_width + 1) / 2;
+    uint32_t chromaHeight = (m_height + 1) / 2;
+    size_t lumaSize = size_t(m_width) * m_height;
+    size_t chromaSize = size_t(chromaWidth) * chromaHeight;
+
+    QByteArray data(qsizetype(FRAME_HEADER.size() + lumaSize + 2 * chromaSize), Qt::Uninitialized);
+    std::copy(FRAME_HEADER.begin(), FRAME_HEADER.end(), data.begin());
+
+    uint8_t* luma = (uint8_t*)data.data() + FRAME_HEADER.size();
+    uint8_t* blueDiff = luma + lumaSize;
+    uint8_t* redDiff = blueDiff + chromaSize;
+
+    // The video has no transparency, the alpha is dropped
+    for (uint32_t y = 0; y < m_height; y++) {
+        for (uint32_t x = 0; x < m_width; x++) {
+            Color color = frame->getColor(x, y);
+            luma[size_t(y) * m_width + x] = uint8_t((LUMA_RED * color.r() + LUMA_GREEN * color.g() + LUMA_BLUE * color.b() + 128) >> 8);
+        }
+    }
+
+    // A chroma sample per 2x2 pixels, of their average color
+    for (uint32_t y = 0; y < chromaHeight; y++) {
+        for (uint32_t x = 0; x < chromaWidth; x++) {
+            int red = 0, green = 0, blue = 0, count = 0;
+            for (uint32_t py = 2 * y; py < std::min(2 * y + 2, m_height); py++) {
+                for (uint32_t px = 2 * x; px < std::min(2 * x + 2, m_width); px++) {
+                    Color color = frame->getColor(px, py);
+                    red += color.r();
+                    green += color.g();
+                    blue += color.b();
+                    count++;
+                }
+            }
+
+            red /= count;
+            green /= count;
+            blue /= count;
+
+            size_t pos = size_t(y) * chromaWidth + x;
+            blueDiff[pos] = toChroma(red, green, blue, BLUE_DIFF_RED, BLUE_DIFF_GREEN, BLUE_DIFF_BLUE);
+            redDiff[pos] = toChroma(red, green, blue, RED_DIFF_RED, RED_DIFF_GREEN, RED_DIFF_BLUE);
+        }
+    }
+
+    delete frame;
+
+    std::unique_lock lock(m_mutex);
+    m_convertedFrames.emplace(index, std::move(data));
+    writeConvertedFrames(lock);
+}
+
+void FrameRecorder::writeConvertedFrames(std::unique_lock<std::mutex>& lock) {
+    // Another encoder is writing, it will write this frame as well once it is its turn
+    if (m_isWriting) {
+        return;
+    }
+
+    m_isWriting = true;
+
+    auto next = m_convertedFrames.find(m_nextFrameToWrite);
+    while (next != m_convertedFrames.end()) {
+        QByteArray data = std::move(next->second);
+        m_convertedFrames.erase(next);
+
+        // The others can add their frames meanwhile
+        lock.unlock();
+        bool isWritten = m_videoFile.write(data) == data.size();
+        lock.lock();
+
+        if (!isWritten && m_error.isEmpty()) {
+            m_error = "Failed to write the file: " + m_path;
+        }
+
+        m_nextFrameToWrite++;
+        m_framesInFlight--;
+        m_frameFinished.notify_all();
+
+        next = m_convertedFrames.find(m_nextFrameToWrite);
+    }
+
+    m_isWriting = false;
+}
+
+void FrameRecorder::finishFrame(utils::Result<Void> result) {
+    std::unique_lock lock(m_mutex);
+
+    if (!result.isOk() && m_error.isEmpty()) {
+        m_error = result.error();
+    }
+
+    m_framesInFlight--;
+    m_frameFinished.notify_all();
+}
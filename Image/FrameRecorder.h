@@ -0,0 +1,69 @@
+#pragma once
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QThreadPool>
+#include "Image.h"
+
+// Writes the frames of an animation to files while the animation goes on
+// Each frame is copied and encoded on a thread pool of its own, so the encoding of the frames overlaps with drawing the next ones
+// The number of frames being encoded is limited, adding a frame waits for the earlier ones once the limit is reached
+class FrameRecorder final {
+public:
+	enum class Format : uint8_t {
+		PNG_SEQUENCE = 0, // A png file per frame in the directory: frame_00000.png, frame_00001.png, ...
+		Y4M // An uncompressed YUV 4:2:0 video, can be played or converted by most of the video tools
+	};
+
+private:
+	QThreadPool m_encoders;
+
+	Format m_format = Format::PNG_SEQUENCE;
+	QString m_path;
+	QFile m_videoFile;
+
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+
+	uint32_t m_framesCount = 0; // Added so far
+	uint32_t m_maxFramesInFlight;
+
+	// Guards all the fields below, the encoders report to them
+	std::mutex m_mutex;
+	std::condition_variable m_frameFinished;
+
+	uint32_t m_framesInFlight = 0; // Added, but not written yet
+	QString m_error; // The first one met, no frames are added after it
+
+	// The video frames must be written in order, though they can be converted in any one
+	std::map<uint32_t, QByteArray> m_convertedFrames;
+	uint32_t m_nextFrameToWrite = 0;
+	bool m_isWriting = false;
+
+public:
+	FrameRecorder();
+	~FrameRecorder();
+
+	// The path is a directory for a png sequence and a file for a video, all the frames must be of the same size
+	utils::Result<Void> open(const QString& path, Format format, uint32_t width, uint32_t height, float frameRate);
+
+	// Copies the image, so that it can be changed as soon as the function returns
+	utils::Result<Void> addFrame(const Image& image);
+
+	// Waits for all the frames to be written, returns the first error met if any
+	utils::Result<Void> finish();
+
+	uint32_t getFramesCount() const;
+
+private:
+	void encodePng(Image* frame, uint32_t index);
+	void encodeY4m(Image* frame, uint32_t index);
+
+	// Writes the converted video frames that are next in order, only a single encoder does it at a time
+	void writeConvertedFrames(std::unique_lock<std::mutex>& lock);
+
+	void finishFrame(utils::Result<Void> result);
+};
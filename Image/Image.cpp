@@ -1,30 +1,61 @@
 #include "Image.h"
+#include <bit>
 #include <cstdio> // For FILE, which is used by libpng
 #include <QStringList>
+#include <QFile>
 #include <png.h>
 #include "../Utils/ScopeExit.h"
+#include "../Utils/Trace.h"
 #include "../Utils/MathUtils.h"
-#include "../GUI/ProgressDialog.h"
-
-// Needed to check the progress of opening/closing
-size_t g_rowsCount = 0;
-size_t g_passesCount = 0;
+#include "PixelKernels.h"
+#include "ImageHistory.h"
 
 Image::Image() {
 
 }
 
 void Image::copyFrom(Image& other) {
-    if (m_data.isEmpty() || m_width != other.getWidth() || m_height != other.getHeight()) {
+    if (!hasPixels() || m_width != other.getWidth() || m_height != other.getHeight()) {
         return;
     }
 
-    std::memcpy(m_data.data(), other.m_data.data(), size_t(m_width) * m_height * m_data.ElemSize);
+    recordChange(0, 0, m_width, m_height);
+    withSequentialAccess([&]() {
+        std::memcpy(pixels(), other.pixels(), size_t(m_width) * m_height * sizeof(uint32_t));
+        if (m_isPremultiplied != other.m_isPremultiplied) {
+            convertPixels(m_isPremultiplied);
+        }
+    });
+}
+
+void Image::setScratchDirectory(const QString& directory) {
+    m_scratchDirectory = directory;
+}
+
+const QString& Image::getScratchDirectory() const {
+    return m_scratchDirectory;
+}
+
+bool Image::isFileBacked() const {
+    return !m_mappedData.isEmpty();
 }
 
 utils::Result<Void> Image::allocateImage(uint32_t width, uint32_t height) {
-    if (auto result = m_data.realloc(width * height); !result.isOk()) {
-        return result.extractError();
+    size_t count = size_t(width) * height;
+    if (!m_scratchDirectory.isEmpty()) {
+        if (auto result = utils::MappedFile::createScratch(m_scratchDirectory, count * sizeof(uint32_t)); !result.isOk()) {
+            return result.extractError();
+        } else {
+            m_mappedData = result.extract();
+        }
+
+        m_data = utils::SizedBuffer<uint32_t, utils::AllocationPolicy::PAGES>(); // The pixels are not kept in memory any more
+    } else {
+        if (auto result = m_data.realloc(count); !result.isOk()) {
+            return result.extractError();
+        }
+
+        m_mappedData = utils::MappedFile();
     }
 
     m_width = width;
@@ -33,39 +64,73 @@ utils::Result<Void> Image::allocateImage(uint32_t width, uint32_t height) {
     return utils::Success();
 }
 
-utils::Result<Void> Image::open(const QString& fileName) {
+utils::Result<Void> Image::open(const QString& fileName, utils::ProgressToken* token) {
     m_fileName = fileName;
 
     QString extension = fileName.split('.').back();
     if (extension == "png") {
-        return openPng(fileName);
+        return openPng(fileName, token);
     }
 
     return utils::Failure("Unknown file extension: " + fileName);
 }
 
-utils::Result<Void> Image::store(const QString& fileName) {
+utils::Result<Void> Image::store(const QString& fileName, utils::ProgressToken* token) {
+    QString extension = fileName.split('.').back();
+    if (extension != "png") {
+        return utils::Failure("Unknown file extension: " + fileName);
+    }
+
+    // The image is written to a temporary file first, so that a failed or cancelled saving does not spoil the existing file
+    QString tempFileName = fileName + ".part";
+    if (auto result = storePng(tempFileName, token); !result.isOk()) {
+        QFile::remove(tempFileName);
+        return result.extractError();
+    }
+
+    QFile::remove(fileName);
+    if (!QFile::rename(tempFileName, fileName)) {
+        QFile::remove(tempFileName);
+        return utils::Failure("Failed to write the file: " + fileName);
+    }
+
     m_fileName = fileName;
+    return utils::Success();
+}
 
-    QString extension = fileName.split('.').back();
-    if (extension == "png") {
-        return storePng(fileName);
+utils::Result<Void> Image::copyTo(Image& copy) const {
+    // A copy of an image larger than RAM has to be file-backed as well
+    copy.m_scratchDirectory = m_scratchDirectory;
+    if (auto result = copy.allocateImage(m_width, m_height); !result.isOk()) {
+        return result.extractError();
     }
 
-    return utils::Failure("Unknown file extension: " + fileName);
+    adviseAccess(utils::MappedFile::Access::SEQUENTIAL);
+    copy.adviseAccess(utils::MappedFile::Access::SEQUENTIAL);
+    at_scope_exit{
+        adviseAccess(utils::MappedFile::Access::NORMAL);
+        copy.adviseAccess(utils::MappedFile::Access::NORMAL);
+    };
+
+    std::memcpy(copy.pixels(), pixels(), size_t(m_width) * m_height * sizeof(uint32_t));
+    copy.copyFileInfoFrom(*this);
+    copy.m_isAntialiased = m_isAntialiased;
+    copy.m_isPremultiplied = m_isPremultiplied;
+
+    return utils::Success();
+}
+
+void Image::copyFileInfoFrom(const Image& other) {
+    m_fileName = other.m_fileName;
+    m_bitDepth = other.m_bitDepth;
+    m_colorType = other.m_colorType;
+    m_extension = other.m_extension;
+    m_pngFileData = other.m_pngFileData;
 }
 
 utils::Result<Void> Image::newImage(uint32_t width, uint32_t height, Color fillColor) {
-    if (width * height > IMAGE_SIZE_MAX) {
-        return utils::Failure(
-            "Image size is too big: "
-            + QString::number(width)
-            + " x "
-            + QString::number(height)
-            + "; Maximal size is "
-            + QString::number(IMAGE_SIZE_MAX)
-            + " pixels"
-        );
+    if (auto result = checkImageSize(width, height); !result.isOk()) {
+        return result.extractError();
     }
 
     if (auto result = allocateImage(width, height); !result.isOk()) {
@@ -83,11 +148,12 @@ utils::Result<Void> Image::newImage(uint32_t width, uint32_t height, Color fillC
 }
 
 utils::Result<QImage> Image::toQImage() const {
-    if (m_data.isEmpty()) {
+    if (!hasPixels()) {
         return utils::Failure("Image is empty: nothing to return");
     }
 
-    auto img = QImage((uint8_t*)m_data.data(), m_width, m_height, QImage::Format_ARGB32);
+    auto format = m_isPremultiplied ? QImage::Format_ARGB32_Premultiplied : QImage::Format_ARGB32;
+    auto img = QImage((uint8_t*)pixels(), m_width, m_height, format);
     return img;
 }
 
@@ -95,19 +161,26 @@ void Image::channelFilter(Color::Channel channel, uint8_t value) {
     Color changeColor = Color::getColorByChannels(channel, value);
     auto mask = Color::getChannelMask(channel);
 
-    for (uint32_t y = 0; y < m_height; y++) {
-        for (uint32_t x = 0; x < m_width; x++) {
-            atFast(x, y).setColorWithMask(mask, changeColor);
-        }
-    }
+    recordChange(0, 0, m_width, m_height);
+    withSequentialAccess([&]() {
+        withStraightAlpha([&]() {
+            for (uint32_t y = 0; y < m_height; y++) {
+                for (uint32_t x = 0; x < m_width; x++) {
+                    atFast(x, y).setColorWithMask(mask, changeColor);
+                }
+            }
+        });
+    });
 }
 
-void Image::splitImageIntoSubimages(uint32_t N, uint32_t M, const QString& basicName) {
+utils::Result<Void> Image::splitImageIntoSubimages(uint32_t N, uint32_t M, const QString& basicName, utils::ProgressToken* token) {
     Image tmp;
     float gridWidth = m_width / float(N);
     float gridHeight = m_height / float(M);
 
-    tmp.allocateImage(int(ceil(gridWidth)), int(ceil(gridHeight)));
+    if (auto result = tmp.allocateImage(int(ceil(gridWidth)), int(ceil(gridHeight))); !result.isOk()) {
+        return result.extractError();
+    }
 
     for (uint32_t x = 0; x < N; x++) {
         int fromX = int(x * gridWidth);
@@ -117,11 +190,23 @@ void Image::splitImageIntoSubimages(uint32_t N, uint32_t M, const QString& basic
             int fromY = int(y * gridHeight);
             int toY = int((y + 1) * gridHeight);
 
-            fillWithSubimage(tmp, QPoint(fromX, fromY), toX - fromX, toY - fromY)
-                .store(basicName + "_" + QString::number(x) + "_" + QString::number(y) + ".png")
-                .isOk(); // Whether it was a successful store, must be handled later
+            QString fileName = basicName + "_" + QString::number(x) + "_" + QString::number(y) + ".png";
+            if (auto result = fillWithSubimage(tmp, QPoint(fromX, fromY), toX - fromX, toY - fromY).store(fileName); !result.isOk()) {
+                return result.extractError();
+            }
+
+            // A single file is stored fast enough, so the token is checked between the files
+            if (token != nullptr) {
+                uint64_t storedCount = uint64_t(x) * M + y + 1;
+                token->setProgress(storedCount, uint64_t(N) * M);
+                if (token->isCancelled()) {
+                    return utils::Failure("Splitting is cancelled, files stored: " + QString::number(storedCount));
+                }
+            }
         }
     }
+
+    return utils::Success();
 }
 
 void Image::splitImageWithGrid(uint32_t N, uint32_t M, float lineWidth, Color color) {
@@ -155,23 +240,41 @@ void Image::drawSquareWithDiagonals(QPoint from, uint32_t side, float lineWidth,
     drawLine(QPoint(from.x() + side, from.y()), QPoint(from.x(), from.y() + side), lineWidth, lineColor);
 }
 
-void Image::emphasizeWhiteAreas(Color lineColor) {
+void Image::emphasizeWhiteAreas(Color lineColor, utils::ProgressToken* token) {
+    lineColor = toStoredColor(lineColor);
+
     for (uint32_t x = 0; x < m_width; x++) {
         for (uint32_t y = 0; y < m_height; y++) {
             if (atFast(x, y) != Color::White && hasColorInNeighborhood(x, y, Color::White)) {
+                recordChange(x, y, 1, 1);
                 atFast(x, y) = lineColor;
             }
         }
+
+        if (token != nullptr) {
+            token->setProgress(x + 1, m_width);
+            if (token->isCancelled()) {
+                return;
+            }
+        }
     }
 }
 
 void Image::drawLine(QPoint from, QPoint to, float width, Color color) {
-    assert(!m_data.isEmpty() && "Image is empty");
+    trace_scope("Image::drawLine");
+
+    assert(hasPixels() && "Image is empty");
 
     if (from == to) {
         return;
     }
 
+    if (m_isAntialiased) {
+        utils::AntialiasedLineRasterizer rast(from, to, width, m_width);
+        drawCoverageRasterized(rast, color);
+        return;
+    }
+
     // This way, we ensure that from is before to along the Y axis
     if (from.y() > to.y()) {
         std::swap(from, to); // So as to from would be before the to
@@ -200,7 +303,7 @@ void Image::drawLine(QPoint from, QPoint to, float width, Color color) {
 }
 
 void Image::drawVerticalLine(QPoint from, uint32_t yOffset, float width, Color color) {
-    assert(!m_data.isEmpty() && "Image is empty");
+    assert(hasPixels() && "Image is empty");
 
     uint32_t xOffset = int(width);
     from.setX(from.x() - int(width / 2));
@@ -209,7 +312,7 @@ void Image::drawVerticalLine(QPoint from, uint32_t yOffset, float width, Color c
 }
 
 void Image::drawHorizontalLine(QPoint from, uint32_t xOffset, float height, Color color) {
-    assert(!m_data.isEmpty() && "Image is empty");
+    assert(hasPixels() && "Image is empty");
 
     uint32_t yOffset = int(height);
     from.setY(from.y() - int(height / 2));
@@ -218,7 +321,9 @@ void Image::drawHorizontalLine(QPoint from, uint32_t xOffset, float height, Colo
 }
 
 void Image::drawRect(QPoint from, uint32_t width, uint32_t height, float lineWidth, Color color) {
-    assert(!m_data.isEmpty() && "Image is empty");
+    trace_scope("Image::drawRect");
+
+    assert(hasPixels() && "Image is empty");
 
     if (from.y() >= m_height || from.x() >= m_width || from.y() + height <= 0 || from.x() + width <= 0) {
         return;
@@ -228,17 +333,27 @@ void Image::drawRect(QPoint from, uint32_t width, uint32_t height, float lineWid
 }
 
 void Image::drawCircle(QPointF center, float radius, float lineWidth, Color color) {
-    assert(!m_data.isEmpty() && "Image is empty");
+    trace_scope("Image::drawCircle");
+
+    assert(hasPixels() && "Image is empty");
 
     if (center.x() + radius < 0 || center.y() + radius < 0) {
         return;
     }
 
-    drawRasterized(utils::RingRasterizer(center.toPoint(), radius, lineWidth), color);
+    if (m_isAntialiased) {
+        utils::AntialiasedRingRasterizer rast(center, radius, lineWidth, m_width);
+        drawCoverageRasterized(rast, color);
+        return;
+    }
+
+    drawRasterized(utils::RingRasterizer(center.toPoint(), radius, lineWidth, m_height), color);
 }
 
 void Image::fillRect(QPoint from, uint32_t width, uint32_t height, Color color) {
-    assert(!m_data.isEmpty() && "Image is empty");
+    trace_scope("Image::fillRect");
+
+    assert(hasPixels() && "Image is empty");
 
     if (from.y() >= m_height || from.x() >= m_width || from.y() + height <= 0 || from.x() + width <= 0) {
         return;
@@ -248,18 +363,272 @@ void Image::fillRect(QPoint from, uint32_t width, uint32_t height, Color color)
 }
 
 void Image::fillCircle(QPointF center, float radius, Color color) {
-    assert(!m_data.isEmpty() && "Image is empty");
+    trace_scope("Image::fillCircle");
+
+    assert(hasPixels() && "Image is empty");
 
     if (center.x() + radius < 0 || center.y() + radius < 0) {
         return;
     }
 
+    if (m_isAntialiased) {
+        utils::AntialiasedCircleRasterizer rast(center, radius, m_width);
+        drawCoverageRasterized(rast, color);
+        return;
+    }
+
     if (radius <= 0.5) {
         drawXStroke(center.x(), center.y(), 1, color);
         return;
     }
 
-    drawRasterized(utils::CircleRasterizer(center.toPoint(), radius), color);
+    drawRasterized(utils::CircleRasterizer(center.toPoint(), radius, m_height), color);
+}
+
+void Image::fillPolygon(std::span<const QPointF> points, utils::FillRule rule, Color color) {
+    trace_scope("Image::fillPolygon");
+
+    assert(hasPixels() && "Image is empty");
+
+    if (points.size() < 3) {
+        return;
+    }
+
+    utils::PolygonRasterizer rast(points, rule, m_width, m_height);
+    while (rast.hasMore()) {
+        for (const utils::RowSpan& span : rast.spans()) {
+            drawXStroke(span.x, rast.getY(), span.length, color);
+        }
+
+        rast.nextRow();
+    }
+}
+
+// Flood fill's marks of the pixels already filled, a bit per pixel
+// Required when the fill color is similar to the area's one, so the filled pixels cannot be told apart by their color
+class FilledMask final {
+private:
+    std::vector<uint64_t> m_bits;
+
+public:
+    FilledMask(size_t size)
+        : m_bits((size + 63) / 64, 0) {
+
+    }
+
+    // The number of pixels from index on (at most count) that are all marked or all unmarked
+    size_t countLeading(size_t index, size_t count, bool isMarked) const {
+        size_t result = 0;
+        while (result < count) {
+            size_t bit = (index + result) % 64;
+            uint64_t word = m_bits[(index + result) / 64] >> bit;
+            uint64_t breaks = isMarked ? ~word : word;
+
+            size_t run = breaks == 0 ? 64 - bit : utils::min(size_t(std::countr_zero(breaks)), 64 - bit);
+            result += run;
+            if (run < 64 - bit) {
+                break;
+            }
+        }
+
+        return utils::min(result, count);
+    }
+
+    // The number of unmarked pixels before end (at most count), going backward
+    size_t countTrailingUnmarked(size_t end, size_t count) const {
+        size_t result = 0;
+        while (result < count) {
+            size_t last = end - result - 1;
+            size_t bit = last % 64;
+            uint64_t word = m_bits[last / 64] << (63 - bit); // The last pixel's bit is the highest one
+
+            size_t run = word == 0 ? bit + 1 : size_t(std::countl_zero(word));
+            result += run;
+            if (run < bit + 1) {
+                break;
+            }
+        }
+
+        return utils::min(result, count);
+    }
+
+    void mark(size_t index, size_t count) {
+        for (size_t i = index; i < index + count;) {
+            size_t bit = i % 64;
+            size_t length = utils::min(64 - bit, index + count - i);
+
+            m_bits[i / 64] |= (length == 64 ? ~uint64_t(0) : ((uint64_t(1) << length) - 1) << bit);
+            i += length;
+        }
+    }
+};
+
+// A range of a row's pixels [fromX, toX) where the pixels to fill are looked for
+struct FloodFillSeed {
+    uint32_t y;
+    uint32_t fromX;
+    uint32_t toX;
+};
+
+void Image::floodFill(QPoint seed, Color color, uint8_t tolerance) {
+    trace_scope("Image::floodFill");
+
+    assert(hasPixels() && "Image is empty");
+
+    if (seed.x() < 0 || seed.y() < 0 || uint32_t(seed.x()) >= m_width || uint32_t(seed.y()) >= m_height) {
+        return;
+    }
+
+    uint32_t target = atFast(seed.x(), seed.y())._data;
+    uint32_t fill = toStoredColor(color)._data;
+
+    // Otherwise the filled pixels are not similar to the target any more, so they stop the filling by themselves
+    bool isMasked = kernels::countSimilar(&fill, 1, target, tolerance) == 1;
+    FilledMask mask(isMasked ? size_t(m_width) * m_height : 0);
+
+    auto getRow = [this](uint32_t y) { return pixels() + size_t(y) * m_width; };
+
+    // The number of pixels from x on (at most count) that are to be filled
+    auto countFillable = [&](uint32_t x, uint32_t y, uint32_t count) {
+        size_t result = kernels::countSimilar(getRow(y) + x, count, target, tolerance);
+        return isMasked ? mask.countLeading(size_t(y) * m_width + x, result, false) : result;
+    };
+
+    // The number of pixels before x (at most count) that are to be filled, going backward
+    auto countFillableBackward = [&](uint32_t x, uint32_t y, uint32_t count) {
+        size_t result = kernels::countSimilarBackward(getRow(y) + x - count, count, target, tolerance);
+        return isMasked ? mask.countTrailingUnmarked(size_t(y) * m_width + x, result) : result;
+    };
+
+    // The number of pixels from x on (at most count) that are not to be filled
+    auto countNotFillable = [&](uint32_t x, uint32_t y, uint32_t count) {
+        size_t result = kernels::countDifferent(getRow(y) + x, count, target, tolerance);
+        while (isMasked && result < count) { // Similar pixels can be filled already
+            size_t marked = mask.countLeading(size_t(y) * m_width + x + result, count - result, true);
+            if (marked == 0) {
+                break;
+            }
+
+            result += marked;
+            result += kernels::countDifferent(getRow(y) + x + result, count - uint32_t(result), target, tolerance);
+        }
+
+        return result;
+    };
+
+    std::vector<FloodFillSeed> seeds;
+    seeds.push_back(FloodFillSeed{ uint32_t(seed.y()), uint32_t(seed.x()), uint32_t(seed.x()) + 1 });
+
+    while (!seeds.empty()) {
+        FloodFillSeed current = seeds.back();
+        seeds.pop_back();
+
+        uint32_t x = current.fromX;
+        while (x < current.toX) {
+            x += uint32_t(countNotFillable(x, current.y, current.toX - x));
+            if (x >= current.toX) {
+                break;
+            }
+
+            // A span of the pixels to fill, it can go beyond the seed's range to both sides
+            uint32_t fromX = x;
+            if (fromX == current.fromX) {
+                fromX -= uint32_t(countFillableBackward(fromX, current.y, fromX));
+            }
+
+            uint32_t toX = x + uint32_t(countFillable(x, current.y, m_width - x));
+
+            recordChange(fromX, current.y, toX - fromX, 1);
+            kernels::fill(getRow(current.y) + fromX, toX - fromX, fill);
+            if (isMasked) {
+                mask.mark(size_t(current.y) * m_width + fromX, toX - fromX);
+            }
+
+            // The neighbouring rows are looked at along the whole span
+            if (current.y > 0) {
+                seeds.push_back(FloodFillSeed{ current.y - 1, fromX, toX });
+            } if (current.y + 1 < m_height) {
+                seeds.push_back(FloodFillSeed{ current.y + 1, fromX, toX });
+            }
+
+            x = toX;
+        }
+    }
+}
+
+Color Image::toStoredColor(Color color) const {
+    return m_isPremultiplied ? color.premultiplied() : color;
+}
+
+void Image::recordChange(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    if (m_history != nullptr) {
+        m_history->saveTiles(*this, x, y, width, height);
+    }
+}
+
+void Image::convertPixels(bool toPremultiplied) {
+    recordChange(0, 0, m_width, m_height);
+    if (toPremultiplied) {
+        kernels::premultiply(pixels(), size_t(m_width) * m_height);
+    } else {
+        kernels::unpremultiply(pixels(), size_t(m_width) * m_height);
+    }
+}
+
+void Image::setPremultiplied(bool isPremultiplied) {
+    if (m_isPremultiplied != isPremultiplied) {
+        if (hasPixels()) { // Otherwise only the representation of the pixels opened/allocated later is set
+            withSequentialAccess([&]() { convertPixels(isPremultiplied); });
+        }
+
+        m_isPremultiplied = isPremultiplied;
+    }
+}
+
+bool Image::isPremultiplied() const {
+    return m_isPremultiplied;
+}
+
+void Image::setHistory(ImageHistory* history) {
+    m_history = history;
+}
+
+void Image::setAntialiased(bool isAntialiased) {
+    m_isAntialiased = isAntialiased;
+}
+
+bool Image::isAntialiased() const {
+    return m_isAntialiased;
+}
+
+void Image::drawCoverageRasterized(utils::CoverageRasterizer& rast, Color color) {
+    Color storedColor = toStoredColor(color);
+
+    // The rows go downwards, so the rest of them are out of image as well
+    while (rast.hasMore() && rast.getY() < m_height) {
+        for (const utils::CoverageSpan& span : rast.spans()) {
+            if (span.x >= m_width) {
+                continue;
+            }
+
+            uint32_t* pixels = (uint32_t*)&atFast(span.x, rast.getY());
+            uint32_t length = utils::min(span.length, m_width - span.x);
+            recordChange(span.x, rast.getY(), length, 1);
+            if (m_isPremultiplied) {
+                if (span.coverage == nullptr) {
+                    kernels::blendPremultiplied(pixels, length, storedColor._data);
+                } else {
+                    kernels::blendPremultipliedCoverage(pixels, length, storedColor._data, span.coverage);
+                }
+            } else if (span.coverage == nullptr) {
+                kernels::blend(pixels, length, color._data);
+            } else {
+                kernels::blendCoverage(pixels, length, color._data, span.coverage);
+            }
+        }
+
+        rast.nextRow();
+    }
 }
 
 void Image::drawXStroke(uint32_t fromX, uint32_t fromY, uint32_t length, Color color) {
@@ -285,8 +654,11 @@ void Image::drawXStroke(uint32_t fromX, uint32_t fromY, uint32_t length, Color c
 
 // Color is supposed to have alpha = 255
 void Image::drawQuickXStroke(uint32_t fromX, uint32_t fromY, uint32_t length, Color color) {
+    color = toStoredColor(color);
+
     uint32_t toX = utils::min(m_width, fromX + length);
     length = toX - fromX;
+    recordChange(fromX, fromY, length, 1);
 
     // Fast fill by 2 pixels at a time
     if (length > 1) {
@@ -306,7 +678,121 @@ void Image::drawQuickXStroke(uint32_t fromX, uint32_t fromY, uint32_t length, Co
     }
 }
 
+void Image::fillImage(Color color) {
+    assert(hasPixels() && "Image is empty");
+
+    recordChange(0, 0, m_width, m_height);
+    withSequentialAccess([&]() {
+        kernels::fill(pixels(), size_t(m_width) * m_height, toStoredColor(color)._data);
+    });
+}
+
+void Image::blendImage(Color color) {
+    assert(hasPixels() && "Image is empty");
+
+    recordChange(0, 0, m_width, m_height);
+    withSequentialAccess([&]() {
+        if (m_isPremultiplied) {
+            kernels::blendPremultiplied(pixels(), size_t(m_width) * m_height, toStoredColor(color)._data);
+        } else {
+            kernels::blend(pixels(), size_t(m_width) * m_height, color._data);
+        }
+    });
+}
+
+void Image::invertImage() {
+    assert(hasPixels() && "Image is empty");
+
+    recordChange(0, 0, m_width, m_height);
+    withSequentialAccess([&]() {
+        withStraightAlpha([&]() {
+            kernels::invert(pixels(), size_t(m_width) * m_height);
+        });
+    });
+}
+
+void Image::thresholdImage(uint8_t level) {
+    assert(hasPixels() && "Image is empty");
+
+    recordChange(0, 0, m_width, m_height);
+    withSequentialAccess([&]() {
+        withStraightAlpha([&]() {
+            kernels::threshold(pixels(), size_t(m_width) * m_height, level);
+        });
+    });
+}
+
+void Image::multiplyChannels(float red, float green, float blue, float alpha) {
+    assert(hasPixels() && "Image is empty");
+
+    // In the order of the pixel's bytes
+    float factors[4] = { blue, green, red, alpha };
+    recordChange(0, 0, m_width, m_height);
+    withSequentialAccess([&]() {
+        withStraightAlpha([&]() {
+            kernels::multiplyChannels(pixels(), size_t(m_width) * m_height, factors);
+        });
+    });
+}
+
+void Image::compositeImage(const Image& other) {
+    assert(hasPixels() && "Image is empty");
+
+    if (&other == this || m_width != other.getWidth() || m_height != other.getHeight()) {
+        return;
+    }
+
+    size_t count = size_t(m_width) * m_height;
+    recordChange(0, 0, m_width, m_height);
+    withSequentialAccess([&]() {
+        if (m_isPremultiplied && other.m_isPremultiplied) {
+            kernels::compositePremultiplied(pixels(), other.pixels(), count);
+        } else if (!m_isPremultiplied && !other.m_isPremultiplied) {
+            kernels::composite(pixels(), other.pixels(), count);
+        } else { // Different representations, so the pixels are converted one by one
+            for (size_t i = 0; i < count; i++) {
+                Color over = other.pixels()[i];
+                if (m_isPremultiplied) {
+                    kernels::blendPremultiplied(&pixels()[i], 1, over.premultiplied()._data);
+                } else {
+                    pixels()[i] = Color::mix(over.unpremultiplied(), pixels()[i])._data;
+                }
+            }
+        }
+    });
+}
+
+void Image::copyRectFrom(Image& other, QPoint from, uint32_t width, uint32_t height) {
+    assert(hasPixels() && "Image is empty");
+
+    if (&other == this || m_width != other.getWidth() || m_height != other.getHeight()) {
+        return;
+    }
+
+    int64_t fromX = utils::max(int64_t(from.x()), int64_t(0));
+    int64_t fromY = utils::max(int64_t(from.y()), int64_t(0));
+    int64_t toX = utils::min(int64_t(from.x()) + width, int64_t(m_width));
+    int64_t toY = utils::min(int64_t(from.y()) + height, int64_t(m_height));
+    if (fromX >= toX || fromY >= toY) {
+        return;
+    }
+
+    recordChange(uint32_t(fromX), uint32_t(fromY), uint32_t(toX - fromX), uint32_t(toY - fromY));
+    for (int64_t y = fromY; y < toY; y++) {
+        uint32_t* row = (uint32_t*)&atFast(fromX, y);
+        kernels::copy(row, (uint32_t*)&other.atFast(fromX, y), size_t(toX - fromX));
+
+        if (m_isPremultiplied && !other.m_isPremultiplied) {
+            kernels::premultiply(row, size_t(toX - fromX));
+        } else if (!m_isPremultiplied && other.m_isPremultiplied) {
+            kernels::unpremultiply(row, size_t(toX - fromX));
+        }
+    }
+}
+
 bool Image::hasColorInNeighborhood(uint32_t x, uint32_t y, Color color) {
+    color = toStoredColor(color);
+
     for (int ox = -1; ox <= 1; ox++) {
         for (int oy = -1; oy <= 1; oy++) {
             int pix_x = int(x) + ox;
@@ -323,6 +809,12 @@ bool Image::hasColorInNeighborhood(uint32_t x, uint32_t y, Color color) {
     return false;
 }
 
+Color Image::getColor(uint32_t x, uint32_t y) const {
+    Color color = at(x, y);
+
+    return m_isPremultiplied ? color.unpremultiplied() : color;
+}
+
 Color& Image::at(uint32_t x, uint32_t y) {
     assert(x < m_width && y < m_height);
     return atFast(x, y);
@@ -333,12 +825,45 @@ Color Image::at(uint32_t x, uint32_t y) const {
     return atFast(x, y);
 }
 
+uint32_t* Image::pixels() {
+    return m_mappedData.isEmpty() ? m_data.data() : (uint32_t*)m_mappedData.data();
+}
+
+const uint32_t* Image::pixels() const {
+    return m_mappedData.isEmpty() ? m_data.data() : (const uint32_t*)m_mappedData.data();
+}
+
+bool Image::hasPixels() const {
+    return !m_data.isEmpty() || !m_mappedData.isEmpty();
+}
+
+void Image::adviseAccess(utils::MappedFile::Access access) const {
+    m_mappedData.advise(access);
+}
+
+utils::Result<Void> Image::checkImageSize(uint32_t width, uint32_t height) const {
+    // Any 32-bit width and height fit into a 64-bit size, so file-backed images are limited by the file system only
+    if (m_scratchDirectory.isEmpty() && uint64_t(width) * height > IMAGE_SIZE_MAX) {
+        return utils::Failure(
+            "Image size is too big: "
+            + QString::number(width)
+            + " x "
+            + QString::number(height)
+            + "; Maximal size is "
+            + QString::number(IMAGE_SIZE_MAX)
+            + " pixels, unless the image is kept in a scratch file"
+        );
+    }
+
+    return utils::Success();
+}
+
 Color& Image::atFast(uint32_t x, uint32_t y) {
-    return *(Color*)&m_data.at(size_t(y) * m_width + x);
+    return *(Color*)&pixels()[size_t(y) * m_width + x];
 }
 
 Color Image::atFast(uint32_t x, uint32_t y) const {
-    return *(Color*)&m_data.at(size_t(y) * m_width + x);
+    return *(Color*)&pixels()[size_t(y) * m_width + x];
 }
 
 QRect Image::getRect() const {
@@ -379,12 +904,20 @@ QList<QPair<QString, QString>> Image::getFullImageInformation() const {
     return result;
 }
 
-void own_png_progress_callback(png_structp png_ptr, png_uint_32 row, int pass) {
-    double progress = double(pass * g_rowsCount + row) / (g_passesCount * g_rowsCount);
-    progressCallbackFunc(progress * 100);
+// Reports the progress of reading/writing the png's rows, returns whether it is cancelled
+// The rows are read/written one by one to check the token between them, since libpng can only be stopped from within by a longjmp
+static bool reportPngProgress(utils::ProgressToken* token, int pass, int passesCount, uint32_t row, uint32_t rowsCount) {
+    if (token == nullptr) {
+        return false;
+    }
+
+    token->setProgress(uint64_t(pass) * rowsCount + row, uint64_t(passesCount) * rowsCount);
+    return token->isCancelled();
 }
 
-utils::Result<Void> Image::openPng(const QString& fileName) {
+utils::Result<Void> Image::openPng(const QString& fileName, utils::ProgressToken* token) {
+    trace_scope("Image::openPng");
+
     FILE* file = fopen(fileName.toLocal8Bit().data(), "rb");
     if (!file) {
         return utils::Failure("failed to open the file: " + fileName);
@@ -441,20 +974,21 @@ utils::Result<Void> Image::openPng(const QString& fileName) {
         &m_pngFileData.filter_method
     );
 
-    if (setjmp(png_jmpbuf(png_sp))) {
-        return utils::Failure("Internal libpng error while reading png");
+    if (auto result = checkImageSize(m_width, m_height); !result.isOk()) {
+        return result.extractError();
     }
 
-    if (m_width * m_height > IMAGE_SIZE_MAX) {
-        return utils::Failure(
-            "Image size is too big: "
-            + QString::number(m_width)
-            + " x "
-            + QString::number(m_height)
-            + "; Maximal size is "
-            + QString::number(IMAGE_SIZE_MAX)
-            + " pixels"
-        );
+    // The rows are read right into the pixels, so that the image takes no more memory than it would anyway
+    // Everything with a destructor is created before the setjmp, since the longjmp on an error would skip the destructor
+    if (auto result = allocateImage(m_width, m_height); !result.isOk()) {
+        return result.extractError();
+    }
+
+    adviseAccess(utils::MappedFile::Access::SEQUENTIAL);
+    at_scope_exit{ adviseAccess(utils::MappedFile::Access::NORMAL); };
+
+    if (setjmp(png_jmpbuf(png_sp))) {
+        return utils::Failure("Internal libpng error while reading png");
     }
 
     // Setting up the libpng so that we read the image in the required format
@@ -486,50 +1020,37 @@ utils::Result<Void> Image::openPng(const QString& fileName) {
         png_set_gray_to_rgb(png_sp);
     }
 
-    png_read_update_info(png_sp, png_ip); // Updating the png_ip
+    // The pixels are 0xAARRGGBB, i.e. the bytes are B, G, R, A in memory
+    png_set_bgr(png_sp);
 
-    // And now we can read the image itself, finally
-    utils::SizedBuffer2D<png_byte> rows;
-    const png_uint_32 rowbytes = png_get_rowbytes(png_sp, png_ip);
-    if (auto result = utils::SizedBuffer2D<png_byte>::allocNonInitialized(m_height, rowbytes); !result.isOk()) {
-        return result.extractError();
-    } else {
-        rows = result.extract();
-    }
+    // An interlaced image is read in several passes, each of them fills its part of the rows
+    int passesCount = png_set_interlace_handling(png_sp);
 
-    // Setting up the progress check
-    if (g_isProgressDialogOpen) {
-        g_passesCount = m_pngFileData.interlace_method == PNG_INTERLACE_ADAM7 ? PNG_INTERLACE_ADAM7_PASSES : 1;
-        g_rowsCount = m_height;
-        png_set_read_status_fn(png_sp, own_png_progress_callback);
-    }
+    png_read_update_info(png_sp, png_ip); // Updating the png_ip
+    assert(png_get_rowbytes(png_sp, png_ip) == size_t(m_width) * 4);
 
-    png_set_rows(png_sp, png_ip, rows.data());
-    png_read_image(png_sp, rows.data());
+    // And now we can read the image itself, finally
+    for (int pass = 0; pass < passesCount; pass++) {
+        for (uint32_t y = 0; y < m_height; y++) {
+            if (reportPngProgress(token, pass, passesCount, y, m_height)) {
+                return utils::Failure("Opening is cancelled: " + fileName);
+            }
 
-    // Now all we have to do is to convert the read data to our internal format
-    if (auto result = m_data.realloc(m_width * m_height); !result.isOk()) {
-        return result.extractError();
+            png_read_row(png_sp, (png_bytep)&atFast(0, y), NULL);
+        }
     }
 
-    for (uint32_t y = 0; y < m_height; y++) {
-        png_bytep row = rows[y];
-        for (uint32_t x = 0; x < m_width; x++) {
-            Color &pix = atFast(x, y);
-            uint32_t byte_idx = x * 4;
-
-            pix.r() = row[byte_idx];
-            pix.g() = row[byte_idx + 1];
-            pix.b() = row[byte_idx + 2];
-            pix.a() = row[byte_idx + 3];
-        }
+    if (m_isPremultiplied) {
+        convertPixels(true);
     }
 
     m_extension = Extension::PNG;
     return utils::Success();
 }
 
-utils::Result<Void> Image::storePng(const QString& fileName) {
+utils::Result<Void> Image::storePng(const QString& fileName, utils::ProgressToken* token) {
+    trace_scope("Image::storePng");
+
     FILE* file = fopen(fileName.toLocal8Bit().data(), "wb");
     if (!file) {
         return utils::Failure("failed to open the file: " + fileName);
@@ -548,12 +1069,26 @@ utils::Result<Void> Image::storePng(const QString& fileName) {
     png_infop png_ip = png_create_info_struct(png_sp);
 
     // Destroying libpng data on return
-    at_scope_exit{ png_destroy_read_struct(&png_sp, &png_ip, NULL); };
+    at_scope_exit{ png_destroy_write_struct(&png_sp, &png_ip); };
 
     if (!png_ip) {
         return utils::Failure("Libpng error: png_create_info_struct");
     }
 
+    // The rows are written right from the pixels, only the premultiplied ones are converted to a row of their own
+    // Everything with a destructor is created before the setjmp, since the longjmp on an error would skip the destructor
+    utils::SizedBuffer<uint32_t> straightRow;
+    if (m_isPremultiplied) {
+        if (auto result = utils::SizedBuffer<uint32_t>::allocNonInitialized(m_width); !result.isOk()) {
+            return result.extractError();
+        } else {
+            straightRow = result.extract();
+        }
+    }
+
+    adviseAccess(utils::MappedFile::Access::SEQUENTIAL);
+    at_scope_exit{ adviseAccess(utils::MappedFile::Access::NORMAL); };
+
     // Initializing I/O for png file
     png_init_io(png_sp, file);
 
@@ -582,40 +1117,31 @@ utils::Result<Void> Image::storePng(const QString& fileName) {
         return utils::Failure("Internal libpng error while writing png");
     }
 
-    // Allocating memory and filling it with pixels' data
-    utils::SizedBuffer2D<png_byte> rows;
-    const png_uint_32 rowbytes = png_get_rowbytes(png_sp, png_ip);
-    if (auto result = utils::SizedBuffer2D<png_byte>::allocNonInitialized(m_height, rowbytes); !result.isOk()) {
-        return result.extractError();
-    } else {
-        rows = result.extract();
-    }
+    // Writing the image pixels
+    png_write_info(png_sp, png_ip);
 
-    for (uint32_t y = 0; y < m_height; y++) {
-        for (uint32_t x = 0; x < m_width; x++) {
-            Color pix = atFast(x, y);
-            png_bytep byte_p = &rows[y][x * 4];
-
-            byte_p[0] = pix.r();
-            byte_p[1] = pix.g();
-            byte_p[2] = pix.b();
-            byte_p[3] = pix.a();
-        }
-    }
+    // The pixels are 0xAARRGGBB, i.e. the bytes are B, G, R, A in memory
+    png_set_bgr(png_sp);
 
-    // Setting up the progress check
-    if (g_isProgressDialogOpen) {
-        g_passesCount = (m_extension == Extension::PNG && m_pngFileData.interlace_method == PNG_INTERLACE_ADAM7)
-            ? PNG_INTERLACE_ADAM7_PASSES : 1;
-        g_rowsCount = m_height;
-        png_set_write_status_fn(png_sp, own_png_progress_callback);
-    }
+    // An interlaced image is written in several passes, each of them goes through all the rows
+    int passesCount = png_set_interlace_handling(png_sp);
+    for (int pass = 0; pass < passesCount; pass++) {
+        for (uint32_t y = 0; y < m_height; y++) {
+            if (reportPngProgress(token, pass, passesCount, y, m_height)) {
+                return utils::Failure("Saving is cancelled: " + fileName);
+            }
 
-    // Writing the image pixels
-    png_write_info(png_sp, png_ip);
+            uint32_t* row = (uint32_t*)&atFast(0, y);
+            if (m_isPremultiplied) {
+                kernels::copy(straightRow.data(), row, m_width);
+                kernels::unpremultiply(straightRow.data(), m_width);
+                row = straightRow.data();
+            }
+
+            png_write_row(png_sp, (png_const_bytep)row);
+        }
+    }
 
-    png_set_rows(png_sp, png_ip, rows.data());
-    png_write_image(png_sp, rows.data());
     png_write_end(png_sp, png_ip);
 
     if (setjmp(png_jmpbuf(png_sp))) {
@@ -634,6 +1160,7 @@ Image& Image::fillWithSubimage(Image& result, QPoint from, uint32_t width, uint3
 
     result.m_width = width;
     result.m_height = height;
+    result.m_isPremultiplied = m_isPremultiplied;
 
     for (uint32_t y = from.y(); y < from.y() + height; y++) {
         Color* rowPtrSrc = &atFast(width, y);
@@ -6,10 +6,15 @@
 #include "Color.h"
 #include "../Utils/Result.h"
 #include "../Utils/Buffer.h"
+#include "../Utils/MappedFile.h"
+#include "../Utils/ProgressToken.h"
 #include "../Utils/Rasterization.h"
 
+class ImageHistory;
 
-// Maximal number of pixels in an image (2^31 - 1)
+
+// Maximal number of pixels in an image kept in memory (2^31 - 1)
+// The images kept in a scratch file are limited by the file system only
 constexpr uint32_t IMAGE_SIZE_MAX = 2147483647;
 
 
@@ -43,7 +48,13 @@ private:
 	uint32_t m_width = 0;
 	uint32_t m_height = 0;
 	QString m_fileName = "";
-	utils::SizedBuffer<uint32_t> m_data;
+	// The pixels, if they are kept in memory
+	// Large images get fresh huge pages: allocating them costs nothing until the pixels are written, and the passes over them miss TLB less
+	utils::SizedBuffer<uint32_t, utils::AllocationPolicy::PAGES> m_data;
+	utils::MappedFile m_mappedData; // The pixels, if they are kept in a scratch file
+
+	// The directory where the scratch files for the pixels are created, the pixels are kept in memory if it is empty
+	QString m_scratchDirectory = "";
 
 	///   Additional data on the original image file   ///
 	// The number of bits for a single color component: 1, 2, 4, 8, or 16
@@ -58,6 +69,15 @@ private:
 	// The extension of the file currently opened
 	Extension m_extension = Extension::NONE;
 
+	// Whether lines and circles are drawn anti-aliased
+	bool m_isAntialiased = false;
+
+	// Whether the pixels are stored with premultiplied alpha
+	bool m_isPremultiplied = false;
+
+	// Keeps the parts of the image before they are changed, if set
+	ImageHistory* m_history = nullptr;
+
 	// Extension-specific data
 	// Since there is png only now, the union part looks pretty useless...
 	union {
@@ -73,22 +93,49 @@ public:
 	// The current image must already be created and have the same size as the other
 	void copyFrom(Image& other);
 
+	// Makes the images allocated afterwards keep their pixels in a memory-mapped scratch file in the directory instead of memory
+	// Such images can be larger than RAM and IMAGE_SIZE_MAX, all the functions work with them the same way
+	// An empty directory returns to keeping the pixels in memory
+	void setScratchDirectory(const QString& directory);
+	const QString& getScratchDirectory() const;
+	bool isFileBacked() const;
+
 	// Allocates an empty image with width and height
 	utils::Result<Void> allocateImage(uint32_t width, uint32_t height);
 
-	utils::Result<Void> open(const QString& fileName); // Loads an image from file, automatically recognizes the file extension
-	utils::Result<Void> store(const QString& fileName); // Stores an image to file, automatically recognizes the file extension
+	// If a token is passed, the progress is reported to it and the operation stops with a Failure once it is cancelled
+	// No global state is used, so several images can be opened/stored at the same time on different threads
+	utils::Result<Void> open(const QString& fileName, utils::ProgressToken* token = nullptr); // Loads an image from file, automatically recognizes the file extension
+	utils::Result<Void> store(const QString& fileName, utils::ProgressToken* token = nullptr); // Stores an image to file, automatically recognizes the file extension
+
+	// Makes copy a full copy of this image, including the information on the file
+	utils::Result<Void> copyTo(Image& copy) const;
+
+	// Takes the information on the file (name, extension, png data) from the other image, e.g. from a copy that was stored
+	void copyFileInfoFrom(const Image& other);
 	
 	// Creates a new image (width x height) filled with fillColor
 	utils::Result<Void> newImage(uint32_t width, uint32_t height, Color fillColor);
 
+	// Switches the pixels' storage between straight and premultiplied alpha, converting the current pixels
+	// Premultiplied images are blended and displayed faster, files are always stored with straight alpha
+	// Colors are passed to the image with straight alpha in both cases
+	void setPremultiplied(bool isPremultiplied);
+	bool isPremultiplied() const;
+
+	// Sets the history the changes of the image are recorded to, nullptr to stop recording
+	// The pixels changed directly via at()/atFast() are not recorded
+	void setHistory(ImageHistory* history);
+
 	// Required image functions
 
 	// Changes all the pixel's channel to some value 
 	void channelFilter(Color::Channel channel, uint8_t value);
 
 	// Splits the image into NxM subimages and saves each one to a separate file (-basicName-_X_Y.png)
-	void splitImageIntoSubimages(uint32_t N, uint32_t M, const QString& basicName);
+	// Stops at the first file that failed to be stored
+	// If a token is passed, the progress is reported to it by the files and the splitting stops with a Failure once it is cancelled
+	utils::Result<Void> splitImageIntoSubimages(uint32_t N, uint32_t M, const QString& basicName, utils::ProgressToken* token = nullptr);
 
 	// Draws a grid splitting image into NxM parts
 	void splitImageWithGrid(uint32_t N, uint32_t M, float lineWidth, Color color);
@@ -100,10 +147,16 @@ public:
 	void drawSquareWithDiagonals(QPoint from, uint32_t side, float lineWidth, Color lineColor, Color fillColor, bool needsFill);
 
 	// Wraps all the white areas on the image with a line of lineColor
-	void emphasizeWhiteAreas(Color lineColor);
+	// If a token is passed, the progress is reported to it and the image is left partly changed once it is cancelled
+	void emphasizeWhiteAreas(Color lineColor, utils::ProgressToken* token = nullptr);
 
 	// Drawing funсtions
 
+	// Turns anti-aliasing on or off for the lines and circles drawn afterwards
+	// Anti-aliased shapes have the same size, but their edges are blended with the image
+	void setAntialiased(bool isAntialiased);
+	bool isAntialiased() const;
+
 	// General line-drawing function
 	// Draws a straight line from one point to another
 	void drawLine(QPoint from, QPoint to, float width, Color color);
@@ -126,6 +179,15 @@ public:
 	// Draws a filled circle at center with a radius and color
 	void fillCircle(QPointF center, float radius, Color color);
 
+	// Draws a filled polygon, the last point is connected to the first one
+	// The polygon can be concave and self-intersecting, the rule decides which of its parts are filled
+	void fillPolygon(std::span<const QPointF> points, utils::FillRule rule, Color color);
+
+	// Fills the area of the pixels similar to the one at seed and connected to it by the sides with color, as a paint bucket does
+	// A pixel is similar if each of its channels differs from the seed's one by at most tolerance
+	// Goes through the area in spans of rows with a stack of its own, so the huge areas are filled fast and without recursion
+	void floodFill(QPoint seed, Color color, uint8_t tolerance);
+
 	// Draws a horizontal line along a single row
 	// In case of incorrect y or x value just returns
 	void drawXStroke(uint32_t fromX, uint32_t fromY, uint32_t length, Color color);
@@ -134,12 +196,41 @@ public:
 	// Does not use color blending, so must not be used with color with alpha less than 255
 	void drawQuickXStroke(uint32_t fromX, uint32_t fromY, uint32_t length, Color color);
 
+	// Bulk functions
+	// Process the whole image (or a rect of it) at once with the native pixel kernels
+
+	// Fills the whole image with color, without color blending
+	void fillImage(Color color);
+
+	// Blends color over the whole image
+	void blendImage(Color color);
+
+	// Inverts the colors of the whole image, alpha is kept
+	void invertImage();
+
+	// Makes the pixels white if their brightness is at least level and black otherwise, alpha is kept
+	void thresholdImage(uint8_t level);
+
+	// Multiplies the channels of the whole image by the factors, the results are clamped to 255
+	void multiplyChannels(float red, float green, float blue, float alpha);
+
+	// Composites the other image over this one (source-over)
+	// The other image must have the same size
+	void compositeImage(const Image& other);
+
+	// Copies a rect of the other image to the same place of this one
+	// The other image must have the same size, the rect is clipped by the image's borders
+	void copyRectFrom(Image& other, QPoint from, uint32_t width, uint32_t height);
+
 	// Converts the contained data to Qt Image, or returns Failure if there is no image loaded
 	utils::Result<QImage> toQImage() const;
 
 	// Returns true if one of the surrounding pixels is of the stated color
 	bool hasColorInNeighborhood(uint32_t x, uint32_t y, Color color);
 
+	Color getColor(uint32_t x, uint32_t y) const; // The pixel's straight-alpha color, whatever the storage is
+
+	// The pixel as it is stored, i.e. premultiplied if the image is
 	Color& at(uint32_t x, uint32_t y); // Slower, but safer
 	Color at(uint32_t x, uint32_t y) const; // A constant variation of the at() function
 
@@ -154,8 +245,50 @@ public:
 	QList<QPair<QString, QString>> getFullImageInformation() const; // Image information for displaying somewhere, "value_name": "value"
 
 private:
-	utils::Result<Void> openPng(const QString& fileName); // Loads an image from a png file
-	utils::Result<Void> storePng(const QString& fileName); // Stores an image to a png file
+	utils::Result<Void> openPng(const QString& fileName, utils::ProgressToken* token); // Loads an image from a png file
+	utils::Result<Void> storePng(const QString& fileName, utils::ProgressToken* token); // Stores an image to a png file
+
+	// The pixels, row by row, wherever they are kept
+	uint32_t* pixels();
+	const uint32_t* pixels() const;
+	bool hasPixels() const;
+
+	// Gives a hint on how the pixels are accessed from now on, if they are kept in a scratch file
+	void adviseAccess(utils::MappedFile::Access access) const;
+
+	// Fails if the image of the size cannot be allocated with the current storage
+	utils::Result<Void> checkImageSize(uint32_t width, uint32_t height) const;
+
+	// Lets the history keep the rect before it is changed
+	void recordChange(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+	// Converts a straight-alpha color to the pixels' representation
+	Color toStoredColor(Color color) const;
+
+	// Converts the pixels between straight and premultiplied alpha, the image's representation is not changed
+	void convertPixels(bool toPremultiplied);
+
+	// Runs an operation that works with straight alpha only, the premultiplied pixels are converted for it
+	template<class Operation>
+	inline void withStraightAlpha(Operation operation) {
+		if (m_isPremultiplied) {
+			convertPixels(false);
+		}
+
+		operation();
+
+		if (m_isPremultiplied) {
+			convertPixels(true);
+		}
+	}
+
+	// Runs an operation that goes through all the pixels once, the scratch file (if any) reads ahead and drops the passed pages meanwhile
+	template<class Operation>
+	inline void withSequentialAccess(Operation operation) {
+		adviseAccess(utils::MappedFile::Access::SEQUENTIAL);
+		operation();
+		adviseAccess(utils::MappedFile::Access::NORMAL);
+	}
 
 	// Returns an image filled with the stated part of this image
 	Image& fillWithSubimage(Image& result, QPoint from, uint32_t width, uint32_t height);
@@ -166,6 +299,9 @@ private:
 	// Draws a thin line with LineRasterizer
 	void drawThinLine(QPoint from, QPoint to, Color color);
 
+	// Draws an anti-aliased shape dictated by the Rasterizer, blending its edges with the image
+	void drawCoverageRasterized(utils::CoverageRasterizer& rast, Color color);
+
 	// Draws a shape dictated by the Rasterizer
 	template<utils::SingleRasterizerConcept Raster>
 	inline void drawRasterized(Raster rast, Color color) {
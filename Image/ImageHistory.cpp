@@ -0,0 +1,266 @@
+#include "ImageHistory.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "Image.h"
+
+void ImageHistory::reset(uint32_t width, uint32_t height) {
+    clear();
+
+    m_width = width;
+    m_height = height;
+    m_tilesPerRow = (width + TILE_SIDE - 1) / TILE_SIDE;
+
+    size_t tilesCount = size_t(m_tilesPerRow) * ((height + TILE_SIDE - 1) / TILE_SIDE);
+    m_keptTiles.assign((tilesCount + 63) / 64, 0);
+}
+
+void ImageHistory::clear() {
+    m_undoSteps.clear();
+    m_redoSteps.clear();
+    m_usedBytes = 0;
+
+    // The current step has nothing to be undone to as well
+    if (m_isRecording) {
+        m_currentStep.tiles.clear();
+        m_currentStep.bytes = 0;
+        m_isStepDropped = true;
+    }
+}
+
+void ImageHistory::setMemoryBudget(size_t bytes) {
+    m_memoryBudget = bytes;
+    freeMemory(0);
+}
+
+size_t ImageHistory::getUsedBytes() const {
+    return m_usedBytes;
+}
+
+void ImageHistory::beginStep(const QString& name) {
+    endStep();
+
+    m_redoSteps.clear();
+    m_usedBytes = 0;
+    for (const Step& step : m_undoSteps) {
+        m_usedBytes += step.bytes;
+    }
+
+    m_currentStep = Step();
+    m_currentStep.name = name;
+    std::fill(m_keptTiles.begin(), m_keptTiles.end(), 0);
+
+    m_isRecording = true;
+    m_isStepDropped = false;
+}
+
+void ImageHistory::endStep() {
+    if (!m_isRecording) {
+        return;
+    }
+
+    m_isRecording = false;
+    if (!m_isStepDropped && !m_currentStep.tiles.empty()) {
+        m_undoSteps.push_back(std::move(m_currentStep));
+    } else {
+        m_usedBytes -= m_currentStep.bytes;
+    }
+
+    m_currentStep = Step();
+}
+
+bool ImageHistory::isRecording() const {
+    return m_isRecording;
+}
+
+void ImageHistory::saveTiles(Image& image, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    if (!m_isRecording || image.getWidth() != m_width || image.getHeight() != m_height) {
+        if (m_isRecording || !m_undoSteps.empty() || !m_redoSteps.empty()) {
+            clear();
+        }
+
+        return;
+    }
+
+    if (m_isStepDropped || width == 0 || height == 0 || x >= m_width || y >= m_height) {
+        return;
+    }
+
+    uint32_t toX = uint32_t(std::min(uint64_t(x) + width, uint64_t(m_width)));
+    uint32_t toY = uint32_t(std::min(uint64_t(y) + height, uint64_t(m_height)));
+
+    for (uint32_t tileY = y / TILE_SIDE; tileY <= (toY - 1) / TILE_SIDE; tileY++) {
+        for (uint32_t tileX = x / TILE_SIDE; tileX <= (toX - 1) / TILE_SIDE; tileX++) {
+            uint32_t index = tileY * m_tilesPerRow + tileX;
+            uint64_t bit = uint64_t(1) << (index % 64);
+            if (m_keptTiles[index / 64] & bit) {
+                continue;
+            }
+
+            m_keptTiles[index / 64] |= bit;
+
+            QRect rect = getTileRect(index);
+            size_t tileBytes = size_t(rect.width()) * rect.height() * sizeof(uint32_t);
+            if (!freeMemory(tileBytes)) { // Even with all the previous steps dropped
+                m_currentStep.tiles.clear();
+                m_usedBytes -= m_currentStep.bytes;
+                m_currentStep.bytes = 0;
+                m_isStepDropped = true;
+                return;
+            }
+
+            m_currentStep.tiles.push_back(Tile{ index, readTile(image, index), false });
+            m_currentStep.bytes += tileBytes;
+            m_usedBytes += tileBytes;
+        }
+    }
+}
+
+bool ImageHistory::canUndo() const {
+    return !m_undoSteps.empty();
+}
+
+bool ImageHistory::canRedo() const {
+    return !m_redoSteps.empty();
+}
+
+QString ImageHistory::getUndoName() const {
+    return m_undoSteps.empty() ? "" : m_undoSteps.back().name;
+}
+
+QString ImageHistory::getRedoName() const {
+    return m_redoSteps.empty() ? "" : m_redoSteps.back().name;
+}
+
+bool ImageHistory::undo(Image& image) {
+    endStep();
+
+    if (m_undoSteps.empty() || image.getWidth() != m_width || image.getHeight() != m_height) {
+        return false;
+    }
+
+    m_redoSteps.push_back(std::move(m_undoSteps.back()));
+    m_undoSteps.pop_back();
+
+    swapTiles(image, m_redoSteps.back());
+
+    return true;
+}
+
+bool ImageHistory::redo(Image& image) {
+    endStep();
+
+    if (m_redoSteps.empty() || image.getWidth() != m_width || image.getHeight() != m_height) {
+        return false;
+    }
+
+    m_undoSteps.push_back(std::move(m_redoSteps.back()));
+    m_redoSteps.pop_back();
+
+    swapTiles(image, m_undoSteps.back());
+
+    return true;
+}
+
+bool ImageHistory::compressSome() {
+    uint32_t compressedCount = 0;
+
+    // The oldest steps first, as they are the least likely to be needed soon
+    for (std::deque<Step>* steps : { &m_undoSteps, &m_redoSteps }) {
+        for (Step& step : *steps) {
+            for (; step.compressedCount < step.tiles.size(); step.compressedCount++) {
+                if (compressedCount == TILES_PER_COMPRESSION) {
+                    return true;
+                }
+
+                Tile& tile = step.tiles[step.compressedCount];
+                if (tile.isCompressed) {
+                    continue;
+                }
+
+                // The fastest compression is enough for the flat areas the edited tiles usually have
+                QByteArray compressed = qCompress(tile.pixels, 1);
+                if (compressed.size() < tile.pixels.size()) {
+                    step.bytes -= tile.pixels.size() - compressed.size();
+                    m_usedBytes -= tile.pixels.size() - compressed.size();
+
+                    tile.pixels = std::move(compressed);
+                    tile.isCompressed = true;
+                }
+
+                compressedCount++;
+            }
+        }
+    }
+
+    return false;
+}
+
+QRect ImageHistory::getTileRect(uint32_t index) const {
+    uint32_t x = (index % m_tilesPerRow) * TILE_SIDE;
+    uint32_t y = (index / m_tilesPerRow) * TILE_SIDE;
+
+    return QRect(x, y, std::min(TILE_SIDE, m_width - x), std::min(TILE_SIDE, m_height - y));
+}
+
+QByteArray ImageHistory::readTile(Image& image, uint32_t index) const {
+    QRect rect = getTileRect(index);
+    size_t rowBytes = size_t(rect.width()) * sizeof(uint32_t);
+
+    QByteArray result(qsizetype(rowBytes * rect.height()), Qt::Uninitialized);
+    for (int row = 0; row < rect.height(); row++) {
+        std::memcpy(result.data() + row * rowBytes, &image.atFast(rect.x(), rect.y() + row), rowBytes);
+    }
+
+    return result;
+}
+
+void ImageHistory::writeTile(Image& image, uint32_t index, const QByteArray& pixels) const {
+    QRect rect = getTileRect(index);
+    size_t rowBytes = size_t(rect.width()) * sizeof(uint32_t);
+
+    assert(size_t(pixels.size()) == rowBytes * rect.height());
+    for (int row = 0; row < rect.height(); row++) {
+        std::memcpy(&image.atFast(rect.x(), rect.y() + row), pixels.constData() + row * rowBytes, rowBytes);
+    }
+}
+
+void ImageHistory::swapTiles(Image& image, Step& step) {
+    m_usedBytes -= step.bytes;
+    step.bytes = 0;
+
+    for (Tile& tile : step.tiles) {
+        QByteArray current = readTile(image, tile.index);
+        writeTile(image, tile.index, tile.isCompressed ? qUncompress(tile.pixels) : tile.pixels);
+
+        tile.pixels = std::move(current);
+        tile.isCompressed = false;
+        step.bytes += tile.pixels.size();
+    }
+
+    step.compressedCount = 0;
+    m_usedBytes += step.bytes;
+
+    // The step's tiles are not compressed any more, so the others can be over the budget now
+    freeMemory(0);
+}
+
+bool ImageHistory::freeMemory(size_t requiredBytes) {
+    while (m_usedBytes + requiredBytes > m_memoryBudget) {
+        // The steps farthest from the current state are the least recently made or undone
+        if (m_undoSteps.size() > (m_redoSteps.empty() && !m_isRecording ? 1 : 0)) {
+            dropStep(m_undoSteps);
+        } else if (m_redoSteps.size() > 1) {
+            dropStep(m_redoSteps);
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ImageHistory::dropStep(std::deque<Step>& steps) {
+    m_usedBytes -= steps.front().bytes;
+    steps.pop_front();
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <QByteArray>
+#include <QRect>
+#include <QString>
+
+class Image;
+
+// Undo/redo history of an image
+// The image is split into tiles, and each step keeps only the tiles that were changed within it:
+// a tile is copied right before its first change in the step (copy-on-write), so a pen stroke costs as much as the tiles it went through
+// Undoing a step exchanges the kept tiles with the image's ones, so the same step keeps what is needed to redo it
+// The kept tiles are compressed when the editor is idle, the least recently made steps are dropped once the memory budget is exceeded
+class ImageHistory final {
+public:
+	// Tiles are squares of TILE_SIDE pixels, the ones at the right and bottom borders can be smaller
+	static constexpr uint32_t TILE_SIDE = 64;
+
+	// The memory the steps can take by default
+	static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t(512) << 20;
+
+	// The number of tiles compressed by a single compressSome() call, so that it does not take long
+	static constexpr uint32_t TILES_PER_COMPRESSION = 256;
+
+private:
+	// A tile's pixels as they were before the step (or after it, once the step is undone)
+	struct Tile {
+		uint32_t index = 0; // Of the tile within the image, row by row
+		QByteArray pixels; // The rows of the tile one after another, compressed with qCompress if isCompressed
+		bool isCompressed = false;
+	};
+
+	struct Step {
+		QString name;
+		std::vector<Tile> tiles;
+		size_t compressedCount = 0; // The first tiles that compressSome() has gone through
+		size_t bytes = 0;
+	};
+
+	std::deque<Step> m_undoSteps; // The last step is undone first
+	std::deque<Step> m_redoSteps; // The last step is redone first
+	Step m_currentStep;
+	std::vector<uint64_t> m_keptTiles; // A bit for each tile, set if the current step keeps it
+
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	uint32_t m_tilesPerRow = 0;
+
+	size_t m_memoryBudget = DEFAULT_MEMORY_BUDGET;
+	size_t m_usedBytes = 0;
+
+	bool m_isRecording = false;
+	bool m_isStepDropped = false; // The current step went over the memory budget, so it cannot be undone
+
+public:
+	// Starts a new history for an image of the size, the previous steps are dropped
+	void reset(uint32_t width, uint32_t height);
+
+	// Drops all the steps
+	void clear();
+
+	void setMemoryBudget(size_t bytes);
+	size_t getUsedBytes() const;
+
+	// The changes of the image between these calls form a single step, the steps that could be redone are dropped
+	// endStep() does nothing if no step was begun
+	void beginStep(const QString& name);
+	void endStep();
+	bool isRecording() const;
+
+	// Called by the image right before it changes the rect, keeps the tiles the current step has not kept yet
+	// The changes made outside of a step clear the history, since the steps before them cannot be undone correctly any more
+	void saveTiles(Image& image, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+	bool canUndo() const;
+	bool canRedo() const;
+	QString getUndoName() const;
+	QString getRedoName() const;
+
+	// Return false if there is nothing to undo/redo
+	bool undo(Image& image);
+	bool redo(Image& image);
+
+	// Compresses a part of the kept tiles, returns true if there are more of them to compress
+	// Supposed to be called when the editor is idle
+	bool compressSome();
+
+private:
+	QRect getTileRect(uint32_t index) const;
+
+	// Copies the tile's pixels from the image and back
+	QByteArray readTile(Image& image, uint32_t index) const;
+	void writeTile(Image& image, uint32_t index, const QByteArray& pixels) const;
+
+	// Exchanges the step's tiles with the image's ones
+	void swapTiles(Image& image, Step& step);
+
+	// Drops the least recently made steps until the memory used (with the bytes required) is within the budget
+	// Returns false if it is not possible
+	bool freeMemory(size_t requiredBytes);
+
+	void dropStep(std::deque<Step>& steps);
+};
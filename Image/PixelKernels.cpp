@@ -0,0 +1,629 @@
+#include "PixelKernels.h"
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define KERNELS_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// Weights of the channels for the brightness, their sum is 256
+constexpr uint32_t BRIGHTNESS_RED = 77;
+constexpr uint32_t BRIGHTNESS_GREEN = 150;
+constexpr uint32_t BRIGHTNESS_BLUE = 29;
+
+constexpr uint32_t ALPHA_MASK = 0xff000000;
+constexpr uint32_t COLOR_MASK = 0x00ffffff;
+
+// The largest number of pixels composite() converts at a time
+constexpr size_t COMPOSITE_CHUNK_SIZE = 256;
+
+// The largest channel multiplier, so that the 8.8 fixed-point products stay within the signed 16 bits
+constexpr float MAX_CHANNEL_FACTOR = 127.f;
+
+// Division by 255 with rounding for x + 128 (x <= 255 * 255), the same as in the SSE2 version
+static inline uint32_t div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t premultiplyPixel(uint32_t pixel) {
+    uint32_t alpha = pixel >> 24;
+    uint32_t result = pixel & ALPHA_MASK;
+    for (uint32_t channel = 0; channel < 3; channel++) {
+        result |= div255(((pixel >> (channel * 8)) & 0xff) * alpha) << (channel * 8);
+    }
+
+    return result;
+}
+
+// The same float arithmetics as in the SSE2 version: value * (255 / alpha), rounded to the nearest
+static inline uint32_t unpremultiplyPixel(uint32_t pixel) {
+    uint32_t alpha = pixel >> 24;
+    if (alpha == 0) {
+        return 0;
+    }
+
+    float factor = 255.f / float(alpha);
+    uint32_t result = pixel & ALPHA_MASK;
+    for (uint32_t channel = 0; channel < 3; channel++) {
+        float value = std::nearbyint(float((pixel >> (channel * 8)) & 0xff) * factor);
+        result |= (value > 255.f ? 255 : uint32_t(value)) << (channel * 8);
+    }
+
+    return result;
+}
+
+// Source-over for a premultiplied pair, the sums are saturated as in the SSE2 version
+static inline uint32_t compositePixel(uint32_t under, uint32_t over) {
+    uint32_t inverse = 255 - (over >> 24);
+    uint32_t result = 0;
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        uint32_t value = ((over >> (channel * 8)) & 0xff) + div255(((under >> (channel * 8)) & 0xff) * inverse);
+        result |= (value > 255 ? 255 : value) << (channel * 8);
+    }
+
+    return result;
+}
+
+static inline bool isSimilarPixel(uint32_t pixel, uint32_t color, uint8_t tolerance) {
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        int32_t difference = int32_t((pixel >> (channel * 8)) & 0xff) - int32_t((color >> (channel * 8)) & 0xff);
+        if (difference > tolerance || -difference > tolerance) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#ifdef KERNELS_USE_SSE2
+// A bit for each of the 4 pixels, set if the pixel is similar to the color
+static inline uint32_t getSimilarMask(__m128i pixels4, __m128i color4, __m128i tolerance16) {
+    __m128i difference = _mm_or_si128(_mm_subs_epu8(pixels4, color4), _mm_subs_epu8(color4, pixels4));
+    __m128i excess = _mm_subs_epu8(difference, tolerance16); // Zero for the channels within the tolerance
+    return uint32_t(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(excess, _mm_setzero_si128()))));
+}
+#endif
+
+// The number of leading pixels that are similar (or not similar) to the color
+static size_t countLeading(const uint32_t* pixels, size_t count, uint32_t color, uint8_t tolerance, bool isSimilar) {
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    __m128i color4 = _mm_set1_epi32(int(color));
+    __m128i tolerance16 = _mm_set1_epi8(char(tolerance));
+    uint32_t runMask = isSimilar ? 0xf : 0;
+
+    for (; i + 4 <= count; i += 4) {
+        uint32_t breaks = getSimilarMask(_mm_loadu_si128((__m128i*)(pixels + i)), color4, tolerance16) ^ runMask;
+        if (breaks != 0) {
+            return i + std::countr_zero(breaks);
+        }
+    }
+#endif
+
+    for (; i < count && isSimilarPixel(pixels[i], color, tolerance) == isSimilar; i++);
+
+    return i;
+}
+
+static inline uint32_t getBrightness(uint32_t pixel) {
+    return (((pixel >> 16) & 0xff) * BRIGHTNESS_RED
+        + ((pixel >> 8) & 0xff) * BRIGHTNESS_GREEN
+        + (pixel & 0xff) * BRIGHTNESS_BLUE) >> 8;
+}
+
+// A channel factor in the 8.8 fixed-point format
+static inline uint16_t toFixedFactor(float factor) {
+    if (!(factor > 0)) { // NaN is treated as 0 as well
+        return 0;
+    }
+
+    if (factor > MAX_CHANNEL_FACTOR) {
+        factor = MAX_CHANNEL_FACTOR;
+    }
+
+    return uint16_t(factor * 256 + 0.5f);
+}
+
+void kernels::fill(uint32_t* pixels, size_t count, uint32_t value) {
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    __m128i value4 = _mm_set1_epi32(int(value));
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(pixels + i), value4);
+    }
+#endif
+
+    for (; i < count; i++) {
+        pixels[i] = value;
+    }
+}
+
+void kernels::blend(uint32_t* pixels, size_t count, uint32_t color) {
+    uint32_t alpha = color >> 24;
+    if (alpha == 0) {
+        return;
+    } if (alpha == 255) {
+        fill(pixels, count, color);
+        return;
+    }
+
+    // result = (pixel * (255 - alpha) + color * alpha) / 255 for every channel
+    // The alpha channel is computed the same way as if the color's alpha was 255
+    uint32_t inverse = 255 - alpha;
+    uint32_t source[4] = { color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff, 255 };
+
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    // 2 pixels per register, 16 bits per channel
+    __m128i zero = _mm_setzero_si128();
+    __m128i inverse8 = _mm_set1_epi16(short(inverse));
+    __m128i bias8 = _mm_set_epi16(
+        short(source[3] * alpha + 128), short(source[2] * alpha + 128), short(source[1] * alpha + 128), short(source[0] * alpha + 128),
+        short(source[3] * alpha + 128), short(source[2] * alpha + 128), short(source[1] * alpha + 128), short(source[0] * alpha + 128)
+    );
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels4 = _mm_loadu_si128((__m128i*)(pixels + i));
+        __m128i low = _mm_unpacklo_epi8(pixels4, zero);
+        __m128i high = _mm_unpackhi_epi8(pixels4, zero);
+
+        low = _mm_add_epi16(_mm_mullo_epi16(low, inverse8), bias8);
+        high = _mm_add_epi16(_mm_mullo_epi16(high, inverse8), bias8);
+
+        low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+        _mm_storeu_si128((__m128i*)(pixels + i), _mm_packus_epi16(low, high));
+    }
+#endif
+
+    for (; i < count; i++) {
+        uint32_t pixel = pixels[i];
+        uint32_t result = 0;
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            uint32_t value = (pixel >> (channel * 8)) & 0xff;
+            result |= div255(value * inverse + source[channel] * alpha) << (channel * 8);
+        }
+
+        pixels[i] = result;
+    }
+}
+
+void kernels::blendCoverage(uint32_t* pixels, size_t count, uint32_t color, const uint8_t* coverage) {
+    uint32_t alpha = color >> 24;
+    if (alpha == 0) {
+        return;
+    }
+
+    // The same as blend(), but the alpha is div255(coverage * alpha) for each pixel
+    uint32_t source[4] = { color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff, 255 };
+
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    // 2 pixels per register, 16 bits per channel
+    __m128i zero = _mm_setzero_si128();
+    __m128i bias8 = _mm_set1_epi16(128);
+    __m128i max8 = _mm_set1_epi16(255);
+    __m128i alpha8 = _mm_set1_epi16(short(alpha));
+    __m128i source8 = _mm_set_epi16(
+        short(source[3]), short(source[2]), short(source[1]), short(source[0]),
+        short(source[3]), short(source[2]), short(source[1]), short(source[0])
+    );
+
+    for (; i + 4 <= count; i += 4) {
+        int32_t coverage4;
+        std::memcpy(&coverage4, coverage + i, sizeof(coverage4));
+
+        // Alphas of the 4 pixels in the lower 16-bit lanes
+        __m128i alphas = _mm_unpacklo_epi8(_mm_cvtsi32_si128(coverage4), zero);
+        alphas = _mm_add_epi16(_mm_mullo_epi16(alphas, alpha8), bias8);
+        alphas = _mm_srli_epi16(_mm_add_epi16(alphas, _mm_srli_epi16(alphas, 8)), 8);
+
+        // Each alpha repeated for the 4 channels of its pixel
+        alphas = _mm_unpacklo_epi16(alphas, alphas);
+        __m128i lowAlphas = _mm_unpacklo_epi32(alphas, alphas);
+        __m128i highAlphas = _mm_unpackhi_epi32(alphas, alphas);
+
+        __m128i pixels4 = _mm_loadu_si128((__m128i*)(pixels + i));
+        __m128i low = _mm_unpacklo_epi8(pixels4, zero);
+        __m128i high = _mm_unpackhi_epi8(pixels4, zero);
+
+        low = _mm_add_epi16(_mm_mullo_epi16(low, _mm_sub_epi16(max8, lowAlphas)), _mm_mullo_epi16(source8, lowAlphas));
+        high = _mm_add_epi16(_mm_mullo_epi16(high, _mm_sub_epi16(max8, highAlphas)), _mm_mullo_epi16(source8, highAlphas));
+        low = _mm_add_epi16(low, bias8);
+        high = _mm_add_epi16(high, bias8);
+
+        low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+        _mm_storeu_si128((__m128i*)(pixels + i), _mm_packus_epi16(low, high));
+    }
+#endif
+
+    for (; i < count; i++) {
+        uint32_t pixelAlpha = div255(coverage[i] * alpha);
+        uint32_t inverse = 255 - pixelAlpha;
+
+        uint32_t pixel = pixels[i];
+        uint32_t result = 0;
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            uint32_t value = (pixel >> (channel * 8)) & 0xff;
+            result |= div255(value * inverse + source[channel] * pixelAlpha) << (channel * 8);
+        }
+
+        pixels[i] = result;
+    }
+}
+
+void kernels::premultiply(uint32_t* pixels, size_t count) {
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    __m128i zero = _mm_setzero_si128();
+    __m128i bias8 = _mm_set1_epi16(128);
+    __m128i alphaMask4 = _mm_set1_epi32(int(ALPHA_MASK));
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels4 = _mm_loadu_si128((__m128i*)(pixels + i));
+        __m128i low = _mm_unpacklo_epi8(pixels4, zero);
+        __m128i high = _mm_unpackhi_epi8(pixels4, zero);
+
+        // Each pixel's alpha repeated for its 4 channels
+        __m128i lowAlphas = _mm_shufflehi_epi16(_mm_shufflelo_epi16(low, 0xff), 0xff);
+        __m128i highAlphas = _mm_shufflehi_epi16(_mm_shufflelo_epi16(high, 0xff), 0xff);
+
+        low = _mm_add_epi16(_mm_mullo_epi16(low, lowAlphas), bias8);
+        high = _mm_add_epi16(_mm_mullo_epi16(high, highAlphas), bias8);
+
+        low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+        // The alpha itself is kept
+        __m128i result = _mm_packus_epi16(low, high);
+        result = _mm_or_si128(_mm_andnot_si128(alphaMask4, result), _mm_and_si128(alphaMask4, pixels4));
+        _mm_storeu_si128((__m128i*)(pixels + i), result);
+    }
+#endif
+
+    for (; i < count; i++) {
+        pixels[i] = premultiplyPixel(pixels[i]);
+    }
+}
+
+void kernels::unpremultiply(uint32_t* pixels, size_t count) {
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    // A pixel per register, 32-bit float per channel
+    __m128i zero = _mm_setzero_si128();
+    __m128i alphaMask4 = _mm_set1_epi32(int(ALPHA_MASK));
+    __m128 max4 = _mm_set1_ps(255.f);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels4 = _mm_loadu_si128((__m128i*)(pixels + i));
+        __m128i low = _mm_unpacklo_epi8(pixels4, zero);
+        __m128i high = _mm_unpackhi_epi8(pixels4, zero);
+
+        __m128i channels[4] = {
+            _mm_unpacklo_epi16(low, zero), _mm_unpackhi_epi16(low, zero),
+            _mm_unpacklo_epi16(high, zero), _mm_unpackhi_epi16(high, zero)
+        };
+
+        for (__m128i& pixel : channels) {
+            __m128 values = _mm_cvtepi32_ps(pixel);
+            __m128 factors = _mm_div_ps(max4, _mm_shuffle_ps(values, values, 0xff));
+
+            // For zero alpha the product is NaN or infinite, such pixels are zeroed below
+            pixel = _mm_cvtps_epi32(_mm_min_ps(_mm_mul_ps(values, factors), max4));
+        }
+
+        __m128i result = _mm_packus_epi16(_mm_packs_epi32(channels[0], channels[1]), _mm_packs_epi32(channels[2], channels[3]));
+
+        // The alpha itself is kept, the fully transparent pixels are zeroed
+        result = _mm_or_si128(_mm_andnot_si128(alphaMask4, result), _mm_and_si128(alphaMask4, pixels4));
+        result = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(pixels4, alphaMask4), zero), result);
+        _mm_storeu_si128((__m128i*)(pixels + i), result);
+    }
+#endif
+
+    for (; i < count; i++) {
+        pixels[i] = unpremultiplyPixel(pixels[i]);
+    }
+}
+
+void kernels::blendPremultiplied(uint32_t* pixels, size_t count, uint32_t color) {
+    uint32_t alpha = color >> 24;
+    if (alpha == 0) {
+        return;
+    } if (alpha == 255) {
+        fill(pixels, count, color);
+        return;
+    }
+
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    // result = color + pixel * (255 - alpha) / 255 for every channel
+    __m128i zero = _mm_setzero_si128();
+    __m128i bias8 = _mm_set1_epi16(128);
+    __m128i inverse8 = _mm_set1_epi16(short(255 - alpha));
+    __m128i color4 = _mm_set1_epi32(int(color));
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels4 = _mm_loadu_si128((__m128i*)(pixels + i));
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels4, zero), inverse8), bias8);
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels4, zero), inverse8), bias8);
+
+        low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+        _mm_storeu_si128((__m128i*)(pixels + i), _mm_adds_epu8(_mm_packus_epi16(low, high), color4));
+    }
+#endif
+
+    for (; i < count; i++) {
+        pixels[i] = compositePixel(pixels[i], color);
+    }
+}
+
+void kernels::blendPremultipliedCoverage(uint32_t* pixels, size_t count, uint32_t color, const uint8_t* coverage) {
+    if ((color >> 24) == 0) {
+        return;
+    }
+
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    // The color is scaled by the coverage first, then composited as in blendPremultiplied()
+    __m128i zero = _mm_setzero_si128();
+    __m128i bias8 = _mm_set1_epi16(128);
+    __m128i max8 = _mm_set1_epi16(255);
+    __m128i color8 = _mm_unpacklo_epi8(_mm_set1_epi32(int(color)), zero);
+
+    for (; i + 4 <= count; i += 4) {
+        int32_t coverage4;
+        std::memcpy(&coverage4, coverage + i, sizeof(coverage4));
+
+        // Each pixel's coverage repeated for its 4 channels
+        __m128i coverages = _mm_unpacklo_epi8(_mm_cvtsi32_si128(coverage4), zero);
+        coverages = _mm_unpacklo_epi16(coverages, coverages);
+        __m128i lowCoverages = _mm_unpacklo_epi32(coverages, coverages);
+        __m128i highCoverages = _mm_unpackhi_epi32(coverages, coverages);
+
+        __m128i lowColors = _mm_add_epi16(_mm_mullo_epi16(color8, lowCoverages), bias8);
+        __m128i highColors = _mm_add_epi16(_mm_mullo_epi16(color8, highCoverages), bias8);
+        lowColors = _mm_srli_epi16(_mm_add_epi16(lowColors, _mm_srli_epi16(lowColors, 8)), 8);
+        highColors = _mm_srli_epi16(_mm_add_epi16(highColors, _mm_srli_epi16(highColors, 8)), 8);
+
+        __m128i lowInverses = _mm_sub_epi16(max8, _mm_shufflehi_epi16(_mm_shufflelo_epi16(lowColors, 0xff), 0xff));
+        __m128i highInverses = _mm_sub_epi16(max8, _mm_shufflehi_epi16(_mm_shufflelo_epi16(highColors, 0xff), 0xff));
+
+        __m128i pixels4 = _mm_loadu_si128((__m128i*)(pixels + i));
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels4, zero), lowInverses), bias8);
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels4, zero), highInverses), bias8);
+
+        low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+        __m128i result = _mm_adds_epu8(_mm_packus_epi16(low, high), _mm_packus_epi16(lowColors, highColors));
+        _mm_storeu_si128((__m128i*)(pixels + i), result);
+    }
+#endif
+
+    for (; i < count; i++) {
+        uint32_t scaledColor = 0;
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            scaledColor |= div255(((color >> (channel * 8)) & 0xff) * coverage[i]) << (channel * 8);
+        }
+
+        pixels[i] = compositePixel(pixels[i], scaledColor);
+    }
+}
+
+void kernels::compositePremultiplied(uint32_t* under, const uint32_t* over, size_t count) {
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    __m128i zero = _mm_setzero_si128();
+    __m128i bias8 = _mm_set1_epi16(128);
+    __m128i max8 = _mm_set1_epi16(255);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i over4 = _mm_loadu_si128((__m128i*)(over + i));
+        __m128i overLow = _mm_unpacklo_epi8(over4, zero);
+        __m128i overHigh = _mm_unpackhi_epi8(over4, zero);
+
+        // Each over pixel's 255 - alpha repeated for its 4 channels
+        __m128i lowInverses = _mm_sub_epi16(max8, _mm_shufflehi_epi16(_mm_shufflelo_epi16(overLow, 0xff), 0xff));
+        __m128i highInverses = _mm_sub_epi16(max8, _mm_shufflehi_epi16(_mm_shufflelo_epi16(overHigh, 0xff), 0xff));
+
+        __m128i under4 = _mm_loadu_si128((__m128i*)(under + i));
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(under4, zero), lowInverses), bias8);
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(under4, zero), highInverses), bias8);
+
+        low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+        _mm_storeu_si128((__m128i*)(under + i), _mm_adds_epu8(_mm_packus_epi16(low, high), over4));
+    }
+#endif
+
+    for (; i < count; i++) {
+        under[i] = compositePixel(under[i], over[i]);
+    }
+}
+
+void kernels::composite(uint32_t* under, const uint32_t* over, size_t count) {
+    // The translucent over pixels are gathered with their under ones into chunks to be converted at once
+    uint32_t underChunk[COMPOSITE_CHUNK_SIZE];
+    uint32_t overChunk[COMPOSITE_CHUNK_SIZE];
+    size_t positions[COMPOSITE_CHUNK_SIZE];
+    size_t chunkSize = 0;
+
+    auto compositeChunk = [&]() {
+        premultiply(overChunk, chunkSize);
+        premultiply(underChunk, chunkSize);
+        compositePremultiplied(underChunk, overChunk, chunkSize);
+        unpremultiply(underChunk, chunkSize);
+
+        for (size_t j = 0; j < chunkSize; j++) {
+            under[positions[j]] = underChunk[j];
+        }
+
+        chunkSize = 0;
+    };
+
+    // The conversion to premultiplied and back is lossy for the translucent pixels, so the ones under the transparent pixels
+    // are left as they are, and the ones under the opaque pixels, as well as the transparent ones, are replaced
+    for (size_t i = 0; i < count; i++) {
+        uint32_t overAlpha = over[i] & ALPHA_MASK;
+        if (overAlpha == 0) {
+            continue;
+        } else if (overAlpha == ALPHA_MASK || (under[i] & ALPHA_MASK) == 0) {
+            under[i] = over[i];
+            continue;
+        }
+
+        underChunk[chunkSize] = under[i];
+        overChunk[chunkSize] = over[i];
+        positions[chunkSize++] = i;
+        if (chunkSize == COMPOSITE_CHUNK_SIZE) {
+            compositeChunk();
+        }
+    }
+
+    if (chunkSize != 0) {
+        compositeChunk();
+    }
+}
+
+void kernels::invert(uint32_t* pixels, size_t count) {
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    __m128i mask4 = _mm_set1_epi32(int(COLOR_MASK));
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels4 = _mm_loadu_si128((__m128i*)(pixels + i));
+        _mm_storeu_si128((__m128i*)(pixels + i), _mm_xor_si128(pixels4, mask4));
+    }
+#endif
+
+    for (; i < count; i++) {
+        pixels[i] ^= COLOR_MASK;
+    }
+}
+
+void kernels::threshold(uint32_t* pixels, size_t count, uint8_t level) {
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    // The channels are extracted into the lower halves of 32-bit lanes, so 16-bit products do not overflow
+    __m128i byteMask4 = _mm_set1_epi32(0xff);
+    __m128i alphaMask4 = _mm_set1_epi32(int(ALPHA_MASK));
+    __m128i colorMask4 = _mm_set1_epi32(int(COLOR_MASK));
+    __m128i red4 = _mm_set1_epi32(BRIGHTNESS_RED);
+    __m128i green4 = _mm_set1_epi32(BRIGHTNESS_GREEN);
+    __m128i blue4 = _mm_set1_epi32(BRIGHTNESS_BLUE);
+    __m128i level4 = _mm_set1_epi32(int(level) - 1);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels4 = _mm_loadu_si128((__m128i*)(pixels + i));
+        __m128i blue = _mm_and_si128(pixels4, byteMask4);
+        __m128i green = _mm_and_si128(_mm_srli_epi32(pixels4, 8), byteMask4);
+        __m128i red = _mm_and_si128(_mm_srli_epi32(pixels4, 16), byteMask4);
+
+        __m128i brightness = _mm_add_epi32(
+            _mm_add_epi32(_mm_mullo_epi16(red, red4), _mm_mullo_epi16(green, green4)),
+            _mm_mullo_epi16(blue, blue4)
+        );
+        brightness = _mm_srli_epi32(brightness, 8);
+
+        __m128i isBright = _mm_cmpgt_epi32(brightness, level4);
+        __m128i result = _mm_or_si128(_mm_and_si128(pixels4, alphaMask4), _mm_and_si128(isBright, colorMask4));
+        _mm_storeu_si128((__m128i*)(pixels + i), result);
+    }
+#endif
+
+    for (; i < count; i++) {
+        uint32_t pixel = pixels[i];
+        pixels[i] = (pixel & ALPHA_MASK) | (getBrightness(pixel) >= level ? COLOR_MASK : 0);
+    }
+}
+
+void kernels::multiplyChannels(uint32_t* pixels, size_t count, const float factors[4]) {
+    uint16_t fixed[4];
+    for (uint32_t channel = 0; channel < 4; channel++) {
+        fixed[channel] = toFixedFactor(factors[channel]);
+    }
+
+    size_t i = 0;
+
+#ifdef KERNELS_USE_SSE2
+    // Unpacking with zero as the lower byte gives value * 256 in each 16-bit lane,
+    // so the high half of the product with the 8.8 factor is exactly value * factor
+    __m128i zero = _mm_setzero_si128();
+    __m128i factors8 = _mm_set_epi16(
+        short(fixed[3]), short(fixed[2]), short(fixed[1]), short(fixed[0]),
+        short(fixed[3]), short(fixed[2]), short(fixed[1]), short(fixed[0])
+    );
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels4 = _mm_loadu_si128((__m128i*)(pixels + i));
+        __m128i low = _mm_mulhi_epu16(_mm_unpacklo_epi8(zero, pixels4), factors8);
+        __m128i high = _mm_mulhi_epu16(_mm_unpackhi_epi8(zero, pixels4), factors8);
+
+        _mm_storeu_si128((__m128i*)(pixels + i), _mm_packus_epi16(low, high));
+    }
+#endif
+
+    for (; i < count; i++) {
+        uint32_t pixel = pixels[i];
+        uint32_t result = 0;
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            uint32_t value = (((pixel >> (channel * 8)) & 0xff) * fixed[channel]) >> 8;
+            result |= (value > 255 ? 255 : value) << (channel * 8);
+        }
+
+        pixels[i] = result;
+    }
+}
+
+void kernels::copy(uint32_t* to, const uint32_t* from, size_t count) {
+    std::memcpy(to, from, count * sizeof(uint32_t));
+}
+
+size_t kernels::countSimilar(const uint32_t* pixels, size_t count, uint32_t color, uint8_t tolerance) {
+    return countLeading(pixels, count, color, tolerance, true);
+}
+
+size_t kernels::countDifferent(const uint32_t* pixels, size_t count, uint32_t color, uint8_t tolerance) {
+    return countLeading(pixels, count, color, tolerance, false);
+}
+
+size_t kernels::countSimilarBackward(const uint32_t* pixels, size_t count, uint32_t color, uint8_t tolerance) {
+    size_t result = 0;
+
+#ifdef KERNELS_USE_SSE2
+    __m128i color4 = _mm_set1_epi32(int(color));
+    __m128i tolerance16 = _mm_set1_epi8(char(tolerance));
+
+    for (; result + 4 <= count; result += 4) {
+        // The highest bit is the last pixel, so the run goes from the highest bit down
+        uint32_t breaks = getSimilarMask(_mm_loadu_si128((__m128i*)(pixels + count - result - 4)), color4, tolerance16) ^ 0xf;
+        if (breaks != 0) {
+            return result + std::countl_zero(breaks) - 28;
+        }
+    }
+#endif
+
+    for (; result < count && isSimilarPixel(pixels[count - result - 1], color, tolerance); result++);
+
+    return result;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Native kernels processing continuous spans of pixels (0xAARRGGBB)
+// The bulk of a span is processed with SSE2 (which every x64 CPU has) several pixels at a time,
+// the tail and the non-SSE2 builds use the scalar version of the same arithmetics, so the results are identical
+namespace kernels {
+	// Sets all the pixels to value
+	void fill(uint32_t* pixels, size_t count, uint32_t value);
+
+	// Blends color over the pixels as if it was painted on top of them (straight, non-premultiplied alpha)
+	void blend(uint32_t* pixels, size_t count, uint32_t color);
+
+	// Blends color over the pixels, with color's alpha scaled for each pixel by its coverage (0 - 255)
+	// Fully covered pixels get the same result as with blend()
+	void blendCoverage(uint32_t* pixels, size_t count, uint32_t color, const uint8_t* coverage);
+
+	// Premultiplied alpha
+	// The color channels are stored already multiplied by the alpha (divided by 255),
+	// so that source-over compositing is a single multiply-add per channel without any division
+
+	// Converts straight-alpha pixels to premultiplied ones
+	void premultiply(uint32_t* pixels, size_t count);
+
+	// Converts premultiplied pixels back to straight-alpha ones, fully transparent pixels become 0
+	void unpremultiply(uint32_t* pixels, size_t count);
+
+	// Composites color over the pixels, both are premultiplied
+	void blendPremultiplied(uint32_t* pixels, size_t count, uint32_t color);
+
+	// Composites color scaled by each pixel's coverage (0 - 255) over the pixels, both are premultiplied
+	void blendPremultipliedCoverage(uint32_t* pixels, size_t count, uint32_t color, const uint8_t* coverage);
+
+	// Composites the over pixels over the under ones, all of them are premultiplied
+	void compositePremultiplied(uint32_t* under, const uint32_t* over, size_t count);
+
+	// Composites the over pixels over the under ones, all of them have straight alpha
+	// Goes through the premultiplied representation for the translucent over pixels, so the result is exact for opaque under pixels,
+	// the under pixels are kept as they are under the transparent over pixels and replaced by the opaque ones and over the transparent ones
+	void composite(uint32_t* under, const uint32_t* over, size_t count);
+
+	// Inverts the color channels, alpha is kept
+	void invert(uint32_t* pixels, size_t count);
+
+	// Makes the pixels white if their brightness is at least level, and black otherwise, alpha is kept
+	void threshold(uint32_t* pixels, size_t count, uint8_t level);
+
+	// Multiplies each channel by its factor, the results are clamped to 255
+	// Factors are in the order of Color's bytes: blue, green, red, alpha
+	// Negative factors are treated as 0, the ones above 127 as 127
+	void multiplyChannels(uint32_t* pixels, size_t count, const float factors[4]);
+
+	// Copies count pixels, the spans must not overlap
+	void copy(uint32_t* to, const uint32_t* from, size_t count);
+
+	// Color comparison, e.g. for flood filling
+	// A pixel is similar to the color if each of its channels differs from the color's one by at most tolerance
+
+	// The number of leading pixels that are similar to the color
+	size_t countSimilar(const uint32_t* pixels, size_t count, uint32_t color, uint8_t tolerance);
+
+	// The number of leading pixels that are not similar to the color
+	size_t countDifferent(const uint32_t* pixels, size_t count, uint32_t color, uint8_t tolerance);
+
+	// The number of trailing pixels that are similar to the color, i.e. counted from the last pixel backward
+	size_t countSimilarBackward(const uint32_t* pixels, size_t count, uint32_t color, uint8_t tolerance);
+}
\ No newline at end of file
@@ -0,0 +1,471 @@
+#include "ByteCodeVerifier.h"
+#include <algorithm>
+#include <limits>
+
+// Lower than any sizes the code can reach, a function can take any number of its caller's values
+constexpr int64_t NO_FLOOR = std::numeric_limits<int64_t>::min() / 4;
+
+static QString getErrorPrefix(uint32_t pos) {
+    return "Bytecode error at instruction " + QString::number(pos) + ": ";
+}
+
+// The numbers of values taken from the stack and put to it by the instructions that do nothing else with the stacks
+// Returns false for the other instructions
+static bool getStackEffect(const Instruction& inst, int64_t& pops, int64_t& pushes) {
+    switch (inst.op) {
+    case InstructionType::NOPE:
+    case InstructionType::SET_IMAGE:
+    case InstructionType::COPY_IMAGE:
+    case InstructionType::FILL_IMAGE:
+    case InstructionType::BLEND_IMAGE:
+    case InstructionType::INVERT_IMAGE:
+        pops = 0, pushes = 0;
+        return true;
+    case InstructionType::PUSH:
+    case InstructionType::PUSH_WIDTH:
+    case InstructionType::PUSH_HEIGHT:
+        pops = 0, pushes = 1;
+        return true;
+    case InstructionType::PUSH_POINT:
+        pops = 0, pushes = 2;
+        return true;
+    case InstructionType::POP:
+    case InstructionType::SET_WIDTH:
+    case InstructionType::THRESHOLD_IMAGE:
+    case InstructionType::SET_FRAME_RATE:
+        pops = 1, pushes = 0;
+        return true;
+    case InstructionType::POP_POINT:
+    case InstructionType::DRAW_PIX:
+        pops = 2, pushes = 0;
+        return true;
+    case InstructionType::DRAW_STROKE:
+    case InstructionType::DRAW_CIRCLE:
+    case InstructionType::FILL_CIRCLE:
+        pops = 3, pushes = 0;
+        return true;
+    case InstructionType::POP_COLOR:
+    case InstructionType::SET_COLOR:
+    case InstructionType::DRAW_LINE:
+    case InstructionType::DRAW_RECT:
+    case InstructionType::FILL_RECT:
+    case InstructionType::MULTIPLY_IMAGE:
+    case InstructionType::COPY_RECT:
+        pops = 4, pushes = 0;
+        return true;
+    case InstructionType::FILL_POLYGON:
+        pops = int64_t(inst.value[0]) * 2, pushes = 0;
+        return true;
+    case InstructionType::GET_COLOR_RED:
+    case InstructionType::GET_COLOR_GREEN:
+    case InstructionType::GET_COLOR_BLUE:
+    case InstructionType::GET_COLOR_ALPHA:
+    case InstructionType::CMP_EQ_POINTS:
+    case InstructionType::CMP_NEQ_POINTS:
+    case InstructionType::DISTANCE:
+        pops = 4, pushes = 1;
+        return true;
+    case InstructionType::GET_POINT_X:
+    case InstructionType::GET_POINT_Y:
+    case InstructionType::ADD:
+    case InstructionType::SUB:
+    case InstructionType::MUL:
+    case InstructionType::DIV:
+    case InstructionType::MOD:
+    case InstructionType::POW:
+    case InstructionType::CMP_EQ:
+    case InstructionType::CMP_NEQ:
+    case InstructionType::CMP_LT:
+    case InstructionType::CMP_GT:
+    case InstructionType::CMP_GE:
+    case InstructionType::CMP_LE:
+    case InstructionType::AND:
+    case InstructionType::OR:
+    case InstructionType::LENGTH:
+        pops = 2, pushes = 1;
+        return true;
+    case InstructionType::ADD_POINT:
+    case InstructionType::SUB_POINT:
+        pops = 4, pushes = 2;
+        return true;
+    case InstructionType::ADD_COLOR:
+    case InstructionType::SUB_COLOR:
+        pops = 8, pushes = 4;
+        return true;
+    case InstructionType::ADD_TO_POINT:
+    case InstructionType::SUB_FROM_POINT:
+    case InstructionType::MUL_POINT_ON_NUMBER:
+    case InstructionType::DIV_POINT_ON_NUMBER:
+    case InstructionType::MOD_POINT_ON_NUMBER:
+    case InstructionType::POW_POINT_TO_NUMBER:
+        pops = 3, pushes = 2;
+        return true;
+    case InstructionType::ADD_TO_COLOR:
+    case InstructionType::SUB_FROM_COLOR:
+    case InstructionType::MUL_COLOR_ON_NUMBER:
+    case InstructionType::DIV_COLOR_ON_NUMBER:
+    case InstructionType::MOD_COLOR_ON_NUMBER:
+    case InstructionType::POW_COLOR_TO_NUMBER:
+        pops = 5, pushes = 4;
+        return true;
+    case InstructionType::NEG:
+    case InstructionType::INC:
+    case InstructionType::DEC:
+    case InstructionType::NOT:
+    case InstructionType::ABS:
+    case InstructionType::ROUND:
+    case InstructionType::FLOOR:
+    case InstructionType::CEIL:
+    case InstructionType::SIN:
+    case InstructionType::COS:
+    case InstructionType::TAN:
+    case InstructionType::COT:
+    case InstructionType::EXP:
+    case InstructionType::LOG:
+        pops = 1, pushes = 1;
+        return true;
+    case InstructionType::NEG_POINT:
+        pops = 2, pushes = 2;
+        return true;
+    case InstructionType::NEG_COLOR:
+        pops = 4, pushes = 4;
+        return true;
+    case InstructionType::CMP_EQ_COLORS:
+    case InstructionType::CMP_NEQ_COLORS:
+        pops = 8, pushes = 1;
+        return true;
+    case InstructionType::INIT_RANGE:
+        pops = 3, pushes = 3;
+        return true;
+    case InstructionType::CHECK_RANGE:
+        pops = 3, pushes = 1;
+        return true;
+    case InstructionType::MIN:
+    case InstructionType::MAX:
+    case InstructionType::SUM:
+        pops = inst.value[0], pushes = 1;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// The number of values the instructions working with a single variable of the type copy
+static int64_t getValueSize(InstructionType inst, InstructionType numberInst) {
+    constexpr int64_t SIZES[3] = { 1, 2, 4 };
+    return SIZES[uint8_t(inst) - uint8_t(numberInst)];
+}
+
+ByteCodeVerifier::ByteCodeVerifier(const QList<Instruction>& byteCode, uint32_t globalsSize, uint32_t imageBuffersCount)
+    : m_byteCode(byteCode), m_globalsSize(globalsSize), m_imageBuffersCount(imageBuffersCount) {
+
+}
+
+utils::Result<ByteCodeLimits> ByteCodeVerifier::verify() {
+    Frame program;
+    program.isFunction = false;
+
+    // The program finishes on reaching the end of the code, the functions are placed after a halt
+    Region region{ 0, uint32_t(m_byteCode.size()), { 0, 0 }, { 0, 0 }, false };
+    if (auto result = checkRegion(program, region); !result.isOk()) {
+        return result.extractError();
+    }
+
+    constexpr int64_t MAX_SIZE = std::numeric_limits<uint32_t>::max();
+    if (program.max.stack > MAX_SIZE || program.max.locals > MAX_SIZE) {
+        return utils::Failure("Bytecode error: the stacks grow too large");
+    }
+
+    return ByteCodeLimits{ uint32_t(program.max.stack), uint32_t(program.max.locals), program.callDepth };
+}
+
+utils::Result<Void> ByteCodeVerifier::checkFunction(uint32_t position) {
+    FrameStatus& status = m_functionStatuses[position];
+    if (status == FrameStatus::CHECKED) {
+        return utils::Success();
+    } else if (status == FrameStatus::IN_PROGRESS) {
+        // The compiler cannot produce it, and the stacks it needs cannot be known in advance
+        return utils::Failure("Bytecode error: the function at " + QString::number(position) + " is called recursively");
+    }
+
+    status = FrameStatus::IN_PROGRESS;
+
+    // The function's code is never finished by reaching a position, only by a return or a halt
+    Frame& function = m_functions[position];
+    function.isFunction = true;
+
+    Region region{ position, std::numeric_limits<uint32_t>::max(), { 0, 0 }, { NO_FLOOR, NO_FLOOR }, false };
+    if (auto result = checkRegion(function, region); !result.isOk()) {
+        return result.extractError();
+    }
+
+    m_functionStatuses[position] = FrameStatus::CHECKED;
+    return utils::Success();
+}
+
+utils::Result<Void> ByteCodeVerifier::checkRegion(Frame& frame, const Region& region) {
+    QList<uint32_t> toCheck;
+    if (auto result = jump(frame, region, region.start, region.start, region.entry, toCheck); !result.isOk()) {
+        return result.extractError();
+    }
+
+    while (!toCheck.isEmpty()) {
+        uint32_t pos = toCheck.back();
+        toCheck.pop_back();
+
+        if (auto result = checkInstruction(frame, region, pos, frame.states[pos], toCheck); !result.isOk()) {
+            return result.extractError();
+        }
+    }
+
+    return utils::Success();
+}
+
+utils::Result<Void> ByteCodeVerifier::checkInstruction(Frame& frame, const Region& region, uint32_t pos, StackState state, QList<uint32_t>& toCheck) {
+    const Instruction& inst = m_byteCode[pos];
+
+    auto pop = [&](int64_t count) -> bool {
+        state.stack -= count;
+        frame.min.stack = std::min(frame.min.stack, state.stack);
+        return state.stack >= region.floor.stack;
+    };
+
+    auto push = [&](int64_t count) {
+        state.stack += count;
+        frame.max.stack = std::max(frame.max.stack, state.stack);
+    };
+
+    // The parallel for's body can read the variables declared before it, only the top-level code has a floor for reading
+    auto isLocal = [&](uint32_t offset, int64_t size) -> bool {
+        int64_t first = state.locals - offset;
+        frame.min.locals = std::min(frame.min.locals, first);
+        return offset >= size && (frame.isFunction || first >= 0);
+    };
+
+    auto isGlobal = [&](uint32_t index, int64_t size) -> bool {
+        return index + size <= m_globalsSize;
+    };
+
+    // The image itself or one of the buffers
+    auto isImage = [&](uint32_t index) -> bool {
+        return index == 0 || index < m_imageBuffersCount;
+    };
+
+    auto next = [&]() {
+        return jump(frame, region, pos, pos + 1, state, toCheck);
+    };
+
+    const QString prefix = getErrorPrefix(pos);
+    switch (inst.op) {
+    case InstructionType::ADD_LOCAL:
+    case InstructionType::ADD_LOCAL_POINT:
+    case InstructionType::ADD_LOCAL_COLOR: {
+        int64_t size = getValueSize(inst.op, InstructionType::ADD_LOCAL);
+        if (!pop(size)) {
+            return utils::Failure(prefix + "not enough values on the stack");
+        }
+
+        state.locals += size;
+        frame.max.locals = std::max(frame.max.locals, state.locals);
+        return next();
+    }
+    case InstructionType::CLEAR_SCOPE:
+        state.locals -= inst.value[0];
+        frame.min.locals = std::min(frame.min.locals, state.locals);
+        if (state.locals < region.floor.locals) {
+            return utils::Failure(prefix + "removes more local variables than there are");
+        }
+
+        return next();
+    case InstructionType::LOAD:
+    case InstructionType::LOAD_POINT:
+    case InstructionType::LOAD_COLOR: {
+        int64_t size = getValueSize(inst.op, InstructionType::LOAD);
+        if (!isLocal(inst.value[0], size)) {
+            return utils::Failure(prefix + "no such local variable");
+        }
+
+        push(size);
+        return next();
+    }
+    case InstructionType::STORE:
+    case InstructionType::STORE_POINT:
+    case InstructionType::STORE_COLOR: {
+        int64_t size = getValueSize(inst.op, InstructionType::STORE);
+        if (!pop(size)) {
+            return utils::Failure(prefix + "not enough values on the stack");
+        } else if (!isLocal(inst.value[0], size)) {
+            return utils::Failure(prefix + "no such local variable");
+        }
+
+        return next();
+    }
+    case InstructionType::LOAD_GLOBAL:
+    case InstructionType::LOAD_POINT_GLOBAL:
+    case InstructionType::LOAD_COLOR_GLOBAL: {
+        int64_t size = getValueSize(inst.op, InstructionType::LOAD_GLOBAL);
+        if (!isGlobal(inst.value[0], size)) {
+            return utils::Failure(prefix + "no such global variable");
+        }
+
+        push(size);
+        return next();
+    }
+    case InstructionType::STORE_GLOBAL:
+    case InstructionType::STORE_POINT_GLOBAL:
+    case InstructionType::STORE_COLOR_GLOBAL: {
+        int64_t size = getValueSize(inst.op, InstructionType::STORE_GLOBAL);
+        if (!pop(size)) {
+            return utils::Failure(prefix + "not enough values on the stack");
+        } else if (!isGlobal(inst.value[0], size)) {
+            return utils::Failure(prefix + "no such global variable");
+        }
+
+        return next();
+    }
+    case InstructionType::GOTO:
+        return jump(frame, region, pos, inst.value[0], state, toCheck);
+    case InstructionType::GOTO_IF_NOT:
+        if (!pop(1)) {
+            return utils::Failure(prefix + "not enough values on the stack");
+        }
+
+        if (auto result = jump(frame, region, pos, inst.value[0], state, toCheck); !result.isOk()) {
+            return result.extractError();
+        }
+
+        return next();
+    case InstructionType::CALL: {
+        uint32_t target = inst.value[0];
+        if (target >= m_byteCode.size()) {
+            return utils::Failure(prefix + "calls a function outside of the code");
+        }
+
+        if (auto result = checkFunction(target); !result.isOk()) {
+            return result.extractError();
+        }
+
+        // The function's sizes are relative to the ones at the call
+        const Frame& function = m_functions[target];
+        int64_t lowestStack = state.stack + function.min.stack;
+        int64_t lowestLocal = state.locals + function.min.locals;
+
+        frame.min = { std::min(frame.min.stack, lowestStack), std::min(frame.min.locals, lowestLocal) };
+        frame.max = { std::max(frame.max.stack, state.stack + function.max.stack), std::max(frame.max.locals, state.locals + function.max.locals) };
+        frame.callDepth = std::max(frame.callDepth, function.callDepth + 1);
+
+        if (lowestStack < region.floor.stack) {
+            return utils::Failure(prefix + "the function takes more values than there are on the stack");
+        } else if (!frame.isFunction && lowestLocal < 0) {
+            return utils::Failure(prefix + "the function accesses more local variables than there are");
+        } else if (function.canSleep && region.isParallelBody) {
+            return utils::Failure(prefix + "the function called within a parallel for's body can pause the execution");
+        }
+
+        frame.canSleep |= function.canSleep;
+
+        if (!function.stackChange.has_value()) {
+            return utils::Success(); // Never returns, it halts
+        }
+
+        push(*function.stackChange);
+        return next();
+    }
+    case InstructionType::RET:
+        if (!frame.isFunction) {
+            return utils::Failure(prefix + "return outside of a function");
+        } else if (region.isParallelBody) {
+            return utils::Failure(prefix + "return from a parallel for's body");
+        } else if (state.locals != 0) {
+            return utils::Failure(prefix + "the function does not remove its local variables");
+        } else if (frame.stackChange.has_value() && *frame.stackChange != state.stack) {
+            return utils::Failure(prefix + "the function returns different numbers of values");
+        }
+
+        frame.stackChange = state.stack;
+        return utils::Success();
+    case InstructionType::HALT:
+        if (region.isParallelBody) {
+            return utils::Failure(prefix + "halt within a parallel for's body");
+        }
+
+        return utils::Success();
+    case InstructionType::SLEEP:
+    case InstructionType::UPDATE: // Waits for the next frame's tick once a frame rate is set
+        // The iterations are run to the end at once, they cannot be paused
+        if (region.isParallelBody) {
+            return utils::Failure(prefix + "sleep or update within a parallel for's body");
+        } else if (!pop(inst.op == InstructionType::SLEEP ? 1 : 0)) {
+            return utils::Failure(prefix + "not enough values on the stack");
+        }
+
+        frame.canSleep = true;
+        return next();
+    case InstructionType::PARALLEL_FOR: {
+        uint32_t end = inst.value[0];
+        if (end <= pos || end > m_byteCode.size()) {
+            return utils::Failure(prefix + "the parallel for's body is outside of the code");
+        } else if (!pop(3)) {
+            return utils::Failure(prefix + "not enough values on the stack");
+        }
+
+        // The body starts with the iteration's value as a local variable, and cannot use anything below it
+        StackState bodyEntry{ state.stack, state.locals + 1 };
+        frame.max.locals = std::max(frame.max.locals, bodyEntry.locals);
+
+        Region body{ pos + 1, end, bodyEntry, bodyEntry, true };
+        if (auto result = checkRegion(frame, body); !result.isOk()) {
+            return result.extractError();
+        }
+
+        return jump(frame, region, pos, end, state, toCheck);
+    }
+    default: {
+        int64_t pops, pushes;
+        if (!getStackEffect(inst, pops, pushes)) {
+            return utils::Failure(prefix + "unknown instruction " + QString::number(uint8_t(inst.op)));
+        }
+
+        if ((inst.op == InstructionType::SET_IMAGE && !isImage(inst.value[0]))
+            || (inst.op == InstructionType::COPY_IMAGE && (!isImage(inst.value[0]) || !isImage(inst.value[1])))
+            || (inst.op == InstructionType::COPY_RECT && !isImage(inst.value[0]))) {
+            return utils::Failure(prefix + "no such image buffer");
+        } else if ((inst.op == InstructionType::MIN || inst.op == InstructionType::MAX || inst.op == InstructionType::SUM) && inst.value[0] == 0) {
+            return utils::Failure(prefix + "no values to take");
+        } else if (inst.op == InstructionType::FILL_POLYGON && inst.value[1] > 1) {
+            return utils::Failure(prefix + "unknown fill rule");
+        }
+
+        if (!pop(pops)) {
+            return utils::Failure(prefix + "not enough values on the stack");
+        }
+
+        push(pushes);
+        return next();
+    }
+    }
+}
+
+utils::Result<Void> ByteCodeVerifier::jump(Frame& frame, const Region& region, uint32_t from, uint32_t to, StackState state, QList<uint32_t>& toCheck) {
+    if (to == region.end) {
+        // Nothing can be left on the stack for the next iteration, the locals are removed by the VM
+        if (region.isParallelBody && state.stack != region.entry.stack) {
+            return utils::Failure(getErrorPrefix(from) + "the parallel for's body leaves values on the stack");
+        }
+
+        return utils::Success();
+    } else if (to >= m_byteCode.size()) {
+        return utils::Failure(getErrorPrefix(from) + "jumps outside of the code");
+    } else if (region.isParallelBody && (to < region.start || to > region.end)) {
+        return utils::Failure(getErrorPrefix(from) + "jumps out of the parallel for's body");
+    }
+
+    auto [it, isNew] = frame.states.try_emplace(to, state);
+    if (isNew) {
+        toCheck.push_back(to);
+    } else if (!(it->second == state)) {
+        return utils::Failure(getErrorPrefix(from) + "the stacks' sizes differ from the ones on the other ways to instruction " + QString::number(to));
+    }
+
+    return utils::Success();
+}
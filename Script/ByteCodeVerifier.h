@@ -0,0 +1,89 @@
+#pragma once
+#include <optional>
+#include <unordered_map>
+#include <QList>
+#include "Instruction.h"
+#include "../Utils/Result.h"
+
+// The largest sizes of the VM's stacks the verified bytecode can reach
+struct ByteCodeLimits {
+	uint32_t stackSize;
+	uint32_t localVarStackSize;
+	uint32_t callStackSize;
+};
+
+// Checks a loaded bytecode before it is run, so that the VM can execute it without checking anything
+// Goes through all the ways the code can be executed and proves for each of the instructions that:
+// the stack has all the values it takes, the local variables it accesses exist, the global variables and image buffers are declared,
+// and the jumps and calls lead to instructions; each instruction must be reached with the same stacks' sizes on all the ways
+// A function is checked once, the lowest sizes it needs and its effect on the stacks are checked on each call of it
+class ByteCodeVerifier final {
+private:
+	// The sizes of the stacks relative to the start of the code being checked
+	struct StackState {
+		int64_t stack;
+		int64_t locals;
+
+		inline bool operator==(const StackState& other) const {
+			return stack == other.stack && locals == other.locals;
+		}
+	};
+
+	// The top-level code or a function
+	struct Frame {
+		bool isFunction;
+
+		// The lowest sizes reached, the caller must have that many values, and the highest ones including the nested calls
+		StackState min = { 0, 0 };
+		StackState max = { 0, 0 };
+		uint32_t callDepth = 0;
+		bool canSleep = false; // Whether the execution can be paused by a sleep or an update, including the nested calls
+
+		std::optional<int64_t> stackChange; // Of the stack on return, none if the function never returns
+
+		std::unordered_map<uint32_t, StackState> states; // Of the instructions reached
+	};
+
+	// A part of the frame's code with a floor the stacks cannot go below: the frame itself or a parallel for's body
+	struct Region {
+		uint32_t start;
+		uint32_t end; // Reaching it finishes the region
+		StackState entry;
+		StackState floor;
+		bool isParallelBody;
+	};
+
+	enum class FrameStatus : uint8_t {
+		NOT_CHECKED = 0,
+		IN_PROGRESS,
+		CHECKED
+	};
+
+private:
+	const QList<Instruction>& m_byteCode;
+	uint32_t m_globalsSize;
+	uint32_t m_imageBuffersCount;
+
+	// The checked functions by their positions
+	std::unordered_map<uint32_t, Frame> m_functions;
+	std::unordered_map<uint32_t, FrameStatus> m_functionStatuses;
+
+public:
+	ByteCodeVerifier(const QList<Instruction>& byteCode, uint32_t globalsSize, uint32_t imageBuffersCount);
+
+	// Returns the sizes of the stacks required to run the code, or a Failure describing the first problem found
+	utils::Result<ByteCodeLimits> verify();
+
+private:
+	utils::Result<Void> checkFunction(uint32_t position);
+
+	// Goes through all the instructions reachable from the region's start within the region
+	utils::Result<Void> checkRegion(Frame& frame, const Region& region);
+
+	// Checks a single instruction reached with the state and adds the following instructions to the positions to check
+	utils::Result<Void> checkInstruction(Frame& frame, const Region& region, uint32_t pos, StackState state, QList<uint32_t>& toCheck);
+
+	// Passes the execution from the instruction to the target: remembers the state the target is reached with,
+	// fails if it was reached with another one or if the target is outside of the region
+	utils::Result<Void> jump(Frame& frame, const Region& region, uint32_t from, uint32_t to, StackState state, QList<uint32_t>& toCheck);
+};
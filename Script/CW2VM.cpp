@@ -1,13 +1,33 @@
 #include "CW2VM.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <QFile>
 #include <QTextStream>
+#include <QThread>
 #include <QTimer>
+#include "ByteCodeVerifier.h"
+#include "PackedValues.h"
+#include "../Utils/MathUtils.h"
+#include "../Utils/WorkStealing.h"
+#include "../Utils/Trace.h"
+
+CW2VM::CW2VM(ImageEditScene* parent)
+	: CW2VM(&parent->getImage()) {
+	m_pScene = parent;
+}
 
-CW2VM::CW2VM(ImageEditScene* parent) 
-	: m_pScene(parent) {
-	m_image = &parent->getImage();
-	m_width = m_image->getWidth();
-	m_height = m_image->getHeight();
+CW2VM::CW2VM(Image* image)
+	: m_pImage(image) {
+	m_context.image = image;
+	m_width = m_context.image->getWidth();
+	m_height = m_context.image->getHeight();
+
+	// The calling thread is one of the workers as well
+	uint32_t workersCount = uint32_t(std::max(QThread::idealThreadCount(), 1));
+	m_workers.setMaxThreadCount(int(workersCount - 1));
+	m_workerContexts.resize(workersCount);
+	m_drawBuffers.resize(workersCount);
 }
 
 CW2VM::~CW2VM() {
@@ -26,6 +46,8 @@ utils::Result<Void> CW2VM::loadFromFile(const QString& fileName) {
         resetVMState();
     }
 
+    m_framePacer.setFrameRate(0);
+
     QTextStream in(&file);
 
     uint32_t imageBuffersCount, maxCallStackSize, maxLocalStackSize, maxStackSize, globalsSize, byteCodeSize;
@@ -38,7 +60,10 @@ utils::Result<Void> CW2VM::loadFromFile(const QString& fileName) {
 
     m_imageBuffers.reserve(imageBuffersCount);
     for (uint32_t i = 0; i < imageBuffersCount; i++) {
+        // The buffers are drawn the same way as the image itself and can be copied to it as they are
         Image *img = new Image();
+        img->setAntialiased(m_context.image->isAntialiased());
+        img->setPremultiplied(m_context.image->isPremultiplied());
         if (auto result = img->allocateImage(m_width, m_height); !result.isOk()) {
             return result.extractError();
         }
@@ -68,6 +93,50 @@ utils::Result<Void> CW2VM::loadFromFile(const QString& fileName) {
         }
     }
 
+    if (in.status() != QTextStream::Ok) {
+        resetVMState();
+        return utils::Failure("Failed to read the bytecode from file: " + fileName);
+    }
+
+    // The code is run without any checks, so it must not be run at all unless it is proven to be correct
+    ByteCodeVerifier verifier(m_byteCode, globalsSize, imageBuffersCount);
+    auto limits = verifier.verify();
+    if (!limits.isOk()) {
+        resetVMState();
+        return limits.extractError();
+    }
+
+    if (limits.value().stackSize > maxStackSize
+        || limits.value().localVarStackSize > maxLocalStackSize
+        || limits.value().callStackSize > maxCallStackSize) {
+        resetVMState();
+        return utils::Failure("The script requires larger stacks than the ones stated in file: " + fileName);
+    }
+
+    // The stacks never grow beyond the verified sizes, so they are allocated once
+    // The workers run the parallel for-loops' bodies only, but they can be at any depth of the stacks
+    auto allocateStacks = [&](ExecutionContext& context) -> utils::Result<Void> {
+        if (auto result = context.stack.setCapacity(limits.value().stackSize); !result.isOk()) {
+            return result.extractError();
+        } else if (auto result = context.localVarStack.setCapacity(limits.value().localVarStackSize); !result.isOk()) {
+            return result.extractError();
+        }
+
+        return context.callStack.setCapacity(limits.value().callStackSize);
+    };
+
+    if (auto result = allocateStacks(m_context); !result.isOk()) {
+        resetVMState();
+        return result.extractError();
+    }
+
+    for (ExecutionContext& worker : m_workerContexts) {
+        if (auto result = allocateStacks(worker); !result.isOk()) {
+            resetVMState();
+            return result.extractError();
+        }
+    }
+
     m_isLoaded = true;
     return utils::Success();
 }
@@ -76,737 +145,474 @@ void CW2VM::forceHalt() {
     m_shallHalt = true;
 }
 
+FramePacingReport CW2VM::getFramePacingReport() const {
+    return m_framePacer.getReport();
+}
+
+utils::Result<Void> CW2VM::render(FrameRecorder* recorder, uint32_t framesCount, utils::ProgressToken* token) {
+    trace_scope("CW2VM::render");
+
+    m_isRendering = true;
+    m_pRecorder = recorder;
+    m_pRenderToken = token;
+    m_framesToRender = framesCount;
+    m_renderedFramesCount = 0;
+    m_renderError.clear();
+
+    if (framesCount != 0) {
+        run(m_context, uint32_t(m_byteCode.size()));
+    }
+
+    resetVMState();
+    m_isRendering = false;
+    m_pRecorder = nullptr;
+    m_pRenderToken = nullptr;
+
+    if (!m_renderError.isEmpty()) {
+        return utils::Failure(m_renderError);
+    } else if (token != nullptr && token->isCancelled()) {
+        return utils::Failure("Rendering is cancelled, frames rendered: " + QString::number(m_renderedFramesCount));
+    } else if (m_renderedFramesCount == 0) {
+        return utils::Failure("Nothing to render: the script has not updated the image");
+    }
+
+    return utils::Success();
+}
+
 void CW2VM::execute() {
-    while (m_pos < m_byteCode.size()) {
-        Instruction& inst = m_byteCode[m_pos++];
+    trace_scope("CW2VM::execute");
+
+    // The memory of the script is freed once it is finished, the VM can be loaded again
+    if (run(m_context, uint32_t(m_byteCode.size()))) {
+        resetVMState();
+    }
+}
+
+// Replaces the two values of the vector type at the top of the stack with the result of the operation on them
+template<typename Vector, typename Operation>
+static inline void applyToVectors(utils::FixedStack<float>& stack, Operation operation) {
+    float* first = stack.end() - 2 * Vector::SIZE;
+    operation(Vector::load(first), Vector::load(first + Vector::SIZE)).store(first);
+    stack.resize(stack.size() - Vector::SIZE);
+}
+
+// Replaces the vector and the number above it with the result of the operation on each of the vector's fields and the number
+template<typename Vector, typename Operation>
+static inline void applyToVectorAndNumber(utils::FixedStack<float>& stack, Operation operation) {
+    float* vector = stack.end() - Vector::SIZE - 1;
+    operation(Vector::load(vector), Vector::splat(vector[Vector::SIZE])).store(vector);
+    stack.pop_back();
+}
+
+// The same for the operations that have no vector instructions, the fields are computed one by one in place
+template<uint32_t SIZE, typename Operation>
+static inline void applyToFieldsAndNumber(utils::FixedStack<float>& stack, Operation operation) {
+    float* vector = stack.end() - SIZE - 1;
+    for (uint32_t i = 0; i < SIZE; i++) {
+        vector[i] = operation(vector[i], vector[SIZE]);
+    }
+
+    stack.pop_back();
+}
+
+// Replaces the two values of the vector type at the top of the stack with 1 if they are equal (or not equal), or 0 otherwise
+template<typename Vector>
+static inline void compareVectors(utils::FixedStack<float>& stack, bool isEqualityCheck) {
+    float* first = stack.end() - 2 * Vector::SIZE;
+    bool isEqual = Vector::load(first) == Vector::load(first + Vector::SIZE);
+    stack.resize(stack.size() - 2 * Vector::SIZE);
+    stack.push_back(isEqual == isEqualityCheck ? 1 : 0);
+}
+
+bool CW2VM::run(ExecutionContext& context, uint32_t end) {
+    // The code is shared by the workers, so it must not be detached
+    const Instruction* byteCode = m_byteCode.constData();
+
+    // The functions' code can be after the end, so only reaching the end itself stops the execution
+    while (context.pos != end) {
+        const Instruction& inst = byteCode[context.pos++];
         switch (inst.op) {
         case InstructionType::NOPE: break;
         case InstructionType::PUSH:
-            m_stack.push_back(*(float*)&inst.value[0]);
+            context.stack.push_back(*(float*)&inst.value[0]);
             break;
         case InstructionType::PUSH_POINT:
-            m_stack.push_back(*(float*)&inst.value[0]);
-            m_stack.push_back(*(float*)&inst.value[1]);
+            context.stack.push_back(*(float*)&inst.value[0]);
+            context.stack.push_back(*(float*)&inst.value[1]);
             break;
         case InstructionType::POP:
-            m_stack.pop_back();
+            context.stack.pop_back();
             break;
         case InstructionType::POP_POINT:
-            m_stack.pop_back();
-            m_stack.pop_back();
+            context.stack.resize(context.stack.size() - 2);
             break;
         case InstructionType::POP_COLOR:
-            m_stack.pop_back();
-            m_stack.pop_back();
-            m_stack.pop_back();
-            m_stack.pop_back();
+            context.stack.resize(context.stack.size() - 4);
             break;
         case InstructionType::GET_COLOR_RED:
-            m_stack.pop_back();
-            m_stack.pop_back();
-            m_stack.pop_back();
+            context.stack.pop_back();
+            context.stack.pop_back();
+            context.stack.pop_back();
             break;
         case InstructionType::GET_COLOR_GREEN: {
-            m_stack.pop_back();
-            m_stack.pop_back();
+            context.stack.pop_back();
+            context.stack.pop_back();
 
-            float val = m_stack.back();
-            m_stack.pop_back();
-            m_stack[m_stack.size() - 1] = val;
+            float val = context.stack.back();
+            context.stack.pop_back();
+            context.stack[context.stack.size() - 1] = val;
             } break;
         case InstructionType::GET_COLOR_BLUE: {
-            m_stack.pop_back();
+            context.stack.pop_back();
 
-            float val = m_stack.back();
-            m_stack.pop_back();
-            m_stack.pop_back();
-            m_stack[m_stack.size() - 1] = val;
+            float val = context.stack.back();
+            context.stack.pop_back();
+            context.stack.pop_back();
+            context.stack[context.stack.size() - 1] = val;
         } break;
         case InstructionType::GET_COLOR_ALPHA: {
-            float val = m_stack.back();
-            m_stack.pop_back();
-            m_stack.pop_back();
-            m_stack.pop_back();
-            m_stack[m_stack.size() - 1] = val;
+            float val = context.stack.back();
+            context.stack.pop_back();
+            context.stack.pop_back();
+            context.stack.pop_back();
+            context.stack[context.stack.size() - 1] = val;
         } break;
         case InstructionType::GET_POINT_X:
-            m_stack.pop_back();
+            context.stack.pop_back();
             break;
         case InstructionType::GET_POINT_Y: {
-            float val = m_stack.back();
-            m_stack.pop_back();
-            m_stack[m_stack.size() - 1] = val;
+            float val = context.stack.back();
+            context.stack.pop_back();
+            context.stack[context.stack.size() - 1] = val;
         } break;
         case InstructionType::ADD_LOCAL: {
-            float val = m_stack.back();
-            m_stack.pop_back();
+            float val = context.stack.back();
+            context.stack.pop_back();
 
-            m_localVarStack.push_back(val);
+            context.localVarStack.push_back(val);
         } break;
         case InstructionType::ADD_LOCAL_POINT: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_localVarStack.push_back(val1);
-            m_localVarStack.push_back(val2);
+            context.localVarStack.resize(context.localVarStack.size() + 2);
+            Float2::load(context.stack.end() - 2).store(context.localVarStack.end() - 2);
+            context.stack.resize(context.stack.size() - 2);
         } break;
         case InstructionType::ADD_LOCAL_COLOR: {
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_localVarStack.push_back(val1);
-            m_localVarStack.push_back(val2);
-            m_localVarStack.push_back(val3);
-            m_localVarStack.push_back(val4);
+            context.localVarStack.resize(context.localVarStack.size() + 4);
+            Float4::load(context.stack.end() - 4).store(context.localVarStack.end() - 4);
+            context.stack.resize(context.stack.size() - 4);
         } break;
         case InstructionType::CLEAR_SCOPE: {
-            uint32_t totalClear = inst.value[0];
-            for (int i = 0; i < totalClear; i++) {
-                m_localVarStack.pop_back();
-            }
+            context.localVarStack.resize(context.localVarStack.size() - inst.value[0]);
         } break;
         case InstructionType::LOAD: {
-            float val = m_localVarStack[m_localVarStack.size() - inst.value[0]];
-            m_stack.push_back(val);
+            float val = context.localVarStack[context.localVarStack.size() - inst.value[0]];
+            context.stack.push_back(val);
         } break;
         case InstructionType::LOAD_POINT: {
-            float val1 = m_localVarStack[m_localVarStack.size() - inst.value[0]];
-            float val2 = m_localVarStack[m_localVarStack.size() - inst.value[0] + 1];
-
-            m_stack.push_back(val1);
-            m_stack.push_back(val2);
+            context.stack.resize(context.stack.size() + 2);
+            Float2::load(context.localVarStack.end() - inst.value[0]).store(context.stack.end() - 2);
         } break;
         case InstructionType::LOAD_COLOR: {
-            float val1 = m_localVarStack[m_localVarStack.size() - inst.value[0]];
-            float val2 = m_localVarStack[m_localVarStack.size() - inst.value[0] + 1];
-            float val3 = m_localVarStack[m_localVarStack.size() - inst.value[0] + 2];
-            float val4 = m_localVarStack[m_localVarStack.size() - inst.value[0] + 3];
-
-            m_stack.push_back(val1);
-            m_stack.push_back(val2);
-            m_stack.push_back(val3);
-            m_stack.push_back(val4);
+            context.stack.resize(context.stack.size() + 4);
+            Float4::load(context.localVarStack.end() - inst.value[0]).store(context.stack.end() - 4);
         } break;
         case InstructionType::STORE: {
-            float val = m_stack.back();
-            m_stack.pop_back();
+            float val = context.stack.back();
+            context.stack.pop_back();
 
-            m_localVarStack[m_localVarStack.size() - inst.value[0]] = val;
+            context.localVarStack[context.localVarStack.size() - inst.value[0]] = val;
         } break;
         case InstructionType::STORE_POINT: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_localVarStack[m_localVarStack.size() - inst.value[0]] = val1;
-            m_localVarStack[m_localVarStack.size() - inst.value[0] + 1] = val2;
+            Float2::load(context.stack.end() - 2).store(context.localVarStack.end() - inst.value[0]);
+            context.stack.resize(context.stack.size() - 2);
         } break;
         case InstructionType::STORE_COLOR: {
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_localVarStack[m_localVarStack.size() - inst.value[0]] = val1;
-            m_localVarStack[m_localVarStack.size() - inst.value[0] + 1] = val2;
-            m_localVarStack[m_localVarStack.size() - inst.value[0] + 2] = val3;
-            m_localVarStack[m_localVarStack.size() - inst.value[0] + 3] = val4;
+            Float4::load(context.stack.end() - 4).store(context.localVarStack.end() - inst.value[0]);
+            context.stack.resize(context.stack.size() - 4);
         } break;
         case InstructionType::LOAD_GLOBAL: {
             float val = m_globalVars[inst.value[0]];
-            m_stack.push_back(val);
+            context.stack.push_back(val);
         } break;
         case InstructionType::LOAD_POINT_GLOBAL: {
-            float val1 = m_globalVars[inst.value[0]];
-            float val2 = m_globalVars[inst.value[0] + 1];
-
-            m_stack.push_back(val1);
-            m_stack.push_back(val2);
+            context.stack.resize(context.stack.size() + 2);
+            Float2::load(&m_globalVars[inst.value[0]]).store(context.stack.end() - 2);
         } break;
         case InstructionType::LOAD_COLOR_GLOBAL: {
-            float val1 = m_globalVars[inst.value[0]];
-            float val2 = m_globalVars[inst.value[0] + 1];
-            float val3 = m_globalVars[inst.value[0] + 2];
-            float val4 = m_globalVars[inst.value[0] + 3];
-
-            m_stack.push_back(val1);
-            m_stack.push_back(val2);
-            m_stack.push_back(val3);
-            m_stack.push_back(val4);
+            context.stack.resize(context.stack.size() + 4);
+            Float4::load(&m_globalVars[inst.value[0]]).store(context.stack.end() - 4);
         } break;
         case InstructionType::STORE_GLOBAL: {
-            float val = m_stack.back();
-            m_stack.pop_back();
+            float val = context.stack.back();
+            context.stack.pop_back();
 
             m_globalVars[inst.value[0]] = val;
         } break;
         case InstructionType::STORE_POINT_GLOBAL: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_globalVars[inst.value[0]] = val1;
-            m_globalVars[inst.value[0] + 1] = val2;
+            Float2::load(context.stack.end() - 2).store(&m_globalVars[inst.value[0]]);
+            context.stack.resize(context.stack.size() - 2);
         } break;
         case InstructionType::STORE_COLOR_GLOBAL: {
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_globalVars[inst.value[0]] = val1;
-            m_globalVars[inst.value[0] + 1] = val2;
-            m_globalVars[inst.value[0] + 2] = val3;
-            m_globalVars[inst.value[0] + 3] = val4;
+            Float4::load(context.stack.end() - 4).store(&m_globalVars[inst.value[0]]);
+            context.stack.resize(context.stack.size() - 4);
         } break;
         case InstructionType::ADD: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 + val2);
-        } break;
-        case InstructionType::ADD_POINT: {
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 + val3);
-            m_stack.push_back(val2 + val4);
-        } break;
-        case InstructionType::ADD_COLOR: {
-            float val8 = m_stack.back();
-            m_stack.pop_back();
-            float val7 = m_stack.back();
-            m_stack.pop_back();
-            float val6 = m_stack.back();
-            m_stack.pop_back();
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 + val5);
-            m_stack.push_back(val2 + val6);
-            m_stack.push_back(val3 + val7);
-            m_stack.push_back(val4 + val8);
-        } break;
-        case InstructionType::ADD_TO_POINT: {
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 + val3);
-            m_stack.push_back(val2 + val3);
-        } break;
-        case InstructionType::ADD_TO_COLOR: {
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 + val5);
-            m_stack.push_back(val2 + val5);
-            m_stack.push_back(val3 + val5);
-            m_stack.push_back(val4 + val5);
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
+
+            context.stack.push_back(val1 + val2);
         } break;
+        case InstructionType::ADD_POINT:
+            applyToVectors<Float2>(context.stack, std::plus<>());
+            break;
+        case InstructionType::ADD_COLOR:
+            applyToVectors<Float4>(context.stack, std::plus<>());
+            break;
+        case InstructionType::ADD_TO_POINT:
+            applyToVectorAndNumber<Float2>(context.stack, std::plus<>());
+            break;
+        case InstructionType::ADD_TO_COLOR:
+            applyToVectorAndNumber<Float4>(context.stack, std::plus<>());
+            break;
         case InstructionType::SUB: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 - val2);
-        } break;
-        case InstructionType::SUB_POINT: {
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 - val3);
-            m_stack.push_back(val2 - val4);
-        } break;
-        case InstructionType::SUB_COLOR: {
-            float val8 = m_stack.back();
-            m_stack.pop_back();
-            float val7 = m_stack.back();
-            m_stack.pop_back();
-            float val6 = m_stack.back();
-            m_stack.pop_back();
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 - val5);
-            m_stack.push_back(val2 - val6);
-            m_stack.push_back(val3 - val7);
-            m_stack.push_back(val4 - val8);
-        } break;
-        case InstructionType::SUB_FROM_POINT: {
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 - val3);
-            m_stack.push_back(val2 - val3);
-        } break;
-        case InstructionType::SUB_FROM_COLOR: {
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 - val5);
-            m_stack.push_back(val2 - val5);
-            m_stack.push_back(val3 - val5);
-            m_stack.push_back(val4 - val5);
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
+
+            context.stack.push_back(val1 - val2);
         } break;
+        case InstructionType::SUB_POINT:
+            applyToVectors<Float2>(context.stack, std::minus<>());
+            break;
+        case InstructionType::SUB_COLOR:
+            applyToVectors<Float4>(context.stack, std::minus<>());
+            break;
+        case InstructionType::SUB_FROM_POINT:
+            applyToVectorAndNumber<Float2>(context.stack, std::minus<>());
+            break;
+        case InstructionType::SUB_FROM_COLOR:
+            applyToVectorAndNumber<Float4>(context.stack, std::minus<>());
+            break;
         case InstructionType::MUL: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 * val2);
-        } break;
-        case InstructionType::MUL_POINT_ON_NUMBER: {
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 * val3);
-            m_stack.push_back(val2 * val3);
-        } break;
-        case InstructionType::MUL_COLOR_ON_NUMBER: {
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 * val5);
-            m_stack.push_back(val2 * val5);
-            m_stack.push_back(val3 * val5);
-            m_stack.push_back(val4 * val5);
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
+
+            context.stack.push_back(val1 * val2);
         } break;
+        case InstructionType::MUL_POINT_ON_NUMBER:
+            applyToVectorAndNumber<Float2>(context.stack, std::multiplies<>());
+            break;
+        case InstructionType::MUL_COLOR_ON_NUMBER:
+            applyToVectorAndNumber<Float4>(context.stack, std::multiplies<>());
+            break;
         case InstructionType::DIV: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 / val2);
-        } break;
-        case InstructionType::DIV_POINT_ON_NUMBER: {
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 / val3);
-            m_stack.push_back(val2 / val3);
-        } break;
-        case InstructionType::DIV_COLOR_ON_NUMBER: {
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(val1 / val5);
-            m_stack.push_back(val2 / val5);
-            m_stack.push_back(val3 / val5);
-            m_stack.push_back(val4 / val5);
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
+
+            context.stack.push_back(val1 / val2);
         } break;
+        case InstructionType::DIV_POINT_ON_NUMBER:
+            applyToVectorAndNumber<Float2>(context.stack, std::divides<>());
+            break;
+        case InstructionType::DIV_COLOR_ON_NUMBER:
+            applyToVectorAndNumber<Float4>(context.stack, std::divides<>());
+            break;
         case InstructionType::MOD: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(fmod(val1, val2));
-        } break;
-        case InstructionType::MOD_POINT_ON_NUMBER: {
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(fmod(val1, val3));
-            m_stack.push_back(fmod(val2, val3));
-        } break;
-        case InstructionType::MOD_COLOR_ON_NUMBER: {
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(fmod(val1, val5));
-            m_stack.push_back(fmod(val2, val5));
-            m_stack.push_back(fmod(val3, val5));
-            m_stack.push_back(fmod(val4, val5));
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
+
+            context.stack.push_back(fmod(val1, val2));
         } break;
+        case InstructionType::MOD_POINT_ON_NUMBER:
+            applyToFieldsAndNumber<Float2::SIZE>(context.stack, [](float field, float number) { return fmod(field, number); });
+            break;
+        case InstructionType::MOD_COLOR_ON_NUMBER:
+            applyToFieldsAndNumber<Float4::SIZE>(context.stack, [](float field, float number) { return fmod(field, number); });
+            break;
         case InstructionType::POW: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(pow(val1, val2));
-        } break;
-        case InstructionType::POW_POINT_TO_NUMBER: {
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(pow(val1, val3));
-            m_stack.push_back(pow(val2, val3));
-        } break;
-        case InstructionType::POW_COLOR_TO_NUMBER: {
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(pow(val1, val5));
-            m_stack.push_back(pow(val2, val5));
-            m_stack.push_back(pow(val3, val5));
-            m_stack.push_back(pow(val4, val5));
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
+
+            context.stack.push_back(pow(val1, val2));
         } break;
+        case InstructionType::POW_POINT_TO_NUMBER:
+            applyToFieldsAndNumber<Float2::SIZE>(context.stack, [](float field, float number) { return pow(field, number); });
+            break;
+        case InstructionType::POW_COLOR_TO_NUMBER:
+            applyToFieldsAndNumber<Float4::SIZE>(context.stack, [](float field, float number) { return pow(field, number); });
+            break;
         case InstructionType::NEG: {
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(-val1);
-        } break;
-        case InstructionType::NEG_POINT: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(-val1);
-            m_stack.push_back(-val2);
-        } break;
-        case InstructionType::NEG_COLOR: {
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(-val1);
-            m_stack.push_back(-val2);
-            m_stack.push_back(-val3);
-            m_stack.push_back(-val4);
+            float val1 = context.stack.back();
+            context.stack.pop_back();
+
+            context.stack.push_back(-val1);
         } break;
+        case InstructionType::NEG_POINT:
+            (-Float2::load(context.stack.end() - 2)).store(context.stack.end() - 2);
+            break;
+        case InstructionType::NEG_COLOR:
+            (-Float4::load(context.stack.end() - 4)).store(context.stack.end() - 4);
+            break;
         case InstructionType::INC: {
-            m_stack[m_stack.size() - 1] += 1;
+            context.stack[context.stack.size() - 1] += 1;
         } break;
         case InstructionType::DEC: {
-            m_stack[m_stack.size() - 1] -= 1;
+            context.stack[context.stack.size() - 1] -= 1;
         } break;
         case InstructionType::NOT: {
-            m_stack[m_stack.size() - 1] = (m_stack[m_stack.size() - 1] ? 1 : 0);
+            context.stack[context.stack.size() - 1] = (context.stack[context.stack.size() - 1] ? 1 : 0);
         } break;
         case InstructionType::CMP_EQ: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
 
-            m_stack.push_back(
+            context.stack.push_back(
                 (val1 == val2)
                 ? 1 : 0
             );
         } break;
-        case InstructionType::CMP_EQ_POINTS: {
-            float val6 = m_stack.back();
-            m_stack.pop_back();
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(
-                (val1 == val5
-                    && val2 == val6)
-                ? 1 : 0
-            );
-        } break;
-        case InstructionType::CMP_EQ_COLORS: {
-            float val8 = m_stack.back();
-            m_stack.pop_back();
-            float val7 = m_stack.back();
-            m_stack.pop_back();
-            float val6 = m_stack.back();
-            m_stack.pop_back();
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(
-                (val1 == val5
-                && val2 == val6
-                && val3 == val7
-                && val4 == val8)
-                ? 1 : 0
-            );
-        } break;
+        case InstructionType::CMP_EQ_POINTS:
+            compareVectors<Float2>(context.stack, true);
+            break;
+        case InstructionType::CMP_EQ_COLORS:
+            compareVectors<Float4>(context.stack, true);
+            break;
         case InstructionType::CMP_NEQ: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
 
-            m_stack.push_back(
+            context.stack.push_back(
                 (val1 != val2)
                 ? 1 : 0
             );
         } break;
-        case InstructionType::CMP_NEQ_POINTS: {
-            float val6 = m_stack.back();
-            m_stack.pop_back();
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(
-                (val1 != val5
-                    || val2 != val6)
-                ? 1 : 0
-            );
-        } break;
-        case InstructionType::CMP_NEQ_COLORS: {
-            float val8 = m_stack.back();
-            m_stack.pop_back();
-            float val7 = m_stack.back();
-            m_stack.pop_back();
-            float val6 = m_stack.back();
-            m_stack.pop_back();
-            float val5 = m_stack.back();
-            m_stack.pop_back();
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(
-                (val1 != val5
-                    || val2 != val6
-                    || val3 != val7
-                    || val4 != val8)
-                ? 1 : 0
-            );
-        } break;
+        case InstructionType::CMP_NEQ_POINTS:
+            compareVectors<Float2>(context.stack, false);
+            break;
+        case InstructionType::CMP_NEQ_COLORS:
+            compareVectors<Float4>(context.stack, false);
+            break;
         case InstructionType::CMP_LT: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
 
-            m_stack.push_back(
+            context.stack.push_back(
                 (val1 < val2)
                 ? 1 : 0
             );
         } break;
         case InstructionType::CMP_GT: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
 
-            m_stack.push_back(
+            context.stack.push_back(
                 (val1 > val2)
                 ? 1 : 0
             );
         } break;
         case InstructionType::CMP_GE: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
 
-            m_stack.push_back(
+            context.stack.push_back(
                 (val1 >= val2)
                 ? 1 : 0
             );
         } break;
         case InstructionType::CMP_LE: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
 
-            m_stack.push_back(
+            context.stack.push_back(
                 (val1 <= val2)
                 ? 1 : 0
             );
         } break;
         case InstructionType::AND: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
 
-            m_stack.push_back(
+            context.stack.push_back(
                 (val1 && val2)
                 ? 1 : 0
             );
         } break;
         case InstructionType::OR: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
 
-            m_stack.push_back(
+            context.stack.push_back(
                 (val1 || val2)
                 ? 1 : 0
             );
         } break;
         case InstructionType::GOTO:
-            m_pos = inst.value[0];
+            if (inst.value[0] < context.pos && isRenderCancelled(end)) {
+                context.pos = end;
+                return true;
+            }
+
+            context.pos = inst.value[0];
             break;
         case InstructionType::GOTO_IF_NOT: {
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
 
             if (!val1) {
-                m_pos = inst.value[0];
+                if (inst.value[0] < context.pos && isRenderCancelled(end)) {
+                    context.pos = end;
+                    return true;
+                }
+
+                context.pos = inst.value[0];
             }
         } break;
         case InstructionType::CALL: {
-            m_callStack.push_back(m_pos);
-            m_pos = inst.value[0];
+            context.callStack.push_back(context.pos);
+            context.pos = inst.value[0];
         } break;
         case InstructionType::RET: {
-            m_pos = m_callStack.back();
-            m_callStack.pop_back();
+            context.pos = context.callStack.back();
+            context.callStack.pop_back();
         } break;
         case InstructionType::HALT: {
-            m_pos = m_byteCode.size();
-            this->~CW2VM();
-            return;
+            context.pos = end;
+            return true;
         } break;
         case InstructionType::INIT_RANGE: {
-            float step = m_stack.back();
-            m_stack.pop_back();
-            float to = m_stack.back();
-            m_stack.pop_back();
-            float from = m_stack.back();
-            m_stack.pop_back();
+            float step = context.stack.back();
+            context.stack.pop_back();
+            float to = context.stack.back();
+            context.stack.pop_back();
+            float from = context.stack.back();
+            context.stack.pop_back();
 
             if (to < from) {
                 step = -abs(step);
@@ -814,31 +620,42 @@ void CW2VM::execute() {
                 step = abs(step);
             }
 
-            m_stack.push_back(from);
-            m_stack.push_back(to);
-            m_stack.push_back(step);
+            context.stack.push_back(from);
+            context.stack.push_back(to);
+            context.stack.push_back(step);
         } break;
         case InstructionType::CHECK_RANGE: {
-            float step = m_stack.back();
-            m_stack.pop_back();
-            float to = m_stack.back();
-            m_stack.pop_back();
-            float iter = m_stack.back();
-            m_stack.pop_back();
-
-            m_stack.push_back(step < 0 ? (to < iter ? 1 : 0) : (to > iter ? 1 : 0));
+            float step = context.stack.back();
+            context.stack.pop_back();
+            float to = context.stack.back();
+            context.stack.pop_back();
+            float iter = context.stack.back();
+            context.stack.pop_back();
+
+            context.stack.push_back(step < 0 ? (to < iter ? 1 : 0) : (to > iter ? 1 : 0));
+        } break;
+        case InstructionType::PARALLEL_FOR: {
+            float step = context.stack.back();
+            context.stack.pop_back();
+            float to = context.stack.back();
+            context.stack.pop_back();
+            float from = context.stack.back();
+            context.stack.pop_back();
+
+            runParallelFor(context, from, to, step, inst.value[0]);
+            context.pos = inst.value[0];
         } break;
         case InstructionType::PUSH_WIDTH: {
-            m_stack.push_back(m_width);
+            context.stack.push_back(m_width);
         } break;
         case InstructionType::PUSH_HEIGHT: {
-            m_stack.push_back(m_height);
+            context.stack.push_back(m_height);
         } break;
         case InstructionType::SET_IMAGE: {
             if (inst.value[0] == 0) {
-                m_image = &m_pScene->getImage();
+                context.image = m_pImage;
             } else {
-                m_image = m_imageBuffers[inst.value[0]];
+                context.image = m_imageBuffers[inst.value[0]];
             }
         } break;
         case InstructionType::COPY_IMAGE: {
@@ -846,13 +663,13 @@ void CW2VM::execute() {
             Image* to;
 
             if (inst.value[0] == 0) {
-                from = &m_pScene->getImage();
+                from = m_pImage;
             } else {
                 from = m_imageBuffers[inst.value[0]];
             }
 
             if (inst.value[1] == 0) {
-                to = &m_pScene->getImage();
+                to = m_pImage;
             } else {
                 to = m_imageBuffers[inst.value[1]];
             }
@@ -862,246 +679,509 @@ void CW2VM::execute() {
             }
         } break;
         case InstructionType::UPDATE:
+            m_width = m_pImage->getWidth();
+            m_height = m_pImage->getHeight();
+
+            // The frames are rendered one after another, whatever the frame rate is
+            if (m_isRendering) {
+                if (!renderFrame()) {
+                    context.pos = end;
+                    return true;
+                }
+
+                break;
+            }
+
             m_pScene->update();
-            m_width = m_pScene->getImage().getWidth();
-            m_height = m_pScene->getImage().getHeight();
+
+            // The frame is shown till the next tick, however long it took to draw
+            if (m_framePacer.isActive()) {
+                QTimer::singleShot(m_framePacer.finishFrame(), Qt::PreciseTimer, this, &CW2VM::delayedExecute);
+                return false;
+            }
+
             break;
         case InstructionType::SET_COLOR: {
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            uint8_t r = utils::clamp(int(val1), 0, 255);
-            uint8_t g = utils::clamp(int(val2), 0, 255);
-            uint8_t b = utils::clamp(int(val3), 0, 255);
-            uint8_t a = utils::clamp(int(val4), 0, 255);
-
-            m_color = Color(r, g, b, a);
+            // Saturated to the channels' range at once
+            context.color = Float4::load(context.stack.end() - 4).toColor();
+            context.stack.resize(context.stack.size() - 4);
         } break;
         case InstructionType::SET_WIDTH: {
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            m_toolWidth = val1;
-        } break;
-        case InstructionType::DRAW_PIX: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            uint32_t fromX = utils::clamp(int(val1), 0, m_width);
-            uint32_t fromY = utils::clamp(int(val2), 0, m_height);
-
-            m_image->drawXStroke(fromX, fromY, 1, m_color);
-        } break;
-        case InstructionType::DRAW_STROKE: {
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            uint32_t fromX = utils::clamp(int(val1), 0, m_width);
-            uint32_t fromY = utils::clamp(int(val2), 0, m_height);
-            uint32_t length = utils::clamp(int(val3), 0, m_width - fromX + 1);
-
-            m_image->drawXStroke(fromX, fromY, length, m_color);
-        } break;
-        case InstructionType::DRAW_LINE: {
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            int fromX = utils::clamp(int(val1), 0, m_width);
-            int fromY = utils::clamp(int(val2), 0, m_height);
-            int toX = utils::clamp(int(val3), 0, m_width);
-            int toY = utils::clamp(int(val4), 0, m_height);
-
-            m_image->drawLine(QPoint(fromX, fromY), QPoint(toX, toY), m_toolWidth, m_color);
-        } break;
-        case InstructionType::DRAW_RECT: {
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            int fromX = utils::clamp(int(val1), 0, m_width);
-            int fromY = utils::clamp(int(val2), 0, m_height);
-            int width = utils::clamp(int(val3), 0, m_width - fromX);
-            int height = utils::clamp(int(val4), 0, m_height - fromY);
-
-            m_image->drawRect(QPoint(fromX, fromY), width, height, m_toolWidth, m_color);
-        } break;
-        case InstructionType::DRAW_CIRCLE: {
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            int fromX = utils::clamp(int(val1), 0, m_width);
-            int fromY = utils::clamp(int(val2), 0, m_height);
-
-            m_image->drawCircle(QPointF(fromX, fromY), val3, m_toolWidth, m_color);
-        } break;
-        case InstructionType::FILL_RECT: {
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            int fromX = utils::clamp(int(val1), 0, m_width);
-            int fromY = utils::clamp(int(val2), 0, m_height);
-            int width = utils::clamp(int(val3), 0, m_width - fromX);
-            int height = utils::clamp(int(val4), 0, m_height - fromY);
-
-            m_image->fillRect(QPoint(fromX, fromY), width, height, m_color);
-        } break;
-        case InstructionType::FILL_CIRCLE: {
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
-
-            int fromX = utils::clamp(int(val1), 0, m_width);
-            int fromY = utils::clamp(int(val2), 0, m_height);
-
-            m_image->fillCircle(QPointF(fromX, fromY), val3, m_color);
-        } break;
+            float val1 = context.stack.back();
+            context.stack.pop_back();
+
+            context.toolWidth = val1;
+        } break;
+        case InstructionType::DRAW_PIX:
+        case InstructionType::DRAW_STROKE:
+        case InstructionType::DRAW_LINE:
+        case InstructionType::DRAW_RECT:
+        case InstructionType::DRAW_CIRCLE:
+        case InstructionType::FILL_RECT:
+        case InstructionType::FILL_CIRCLE:
+        case InstructionType::FILL_POLYGON:
+        case InstructionType::FILL_IMAGE:
+        case InstructionType::BLEND_IMAGE:
+        case InstructionType::INVERT_IMAGE:
+        case InstructionType::THRESHOLD_IMAGE:
+        case InstructionType::MULTIPLY_IMAGE:
+        case InstructionType::COPY_RECT:
+            if (context.drawBuffer != nullptr) {
+                recordDraw(context, inst);
+            } else {
+                draw(context, inst);
+            }
+            break;
         case InstructionType::SLEEP: {
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
+
+            // The time is not waited for when rendering, the frame rate of the recording sets the time between the frames
+            if (m_isRendering) {
+                break;
+            }
 
             QTimer::singleShot(int(val1), this, &CW2VM::delayedExecute);
-            return;
+            return false;
+        } break;
+        case InstructionType::SET_FRAME_RATE: {
+            float val1 = context.stack.back();
+            context.stack.pop_back();
+
+            m_framePacer.setFrameRate(val1);
         } break;
         case InstructionType::ABS: {
-            m_stack[m_stack.size() - 1] = fabs(m_stack[m_stack.size() - 1]);
+            context.stack[context.stack.size() - 1] = fabs(context.stack[context.stack.size() - 1]);
         } break;
         case InstructionType::MIN: {
             uint32_t cnt = inst.value[0];
 
-            float minVal = m_stack.back();
-            m_stack.pop_back();
+            float minVal = context.stack.back();
+            context.stack.pop_back();
 
             for (int i = 1; i < cnt; i++) {
-                if (m_stack.back() < minVal) {
-                    minVal = m_stack.back();
+                if (context.stack.back() < minVal) {
+                    minVal = context.stack.back();
                 }
 
-                m_stack.pop_back();
+                context.stack.pop_back();
             }
 
-            m_stack.push_back(minVal);
+            context.stack.push_back(minVal);
         } break;
         case InstructionType::MAX: {
             uint32_t cnt = inst.value[0];
 
-            float maxVal = m_stack.back();
-            m_stack.pop_back();
+            float maxVal = context.stack.back();
+            context.stack.pop_back();
 
             for (int i = 1; i < cnt; i++) {
-                if (m_stack.back() > maxVal) {
-                    maxVal = m_stack.back();
+                if (context.stack.back() > maxVal) {
+                    maxVal = context.stack.back();
                 }
 
-                m_stack.pop_back();
+                context.stack.pop_back();
             }
 
-            m_stack.push_back(maxVal);
+            context.stack.push_back(maxVal);
         } break;
         case InstructionType::SUM: {
             uint32_t cnt = inst.value[0];
 
-            float sumVal = m_stack.back();
-            m_stack.pop_back();
+            float sumVal = context.stack.back();
+            context.stack.pop_back();
 
             for (int i = 1; i < cnt; i++) {
-                sumVal += m_stack.back();
-                m_stack.pop_back();
+                sumVal += context.stack.back();
+                context.stack.pop_back();
             }
 
-            m_stack.push_back(sumVal);
+            context.stack.push_back(sumVal);
         } break;
         case InstructionType::ROUND: {
-            m_stack[m_stack.size() - 1] = round(m_stack[m_stack.size() - 1]);
+            context.stack[context.stack.size() - 1] = round(context.stack[context.stack.size() - 1]);
         } break;
         case InstructionType::FLOOR: {
-            m_stack[m_stack.size() - 1] = floor(m_stack[m_stack.size() - 1]);
+            context.stack[context.stack.size() - 1] = floor(context.stack[context.stack.size() - 1]);
         } break;
         case InstructionType::CEIL: {
-            m_stack[m_stack.size() - 1] = ceil(m_stack[m_stack.size() - 1]);
+            context.stack[context.stack.size() - 1] = ceil(context.stack[context.stack.size() - 1]);
         } break;
         case InstructionType::SIN: {
-            m_stack[m_stack.size() - 1] = sin(m_stack[m_stack.size() - 1]);
+            context.stack[context.stack.size() - 1] = sin(context.stack[context.stack.size() - 1]);
         } break;
         case InstructionType::COS: {
-            m_stack[m_stack.size() - 1] = cos(m_stack[m_stack.size() - 1]);
+            context.stack[context.stack.size() - 1] = cos(context.stack[context.stack.size() - 1]);
         } break;
         case InstructionType::TAN: {
-            m_stack[m_stack.size() - 1] = tan(m_stack[m_stack.size() - 1]);
+            context.stack[context.stack.size() - 1] = tan(context.stack[context.stack.size() - 1]);
         } break;
         case InstructionType::COT: {
-            m_stack[m_stack.size() - 1] = 1 / tan(m_stack[m_stack.size() - 1]);
+            context.stack[context.stack.size() - 1] = 1 / tan(context.stack[context.stack.size() - 1]);
         } break;
         case InstructionType::EXP: {
-            m_stack[m_stack.size() - 1] = exp(m_stack[m_stack.size() - 1]);
+            context.stack[context.stack.size() - 1] = exp(context.stack[context.stack.size() - 1]);
         } break;
         case InstructionType::LOG: {
-            m_stack[m_stack.size() - 1] = log(m_stack[m_stack.size() - 1]);
+            context.stack[context.stack.size() - 1] = log(context.stack[context.stack.size() - 1]);
         } break;
         case InstructionType::LENGTH: {
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
 
-            m_stack.push_back(sqrt(val1 * val1 + val2 * val2));
+            context.stack.push_back(sqrt(val1 * val1 + val2 * val2));
         } break;
         case InstructionType::DISTANCE: {
-            float val4 = m_stack.back();
-            m_stack.pop_back();
-            float val3 = m_stack.back();
-            m_stack.pop_back();
-            float val2 = m_stack.back();
-            m_stack.pop_back();
-            float val1 = m_stack.back();
-            m_stack.pop_back();
+            float val4 = context.stack.back();
+            context.stack.pop_back();
+            float val3 = context.stack.back();
+            context.stack.pop_back();
+            float val2 = context.stack.back();
+            context.stack.pop_back();
+            float val1 = context.stack.back();
+            context.stack.pop_back();
 
             float x = val1 - val3;
             float y = val2 - val4;
 
-            m_stack.push_back(sqrt(x * x + y * y));
+            context.stack.push_back(sqrt(x * x + y * y));
         } break;
         default:
             break;
         }
     }
 
-    this->~CW2VM();
+    return true;
+}
+
+// The number of the stack's values a draw instruction takes
+static uint32_t getDrawArgsSize(const Instruction& inst) {
+    switch (inst.op) {
+    case InstructionType::THRESHOLD_IMAGE:
+        return 1;
+    case InstructionType::DRAW_PIX:
+        return 2;
+    case InstructionType::DRAW_STROKE:
+    case InstructionType::DRAW_CIRCLE:
+    case InstructionType::FILL_CIRCLE:
+        return 3;
+    case InstructionType::DRAW_LINE:
+    case InstructionType::DRAW_RECT:
+    case InstructionType::FILL_RECT:
+    case InstructionType::MULTIPLY_IMAGE:
+    case InstructionType::COPY_RECT:
+        return 4;
+    case InstructionType::FILL_POLYGON:
+        return inst.value[0] * 2;
+    default:
+        return 0;
+    }
+}
+
+// The iterations of a parallel for are run in batches, so the draws recorded meanwhile are limited however long the range is
+constexpr uint32_t PARALLEL_FOR_BATCH_SIZE = 1 << 16;
+
+void CW2VM::runParallelFor(ExecutionContext& context, float from, float to, float step, uint32_t bodyEnd) {
+    uint32_t bodyStart = context.pos;
+
+    // The number of the values the for-loop goes through, a zero step (or NaN) does not run the body at all
+    // The values are computed from their indices, so a step too small to change the value cannot make the range endless
+    // They are the same as the for-loop's ones for whole steps, the fractional ones are not accumulated and so may differ in the last bits
+    uint64_t count = 0;
+    if (step != 0 && (step < 0 ? to < from : to > from)) {
+        double countValue = std::ceil((double(to) - from) / step);
+        count = uint64_t(utils::clamp(countValue, 1.0, double(uint64_t(1) << 63)));
+    }
+
+    Color color = context.color;
+    float toolWidth = context.toolWidth;
+
+    // The nested parallel for-loops are run by the worker itself, since the other ones are busy anyway
+    if (context.drawBuffer != nullptr || count < 2 || m_workerContexts.size() < 2) {
+        for (uint64_t i = 0; i < count; i++) {
+            context.color = color;
+            context.toolWidth = toolWidth;
+            runIteration(context, from, step, i, bodyStart, bodyEnd);
+        }
+
+        context.color = color;
+        context.toolWidth = toolWidth;
+        return;
+    }
+
+    for (size_t i = 0; i < m_workerContexts.size(); i++) {
+        ExecutionContext& worker = m_workerContexts[i];
+        worker.stack.clear();
+        worker.callStack.clear();
+        worker.localVarStack.copyFrom(context.localVarStack); // Only read by the iterations
+        worker.image = context.image;
+        worker.drawBuffer = &m_drawBuffers[i];
+    }
+
+    std::vector<IterationDraws> draws;
+    for (uint64_t batchFrom = 0; batchFrom < count; batchFrom += PARALLEL_FOR_BATCH_SIZE) {
+        uint32_t batchSize = uint32_t(utils::min(count - batchFrom, uint64_t(PARALLEL_FOR_BATCH_SIZE)));
+        for (DrawBuffer& buffer : m_drawBuffers) {
+            buffer.commands.clear();
+            buffer.args.clear();
+        }
+
+        // Each iteration is run by a single worker, so its draws are a continuous part of the worker's buffer
+        draws.resize(batchSize);
+        utils::runWorkStealing(m_workers, batchSize, uint32_t(m_workerContexts.size()), [&](uint32_t worker, uint32_t chunkFrom, uint32_t chunkTo) {
+            trace_scope("CW2VM::runParallelFor chunk");
+
+            ExecutionContext& workerContext = m_workerContexts[worker];
+            for (uint32_t i = chunkFrom; i < chunkTo; i++) {
+                uint32_t drawsFrom = uint32_t(workerContext.drawBuffer->commands.size());
+
+                workerContext.color = color;
+                workerContext.toolWidth = toolWidth;
+                runIteration(workerContext, from, step, batchFrom + i, bodyStart, bodyEnd);
+
+                draws[i] = IterationDraws{ worker, drawsFrom, uint32_t(workerContext.drawBuffer->commands.size()) };
+            }
+        });
+
+        // The draws are applied in the order of the iterations, so the image is the same as after the for-loop
+        for (const IterationDraws& iteration : draws) {
+            const DrawBuffer& buffer = m_drawBuffers[iteration.worker];
+            for (uint32_t i = iteration.from; i < iteration.to; i++) {
+                const DrawBuffer::Command& command = buffer.commands[i];
+                uint32_t argsSize = getDrawArgsSize(command.inst);
+                for (uint32_t arg = 0; arg < argsSize; arg++) {
+                    context.stack.push_back(buffer.args[command.argsPos + arg]);
+                }
+
+                context.color = command.color;
+                context.toolWidth = command.toolWidth;
+                draw(context, command.inst);
+            }
+        }
+    }
+
+    context.color = color;
+    context.toolWidth = toolWidth;
+}
+
+void CW2VM::runIteration(ExecutionContext& context, float from, float step, uint64_t index, uint32_t bodyStart, uint32_t bodyEnd) {
+    size_t localsSize = context.localVarStack.size();
+    context.localVarStack.push_back(float(from + double(index) * step));
+    context.pos = bodyStart;
+
+    // The compiler does not allow sleep within the body, so it always runs to the end
+    run(context, bodyEnd);
+
+    // Removes the value together with whatever the body has left
+    context.localVarStack.resize(localsSize);
+}
+
+void CW2VM::recordDraw(ExecutionContext& context, const Instruction& inst) {
+    DrawBuffer& buffer = *context.drawBuffer;
+    uint32_t argsSize = getDrawArgsSize(inst);
+
+    buffer.commands.push_back(DrawBuffer::Command{ inst, context.color, context.toolWidth, uint32_t(buffer.args.size()) });
+    buffer.args.insert(buffer.args.end(), context.stack.end() - argsSize, context.stack.end());
+    context.stack.resize(context.stack.size() - argsSize);
+}
+
+void CW2VM::draw(ExecutionContext& context, const Instruction& inst) {
+    switch (inst.op) {
+    case InstructionType::DRAW_PIX: {
+        float val2 = context.stack.back();
+        context.stack.pop_back();
+        float val1 = context.stack.back();
+        context.stack.pop_back();
+
+        uint32_t fromX = utils::clamp(int(val1), 0, m_width);
+        uint32_t fromY = utils::clamp(int(val2), 0, m_height);
+
+        context.image->drawXStroke(fromX, fromY, 1, context.color);
+    } break;
+    case InstructionType::DRAW_STROKE: {
+        float val3 = context.stack.back();
+        context.stack.pop_back();
+        float val2 = context.stack.back();
+        context.stack.pop_back();
+        float val1 = context.stack.back();
+        context.stack.pop_back();
+
+        uint32_t fromX = utils::clamp(int(val1), 0, m_width);
+        uint32_t fromY = utils::clamp(int(val2), 0, m_height);
+        uint32_t length = utils::clamp(int(val3), 0, m_width - fromX + 1);
+
+        context.image->drawXStroke(fromX, fromY, length, context.color);
+    } break;
+    case InstructionType::DRAW_LINE: {
+        float val4 = context.stack.back();
+        context.stack.pop_back();
+        float val3 = context.stack.back();
+        context.stack.pop_back();
+        float val2 = context.stack.back();
+        context.stack.pop_back();
+        float val1 = context.stack.back();
+        context.stack.pop_back();
+
+        int fromX = utils::clamp(int(val1), 0, m_width);
+        int fromY = utils::clamp(int(val2), 0, m_height);
+        int toX = utils::clamp(int(val3), 0, m_width);
+        int toY = utils::clamp(int(val4), 0, m_height);
+
+        context.image->drawLine(QPoint(fromX, fromY), QPoint(toX, toY), context.toolWidth, context.color);
+    } break;
+    case InstructionType::DRAW_RECT: {
+        float val4 = context.stack.back();
+        context.stack.pop_back();
+        float val3 = context.stack.back();
+        context.stack.pop_back();
+        float val2 = context.stack.back();
+        context.stack.pop_back();
+        float val1 = context.stack.back();
+        context.stack.pop_back();
+
+        int fromX = utils::clamp(int(val1), 0, m_width);
+        int fromY = utils::clamp(int(val2), 0, m_height);
+        int width = utils::clamp(int(val3), 0, m_width - fromX);
+        int height = utils::clamp(int(val4), 0, m_height - fromY);
+
+        context.image->drawRect(QPoint(fromX, fromY), width, height, context.toolWidth, context.color);
+    } break;
+    case InstructionType::DRAW_CIRCLE: {
+        float val3 = context.stack.back();
+        context.stack.pop_back();
+        float val2 = context.stack.back();
+        context.stack.pop_back();
+        float val1 = context.stack.back();
+        context.stack.pop_back();
+
+        int fromX = utils::clamp(int(val1), 0, m_width);
+        int fromY = utils::clamp(int(val2), 0, m_height);
+
+        context.image->drawCircle(QPointF(fromX, fromY), val3, context.toolWidth, context.color);
+    } break;
+    case InstructionType::FILL_RECT: {
+        float val4 = context.stack.back();
+        context.stack.pop_back();
+        float val3 = context.stack.back();
+        context.stack.pop_back();
+        float val2 = context.stack.back();
+        context.stack.pop_back();
+        float val1 = context.stack.back();
+        context.stack.pop_back();
+
+        int fromX = utils::clamp(int(val1), 0, m_width);
+        int fromY = utils::clamp(int(val2), 0, m_height);
+        int width = utils::clamp(int(val3), 0, m_width - fromX);
+        int height = utils::clamp(int(val4), 0, m_height - fromY);
+
+        context.image->fillRect(QPoint(fromX, fromY), width, height, context.color);
+    } break;
+    case InstructionType::FILL_CIRCLE: {
+        float val3 = context.stack.back();
+        context.stack.pop_back();
+        float val2 = context.stack.back();
+        context.stack.pop_back();
+        float val1 = context.stack.back();
+        context.stack.pop_back();
+
+        int fromX = utils::clamp(int(val1), 0, m_width);
+        int fromY = utils::clamp(int(val2), 0, m_height);
+
+        context.image->fillCircle(QPointF(fromX, fromY), val3, context.color);
+    } break;
+    case InstructionType::FILL_POLYGON: {
+        uint32_t cnt = inst.value[0];
+        size_t first = context.stack.size() - size_t(cnt) * 2;
+
+        // Not clamped, the polygon is clipped by the image itself
+        context.polygonPoints.clear();
+        for (uint32_t i = 0; i < cnt; i++) {
+            context.polygonPoints.push_back(QPointF(context.stack[first + i * 2], context.stack[first + i * 2 + 1]));
+        }
+
+        context.stack.resize(first);
+
+        context.image->fillPolygon(context.polygonPoints, utils::FillRule(inst.value[1]), context.color);
+    } break;
+    case InstructionType::FILL_IMAGE:
+        context.image->fillImage(context.color);
+        break;
+    case InstructionType::BLEND_IMAGE:
+        context.image->blendImage(context.color);
+        break;
+    case InstructionType::INVERT_IMAGE:
+        context.image->invertImage();
+        break;
+    case InstructionType::THRESHOLD_IMAGE: {
+        float val1 = context.stack.back();
+        context.stack.pop_back();
+
+        context.image->thresholdImage(utils::clamp(int(val1), 0, 255));
+    } break;
+    case InstructionType::MULTIPLY_IMAGE: {
+        float val4 = context.stack.back();
+        context.stack.pop_back();
+        float val3 = context.stack.back();
+        context.stack.pop_back();
+        float val2 = context.stack.back();
+        context.stack.pop_back();
+        float val1 = context.stack.back();
+        context.stack.pop_back();
+
+        context.image->multiplyChannels(val1, val2, val3, val4);
+    } break;
+    case InstructionType::COPY_RECT: {
+        float val4 = context.stack.back();
+        context.stack.pop_back();
+        float val3 = context.stack.back();
+        context.stack.pop_back();
+        float val2 = context.stack.back();
+        context.stack.pop_back();
+        float val1 = context.stack.back();
+        context.stack.pop_back();
+
+        int fromX = utils::clamp(int(val1), 0, m_width);
+        int fromY = utils::clamp(int(val2), 0, m_height);
+        int width = utils::clamp(int(val3), 0, m_width - fromX);
+        int height = utils::clamp(int(val4), 0, m_height - fromY);
+
+        Image* from;
+        if (inst.value[0] == 0) {
+            from = m_pImage;
+        } else {
+            from = m_imageBuffers[inst.value[0]];
+        }
+
+        context.image->copyRectFrom(*from, QPoint(fromX, fromY), width, height);
+    } break;
+    default:
+        break;
+    }
+}
+
+bool CW2VM::renderFrame() {
+    if (m_pRecorder != nullptr) {
+        if (auto result = m_pRecorder->addFrame(*m_pImage); !result.isOk()) {
+            m_renderError = result.error();
+            return false;
+        }
+    }
+
+    m_renderedFramesCount++;
+    if (m_pRenderToken != nullptr) {
+        m_pRenderToken->setProgress(m_renderedFramesCount, m_framesToRender);
+        if (m_pRenderToken->isCancelled()) {
+            return false;
+        }
+    }
+
+    return m_renderedFramesCount < m_framesToRender;
+}
+
+bool CW2VM::isRenderCancelled(uint32_t end) const {
+    return m_pRenderToken != nullptr && end == uint32_t(m_byteCode.size()) && m_pRenderToken->isCancelled();
 }
 
 void CW2VM::delayedExecute() {
@@ -1113,14 +1193,15 @@ void CW2VM::delayedExecute() {
 }
 
 void CW2VM::resetVMState() {
-    m_pos = 0;
+    m_context.pos = 0;
     m_byteCode.clear();
-    m_callStack.clear();
+    m_context.callStack.clear();
     m_globalVars.clear();
-    m_stack.clear();
-    m_localVarStack.clear();
-    m_color = Color::Black;
-    m_toolWidth = 3;
+    m_context.stack.clear();
+    m_context.localVarStack.clear();
+    m_context.image = m_pImage;
+    m_context.color = Color::Black;
+    m_context.toolWidth = 3;
 
     for (Image* img : m_imageBuffers) {
         delete img;
@@ -1,37 +1,96 @@
 #pragma once
+#include <vector>
+#include <QThreadPool>
 #include "Instruction.h"
+#include "FramePacer.h"
+#include "../Utils/FixedStack.h"
+#include "../Utils/ProgressToken.h"
 #include "../Image/Image.h"
+#include "../Image/FrameRecorder.h"
 #include "../GUI/ImageEditScene.h"
 
 // Allows to load CW2 bytecode and execute it
+// Runs either on the scene's image and shows the updates, or on an image of its own and renders the updates to files
+// The iterations of the parallel for-loops are executed by a number of worker contexts on a thread pool
 class CW2VM final : public QObject {
 	Q_OBJECT
 
+private:
+	// The draw instructions met by a worker, they are applied to the image once all the iterations are finished
+	// Each worker has a buffer of its own, so they are written without any locking
+	struct DrawBuffer {
+		struct Command {
+			Instruction inst;
+			Color color;
+			float toolWidth;
+			uint32_t argsPos; // Of the instruction's arguments in args
+		};
+
+		std::vector<Command> commands;
+		std::vector<float> args;
+	};
+
+	// The draw commands of a single iteration of a parallel for, within a worker's buffer
+	struct IterationDraws {
+		uint32_t worker;
+		uint32_t from;
+		uint32_t to;
+	};
+
+	// A thread of execution: the main one runs the script, the workers' ones run the iterations of the parallel for-loops
+	struct ExecutionContext {
+		// Allocated to the sizes proven by the verifier on loading, so nothing is checked on pushing
+		utils::FixedStack<float> stack;
+		utils::FixedStack<float> localVarStack;
+		utils::FixedStack<uint32_t> callStack;
+
+		std::vector<QPointF> polygonPoints; // Kept between the fill_polygon instructions so as not to reallocate
+
+		Image* image = nullptr;
+
+		Color color = Color::Black;
+		float toolWidth = 3;
+
+		uint32_t pos = 0;
+
+		DrawBuffer* drawBuffer = nullptr; // Set for the workers only, the draw instructions are recorded to it instead of being executed
+	};
+
 private:
 	QList<Instruction> m_byteCode;
-	QList<float> m_stack;
-	QList<float> m_localVarStack;
 	QList<float> m_globalVars;
-	QList<uint32_t> m_callStack;
 
 	QList<Image*> m_imageBuffers;
-	ImageEditScene* m_pScene;
+	ImageEditScene* m_pScene = nullptr; // None if the VM renders offline
+	Image* m_pImage; // The image the script draws on and updates
+
+	// Set while rendering offline: the updates are passed to the recorder as fast as they are drawn and the sleeps are skipped
+	bool m_isRendering = false;
+	FrameRecorder* m_pRecorder = nullptr;
+	utils::ProgressToken* m_pRenderToken = nullptr;
+	uint32_t m_framesToRender = 0;
+	uint32_t m_renderedFramesCount = 0;
+	QString m_renderError;
 
-	Image* m_image;
+	ExecutionContext m_context;
 
-	Color m_color = Color::Black;
-	float m_toolWidth = 3;
+	// Set by the frame_rate instruction, kept after the script is finished so that its statistics can be seen
+	FramePacer m_framePacer;
+
+	QThreadPool m_workers;
+	std::vector<ExecutionContext> m_workerContexts;
+	std::vector<DrawBuffer> m_drawBuffers;
 
 	uint32_t m_width;
 	uint32_t m_height;
 
-	uint32_t m_pos = 0;
-
 	bool m_isLoaded = false; // whether the vm has some code loaded
 	bool m_shallHalt = false;
 
 public:
 	CW2VM(ImageEditScene* parent);
+	CW2VM(Image* image); // Not bound to any scene, can be used for offline rendering only
+
 
 	~CW2VM();
 
@@ -40,10 +99,36 @@ public:
 	// So as to stop it forcefully even if the "sleep" is uxecuting
 	void forceHalt();
 
+	// The statistics of the frames shown by the last loaded script since its last frame_rate
+	FramePacingReport getFramePacingReport() const;
+
+	// Runs the loaded script till it is finished or the frames count is rendered, the animations usually never finish
+	// The frames are as they are on the updates, and the token is used to report the progress and to cancel the rendering
+	// Without a recorder the frames are only counted, so that the script itself can be measured
+	utils::Result<Void> render(FrameRecorder* recorder, uint32_t framesCount, utils::ProgressToken* token = nullptr);
+
 public slots:
 	void execute();
 
 private:
+	// Executes the instructions till the end position, returns false if the execution was paused by a sleep or an update
+	bool run(ExecutionContext& context, uint32_t end);
+
+	// Runs the body of the parallel for that starts at the context's position for each value of the range
+	void runParallelFor(ExecutionContext& context, float from, float to, float step, uint32_t bodyEnd);
+	void runIteration(ExecutionContext& context, float from, float step, uint64_t index, uint32_t bodyStart, uint32_t bodyEnd);
+
+	// Executes a draw instruction with the arguments on the context's stack, or records it to the context's draw buffer
+	void draw(ExecutionContext& context, const Instruction& inst);
+	void recordDraw(ExecutionContext& context, const Instruction& inst);
+
+	// Passes the updated image to the recorder, returns false if the rendering must be stopped
+	bool renderFrame();
+
+	// Checked on the backward jumps, so that a script looping without updates can be cancelled as well
+	// Only the script's own run is stopped, the bodies of the parallel for-loops are run to their ends
+	bool isRenderCancelled(uint32_t end) const;
+
 	void delayedExecute();
 	void resetVMState();
 };
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "CompilationCache.h"
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include "Compiler.h"
+#include "../Utils/Trace.h"
+
+CompilationCache::CompilationCache(QString directory)
+    : m_directory(std::move(directory)) {
+
+}
+
+QString CompilationCache::getDefaultDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/cw2";
+}
+
+QString CompilationCache::getKey(const QByteArray& source) const {
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(QByteArray(CW2_COMPILER_VERSION));
+    hash.addData(QByteArray("\n"));
+    hash.addData(source);
+
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+bool CompilationCache::restore(const QString& key, const QString& outputPath) const {
+    trace_scope("CompilationCache::restore");
+
+    QString entryPath = getEntryPath(key);
+    if (!QFile::exists(entryPath)) {
+        return false;
+    }
+
+    // QFile::copy does not overwrite files
+    if (QFile::exists(outputPath) && !QFile::remove(outputPath)) {
+        return false;
+    }
+
+    return QFile::copy(entryPath, outputPath);
+}
+
+utils::Result<Void> CompilationCache::store(const QString& key, const QString& compiledPath) const {
+    if (!QDir().mkpath(m_directory)) {
+        return utils::Failure("Failed to create the compilation cache directory: " + m_directory);
+    }
+
+    QFile compiledFile(compiledPath);
+    if (!compiledFile.open(QIODevice::ReadOnly)) {
+        return utils::Failure("Failed to open file: " + compiledPath);
+    }
+
+    QByteArray compiled = compiledFile.readAll();
+
+    // QSaveFile writes to a temporary file of its own and renames it on commit,
+    // so neither a concurrent restore nor a concurrent store of the same script (e.g. by another instance) sees a partially written entry
+    QString entryPath = getEntryPath(key);
+    QSaveFile entryFile(entryPath);
+    if (!entryFile.open(QIODevice::WriteOnly) || entryFile.write(compiled) != compiled.size() || !entryFile.commit()) {
+        return utils::Failure("Failed to store the compiled script to the cache: " + entryPath);
+    }
+
+    return utils::Success();
+}
+
+QString CompilationCache::getEntryPath(const QString& key) const {
+    return m_directory + "/" + key + ".cw2c";
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <QString>
+#include <QByteArray>
+#include "../Utils/Result.h"
+
+// Persistent cache of compiled scripts
+// A compiled script is stored under a key derived from the script's source and the compiler's version,
+// so any change to either of them results in a cache miss
+class CompilationCache final {
+private:
+	QString m_directory;
+
+public:
+	// The cache directory is created on the first store
+	CompilationCache(QString directory = getDefaultDirectory());
+
+	// The user's cache location, e.g. %LOCALAPPDATA%/<app>/cache/cw2
+	static QString getDefaultDirectory();
+
+	// Returns the key for the script's source
+	QString getKey(const QByteArray& source) const;
+
+	// Copies the cached compiled script to outputPath if there is one, returns whether it was found
+	bool restore(const QString& key, const QString& outputPath) const;
+
+	// Puts the compiled script to the cache
+	utils::Result<Void> store(const QString& key, const QString& compiledPath) const;
+
+private:
+	QString getEntryPath(const QString& key) const;
+};
\ No newline at end of file
@@ -1,10 +1,82 @@
 #include "Compiler.h"
+#include <vector>
 #include <QFile>
+#include <QTextStream>
+#include <QThreadPool>
 #include "Compiler/Lexer.h"
 #include "Compiler/Parser.h"
 #include "Compiler/ByteCodeBuilder.h"
+#include "Compiler/ast/FunctionDefState.h"
+#include "CompilationCache.h"
+#include "../Utils/Trace.h"
+
+// Generates the bodies of the functions met in the program's code and links them to the program
+// The bodies are independent from each other once all the signatures are known, so they are generated on a thread pool
+// Functions defined within other functions are generated on the next pass
+static utils::Result<Void> generateFunctions(ByteCodeBuilder& program) {
+    QThreadPool pool;
+
+    QList<FunctionDefState*> functions = program.takePendingFunctions();
+    while (!functions.isEmpty()) {
+        std::vector<ByteCodeBuilder> builders(functions.size());
+        QList<QString> errors(functions.size());
+
+        for (qsizetype i = 0; i < functions.size(); i++) {
+            pool.start([&, i]() {
+                trace_scope("FunctionDefState::generateBody");
+
+                try {
+                    functions[i]->generateBody(builders[i]);
+                } catch (QString error) {
+                    errors[i] = std::move(error);
+                }
+            });
+        }
+
+        pool.waitForDone();
+
+        // Linking in the order of definition, so that the output does not depend on the threads' timing
+        QList<FunctionDefState*> nestedFunctions;
+        for (qsizetype i = 0; i < functions.size(); i++) {
+            if (!errors[i].isEmpty()) {
+                return utils::Failure(errors[i]);
+            }
+
+            program.linkFunction(functions[i]->getFunctionId(), builders[i]);
+            nestedFunctions.append(builders[i].takePendingFunctions());
+        }
+
+        functions = std::move(nestedFunctions);
+    }
+
+    return utils::Success();
+}
+
+utils::Result<Void> Compiler::generate(const QList<State*>& states, ByteCodeBuilder& program) {
+    trace_scope("Compiler::generate");
+
+    // The top-level code first, then the functions
+    try {
+        for (State* state : states) {
+            state->generate(program);
+        }
+
+        program.addInst(Instruction(InstructionType::HALT));
+    } catch (QString error) {
+        return utils::Failure(error);
+    }
+
+    return generateFunctions(program);
+}
+
+Compiler::Compiler(bool useCache)
+    : m_useCache(useCache) {
+
+}
 
 utils::Result<Void> Compiler::compile(QString scriptFilePath) {
+    trace_scope("Compiler::compile");
+
     // Checking for correct file extension
     if (!scriptFilePath.endsWith(".cw2")) {
         return utils::Failure("Not a CW2 script file: " + scriptFilePath);
@@ -16,39 +88,54 @@ utils::Result<Void> Compiler::compile(QString scriptFilePath) {
         return utils::Failure("Failed to open file: " + scriptFilePath);
     }
 
-    g_builder = ByteCodeBuilder();
-
     // Reading the file
-    std::string program = file.readAll().toStdString();
+    QByteArray source = file.readAll();
+    QString outputPath = scriptFilePath + "c";
+
+    // The same source was compiled before
+    CompilationCache cache;
+    QString cacheKey;
+    if (m_useCache) {
+        cacheKey = cache.getKey(source);
+        if (cache.restore(cacheKey, outputPath)) {
+            return utils::Success();
+        }
+    }
 
     // Splitting the script's text into tokens
-    utils::Result<QList<Token>> tokens = Lexer(std::move(program)).tokenize();
+    utils::Result<QList<Token>> tokens = Lexer(source.toStdString()).tokenize();
 
     if (!tokens.isOk()) {
         return tokens.extractError();
     }
 
     // Parsing the tokens into AST
-    utils::Result<std::vector<std::unique_ptr<State>>> ast = Parser(tokens.extract()).parse();
+    // All the nodes live within the arena and are freed at once on leaving the function
+    // The program's builder gathers the variables and functions' signatures during parsing
+    utils::Arena arena;
+    ByteCodeBuilder program;
+    utils::Result<QList<State*>> ast = Parser(tokens.extract(), arena, program).parse();
 
     if (!ast.isOk()) {
         return ast.extractError();
     }
 
     // Compiling ast into bytecode
-    try {
-        auto astVec = ast.extract();
-        for (auto& state : astVec) {
-            state->generate();
-        }
-
-        g_builder.addInst(Instruction(InstructionType::HALT));
-    } catch (QString error) {
-        return utils::Failure(error);
+    if (auto result = generate(ast.extract(), program); !result.isOk()) {
+        return result.extractError();
     }
 
     // Processing the bytecode and storing it to file
-    g_builder.buildAndStore(scriptFilePath + "c");
+    if (auto result = program.buildAndStore(outputPath); !result.isOk()) {
+        return result.extractError();
+    }
+
+    if (m_useCache) {
+        // Not critical: the script would just be compiled again the next time
+        if (auto result = cache.store(cacheKey, outputPath); !result.isOk()) {
+            QTextStream(stderr) << result.error() << "\n";
+        }
+    }
 
     return utils::Success();
 }
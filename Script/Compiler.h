@@ -1,10 +1,26 @@
 #pragma once
+#include <QList>
 #include "../Utils/Result.h"
 
+class State;
+class ByteCodeBuilder;
+
+// Version of the compiler and the bytecode format
+// Must be changed on any change to the generated bytecode, since it invalidates the compilation cache
+constexpr const char* CW2_COMPILER_VERSION = "cw2c-8";
+
 // Compiles a script into a compiled bytecode file
 class Compiler final {
+private:
+	bool m_useCache;
+
 public:
-	Compiler() = default;
+	// If useCache is set, compiled scripts are looked up in and stored to the compilation cache
+	Compiler(bool useCache = true);
 
 	utils::Result<Void> compile(QString scriptFilePath);
+
+	// Generates the bytecode of the parsed program into the program's builder: the top-level code, then the functions
+	// A stage of compile(), exposed so that it can be measured by itself
+	static utils::Result<Void> generate(const QList<State*>& states, ByteCodeBuilder& program);
 };
\ No newline at end of file
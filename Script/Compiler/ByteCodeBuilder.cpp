@@ -1,20 +1,28 @@
 #include "ByteCodeBuilder.h"
+#include <algorithm>
 #include <QFile>
 #include <QTextStream>
-
-ByteCodeBuilder g_builder;
-
-Variable g_scopeVar = Variable{ "", Type(), 0, false, true };
+#include "../../Utils/Trace.h"
 
 // The offset to differentiate between labels and normal positions
 constexpr size_t LABELS_OFFSET = 0x1000000;
 
-void ByteCodeBuilder::buildAndStore(QString fileName) {
+// The offset to differentiate between function IDs and labels
+constexpr size_t FUNCTIONS_OFFSET = 0x2000000;
+
+utils::Result<Void> ByteCodeBuilder::buildAndStore(QString fileName) {
+    trace_scope("ByteCodeBuilder::buildAndStore");
+
     replaceLabels();
 
+    if (auto result = checkParallelBodies(); !result.isOk()) {
+        return result.extractError();
+    }
+
     QFile file(fileName);
-    if (!file.open(QFile::WriteOnly | QFile::Text))
-        return;
+    if (!file.open(QFile::WriteOnly | QFile::Text)) {
+        return utils::Failure("Failed to open file: " + fileName);
+    }
     
     QTextStream out(&file);
     out << m_imageBuffersCount << "\n"
@@ -34,6 +42,8 @@ void ByteCodeBuilder::buildAndStore(QString fileName) {
 
         out << "\n";
     }
+
+    return utils::Success();
 }
 
 size_t ByteCodeBuilder::addInst(Instruction inst) {
@@ -44,6 +54,12 @@ size_t ByteCodeBuilder::addInst(Instruction inst) {
 void ByteCodeBuilder::addBreakInst(uint8_t cycleId) {
     assert(cycleId < m_cycles.size());
 
+    for (uint8_t i = 0; i <= cycleId; i++) {
+        if (m_cycles[m_cycles.size() - i - 1].isParallel) {
+            throw QString("Cannot break out of a parallel for");
+        }
+    }
+
     Cycle cycle = m_cycles[m_cycles.size() - cycleId - 1];
     addClearScopeInst(uint32_t(m_localTop - cycle.clearIndex));
     addInst(Instruction(InstructionType::GOTO, (uint32_t)cycle.endLabel));
@@ -52,6 +68,13 @@ void ByteCodeBuilder::addBreakInst(uint8_t cycleId) {
 void ByteCodeBuilder::addContinueInst(uint8_t cycleId) {
     assert(cycleId < m_cycles.size());
 
+    // Continuing a parallel for itself just finishes the iteration
+    for (uint8_t i = 0; i < cycleId; i++) {
+        if (m_cycles[m_cycles.size() - i - 1].isParallel) {
+            throw QString("Cannot continue a cycle outside of a parallel for from within it");
+        }
+    }
+
     Cycle cycle = m_cycles[m_cycles.size() - cycleId - 1];
     addClearScopeInst(uint32_t(m_localTop - cycle.clearIndex));
     addInst(Instruction(InstructionType::GOTO, (uint32_t)cycle.beginLabel));
@@ -66,6 +89,12 @@ void ByteCodeBuilder::addClearScopeInst(uint32_t totalClear) {
 void ByteCodeBuilder::addRetInst() {
     assert(m_retClearIndices.size());
 
+    for (const Cycle& cycle : m_cycles) {
+        if (cycle.isParallel) {
+            throw QString("Cannot return from within a parallel for");
+        }
+    }
+
     addClearScopeInst(uint32_t(m_localTop - m_retClearIndices.back()));
     addInst(Instruction(InstructionType::RET));
 }
@@ -75,6 +104,7 @@ Cycle* ByteCodeBuilder::addCycle() {
     cycle.beginLabel = getLabel();
     cycle.endLabel = getLabel();
     cycle.clearIndex = m_localTop;
+    cycle.isParallel = false;
 
     m_cycles.push_back(cycle);
     return &m_cycles.back();
@@ -94,6 +124,24 @@ void ByteCodeBuilder::popRetClearIndex() {
     m_retClearIndices.pop_back();
 }
 
+void ByteCodeBuilder::beginParallelBody() {
+    m_parallelBodies.push_back(m_localTop);
+}
+
+void ByteCodeBuilder::endParallelBody() {
+    assert(m_parallelBodies.size());
+
+    m_parallelBodies.pop_back();
+}
+
+bool ByteCodeBuilder::isInParallelBody() {
+    return !m_parallelBodies.isEmpty();
+}
+
+bool ByteCodeBuilder::isSharedWithParallelBody(const Variable& var) {
+    return isInParallelBody() && (var.isGlobal || var.index < m_parallelBodies.back());
+}
+
 size_t ByteCodeBuilder::getLabel() {
     m_labels.push_back(0);
     return m_labels.size() + LABELS_OFFSET - 1;
@@ -107,11 +155,14 @@ void ByteCodeBuilder::setLabelAtNextInst(size_t labelId) {
 
 void ByteCodeBuilder::replaceLabels() {
     for (auto& inst : m_byteCode) {
-        if (inst.op == InstructionType::GOTO || inst.op == InstructionType::GOTO_IF_NOT || inst.op == InstructionType::CALL) {
+        if (inst.op == InstructionType::GOTO || inst.op == InstructionType::GOTO_IF_NOT || inst.op == InstructionType::PARALLEL_FOR) {
             if (inst.value[0] >= LABELS_OFFSET) { // It is a label
                 assert(inst.value[0] - LABELS_OFFSET < m_labels.size());
                 inst.value[0] = m_labels[inst.value[0] - LABELS_OFFSET];
             }
+        } else if (inst.op == InstructionType::CALL) {
+            assert(inst.value[0] >= FUNCTIONS_OFFSET && inst.value[0] - FUNCTIONS_OFFSET < m_funcStarts.size());
+            inst.value[0] = m_funcStarts[inst.value[0] - FUNCTIONS_OFFSET];
         }
     }
 
@@ -119,57 +170,92 @@ void ByteCodeBuilder::replaceLabels() {
 }
 
 Variable* ByteCodeBuilder::findVariable(const std::string& name) {
-    for (int i = m_vars.size() - 1; i >= 0; i--) {
-        if (m_vars[i].name == name) {
-            return &m_vars[i];
-        }
+    auto nameId = m_nameIds.find(name);
+    if (nameId == m_nameIds.end() || m_visibleVars[nameId->second] < 0) {
+        return nullptr;
     }
 
-    return nullptr;
+    return &m_vars[m_visibleVars[nameId->second]].var;
 }
 
 Function* ByteCodeBuilder::findFunction(const std::string& name, const Type& arguments) {
-    for (int i = m_funcs.size() - 1; i >= 0; i--) {
-        if (m_funcs[i].name == name && m_funcs[i].arguments == arguments) {
-            return &m_funcs[i];
-        }
+    auto nameId = m_nameIds.find(name);
+    if (nameId == m_nameIds.end()) {
+        return nullptr;
+    }
+
+    auto func = m_funcsBySignature.find(FunctionKey{ nameId->second, arguments.getSignature() });
+    if (func == m_funcsBySignature.end()) {
+        return nullptr;
     }
 
-    return nullptr;
+    return &m_funcs[func->second];
 }
 
 Function* ByteCodeBuilder::findFunction(size_t funcId) {
-    assert(funcId < m_labels.size() + LABELS_OFFSET);
-
-    for (auto& func : m_funcs) {
-        if (func.position == funcId) {
-            return &func;
-        }
+    if (funcId < FUNCTIONS_OFFSET || funcId - FUNCTIONS_OFFSET >= m_funcs.size()) {
+        return nullptr;
     }
 
-    return nullptr;
+    return &m_funcs[funcId - FUNCTIONS_OFFSET];
 }
 
 Variable ByteCodeBuilder::addVariable(std::string name, Type type, bool isGlobal) {
     uint32_t& varTop = isGlobal ? m_globalTop : m_localTop;
     uint32_t varSize = getTypeSize(type[0]);
+    uint32_t nameId = internName(name);
 
-    m_vars.push_back(Variable{ std::move(name), std::move(type), varTop, isGlobal, false });
+    // The new variable hides the previous one with the same name till the end of the scope
+    m_vars.push_back(VariableEntry{ Variable{ std::move(name), std::move(type), varTop, isGlobal }, nameId, m_visibleVars[nameId] });
+    m_visibleVars[nameId] = int32_t(m_vars.size() - 1);
     varTop += varSize;
 
-    return m_vars.back();
+    return m_vars.back().var;
 }
 
 size_t ByteCodeBuilder::addFunction(std::string name, Type retType, Type argTypes) {
-    m_funcs.push_back(Function{ std::move(name), std::move(argTypes), std::move(retType), getLabel() });
+    uint32_t nameId = internName(name);
+    uint32_t index = uint32_t(m_funcs.size());
+
+    m_funcs.push_back(Function{ std::move(name), argTypes, std::move(retType), FUNCTIONS_OFFSET + index });
+    m_funcStarts.push_back(0);
+
+    // A redefinition with the same signature replaces the previous function for the further calls
+    m_funcsBySignature[FunctionKey{ nameId, argTypes.getSignature() }] = index;
 
     return m_funcs.back().position;
 }
 
-Function& ByteCodeBuilder::setFunctionStartLoc(size_t funcId) {
-    setLabelAtNextInst(funcId);
+void ByteCodeBuilder::addPendingFunction(FunctionDefState* function) {
+    m_pendingFunctions.push_back(function);
+}
 
-    return *findFunction(funcId);
+QList<FunctionDefState*> ByteCodeBuilder::takePendingFunctions() {
+    return std::exchange(m_pendingFunctions, QList<FunctionDefState*>());
+}
+
+void ByteCodeBuilder::linkFunction(size_t funcId, ByteCodeBuilder& function) {
+    assert(funcId >= FUNCTIONS_OFFSET && funcId - FUNCTIONS_OFFSET < m_funcStarts.size());
+
+    size_t start = m_byteCode.size();
+    m_funcStarts[funcId - FUNCTIONS_OFFSET] = start;
+
+    // The function's labels are local to its code, so they are resolved with the code's new position
+    // Calls are left as is, since they refer to the functions of this builder
+    m_byteCode.reserve(start + function.m_byteCode.size());
+    for (Instruction inst : function.m_byteCode) {
+        if (inst.op == InstructionType::GOTO || inst.op == InstructionType::GOTO_IF_NOT || inst.op == InstructionType::PARALLEL_FOR) {
+            if (inst.value[0] >= LABELS_OFFSET) {
+                assert(inst.value[0] - LABELS_OFFSET < function.m_labels.size());
+                inst.value[0] = uint32_t(function.m_labels[inst.value[0] - LABELS_OFFSET] + start);
+            }
+        }
+
+        m_byteCode.push_back(inst);
+    }
+
+    function.m_byteCode.clear();
+    function.m_labels.clear();
 }
 
 uint32_t ByteCodeBuilder::getCurrentLocalVarLoc(uint32_t index) {
@@ -179,20 +265,23 @@ uint32_t ByteCodeBuilder::getCurrentLocalVarLoc(uint32_t index) {
 }
 
 void ByteCodeBuilder::addScope(bool modifyInsts) {
-    g_scopeVar.index = m_localTop;
-    m_vars.push_back(g_scopeVar);
+    m_scopes.push_back(uint32_t(m_vars.size()));
 }
 
 void ByteCodeBuilder::deleteScope(bool modifyInsts) {
+    assert(m_scopes.size());
+
+    // Only the variables of the scope are visited, each one restores the variable it hid
+    uint32_t scopeStart = m_scopes.back();
+    m_scopes.pop_back();
+
     uint32_t totalClear = 0;
-    for (int i = m_vars.size() - 1; i >= 0; i--) {
-        if (m_vars[i].scopeFlag) {
-            m_vars.pop_back();
-            break;
-        }
+    while (m_vars.size() > scopeStart) {
+        VariableEntry& entry = m_vars.back();
+        m_visibleVars[entry.nameId] = entry.shadowed;
 
-        m_localTop -= getTypeSize(m_vars.back().type[0]);
-        totalClear += getTypeSize(m_vars.back().type[0]);
+        m_localTop -= getTypeSize(entry.var.type[0]);
+        totalClear += getTypeSize(entry.var.type[0]);
         m_vars.pop_back();
     }
 
@@ -220,3 +309,86 @@ void ByteCodeBuilder::setImageBuffersCount(uint8_t count) {
 uint8_t ByteCodeBuilder::getImageBuffersCount() {
     return m_imageBuffersCount;
 }
+
+uint32_t ByteCodeBuilder::internName(const std::string& name) {
+    auto [nameId, isNew] = m_nameIds.try_emplace(name, uint32_t(m_visibleVars.size()));
+    if (isNew) {
+        m_visibleVars.push_back(-1);
+    }
+
+    return nameId->second;
+}
+
+// Instructions that are not allowed within the parallel for's iterations, since they change what the other iterations see
+static bool isSharedStateInstruction(InstructionType op) {
+    switch (op) {
+    case InstructionType::STORE_GLOBAL:
+    case InstructionType::STORE_POINT_GLOBAL:
+    case InstructionType::STORE_COLOR_GLOBAL:
+    case InstructionType::HALT:
+    case InstructionType::SET_IMAGE:
+    case InstructionType::COPY_IMAGE:
+    case InstructionType::UPDATE:
+    case InstructionType::SLEEP:
+    case InstructionType::SET_FRAME_RATE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+utils::Result<Void> ByteCodeBuilder::checkParallelBodies() {
+    // The code of the functions is linked one after another after the top-level code
+    QList<size_t> starts = m_funcStarts;
+    std::sort(starts.begin(), starts.end());
+    auto getFunction = [&](size_t start) {
+        return qsizetype(std::lower_bound(starts.begin(), starts.end(), start) - starts.begin());
+    };
+
+    auto getFunctionEnd = [&](qsizetype function) {
+        return function + 1 < starts.size() ? starts[function + 1] : size_t(m_byteCode.size());
+    };
+
+    // A function cannot be called within a parallel for if it or any function it calls has such instructions
+    QList<bool> isShared(starts.size(), false);
+    for (qsizetype i = 0; i < starts.size(); i++) {
+        for (size_t pos = starts[i]; pos < getFunctionEnd(i) && !isShared[i]; pos++) {
+            isShared[i] = isSharedStateInstruction(m_byteCode[pos].op);
+        }
+    }
+
+    for (bool isChanged = true; isChanged; ) {
+        isChanged = false;
+        for (qsizetype i = 0; i < starts.size(); i++) {
+            for (size_t pos = starts[i]; pos < getFunctionEnd(i) && !isShared[i]; pos++) {
+                if (m_byteCode[pos].op == InstructionType::CALL && isShared[getFunction(m_byteCode[pos].value[0])]) {
+                    isShared[i] = isChanged = true;
+                }
+            }
+        }
+    }
+
+    // The parser rejects such instructions already, the body's own ones are checked as well in case any slips through it
+    for (size_t pos = 0; pos < m_byteCode.size(); pos++) {
+        if (m_byteCode[pos].op != InstructionType::PARALLEL_FOR) {
+            continue;
+        }
+
+        for (size_t bodyPos = pos + 1; bodyPos < m_byteCode[pos].value[0]; bodyPos++) {
+            const Instruction& inst = m_byteCode[bodyPos];
+            if (isSharedStateInstruction(inst.op)) {
+                return utils::Failure("A parallel for cannot change global variables or use set_image, copy_image, update, sleep or frame_rate");
+            }
+
+            if (inst.op != InstructionType::CALL || !isShared[getFunction(inst.value[0])]) {
+                continue;
+            }
+
+            auto function = std::find(m_funcStarts.begin(), m_funcStarts.end(), inst.value[0]);
+            return utils::Failure("Function " + QString::fromStdString(m_funcs[function - m_funcStarts.begin()].name)
+                + " cannot be called within a parallel for: it changes global variables or uses set_image, copy_image, update, sleep or frame_rate");
+        }
+    }
+
+    return utils::Success();
+}
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
+#include <string>
+#include <unordered_map>
 #include <QList>
 #include "../Instruction.h"
+#include "../../Utils/Result.h"
 #include "ast/Type.h"
 
 struct Variable {
@@ -8,14 +11,13 @@ struct Variable {
 	Type type;
 	uint32_t index; // Its index in variable pool
 	bool isGlobal;
-	bool scopeFlag = false; // Flag meaning it is not a variable but a marker of a scope
 };
 
 struct Function {
 	std::string name;
 	Type arguments;
 	Type returnType;
-	size_t position;
+	size_t position; // The function's ID, replaced with the actual position on linking
 };
 
 struct Cycle {
@@ -23,18 +25,60 @@ struct Cycle {
 	size_t endLabel;
 
 	size_t clearIndex; // Index of the scope variable till which variable stack would be cleared on break/continue
+
+	bool isParallel; // A parallel for's iterations can only be continued, the cycle cannot be left from within them
 };
 
+class FunctionDefState;
+
 // Allows to build a bytecode from AST
 // Must be called from AST, does nothing on itself
+// The program's builder is used by the parser for the symbols and generates the top-level code,
+// while each of the functions' bodies is generated by a builder of its own and then linked into the program's one
 class ByteCodeBuilder final {
+private:
+	// A variable within the stack of the currently visible variables
+	struct VariableEntry {
+		Variable var;
+		uint32_t nameId;
+		int32_t shadowed; // Index of the entry with the same name that this one hides, or -1
+	};
+
+	// Functions are overloaded by the argument types, so the signature is a part of the key
+	struct FunctionKey {
+		uint32_t nameId;
+		uint64_t arguments;
+
+		inline bool operator==(const FunctionKey& other) const {
+			return nameId == other.nameId && arguments == other.arguments;
+		}
+	};
+
+	struct FunctionKeyHash {
+		inline size_t operator()(const FunctionKey& key) const {
+			return std::hash<uint64_t>()(key.arguments * 0x9E3779B97F4A7C15ull ^ key.nameId);
+		}
+	};
+
 private:
 	QList<Instruction> m_byteCode;
-	QList<Variable> m_vars;
+	QList<VariableEntry> m_vars;
+	QList<uint32_t> m_scopes; // Size of m_vars at the moment each of the scopes was opened
 	QList<Function> m_funcs;
+
+	// Interned names of variables and functions
+	std::unordered_map<std::string, uint32_t> m_nameIds;
+	QList<int32_t> m_visibleVars; // The currently visible variable's index within m_vars per name ID, or -1
+
+	std::unordered_map<FunctionKey, uint32_t, FunctionKeyHash> m_funcsBySignature;
+	QList<size_t> m_funcStarts; // Positions of the linked functions' bodies
+
+	QList<FunctionDefState*> m_pendingFunctions; // Functions met during the codegen that are to be generated separately
+
 	QList<size_t> m_labels;
 	QList<Cycle> m_cycles;
 	QList<size_t> m_retClearIndices;
+	QList<uint32_t> m_parallelBodies; // The top of the local variables at the moment each of the parallel for's bodies was begun
 
 	uint32_t m_globalTop = 0;
 	uint32_t m_localTop = 0;
@@ -46,7 +90,7 @@ private:
 	uint32_t m_maxLocalVariableStackSize = 256 * 256;
 
 public:
-	void buildAndStore(QString fileName);
+	utils::Result<Void> buildAndStore(QString fileName);
 
 	// Adds a new instruction and returns its index
 	size_t addInst(Instruction inst);
@@ -66,13 +110,20 @@ public:
 	void addRetClearIndex();
 	void popRetClearIndex();
 
+	// Used during parsing: the variables declared before the innermost parallel for's body are shared by its iterations
+	// and thus can only be read within it, the same goes for the global variables
+	void beginParallelBody();
+	void endParallelBody();
+	bool isInParallelBody();
+	bool isSharedWithParallelBody(const Variable& var);
+
 	// Creates a new label and returns its index
 	size_t getLabel();
 
 	// Sets the label's value to the current instruction
 	void setLabelAtNextInst(size_t labelId);
 
-	// Replaces all the labels with actual positions
+	// Replaces all the labels and function IDs with actual positions
 	// Deletes all the labels, thus can only be called once
 	void replaceLabels();
 
@@ -86,7 +137,13 @@ public:
 	// Returns the functions ID that must be later used for setting up the function to the code
 	size_t addFunction(std::string name, Type retType, Type argTypes);
 
-	Function& setFunctionStartLoc(size_t funcId);
+	// Functions' bodies are not generated in place, but collected to be generated separately
+	void addPendingFunction(FunctionDefState* function);
+	QList<FunctionDefState*> takePendingFunctions();
+
+	// Appends the code generated by the function's own builder and sets the function's position to it
+	// The function's builder must not be used after that
+	void linkFunction(size_t funcId, ByteCodeBuilder& function);
 
 	uint32_t getCurrentLocalVarLoc(uint32_t index);
 
@@ -100,6 +157,12 @@ public:
 
 	void setImageBuffersCount(uint8_t count);
 	uint8_t getImageBuffersCount();
-};
 
-extern ByteCodeBuilder g_builder;
\ No newline at end of file
+private:
+	// Returns the ID of the name, registering the name if it is met for the first time
+	uint32_t internName(const std::string& name);
+
+	// Checks that the functions called within the parallel for's bodies neither change global variables nor pause or switch the image
+	// Must be called after the labels are replaced
+	utils::Result<Void> checkParallelBodies();
+};
\ No newline at end of file
@@ -2,15 +2,17 @@
 #include <QMap>
 #include <functional>
 #include <QMessageBox>
+#include "../../Utils/Trace.h"
 
 QList<std::string> KEY_WORDS{
 	"let", "global", "set", "call", "Number", "Point", "Color",
-	"def", "if", "else", "while", "for",
+	"def", "if", "else", "while", "for", "parallel",
 	"continue", "break", "return", "to", "in", "range",
 	"set_image_buffer", "set_image", "set_color", "set_width", "copy_image", "update",
 	"draw_pix", "draw_stroke", "draw_line", "draw_rect", "draw_circle",
-	"fill_rect", "fill_circle",
-	"sleep",
+	"fill_rect", "fill_circle", "fill_polygon", "fill_polygon_evenodd",
+	"fill_image", "blend_image", "invert_image", "threshold_image", "multiply_image", "copy_rect",
+	"sleep", "frame_rate",
 	"Width", "Height",
 	"abs", "min", "max", "sum",
 	"round", "floor", "ceil",
@@ -117,6 +119,8 @@ Lexer::Lexer(std::string text)
 }
 
 utils::Result<QList<Token>> Lexer::tokenize() {
+	trace_scope("Lexer::tokenize");
+
 	try {
 		while (m_pos < m_text.size()) {
 			nextToken();
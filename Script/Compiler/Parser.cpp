@@ -12,26 +12,30 @@
 #include "ast/ForState.h"
 #include "ast/FunctionDefState.h"
 #include "ast/IfElseState.h"
+#include "ast/ParallelForState.h"
 #include "ast/SetState.h"
 #include "ast/TerminatorState.h"
 #include "ast/VariableDeclState.h"
 #include "ast/WhileState.h"
+#include "../../Utils/Trace.h"
 
 
 static Token _NO_TOK = Token();
 
-Parser::Parser(QList<Token> tokens)
-	: m_toks(std::move(tokens)) {
+Parser::Parser(QList<Token> tokens, utils::Arena& arena, ByteCodeBuilder& builder)
+	: m_toks(std::move(tokens)), m_arena(arena), m_builder(builder) {
 
 }
 
-utils::Result<std::vector<std::unique_ptr<State>>> Parser::parse() {
-	std::vector<std::unique_ptr<State>> result;
+utils::Result<QList<State*>> Parser::parse() {
+	trace_scope("Parser::parse");
+
+	QList<State*> result;
 
 	try {
 		while (m_pos < m_toks.size()) {
 			if (auto state = stateOrBlock(true); state != nullptr) {
-				result.push_back(std::move(state));
+				result.push_back(state);
 			}
 		}
 	} catch (QString error) {
@@ -41,28 +45,31 @@ utils::Result<std::vector<std::unique_ptr<State>>> Parser::parse() {
 	return result;
 }
 
-std::unique_ptr<State> Parser::stateOrBlock(bool isHighLevel) {
+State* Parser::stateOrBlock(bool isHighLevel) {
 	if (match(TokenType::LBRACE)) {
-		g_builder.addScope(false);
-		std::vector<std::unique_ptr<State>> states;
+		m_builder.addScope(false);
+		std::vector<State*> states;
 		while (!match(TokenType::RBRACE)) {
 			states.push_back(statement());
 		}
 
-		g_builder.deleteScope(false);
-		return std::make_unique<BlockState>(std::move(states));
+		m_builder.deleteScope(false);
+		return m_arena.make<BlockState>(m_arena.makeArray(states));
 	} else {
 		return statement(isHighLevel);
 	}
 }
 
-std::unique_ptr<State> Parser::statement(bool isHighLevel) {
+State* Parser::statement(bool isHighLevel) {
 	if (match(TokenType::IF)) {
 		return ifElseStatement();
 	} else if (match(TokenType::WHILE)) {
 		return whileStatement();
 	} else if (match(TokenType::FOR)) {
 		return forStatement();
+	} else if (match(TokenType::PARALLEL)) {
+		consume(TokenType::FOR);
+		return forStatement(true);
 	} else if (peek().type == TokenType::LBRACE) {
 		return stateOrBlock(isHighLevel);
 	} else if (peek().type == TokenType::LET || peek().type == TokenType::GLOBAL) {
@@ -95,24 +102,33 @@ std::unique_ptr<State> Parser::statement(bool isHighLevel) {
 		}
 
 		consume(TokenType::TO);
-		return std::make_unique<SetState>(std::move(name), field, expression());
+		return m_arena.make<SetState>(m_builder, std::move(name), field, expression());
 	} if (match(TokenType::CALL)) { // Supposed to be used with functions, but any kind of expression can be used
-		return std::make_unique<ExprState>(expression());
+		return m_arena.make<ExprState>(expression());
 	} if (match(TokenType::SET_IMAGE_BUFFER)) {
 		uint32_t amount = (uint32_t)std::stoul(consume(TokenType::NUMBER_VAL).data);
 
-		g_builder.setImageBuffersCount(amount);
+		m_builder.setImageBuffersCount(amount);
 
 		return nullptr;
-	} if (matchRange(TokenType::SET_IMAGE, TokenType::SLEEP)) {
+	} if (matchRange(TokenType::SET_IMAGE, TokenType::FRAME_RATE)) {
 		TokenType tokenType = peek(-1).type;
-		std::vector<std::unique_ptr<Expr>> args;
+		std::vector<Expr*> args;
+
+		// The iterations would see each other's image and wait for each other otherwise
+		if (m_builder.isInParallelBody() && (tokenType == TokenType::SET_IMAGE || tokenType == TokenType::COPY_IMAGE
+			|| tokenType == TokenType::UPDATE || tokenType == TokenType::SLEEP || tokenType == TokenType::FRAME_RATE)) {
+			throw QString("Set_image, copy_image, update, sleep and frame_rate cannot be used within a parallel for");
+		}
 		
 		switch (tokenType) {
 			case TokenType::SET_IMAGE:
 			case TokenType::SET_COLOR:
 			case TokenType::SET_WIDTH:
+			case TokenType::THRESHOLD_IMAGE:
+			case TokenType::MULTIPLY_IMAGE:
 			case TokenType::SLEEP:
+			case TokenType::FRAME_RATE:
 				args.push_back(expression());
 				break;
 			case TokenType::COPY_IMAGE:
@@ -131,31 +147,48 @@ std::unique_ptr<State> Parser::statement(bool isHighLevel) {
 				consume(TokenType::COMMA);
 				args.push_back(expression());
 				break;
+			case TokenType::FILL_POLYGON:
+			case TokenType::FILL_POLYGON_EVEN_ODD:
+				args.push_back(expression());
+				while (match(TokenType::COMMA)) {
+					args.push_back(expression());
+				}
+				break;
+			case TokenType::COPY_RECT:
+				args.push_back(expression());
+				consume(TokenType::COMMA);
+				args.push_back(expression());
+				consume(TokenType::COMMA);
+				args.push_back(expression());
+				break;
+			case TokenType::FILL_IMAGE:
+			case TokenType::BLEND_IMAGE:
+			case TokenType::INVERT_IMAGE:
 			case TokenType::UPDATE:
 		default: break;
 		}
 
-		return std::make_unique<BuiltInState>(tokenType, std::move(args));
+		return m_arena.make<BuiltInState>(tokenType, m_arena.makeArray(args));
 	}
 	
 	if (!isHighLevel) {
 		if (match(TokenType::RETURN)) {
-			return std::make_unique<TerminatorState>(TerminatorAdded::RETURN, expression());
+			return m_arena.make<TerminatorState>(TerminatorAdded::RETURN, expression());
 		} if (match(TokenType::BREAK)) {
-			return std::make_unique<TerminatorState>(TerminatorAdded::BREAK, expression());
+			return m_arena.make<TerminatorState>(TerminatorAdded::BREAK, expression());
 		} if (match(TokenType::CONTINUE)) {
-			return std::make_unique<TerminatorState>(TerminatorAdded::CONTINUE, expression());
+			return m_arena.make<TerminatorState>(TerminatorAdded::CONTINUE, expression());
 		}
 	}
 
 	throw QString("No statement");
 }
 
-std::unique_ptr<State> Parser::functionDefStatement() {
+State* Parser::functionDefStatement() {
 	std::string name = consume(TokenType::WORD).data;
 
 	// Arguments
-	g_builder.addScope(false);
+	m_builder.addScope(false);
 	consume(TokenType::LPAR);
 
 	QList<Variable> args;
@@ -173,7 +206,7 @@ std::unique_ptr<State> Parser::functionDefStatement() {
 			}
 
 			std::string argName = consume(TokenType::WORD).data;
-			args.push_back(g_builder.addVariable(std::move(argName), Type({ argTypes.back() }), false));
+			args.push_back(m_builder.addVariable(std::move(argName), Type({ argTypes.back() }), false));
 		} while (match(TokenType::COMMA));
 		consume(TokenType::RPAR);
 	}
@@ -194,24 +227,24 @@ std::unique_ptr<State> Parser::functionDefStatement() {
 
 	// Short function, like def a() number = 10;
 	if (match(TokenType::EQ)) {
-		std::unique_ptr<Expr> expr = expression();
-		std::unique_ptr<State> body = std::make_unique<TerminatorState>(TerminatorAdded::RETURN, std::move(expr));
+		Expr* expr = expression();
+		State* body = m_arena.make<TerminatorState>(TerminatorAdded::RETURN, expr);
 
-		g_builder.deleteScope(false);
-		return std::make_unique<FunctionDefState>(std::move(name), std::move(returnType), std::move(args), std::move(argTypes), std::move(body));
+		m_builder.deleteScope(false);
+		return m_arena.make<FunctionDefState>(m_builder, std::move(name), std::move(returnType), std::move(args), std::move(argTypes), body);
 	} else if (match(TokenType::LBRACE)) {
 		m_pos--;
-		std::unique_ptr<State> body = stateOrBlock();
+		State* body = stateOrBlock();
 
-		g_builder.deleteScope(false);
-		return std::make_unique<FunctionDefState>(std::move(name), std::move(returnType), std::move(args), std::move(argTypes), std::move(body));
+		m_builder.deleteScope(false);
+		return m_arena.make<FunctionDefState>(m_builder, std::move(name), std::move(returnType), std::move(args), std::move(argTypes), body);
 	} else {
-		g_builder.deleteScope(false);
+		m_builder.deleteScope(false);
 		return nullptr;
 	}
 }
 
-std::unique_ptr<State> Parser::variableDeclStatement() {
+State* Parser::variableDeclStatement() {
 	bool isGlobal;
 	if (match(TokenType::GLOBAL)) {
 		isGlobal = true;
@@ -220,6 +253,11 @@ std::unique_ptr<State> Parser::variableDeclStatement() {
 		isGlobal = false;
 	}
 
+	// The iterations would race on the variable otherwise
+	if (isGlobal && m_builder.isInParallelBody()) {
+		throw QString("Global variables cannot be declared within a parallel for");
+	}
+
 	Type type;
 	if (match(TokenType::POINT)) {
 		type.push_back(BasicType::POINT);
@@ -234,23 +272,21 @@ std::unique_ptr<State> Parser::variableDeclStatement() {
 	std::string alias = consume(TokenType::WORD).data;
 
 	consume(TokenType::EQ);
-	std::unique_ptr<Expr> expr = expression();
+	Expr* expr = expression();
 
-	return std::make_unique<VariableDeclState>(std::move(alias), std::move(type), isGlobal, std::move(expr));
+	return m_arena.make<VariableDeclState>(m_builder, std::move(alias), std::move(type), isGlobal, expr);
 }
 
-std::unique_ptr<State> Parser::forStatement() {
+State* Parser::forStatement(bool isParallel) {
 	std::string iterName = consume(TokenType::WORD).data;
-	g_builder.addScope(false);
-	g_builder.addVariable(iterName, Type({ BasicType::NUMBER }), false);
 
 	consume(TokenType::IN);
 	consume(TokenType::RANGE);
 
 	consume(TokenType::LPAR);
-	std::unique_ptr<Expr> toExpr = expression();
-	std::unique_ptr<Expr> fromExpr = nullptr;
-	std::unique_ptr<Expr> stepExpr = nullptr;
+	Expr* toExpr = expression();
+	Expr* fromExpr = nullptr;
+	Expr* stepExpr = nullptr;
 
 	if (match(TokenType::COMMA)) {
 		fromExpr = expression();
@@ -263,53 +299,73 @@ std::unique_ptr<State> Parser::forStatement() {
 	
 	consume(TokenType::RPAR);
 
-	std::unique_ptr<State> body = stateOrBlock();
+	// The range is evaluated before the iteration variable is created
+	m_builder.addScope(false);
+	if (isParallel) {
+		m_builder.beginParallelBody();
+	}
+
+	// The variables must be laid out as ForState lays them out, since the body's nodes compute their locations right away
+	if (!isParallel) {
+		m_builder.addVariable("$range_step", Type({ BasicType::NUMBER }), false);
+		m_builder.addVariable("$range_to", Type({ BasicType::NUMBER }), false);
+	}
+
+	m_builder.addVariable(iterName, Type({ BasicType::NUMBER }), false);
+
+	State* body = stateOrBlock();
 	
-	g_builder.deleteScope(false);
-	return std::make_unique<ForState>(std::move(iterName), std::move(fromExpr), std::move(toExpr), std::move(stepExpr), std::move(body));
+	if (isParallel) {
+		m_builder.endParallelBody();
+		m_builder.deleteScope(false);
+		return m_arena.make<ParallelForState>(std::move(iterName), fromExpr, toExpr, stepExpr, body);
+	}
+
+	m_builder.deleteScope(false);
+	return m_arena.make<ForState>(std::move(iterName), fromExpr, toExpr, stepExpr, body);
 }
 
-std::unique_ptr<State> Parser::whileStatement() {
-	std::unique_ptr<Expr> condition = expression();
-	g_builder.addScope(false);
+State* Parser::whileStatement() {
+	Expr* condition = expression();
+	m_builder.addScope(false);
 
-	std::unique_ptr<State> body = stateOrBlock();
+	State* body = stateOrBlock();
 
-	g_builder.deleteScope(false);
-	return std::make_unique<WhileState>(std::move(body), std::move(condition));
+	m_builder.deleteScope(false);
+	return m_arena.make<WhileState>(body, condition);
 }
 
-std::unique_ptr<State> Parser::ifElseStatement() {
-	std::unique_ptr<Expr> condition = expression();
-	g_builder.addScope(false);
+State* Parser::ifElseStatement() {
+	Expr* condition = expression();
+	m_builder.addScope(false);
 
-	std::unique_ptr<State> body = stateOrBlock();
-	std::unique_ptr<State> elseBody = nullptr;
+	State* body = stateOrBlock();
+	State* elseBody = nullptr;
 
-	g_builder.deleteScope(false);
+	m_builder.deleteScope(false);
 
 	if (match(TokenType::ELSE)) {
-		g_builder.addScope(false);
+		m_builder.addScope(false);
 		elseBody = stateOrBlock();
-		g_builder.deleteScope(false);
+		m_builder.deleteScope(false);
 	}
 
-	return std::make_unique<IfElseState>(std::move(condition), std::move(body), std::move(elseBody));
+	return m_arena.make<IfElseState>(condition, body, elseBody);
 }
 
-std::unique_ptr<Expr> Parser::expression() {
+Expr* Parser::expression() {
 	return logical();
 }
 
-std::unique_ptr<Expr> Parser::logical() {
-	std::unique_ptr<Expr> result = conditional();
+Expr* Parser::logical() {
+	Expr* result = conditional();
 
 	while (true) {
 		if (match(TokenType::ANDAND)) {
-			result = std::make_unique<BinaryExpr>(TokenType::ANDAND, std::move(result), conditional());
+			result = m_arena.make<BinaryExpr>(TokenType::ANDAND, result, conditional());
 			continue;
 		} if (match(TokenType::OROR)) {
-			result = std::make_unique<BinaryExpr>(TokenType::OROR, std::move(result), conditional());
+			result = m_arena.make<BinaryExpr>(TokenType::OROR, result, conditional());
 			continue;
 		}
 
@@ -319,27 +375,27 @@ std::unique_ptr<Expr> Parser::logical() {
 	return result;
 }
 
-std::unique_ptr<Expr> Parser::conditional() {
-	std::unique_ptr<Expr> result = additive();
+Expr* Parser::conditional() {
+	Expr* result = additive();
 
 	while (true) {
 		if (match(TokenType::EQEQ)) {
-			result = std::make_unique<BinaryExpr>(TokenType::EQEQ, std::move(result), additive());
+			result = m_arena.make<BinaryExpr>(TokenType::EQEQ, result, additive());
 			continue;
 		} if (match(TokenType::NOT_EQ)) {
-			result = std::make_unique<BinaryExpr>(TokenType::NOT_EQ, std::move(result), additive());
+			result = m_arena.make<BinaryExpr>(TokenType::NOT_EQ, result, additive());
 			continue;
 		} if (match(TokenType::LESS)) {
-			result = std::make_unique<BinaryExpr>(TokenType::LESS, std::move(result), additive());
+			result = m_arena.make<BinaryExpr>(TokenType::LESS, result, additive());
 			continue;
 		} if (match(TokenType::LESS_EQ)) {
-			result = std::make_unique<BinaryExpr>(TokenType::LESS_EQ, std::move(result), additive());
+			result = m_arena.make<BinaryExpr>(TokenType::LESS_EQ, result, additive());
 			continue;
 		} if (match(TokenType::GREATER)) {
-			result = std::make_unique<BinaryExpr>(TokenType::GREATER, std::move(result), additive());
+			result = m_arena.make<BinaryExpr>(TokenType::GREATER, result, additive());
 			continue;
 		} if (match(TokenType::GREATER_EQ)) {
-			result = std::make_unique<BinaryExpr>(TokenType::GREATER_EQ, std::move(result), additive());
+			result = m_arena.make<BinaryExpr>(TokenType::GREATER_EQ, result, additive());
 			continue;
 		}
 
@@ -349,15 +405,15 @@ std::unique_ptr<Expr> Parser::conditional() {
 	return result;
 }
 
-std::unique_ptr<Expr> Parser::additive() {
-	std::unique_ptr<Expr> result = multiplicative();
+Expr* Parser::additive() {
+	Expr* result = multiplicative();
 
 	while (true) {
 		if (match(TokenType::PLUS)) {
-			result = std::make_unique<BinaryExpr>(TokenType::PLUS, std::move(result), multiplicative());
+			result = m_arena.make<BinaryExpr>(TokenType::PLUS, result, multiplicative());
 			continue;
 		} if (match(TokenType::MINUS)) {
-			result = std::make_unique<BinaryExpr>(TokenType::MINUS, std::move(result), multiplicative());
+			result = m_arena.make<BinaryExpr>(TokenType::MINUS, result, multiplicative());
 			continue;
 		}
 
@@ -367,18 +423,18 @@ std::unique_ptr<Expr> Parser::additive() {
 	return result;
 }
 
-std::unique_ptr<Expr> Parser::multiplicative() {
-	std::unique_ptr<Expr> result = degree();
+Expr* Parser::multiplicative() {
+	Expr* result = degree();
 
 	while (true) {
 		if (match(TokenType::STAR)) {
-			result = std::make_unique<BinaryExpr>(TokenType::STAR, std::move(result), degree());
+			result = m_arena.make<BinaryExpr>(TokenType::STAR, result, degree());
 			continue;
 		} if (match(TokenType::SLASH)) {
-			result = std::make_unique<BinaryExpr>(TokenType::SLASH, std::move(result), degree());
+			result = m_arena.make<BinaryExpr>(TokenType::SLASH, result, degree());
 			continue;
 		} if (match(TokenType::PERCENT)) {
-			result = std::make_unique<BinaryExpr>(TokenType::PERCENT, std::move(result), degree());
+			result = m_arena.make<BinaryExpr>(TokenType::PERCENT, result, degree());
 			continue;
 		}
 
@@ -388,12 +444,12 @@ std::unique_ptr<Expr> Parser::multiplicative() {
 	return result;
 }
 
-std::unique_ptr<Expr> Parser::degree() {
-	std::unique_ptr<Expr> result = unary();
+Expr* Parser::degree() {
+	Expr* result = unary();
 
 	while (true) {
 		if (match(TokenType::DOUBLE_STAR)) {
-			result = std::make_unique<BinaryExpr>(TokenType::DOUBLE_STAR, std::move(result), unary());
+			result = m_arena.make<BinaryExpr>(TokenType::DOUBLE_STAR, result, unary());
 			continue;
 		}
 
@@ -403,12 +459,12 @@ std::unique_ptr<Expr> Parser::degree() {
 	return result;
 }
 
-std::unique_ptr<Expr> Parser::unary() {
+Expr* Parser::unary() {
 	while (true) {
 		if (match(TokenType::MINUS)) {
-			return std::make_unique<UnaryExpr>(TokenType::MINUS, unary());
+			return m_arena.make<UnaryExpr>(TokenType::MINUS, unary());
 		} if (match(TokenType::NOT)) {
-			return std::make_unique<UnaryExpr>(TokenType::NOT, unary());
+			return m_arena.make<UnaryExpr>(TokenType::NOT, unary());
 		}
 
 		break;
@@ -417,8 +473,8 @@ std::unique_ptr<Expr> Parser::unary() {
 	return postfix();
 }
 
-std::unique_ptr<Expr> Parser::postfix() {
-	std::unique_ptr<Expr> result = primary();
+Expr* Parser::postfix() {
+	Expr* result = primary();
 
 	while (match(TokenType::DOT)) { // Field access
 		consume(TokenType::WORD);
@@ -426,22 +482,22 @@ std::unique_ptr<Expr> Parser::postfix() {
 		std::string field = peek(-1).data;
 
 		if (field == "r" || field == "red") {
-			result = std::make_unique<FieldAccessExpr>(FieldAccessExpr::RED, std::move(result));
+			result = m_arena.make<FieldAccessExpr>(FieldAccessExpr::RED, result);
 			continue;
 		} if (field == "g" || field == "green") {
-			result = std::make_unique<FieldAccessExpr>(FieldAccessExpr::GREEN, std::move(result));
+			result = m_arena.make<FieldAccessExpr>(FieldAccessExpr::GREEN, result);
 			continue;
 		} if (field == "g" || field == "blue") {
-			result = std::make_unique<FieldAccessExpr>(FieldAccessExpr::BLUE, std::move(result));
+			result = m_arena.make<FieldAccessExpr>(FieldAccessExpr::BLUE, result);
 			continue;
 		} if (field == "a" || field == "alpha") {
-			result = std::make_unique<FieldAccessExpr>(FieldAccessExpr::ALPHA, std::move(result));
+			result = m_arena.make<FieldAccessExpr>(FieldAccessExpr::ALPHA, result);
 			continue;
 		} if (field == "x") {
-			result = std::make_unique<FieldAccessExpr>(FieldAccessExpr::X, std::move(result));
+			result = m_arena.make<FieldAccessExpr>(FieldAccessExpr::X, result);
 			continue;
 		} if (field == "y") {
-			result = std::make_unique<FieldAccessExpr>(FieldAccessExpr::Y, std::move(result));
+			result = m_arena.make<FieldAccessExpr>(FieldAccessExpr::Y, result);
 			continue;
 		}
 
@@ -451,27 +507,27 @@ std::unique_ptr<Expr> Parser::postfix() {
 	return result;
 }
 
-std::unique_ptr<Expr> Parser::primary() {
+Expr* Parser::primary() {
 	if (match(TokenType::LPAR)) {
-		std::unique_ptr<Expr> result = expression();
+		Expr* result = expression();
 		consume(TokenType::RPAR);
 		return result;
 	}
 
 	// Literals
 	if (match(TokenType::NUMBER_VAL)) {
-		return std::make_unique<ValueExpr>(std::stof(peek(-1).data));
+		return m_arena.make<ValueExpr>(std::stof(peek(-1).data));
 	}
 
 	// Built-ins
 	if (match(TokenType::WIDTH)) {
-		return std::make_unique<BuiltInExpr>(TokenType::WIDTH);
+		return m_arena.make<BuiltInExpr>(TokenType::WIDTH);
 	} if (match(TokenType::HEIGHT)) {
-		return std::make_unique<BuiltInExpr>(TokenType::HEIGHT);
+		return m_arena.make<BuiltInExpr>(TokenType::HEIGHT);
 	}
 
 	if (matchRange(TokenType::ABS, TokenType::DISTANCE) || match(TokenType::COLOR) || match(TokenType::POINT)) {
-		std::vector<std::unique_ptr<Expr>> args;
+		std::vector<Expr*> args;
 		TokenType op = peek(-1).type;
 
 		consume(TokenType::LPAR);
@@ -483,7 +539,7 @@ std::unique_ptr<Expr> Parser::primary() {
 			consume(TokenType::RPAR);
 		}
 
-		return std::make_unique<BuiltInExpr>(op, std::move(args));
+		return m_arena.make<BuiltInExpr>(op, m_arena.makeArray(args));
 	}
 
 	// Identifier
@@ -491,7 +547,7 @@ std::unique_ptr<Expr> Parser::primary() {
 		std::string name = peek(-1).data;
 
 		if (match(TokenType::LPAR)) { // Function call
-			std::vector<std::unique_ptr<Expr>> args;
+			std::vector<Expr*> args;
 
 			if (!match(TokenType::RPAR)) {
 				do {
@@ -501,9 +557,9 @@ std::unique_ptr<Expr> Parser::primary() {
 				consume(TokenType::RPAR);
 			}
 
-			return std::make_unique<FunctionCallExpr>(name, std::move(args));
+			return m_arena.make<FunctionCallExpr>(m_builder, name, m_arena.makeArray(args));
 		} else { // Variable
-			return std::make_unique<VariableExpr>(name);
+			return m_arena.make<VariableExpr>(m_builder, name);
 		}
 	}
 
@@ -1,42 +1,47 @@
 #pragma once
-#include <memory>
 #include <QList>
 #include "../../Utils/Result.h"
+#include "../../Utils/Arena.h"
 #include "Token.h"
+#include "ByteCodeBuilder.h"
 #include "ast/State.h"
 #include "ast/Expr.h"
 
 // Parser a list of tokens into an Abstact Syntax Tree
+// All the nodes are allocated within the arena, so the tree lives as long as the arena does
+// Variables and functions are registered within the program's builder
 class Parser final {
 protected:
 	QList<Token> m_toks;
 	size_t m_pos = 0;
 
+	utils::Arena& m_arena;
+	ByteCodeBuilder& m_builder;
+
 public:
-	Parser(QList<Token> tokens);
+	Parser(QList<Token> tokens, utils::Arena& arena, ByteCodeBuilder& builder);
 
-	// std::vector is used instead of QList because QList cannot handle unique_ptr
-	utils::Result<std::vector<std::unique_ptr<State>>> parse();
+	utils::Result<QList<State*>> parse();
 
 private:
 	// Parsing the tokens by recursive descent
-	std::unique_ptr<State> stateOrBlock(bool isHighLevel = false);
-	std::unique_ptr<State> statement(bool isHighLevel = false);
-	std::unique_ptr<State> functionDefStatement();
-	std::unique_ptr<State> variableDeclStatement();
-	std::unique_ptr<State> forStatement();
-	std::unique_ptr<State> whileStatement();
-	std::unique_ptr<State> ifElseStatement();
-
-	std::unique_ptr<Expr> expression();
-	std::unique_ptr<Expr> logical();
-	std::unique_ptr<Expr> conditional();
-	std::unique_ptr<Expr> additive();
-	std::unique_ptr<Expr> multiplicative();
-	std::unique_ptr<Expr> degree();
-	std::unique_ptr<Expr> unary();
-	std::unique_ptr<Expr> postfix();
-	std::unique_ptr<Expr> primary();
+	State* stateOrBlock(bool isHighLevel = false);
+	State* statement(bool isHighLevel = false);
+	State* functionDefStatement();
+	State* variableDeclStatement();
+	State* forStatement(bool isParallel = false);
+	State* whileStatement();
+	State* ifElseStatement();
+
+	Expr* expression();
+	Expr* logical();
+	Expr* conditional();
+	Expr* additive();
+	Expr* multiplicative();
+	Expr* degree();
+	Expr* unary();
+	Expr* postfix();
+	Expr* primary();
 
 private:
 	Token& consume(TokenType type);
@@ -57,6 +57,7 @@ enum class TokenType : uint8_t {
 	ELSE,
 	WHILE,
 	FOR, // for -name- in range(-from: number-, -to: number-, -step: number-) ...
+	PARALLEL, // parallel for ..., the iterations are independent and run on several threads
 
 	CONTINUE,
 	BREAK,
@@ -85,9 +86,20 @@ enum class TokenType : uint8_t {
 
 	FILL_RECT, // fill_rect -from: point-, -to: point-
 	FILL_CIRCLE, // fill_circle -center: point-, -radius: number-
+	FILL_POLYGON, // fill_polygon -p1: point-, -p2: point-, -p3: point-, ..., the parts the polygon winds around are filled (non-zero rule)
+	FILL_POLYGON_EVEN_ODD, // fill_polygon_evenodd -p1: point-, -p2: point-, -p3: point-, ..., the parts within an odd number of edges are filled
+
+	// Bulk image functions, process the whole current image at once
+	FILL_IMAGE, // fill_image, fills the image with the current color
+	BLEND_IMAGE, // blend_image, blends the current color over the image
+	INVERT_IMAGE, // invert_image
+	THRESHOLD_IMAGE, // threshold_image -level: number-
+	MULTIPLY_IMAGE, // multiply_image -factors: color-, multiplies each channel by the according factor
+	COPY_RECT, // copy_rect -from: constant number-, -pos: point-, -size: point-, copies a rect of an image buffer to the current image
 
 	// System functions
 	SLEEP, // sleep -millisecond: number-
+	FRAME_RATE, // frame_rate -frames per second: number-, from then on update waits for the next frame's tick (0 to stop it)
 
 	// Built-in variables
 	WIDTH,
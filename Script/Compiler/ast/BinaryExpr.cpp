@@ -1,8 +1,8 @@
 #include "BinaryExpr.h"
 #include "../ByteCodeBuilder.h"
 
-BinaryExpr::BinaryExpr(TokenType op, std::unique_ptr<Expr> left, std::unique_ptr<Expr> right)
-	: Expr(getCommonType(left->getType(), right->getType())), m_op(op), m_left(std::move(left)), m_right(std::move(right)) {
+BinaryExpr::BinaryExpr(TokenType op, Expr* left, Expr* right)
+	: Expr(getCommonType(left->getType(), right->getType())), m_op(op), m_left(left), m_right(right) {
 	if (op == TokenType::EQEQ || op == TokenType::NOT_EQ || op == TokenType::LESS
 		|| op == TokenType::GREATER || op == TokenType::LESS_EQ || op == TokenType::GREATER_EQ) {
 		if (m_left->getType() != m_right->getType()) {
@@ -21,27 +21,27 @@ BinaryExpr::BinaryExpr(TokenType op, std::unique_ptr<Expr> left, std::unique_ptr
 	}
 }
 
-void BinaryExpr::generate() {
+void BinaryExpr::generate(ByteCodeBuilder& builder) {
 	switch (m_op) {
 		case TokenType::PLUS:
 			if (m_left->getType() == m_right->getType()) {
-				m_left->generate();
-				m_right->generate();
-				g_builder.addInst(Instruction(getAccordingToType(InstructionType::ADD, (uint8_t)m_left->getType()[0])));
+				m_left->generate(builder);
+				m_right->generate(builder);
+				builder.addInst(Instruction(getAccordingToType(InstructionType::ADD, (uint8_t)m_left->getType()[0])));
 			} else {
 				if (m_left->getType()[0] == BasicType::NUMBER) {
-					m_right->generate();
-					m_left->generate();
-					g_builder.addInst(Instruction(
+					m_right->generate(builder);
+					m_left->generate(builder);
+					builder.addInst(Instruction(
 						getAccordingToType(
 							InstructionType((int)InstructionType::ADD_TO_POINT - 1), 
 							(uint8_t)m_right->getType()[0]
 						)
 					));
 				} else if (m_right->getType()[0] == BasicType::NUMBER) {
-					m_left->generate();
-					m_right->generate();
-					g_builder.addInst(Instruction(
+					m_left->generate(builder);
+					m_right->generate(builder);
+					builder.addInst(Instruction(
 						getAccordingToType(
 							InstructionType((int)InstructionType::ADD_TO_POINT - 1),
 							(uint8_t)m_left->getType()[0]
@@ -53,14 +53,14 @@ void BinaryExpr::generate() {
 			} break;
 		case TokenType::MINUS:
 			if (m_left->getType() == m_right->getType()) {
-				m_left->generate();
-				m_right->generate();
-				g_builder.addInst(Instruction(getAccordingToType(InstructionType::SUB, (uint8_t)m_left->getType()[0])));
+				m_left->generate(builder);
+				m_right->generate(builder);
+				builder.addInst(Instruction(getAccordingToType(InstructionType::SUB, (uint8_t)m_left->getType()[0])));
 			} else {
 				if (m_right->getType()[0] == BasicType::NUMBER) {
-					m_left->generate();
-					m_right->generate();
-					g_builder.addInst(Instruction(
+					m_left->generate(builder);
+					m_right->generate(builder);
+					builder.addInst(Instruction(
 						getAccordingToType(
 							InstructionType((int)InstructionType::SUB_FROM_POINT - 1),
 							(uint8_t)m_left->getType()[0]
@@ -72,18 +72,18 @@ void BinaryExpr::generate() {
 			} break;
 		case TokenType::STAR:
 			if (m_left->getType()[0] == BasicType::NUMBER) {
-				m_right->generate();
-				m_left->generate();
-				g_builder.addInst(Instruction(
+				m_right->generate(builder);
+				m_left->generate(builder);
+				builder.addInst(Instruction(
 					getAccordingToType(
 						InstructionType::MUL,
 						(uint8_t)m_right->getType()[0]
 					)
 				));
 			} else if (m_right->getType()[0] == BasicType::NUMBER) {
-				m_left->generate();
-				m_right->generate();
-				g_builder.addInst(Instruction(
+				m_left->generate(builder);
+				m_right->generate(builder);
+				builder.addInst(Instruction(
 					getAccordingToType(
 						InstructionType::MUL,
 						(uint8_t)m_left->getType()[0]
@@ -94,9 +94,9 @@ void BinaryExpr::generate() {
 			} break;
 		case TokenType::SLASH:
 			if (m_right->getType()[0] == BasicType::NUMBER) {
-				m_left->generate();
-				m_right->generate();
-				g_builder.addInst(Instruction(
+				m_left->generate(builder);
+				m_right->generate(builder);
+				builder.addInst(Instruction(
 					getAccordingToType(
 						InstructionType::DIV,
 						(uint8_t)m_left->getType()[0]
@@ -107,9 +107,9 @@ void BinaryExpr::generate() {
 			} break;
 		case TokenType::PERCENT:
 			if (m_right->getType()[0] == BasicType::NUMBER) {
-				m_left->generate();
-				m_right->generate();
-				g_builder.addInst(Instruction(
+				m_left->generate(builder);
+				m_right->generate(builder);
+				builder.addInst(Instruction(
 					getAccordingToType(
 						InstructionType::MOD,
 						(uint8_t)m_left->getType()[0]
@@ -120,9 +120,9 @@ void BinaryExpr::generate() {
 			} break;
 		case TokenType::DOUBLE_STAR:
 			if (m_right->getType()[0] == BasicType::NUMBER) {
-				m_left->generate();
-				m_right->generate();
-				g_builder.addInst(Instruction(
+				m_left->generate(builder);
+				m_right->generate(builder);
+				builder.addInst(Instruction(
 					getAccordingToType(
 						InstructionType::POW,
 						(uint8_t)m_left->getType()[0]
@@ -134,50 +134,50 @@ void BinaryExpr::generate() {
 
 		// For the next ones types are already verified
 		case TokenType::EQEQ:
-			m_left->generate();
-			m_right->generate();
-			g_builder.addInst(Instruction(getAccordingToType(
+			m_left->generate(builder);
+			m_right->generate(builder);
+			builder.addInst(Instruction(getAccordingToType(
 				InstructionType::CMP_EQ,
 				(uint8_t)m_right->getType()[0]
 			)));
 			break;
 		case TokenType::NOT_EQ:
-			m_left->generate();
-			m_right->generate();
-			g_builder.addInst(Instruction(getAccordingToType(
+			m_left->generate(builder);
+			m_right->generate(builder);
+			builder.addInst(Instruction(getAccordingToType(
 				InstructionType::CMP_NEQ,
 				(uint8_t)m_right->getType()[0]
 			)));
 			break;
 		case TokenType::LESS:
-			m_left->generate();
-			m_right->generate();
-			g_builder.addInst(Instruction(InstructionType::CMP_LT));
+			m_left->generate(builder);
+			m_right->generate(builder);
+			builder.addInst(Instruction(InstructionType::CMP_LT));
 			break;
 		case TokenType::GREATER:
-			m_left->generate();
-			m_right->generate();
-			g_builder.addInst(Instruction(InstructionType::CMP_GT));
+			m_left->generate(builder);
+			m_right->generate(builder);
+			builder.addInst(Instruction(InstructionType::CMP_GT));
 			break;
 		case TokenType::LESS_EQ:
-			m_left->generate();
-			m_right->generate();
-			g_builder.addInst(Instruction(InstructionType::CMP_LE));
+			m_left->generate(builder);
+			m_right->generate(builder);
+			builder.addInst(Instruction(InstructionType::CMP_LE));
 			break;
 		case TokenType::GREATER_EQ:
-			m_left->generate();
-			m_right->generate();
-			g_builder.addInst(Instruction(InstructionType::CMP_GE));
+			m_left->generate(builder);
+			m_right->generate(builder);
+			builder.addInst(Instruction(InstructionType::CMP_GE));
 			break;
 		case TokenType::ANDAND:
-			m_left->generate();
-			m_right->generate();
-			g_builder.addInst(Instruction(InstructionType::AND));
+			m_left->generate(builder);
+			m_right->generate(builder);
+			builder.addInst(Instruction(InstructionType::AND));
 			break;
 		case TokenType::OROR:
-			m_left->generate();
-			m_right->generate();
-			g_builder.addInst(Instruction(InstructionType::OR));
+			m_left->generate(builder);
+			m_right->generate(builder);
+			builder.addInst(Instruction(InstructionType::OR));
 			break;
 	default: throw QString("Not a binary operator");
 	}
@@ -5,14 +5,14 @@
 // Binary expression (an operator with 2 operands)
 class BinaryExpr final : public Expr {
 private:
-	std::unique_ptr<Expr> m_left;
-	std::unique_ptr<Expr> m_right;
+	Expr* m_left;
+	Expr* m_right;
 	TokenType m_op;
 
 public:
-	BinaryExpr(TokenType op, std::unique_ptr<Expr> left, std::unique_ptr<Expr> right);
+	BinaryExpr(TokenType op, Expr* left, Expr* right);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 
 	bool isLVal() override;
 };
\ No newline at end of file
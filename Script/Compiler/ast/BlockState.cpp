@@ -1,22 +1,22 @@
 #include "BlockState.h"
 #include "../ByteCodeBuilder.h"
 
-BlockState::BlockState(std::vector<std::unique_ptr<State>> states)
-	: m_states(std::move(states)) {
+BlockState::BlockState(utils::ArenaArray<State*> states)
+	: m_states(states) {
 
 }
 
-void BlockState::generate() {
-	g_builder.addScope(true);
+void BlockState::generate(ByteCodeBuilder& builder) {
+	builder.addScope(true);
 
 	try {
 		for (auto& state : m_states) {
-			state->generate();
+			state->generate(builder);
 		}
 
-		g_builder.deleteScope(true);
+		builder.deleteScope(true);
 	} catch (TerminatorAdded terminator) {
-		g_builder.deleteScope(true);
+		builder.deleteScope(true);
 		throw terminator;
 	}
 }
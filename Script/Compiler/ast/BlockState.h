@@ -1,15 +1,14 @@
 #pragma once
-#include <vector>
-#include <memory>
 #include "State.h"
+#include "../../../Utils/Arena.h"
 
 // Statement for built-in instructions
 class BlockState final : public State {
 private:
-	std::vector<std::unique_ptr<State>> m_states;
+	utils::ArenaArray<State*> m_states;
 
 public:
-	BlockState(std::vector<std::unique_ptr<State>> states);
+	BlockState(utils::ArenaArray<State*> states);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 };
\ No newline at end of file
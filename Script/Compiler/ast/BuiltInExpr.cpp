@@ -2,12 +2,12 @@
 #include "../ByteCodeBuilder.h"
 
 BuiltInExpr::BuiltInExpr(TokenType op)
-	: BuiltInExpr(op, std::vector<std::unique_ptr<Expr>>()) {
+	: BuiltInExpr(op, utils::ArenaArray<Expr*>()) {
 
 }
 
-BuiltInExpr::BuiltInExpr(TokenType op, std::vector<std::unique_ptr<Expr>> args)
-    : m_op(op), m_args(std::move(args)) {
+BuiltInExpr::BuiltInExpr(TokenType op, utils::ArenaArray<Expr*> args)
+    : m_op(op), m_args(args) {
 	switch (m_op) {
 	case TokenType::COLOR:
 		if (m_args.size() != 4 || m_args[0]->getType() != BasicType::NUMBER || m_args[1]->getType() != BasicType::NUMBER
@@ -165,9 +165,9 @@ BuiltInExpr::BuiltInExpr(TokenType op, std::vector<std::unique_ptr<Expr>> args)
 	}
 }
 
-void BuiltInExpr::generate() {
+void BuiltInExpr::generate(ByteCodeBuilder& builder) {
 	for (auto& arg : m_args) {
-		arg->generate();
+		arg->generate(builder);
 	}
 
 	switch (m_op) {
@@ -176,55 +176,55 @@ void BuiltInExpr::generate() {
 	case TokenType::POINT: // Actually does nothing, just a type conversion
 		break;
 	case TokenType::WIDTH:
-		g_builder.addInst(Instruction(InstructionType::PUSH_WIDTH));
+		builder.addInst(Instruction(InstructionType::PUSH_WIDTH));
 		break;
 	case TokenType::HEIGHT:
-		g_builder.addInst(Instruction(InstructionType::PUSH_HEIGHT));
+		builder.addInst(Instruction(InstructionType::PUSH_HEIGHT));
 		break;
 	case TokenType::ABS:
-		g_builder.addInst(Instruction(InstructionType::ABS));
+		builder.addInst(Instruction(InstructionType::ABS));
 		break;
 	case TokenType::MIN:
-		g_builder.addInst(Instruction(InstructionType::MIN, uint32_t(m_args.size())));
+		builder.addInst(Instruction(InstructionType::MIN, uint32_t(m_args.size())));
 		break;
 	case TokenType::MAX:
-		g_builder.addInst(Instruction(InstructionType::MAX, uint32_t(m_args.size())));
+		builder.addInst(Instruction(InstructionType::MAX, uint32_t(m_args.size())));
 		break;
 	case TokenType::SUM:
-		g_builder.addInst(Instruction(InstructionType::SUM, uint32_t(m_args.size())));
+		builder.addInst(Instruction(InstructionType::SUM, uint32_t(m_args.size())));
 		break;
 	case TokenType::ROUND:
-		g_builder.addInst(Instruction(InstructionType::ROUND));
+		builder.addInst(Instruction(InstructionType::ROUND));
 		break;
 	case TokenType::FLOOR:
-		g_builder.addInst(Instruction(InstructionType::FLOOR));
+		builder.addInst(Instruction(InstructionType::FLOOR));
 		break;
 	case TokenType::CEIL:
-		g_builder.addInst(Instruction(InstructionType::CEIL));
+		builder.addInst(Instruction(InstructionType::CEIL));
 		break;
 	case TokenType::SIN:
-		g_builder.addInst(Instruction(InstructionType::SIN));
+		builder.addInst(Instruction(InstructionType::SIN));
 		break;
 	case TokenType::COS:
-		g_builder.addInst(Instruction(InstructionType::COS));
+		builder.addInst(Instruction(InstructionType::COS));
 		break;
 	case TokenType::TAN:
-		g_builder.addInst(Instruction(InstructionType::TAN));
+		builder.addInst(Instruction(InstructionType::TAN));
 		break;
 	case TokenType::COT:
-		g_builder.addInst(Instruction(InstructionType::COT));
+		builder.addInst(Instruction(InstructionType::COT));
 		break;
 	case TokenType::EXP:
-		g_builder.addInst(Instruction(InstructionType::EXP));
+		builder.addInst(Instruction(InstructionType::EXP));
 		break;
 	case TokenType::LOG:
-		g_builder.addInst(Instruction(InstructionType::LOG));
+		builder.addInst(Instruction(InstructionType::LOG));
 		break;
 	case TokenType::LENGTH:
-		g_builder.addInst(Instruction(InstructionType::LENGTH));
+		builder.addInst(Instruction(InstructionType::LENGTH));
 		break;
 	case TokenType::DISTANCE:
-		g_builder.addInst(Instruction(InstructionType::DISTANCE));
+		builder.addInst(Instruction(InstructionType::DISTANCE));
 		break;
 	default: throw QString("Not a built-in expression's token");
 	}
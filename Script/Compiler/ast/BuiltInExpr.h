@@ -1,18 +1,19 @@
 #pragma once
 #include "Expr.h"
+#include "../../../Utils/Arena.h"
 #include "../Token.h"
 
 // Built-in expression (a constant or built-in function)
 class BuiltInExpr final : public Expr {
 private:
-	std::vector<std::unique_ptr<Expr>> m_args;
+	utils::ArenaArray<Expr*> m_args;
 	TokenType m_op;
 
 public:
 	BuiltInExpr(TokenType op);
-	BuiltInExpr(TokenType op, std::vector<std::unique_ptr<Expr>> args);
+	BuiltInExpr(TokenType op, utils::ArenaArray<Expr*> args);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 
 	bool isLVal() override;
 };
\ No newline at end of file
@@ -1,15 +1,16 @@
 #include "BuiltInState.h"
 #include "ValueExpr.h"
 #include "../ByteCodeBuilder.h"
+#include "../../../Utils/Rasterization.h"
 
-BuiltInState::BuiltInState(TokenType op, std::vector<std::unique_ptr<Expr>> args)
-	: m_op(op), m_args(std::move(args)) {
+BuiltInState::BuiltInState(TokenType op, utils::ArenaArray<Expr*> args)
+	: m_op(op), m_args(args) {
 	switch (m_op) {
 		case TokenType::SET_IMAGE:
 			if (m_args.size() != 1 || !m_args[0]->isConstNumber()) {
 				throw QString("Set_image takes one const number argument");
 			} else {
-				float val = ((ValueExpr*)m_args[0].get())->getConstNumber();
+				float val = ((ValueExpr*)m_args[0])->getConstNumber();
 				if (val != floor(val)) {
 					throw QString("Set_image's argument must be a whole number!");
 				}
@@ -26,8 +27,8 @@ BuiltInState::BuiltInState(TokenType op, std::vector<std::unique_ptr<Expr>> args
 			if (m_args.size() != 2 || !m_args[0]->isConstNumber() || !m_args[1]->isConstNumber()) {
 				throw QString("Copy_image takes 2 const number arguments");
 			} else {
-				float val1 = ((ValueExpr*)m_args[0].get())->getConstNumber();
-				float val2 = ((ValueExpr*)m_args[1].get())->getConstNumber();
+				float val1 = ((ValueExpr*)m_args[0])->getConstNumber();
+				float val2 = ((ValueExpr*)m_args[1])->getConstNumber();
 				if (val1 != floor(val1) || val2 != floor(val2)) {
 					throw QString("Copy_image's arguments must be whole numbers!");
 				}
@@ -65,63 +66,132 @@ BuiltInState::BuiltInState(TokenType op, std::vector<std::unique_ptr<Expr>> args
 			if (m_args.size() != 2 || m_args[0]->getType() != BasicType::POINT || m_args[1]->getType() != BasicType::NUMBER) {
 				throw QString("Fill_circle takes a point and a number");
 			} break;
+		case TokenType::FILL_POLYGON:
+		case TokenType::FILL_POLYGON_EVEN_ODD:
+			if (m_args.size() < 3) {
+				throw QString("Fill_polygon takes at least 3 points");
+			}
+
+			for (auto& arg : m_args) {
+				if (arg->getType() != BasicType::POINT) {
+					throw QString("Fill_polygon takes only points");
+				}
+			} break;
+		case TokenType::FILL_IMAGE:
+		case TokenType::BLEND_IMAGE:
+		case TokenType::INVERT_IMAGE:
+			if (m_args.size() != 0) {
+				throw QString("Fill_image, blend_image and invert_image have no arguments");
+			} break;
+		case TokenType::THRESHOLD_IMAGE:
+			if (m_args.size() != 1 || m_args[0]->getType() != BasicType::NUMBER) {
+				throw QString("Threshold_image takes a single number argument");
+			} break;
+		case TokenType::MULTIPLY_IMAGE:
+			if (m_args.size() != 1 || m_args[0]->getType() != BasicType::COLOR) {
+				throw QString("Multiply_image takes a single color argument");
+			} break;
+		case TokenType::COPY_RECT:
+			if (m_args.size() != 3 || !m_args[0]->isConstNumber()
+				|| m_args[1]->getType() != BasicType::POINT || m_args[2]->getType() != BasicType::POINT) {
+				throw QString("Copy_rect takes a const number and 2 points");
+			} else {
+				float val = ((ValueExpr*)m_args[0])->getConstNumber();
+				if (val != floor(val)) {
+					throw QString("Copy_rect's first argument must be a whole number!");
+				}
+			} break;
 		case TokenType::SLEEP:
 			if (m_args.size() != 1 || m_args[0]->getType() != BasicType::NUMBER) {
 				throw QString("Sleep takes a single number argument");
 			} break;
+		case TokenType::FRAME_RATE:
+			if (m_args.size() != 1 || m_args[0]->getType() != BasicType::NUMBER) {
+				throw QString("Frame_rate takes a single number argument");
+			} break;
 	default: throw QString("Not a built-in statement");
 	}
 }
 
-void BuiltInState::generate() {
+void BuiltInState::generate(ByteCodeBuilder& builder) {
 	if (m_op == TokenType::SET_IMAGE) {
-		uint32_t val = (uint32_t)((ValueExpr*)m_args[0].get())->getConstNumber();
-		g_builder.addInst(Instruction(InstructionType::SET_IMAGE, val));
+		uint32_t val = (uint32_t)((ValueExpr*)m_args[0])->getConstNumber();
+		builder.addInst(Instruction(InstructionType::SET_IMAGE, val));
 		return;
 	} if (m_op == TokenType::COPY_IMAGE) {
-		uint32_t val1 = (uint32_t)((ValueExpr*)m_args[0].get())->getConstNumber();
-		uint32_t val2 = (uint32_t)((ValueExpr*)m_args[1].get())->getConstNumber();
-		g_builder.addInst(Instruction(InstructionType::COPY_IMAGE, val1, val2));
+		uint32_t val1 = (uint32_t)((ValueExpr*)m_args[0])->getConstNumber();
+		uint32_t val2 = (uint32_t)((ValueExpr*)m_args[1])->getConstNumber();
+		builder.addInst(Instruction(InstructionType::COPY_IMAGE, val1, val2));
+		return;
+	} if (m_op == TokenType::COPY_RECT) {
+		uint32_t val = (uint32_t)((ValueExpr*)m_args[0])->getConstNumber();
+		m_args[1]->generate(builder);
+		m_args[2]->generate(builder);
+		builder.addInst(Instruction(InstructionType::COPY_RECT, val));
 		return;
 	}
 
 	for (auto& arg : m_args) {
-		arg->generate();
+		arg->generate(builder);
 	}
 
 	switch (m_op) {
 		case TokenType::SET_COLOR:
-			g_builder.addInst(Instruction(InstructionType::SET_COLOR));
+			builder.addInst(Instruction(InstructionType::SET_COLOR));
 			break;
 		case TokenType::SET_WIDTH:
-			g_builder.addInst(Instruction(InstructionType::SET_WIDTH));
+			builder.addInst(Instruction(InstructionType::SET_WIDTH));
 			break;
 		case TokenType::UPDATE:
-			g_builder.addInst(Instruction(InstructionType::UPDATE));
+			builder.addInst(Instruction(InstructionType::UPDATE));
 			break;
 		case TokenType::DRAW_PIX:
-			g_builder.addInst(Instruction(InstructionType::DRAW_PIX));
+			builder.addInst(Instruction(InstructionType::DRAW_PIX));
 			break;
 		case TokenType::DRAW_STROKE:
-			g_builder.addInst(Instruction(InstructionType::DRAW_STROKE));
+			builder.addInst(Instruction(InstructionType::DRAW_STROKE));
 			break;
 		case TokenType::DRAW_LINE:
-			g_builder.addInst(Instruction(InstructionType::DRAW_LINE));
+			builder.addInst(Instruction(InstructionType::DRAW_LINE));
 			break;
 		case TokenType::DRAW_RECT:
-			g_builder.addInst(Instruction(InstructionType::DRAW_RECT));
+			builder.addInst(Instruction(InstructionType::DRAW_RECT));
 			break;
 		case TokenType::DRAW_CIRCLE:
-			g_builder.addInst(Instruction(InstructionType::DRAW_CIRCLE));
+			builder.addInst(Instruction(InstructionType::DRAW_CIRCLE));
 			break;
 		case TokenType::FILL_RECT:
-			g_builder.addInst(Instruction(InstructionType::FILL_RECT));
+			builder.addInst(Instruction(InstructionType::FILL_RECT));
 			break;
 		case TokenType::FILL_CIRCLE:
-			g_builder.addInst(Instruction(InstructionType::FILL_CIRCLE));
+			builder.addInst(Instruction(InstructionType::FILL_CIRCLE));
+			break;
+		case TokenType::FILL_POLYGON:
+			builder.addInst(Instruction(InstructionType::FILL_POLYGON, uint32_t(m_args.size()), uint32_t(utils::FillRule::NON_ZERO)));
+			break;
+		case TokenType::FILL_POLYGON_EVEN_ODD:
+			builder.addInst(Instruction(InstructionType::FILL_POLYGON, uint32_t(m_args.size()), uint32_t(utils::FillRule::EVEN_ODD)));
+			break;
+		case TokenType::FILL_IMAGE:
+			builder.addInst(Instruction(InstructionType::FILL_IMAGE));
+			break;
+		case TokenType::BLEND_IMAGE:
+			builder.addInst(Instruction(InstructionType::BLEND_IMAGE));
+			break;
+		case TokenType::INVERT_IMAGE:
+			builder.addInst(Instruction(InstructionType::INVERT_IMAGE));
+			break;
+		case TokenType::THRESHOLD_IMAGE:
+			builder.addInst(Instruction(InstructionType::THRESHOLD_IMAGE));
+			break;
+		case TokenType::MULTIPLY_IMAGE:
+			builder.addInst(Instruction(InstructionType::MULTIPLY_IMAGE));
 			break;
 		case TokenType::SLEEP:
-			g_builder.addInst(Instruction(InstructionType::SLEEP));
+			builder.addInst(Instruction(InstructionType::SLEEP));
+			break;
+		case TokenType::FRAME_RATE:
+			builder.addInst(Instruction(InstructionType::SET_FRAME_RATE));
 			break;
 	default: throw QString("Not a built-in statement");
 	}
@@ -1,16 +1,17 @@
 #pragma once
 #include "State.h"
 #include "Expr.h"
+#include "../../../Utils/Arena.h"
 #include "../Token.h"
 
 // Statement for built-in instructions
 class BuiltInState final : public State {
 private:
-	std::vector<std::unique_ptr<Expr>> m_args;
+	utils::ArenaArray<Expr*> m_args;
 	TokenType m_op;
 
 public:
-	BuiltInState(TokenType op, std::vector<std::unique_ptr<Expr>> args);
+	BuiltInState(TokenType op, utils::ArenaArray<Expr*> args);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 };
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 #include "Type.h"
 
+class ByteCodeBuilder;
+
 // Basic class for all expressions
+// Expressions are allocated within the parser's arena and are destroyed together with it
 class Expr {
 protected:
 	Type m_type;
@@ -11,9 +14,9 @@ public:
 
 	Expr(Type type);
 
-	// Translates the expression into a set of instructions stored in a global state
+	// Translates the expression into a set of instructions stored in the builder
 	// It is guaranteed that the set of instructions would leave a new value on the stack according to expression's type
-	virtual void generate() = 0;
+	virtual void generate(ByteCodeBuilder& builder) = 0;
 
 	// If it is an LValue
 	virtual bool isLVal() = 0;
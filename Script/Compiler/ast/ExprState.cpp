@@ -1,15 +1,15 @@
 #include "ExprState.h"
 #include "../ByteCodeBuilder.h"
 
-ExprState::ExprState(std::unique_ptr<Expr> expr)
-	: m_expr(std::move(expr)) {
+ExprState::ExprState(Expr* expr)
+	: m_expr(expr) {
 
 }
 
-void ExprState::generate() {
-	m_expr->generate();
+void ExprState::generate(ByteCodeBuilder& builder) {
+	m_expr->generate(builder);
 
 	for (auto type : m_expr->getType()) {
-		g_builder.addInst(Instruction(getAccordingToType(InstructionType::POP, uint8_t(type))));
+		builder.addInst(Instruction(getAccordingToType(InstructionType::POP, uint8_t(type))));
 	}
 }
@@ -6,10 +6,10 @@
 // Executes the expression and clears the stack after it
 class ExprState final : public State {
 private:
-	std::unique_ptr<Expr> m_expr;
+	Expr* m_expr;
 
 public:
-	ExprState(std::unique_ptr<Expr> expr);
+	ExprState(Expr* expr);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 };
\ No newline at end of file
@@ -1,8 +1,8 @@
 #include "FieldAccessExpr.h"
 #include "../ByteCodeBuilder.h"
 
-FieldAccessExpr::FieldAccessExpr(Field field, std::unique_ptr<Expr> expr)
-	: m_field(field), m_expr(std::move(expr)) {
+FieldAccessExpr::FieldAccessExpr(Field field, Expr* expr)
+	: m_field(field), m_expr(expr) {
 	BasicType exprType = m_expr->getType()[0];
 	if (field == Field::RED || field == Field::GREEN || field == Field::BLUE || field == Field::ALPHA) {
 		if (exprType != BasicType::COLOR) {
@@ -17,27 +17,27 @@ FieldAccessExpr::FieldAccessExpr(Field field, std::unique_ptr<Expr> expr)
 	m_type = Type({ BasicType::NUMBER });
 }
 
-void FieldAccessExpr::generate() {
-	m_expr->generate();
+void FieldAccessExpr::generate(ByteCodeBuilder& builder) {
+	m_expr->generate(builder);
 
 	switch (m_field) {
 	case FieldAccessExpr::RED:
-		g_builder.addInst(Instruction(InstructionType::GET_COLOR_RED));
+		builder.addInst(Instruction(InstructionType::GET_COLOR_RED));
 		break;
 	case FieldAccessExpr::GREEN:
-		g_builder.addInst(Instruction(InstructionType::GET_COLOR_GREEN));
+		builder.addInst(Instruction(InstructionType::GET_COLOR_GREEN));
 		break;
 	case FieldAccessExpr::BLUE:
-		g_builder.addInst(Instruction(InstructionType::GET_COLOR_BLUE));
+		builder.addInst(Instruction(InstructionType::GET_COLOR_BLUE));
 		break;
 	case FieldAccessExpr::ALPHA:
-		g_builder.addInst(Instruction(InstructionType::GET_COLOR_ALPHA));
+		builder.addInst(Instruction(InstructionType::GET_COLOR_ALPHA));
 		break;
 	case FieldAccessExpr::X:
-		g_builder.addInst(Instruction(InstructionType::GET_POINT_X));
+		builder.addInst(Instruction(InstructionType::GET_POINT_X));
 		break;
 	case FieldAccessExpr::Y:
-		g_builder.addInst(Instruction(InstructionType::GET_POINT_Y));
+		builder.addInst(Instruction(InstructionType::GET_POINT_Y));
 		break;
 	default:
 		break;
@@ -15,13 +15,13 @@ public:
 	};
 
 private:
-	std::unique_ptr<Expr> m_expr;
+	Expr* m_expr;
 	Field m_field;
 
 public:
-	FieldAccessExpr(Field field, std::unique_ptr<Expr> expr);
+	FieldAccessExpr(Field field, Expr* expr);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 
 	bool isLVal() override;
 };
\ No newline at end of file
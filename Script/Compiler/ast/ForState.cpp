@@ -3,16 +3,16 @@
 
 ForState::ForState(
 	std::string iterName,
-	std::unique_ptr<Expr> rangeFromExpr,
-	std::unique_ptr<Expr> rangeToExpr,
-	std::unique_ptr<Expr> rangeStepExpr,
-	std::unique_ptr<State> body
+	Expr* rangeFromExpr,
+	Expr* rangeToExpr,
+	Expr* rangeStepExpr,
+	State* body
 ) :
 	m_iterName(std::move(iterName)),
-	m_rangeFromExpr(std::move(rangeFromExpr)),
-	m_rangeToExpr(std::move(rangeToExpr)),
-	m_rangeStepExpr(std::move(rangeStepExpr)),
-	m_body(std::move(body))
+	m_rangeFromExpr(rangeFromExpr),
+	m_rangeToExpr(rangeToExpr),
+	m_rangeStepExpr(rangeStepExpr),
+	m_body(body)
 {
 	if (!m_rangeToExpr || m_rangeToExpr->getType() != BasicType::NUMBER
 		|| (m_rangeFromExpr && (m_rangeFromExpr->getType() != BasicType::NUMBER
@@ -21,74 +21,74 @@ ForState::ForState(
 	}
 }
 
-void ForState::generate() {
-	size_t onConditionFalseLabel = g_builder.getLabel();
-	g_builder.addScope(false);
+void ForState::generate(ByteCodeBuilder& builder) {
+	size_t onConditionFalseLabel = builder.getLabel();
+	builder.addScope(false);
 
 	// Initialization
-	Variable stepRangeVar = g_builder.addVariable("$range_step", Type({ BasicType::NUMBER }), false);
-	Variable toRangeVar = g_builder.addVariable("$range_to", Type({ BasicType::NUMBER }), false);
-	Variable iterVar = g_builder.addVariable(m_iterName, Type({ BasicType::NUMBER }), false);
+	Variable stepRangeVar = builder.addVariable("$range_step", Type({ BasicType::NUMBER }), false);
+	Variable toRangeVar = builder.addVariable("$range_to", Type({ BasicType::NUMBER }), false);
+	Variable iterVar = builder.addVariable(m_iterName, Type({ BasicType::NUMBER }), false);
 
-	stepRangeVar.index = g_builder.getCurrentLocalVarLoc(stepRangeVar.index);
-	toRangeVar.index = g_builder.getCurrentLocalVarLoc(toRangeVar.index);
-	iterVar.index = g_builder.getCurrentLocalVarLoc(iterVar.index);
+	stepRangeVar.index = builder.getCurrentLocalVarLoc(stepRangeVar.index);
+	toRangeVar.index = builder.getCurrentLocalVarLoc(toRangeVar.index);
+	iterVar.index = builder.getCurrentLocalVarLoc(iterVar.index);
 
 
 	if (!m_rangeFromExpr) {
-		g_builder.addInst(Instruction(InstructionType::PUSH, 0.f));
+		builder.addInst(Instruction(InstructionType::PUSH, 0.f));
 	} else {
-		m_rangeFromExpr->generate();
+		m_rangeFromExpr->generate(builder);
 	}
 
-	m_rangeToExpr->generate();
+	m_rangeToExpr->generate(builder);
 
 	if (!m_rangeStepExpr) {
-		g_builder.addInst(Instruction(InstructionType::PUSH, 1.f));
+		builder.addInst(Instruction(InstructionType::PUSH, 1.f));
 	} else {
-		m_rangeStepExpr->generate();
+		m_rangeStepExpr->generate(builder);
 	}
 
-	g_builder.addInst(Instruction(InstructionType::INIT_RANGE));
-	g_builder.addInst(Instruction(InstructionType::ADD_LOCAL));
-	g_builder.addInst(Instruction(InstructionType::ADD_LOCAL));
-	g_builder.addInst(Instruction(InstructionType::ADD_LOCAL));
+	builder.addInst(Instruction(InstructionType::INIT_RANGE));
+	builder.addInst(Instruction(InstructionType::ADD_LOCAL));
+	builder.addInst(Instruction(InstructionType::ADD_LOCAL));
+	builder.addInst(Instruction(InstructionType::ADD_LOCAL));
 	
 	// Internal cycle variables must not be cleared on each iteration
-	Cycle* cycle = g_builder.addCycle();
+	Cycle* cycle = builder.addCycle();
 
-	size_t conditionLabel = g_builder.getLabel();
-	g_builder.addInst(Instruction(InstructionType::GOTO, uint32_t(conditionLabel)));
+	size_t conditionLabel = builder.getLabel();
+	builder.addInst(Instruction(InstructionType::GOTO, uint32_t(conditionLabel)));
 
 	// Increment
-	g_builder.setLabelAtNextInst(cycle->beginLabel);
-	g_builder.addInst(Instruction(InstructionType::LOAD, uint32_t(iterVar.index)));
-	g_builder.addInst(Instruction(InstructionType::LOAD, uint32_t(stepRangeVar.index)));
-	g_builder.addInst(Instruction(InstructionType::ADD));
-	g_builder.addInst(Instruction(InstructionType::STORE, uint32_t(iterVar.index)));
+	builder.setLabelAtNextInst(cycle->beginLabel);
+	builder.addInst(Instruction(InstructionType::LOAD, uint32_t(iterVar.index)));
+	builder.addInst(Instruction(InstructionType::LOAD, uint32_t(stepRangeVar.index)));
+	builder.addInst(Instruction(InstructionType::ADD));
+	builder.addInst(Instruction(InstructionType::STORE, uint32_t(iterVar.index)));
 
 	// Condition
-	g_builder.setLabelAtNextInst(conditionLabel);
-	g_builder.addInst(Instruction(InstructionType::LOAD, uint32_t(iterVar.index)));
-	g_builder.addInst(Instruction(InstructionType::LOAD, uint32_t(toRangeVar.index)));
-	g_builder.addInst(Instruction(InstructionType::LOAD, uint32_t(stepRangeVar.index)));
-	g_builder.addInst(Instruction(InstructionType::CHECK_RANGE));
-	g_builder.addInst(Instruction(InstructionType::GOTO_IF_NOT, uint32_t(onConditionFalseLabel)));
+	builder.setLabelAtNextInst(conditionLabel);
+	builder.addInst(Instruction(InstructionType::LOAD, uint32_t(iterVar.index)));
+	builder.addInst(Instruction(InstructionType::LOAD, uint32_t(toRangeVar.index)));
+	builder.addInst(Instruction(InstructionType::LOAD, uint32_t(stepRangeVar.index)));
+	builder.addInst(Instruction(InstructionType::CHECK_RANGE));
+	builder.addInst(Instruction(InstructionType::GOTO_IF_NOT, uint32_t(onConditionFalseLabel)));
 
 	// Body
 	try {
-		m_body->generate();
-		g_builder.addContinueInst(0);
+		m_body->generate(builder);
+		builder.addContinueInst(0);
 	} catch (TerminatorAdded terminator) {
 		// Nothing to do here
 	}
 
 	// Cycle end
-	g_builder.setLabelAtNextInst(onConditionFalseLabel);
-	g_builder.addBreakInst(0);
-	g_builder.setLabelAtNextInst(cycle->endLabel);
+	builder.setLabelAtNextInst(onConditionFalseLabel);
+	builder.addBreakInst(0);
+	builder.setLabelAtNextInst(cycle->endLabel);
 
-	g_builder.addClearScopeInst(3);
-	g_builder.deleteScope(false);
-	g_builder.endCycle();
+	builder.addClearScopeInst(3);
+	builder.deleteScope(false);
+	builder.endCycle();
 }
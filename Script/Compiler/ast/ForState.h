@@ -6,19 +6,19 @@
 class ForState final : public State {
 private:
 	std::string m_iterName;
-	std::unique_ptr<Expr> m_rangeFromExpr;
-	std::unique_ptr<Expr> m_rangeToExpr;
-	std::unique_ptr<Expr> m_rangeStepExpr;
-	std::unique_ptr<State> m_body;
+	Expr* m_rangeFromExpr;
+	Expr* m_rangeToExpr;
+	Expr* m_rangeStepExpr;
+	State* m_body;
 
 public:
 	ForState(
 		std::string iterName,
-		std::unique_ptr<Expr> rangeFromExpr,
-		std::unique_ptr<Expr> rangeToExpr,
-		std::unique_ptr<Expr> rangeStepExpr,
-		std::unique_ptr<State> body
+		Expr* rangeFromExpr,
+		Expr* rangeToExpr,
+		Expr* rangeStepExpr,
+		State* body
 	);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 };
\ No newline at end of file
@@ -1,7 +1,7 @@
 #include "FunctionCallExpr.h"
 
-FunctionCallExpr::FunctionCallExpr(std::string name, std::vector<std::unique_ptr<Expr>> arguments)
-	: m_args(std::move(arguments)) {
+FunctionCallExpr::FunctionCallExpr(ByteCodeBuilder& builder, std::string name, utils::ArenaArray<Expr*> arguments)
+	: m_args(arguments) {
 	Type argTypes;
 	for (auto& arg : m_args) {
 		for (BasicType type : arg->getType()) {
@@ -9,7 +9,7 @@ FunctionCallExpr::FunctionCallExpr(std::string name, std::vector<std::unique_ptr
 		}
 	}
 
-	Function* func = g_builder.findFunction(name, argTypes);
+	Function* func = builder.findFunction(name, argTypes);
 	if (func == nullptr) {
 		throw QString("No function found with name " + QString::fromStdString(name) 
 			+ " and with number of arguments: " + QString::number(argTypes.size()));
@@ -19,14 +19,13 @@ FunctionCallExpr::FunctionCallExpr(std::string name, std::vector<std::unique_ptr
 	m_function = func->position; // Function ID here
 }
 
-void FunctionCallExpr::generate() {
-	Function* func = g_builder.findFunction(m_function);
-
-	for (auto arg = m_args.rbegin(); arg != m_args.rend(); arg++) {
-		(*arg)->generate();
+void FunctionCallExpr::generate(ByteCodeBuilder& builder) {
+	for (size_t i = m_args.size(); i > 0; i--) {
+		m_args[i - 1]->generate(builder);
 	}
 
-	g_builder.addInst(Instruction(InstructionType::CALL, (uint32_t)func->position));
+	// The function's position is known only after linking, so its ID is used
+	builder.addInst(Instruction(InstructionType::CALL, (uint32_t)m_function));
 }
 
 bool FunctionCallExpr::isLVal() {
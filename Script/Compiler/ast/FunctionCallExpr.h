@@ -1,17 +1,18 @@
 #pragma once
 #include "Expr.h"
+#include "../../../Utils/Arena.h"
 #include "../ByteCodeBuilder.h"
 
 // Binary expression (an operator with 2 operands)
 class FunctionCallExpr final : public Expr {
 private:
 	size_t m_function;
-	std::vector<std::unique_ptr<Expr>> m_args;
+	utils::ArenaArray<Expr*> m_args;
 
 public:
-	FunctionCallExpr(std::string name, std::vector<std::unique_ptr<Expr>> arguments);
+	FunctionCallExpr(ByteCodeBuilder& builder, std::string name, utils::ArenaArray<Expr*> arguments);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 
 	bool isLVal() override;
 };
\ No newline at end of file
@@ -7,12 +7,19 @@ class FunctionDefState final : public State {
 private:
 	size_t m_function;
 	QList<Variable> m_args;
-	std::unique_ptr<State> m_body;
+	State* m_body;
 
 public:
-	FunctionDefState(std::string name, Type retType, QList<Variable> args, Type argTypes, std::unique_ptr<State> body);
+	FunctionDefState(ByteCodeBuilder& builder, std::string name, Type retType, QList<Variable> args, Type argTypes, State* body);
 
-	void generate() override;
+	// Registers the function to be generated separately
+	void generate(ByteCodeBuilder& builder) override;
+
+	// Generates the function's body into its own builder
+	// Can be called concurrently for different functions
+	void generateBody(ByteCodeBuilder& builder) const;
+
+	size_t getFunctionId() const;
 
 	bool isFunction() override;
 };
\ No newline at end of file
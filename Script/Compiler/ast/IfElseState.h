@@ -5,12 +5,12 @@
 // Statement for the if-else structure
 class IfElseState final : public State {
 private:
-	std::unique_ptr<State> m_body;
-	std::unique_ptr<State> m_elseBody;
-	std::unique_ptr<Expr> m_condition;
+	State* m_body;
+	State* m_elseBody;
+	Expr* m_condition;
 
 public:
-	IfElseState(std::unique_ptr<Expr> condition, std::unique_ptr<State> body, std::unique_ptr<State> elseBody);
+	IfElseState(Expr* condition, State* body, State* elseBody);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 };
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "ParallelForState.h"
+#include "../ByteCodeBuilder.h"
+
+ParallelForState::ParallelForState(
+	std::string iterName,
+	Expr* rangeFromExpr,
+	Expr* rangeToExpr,
+	Expr* rangeStepExpr,
+	State* body
+) :
+	m_iterName(std::move(iterName)),
+	m_rangeFromExpr(rangeFromExpr),
+	m_rangeToExpr(rangeToExpr),
+	m_rangeStepExpr(rangeStepExpr),
+	m_body(body)
+{
+	if (!m_rangeToExpr || m_rangeToExpr->getType() != BasicType::NUMBER
+		|| (m_rangeFromExpr && (m_rangeFromExpr->getType() != BasicType::NUMBER
+		|| (m_rangeStepExpr && m_rangeStepExpr->getType() != BasicType::NUMBER)))) {
+		throw QString("Incorrect range: must have at least one value and all the values must be numbers");
+	}
+}
+
+void ParallelForState::generate(ByteCodeBuilder& builder) {
+	builder.addScope(false);
+
+	// The range is evaluated once, the VM goes through it on its own
+	if (!m_rangeFromExpr) {
+		builder.addInst(Instruction(InstructionType::PUSH, 0.f));
+	} else {
+		m_rangeFromExpr->generate(builder);
+	}
+
+	m_rangeToExpr->generate(builder);
+
+	if (!m_rangeStepExpr) {
+		builder.addInst(Instruction(InstructionType::PUSH, 1.f));
+	} else {
+		m_rangeStepExpr->generate(builder);
+	}
+
+	builder.addInst(Instruction(InstructionType::INIT_RANGE));
+
+	// The iteration's value is added as a local variable by the VM before the body is run
+	builder.addVariable(m_iterName, Type({ BasicType::NUMBER }), false);
+
+	// Continuing the cycle finishes the iteration, so both the labels are at the end of the body
+	Cycle* cycle = builder.addCycle();
+	cycle->isParallel = true;
+
+	size_t beginLabel = cycle->beginLabel;
+	size_t endLabel = cycle->endLabel;
+	builder.addInst(Instruction(InstructionType::PARALLEL_FOR, uint32_t(endLabel)));
+
+	// Body
+	try {
+		m_body->generate(builder);
+	} catch (TerminatorAdded terminator) {
+		// Nothing to do here
+	}
+
+	// Cycle end, the iteration's variables left are removed by the VM
+	builder.setLabelAtNextInst(beginLabel);
+	builder.setLabelAtNextInst(endLabel);
+
+	builder.deleteScope(false);
+	builder.endCycle();
+}
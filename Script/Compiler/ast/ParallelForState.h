@@ -0,0 +1,26 @@
+#pragma once
+#include "State.h"
+#include "Expr.h"
+
+// Statement for the parallel for cycle
+// The iterations are run by the VM on several threads in any order, so they can only read the variables declared outside of the body
+// Each iteration starts with the color and width the cycle started with, the drawings are applied in the order of the iterations
+class ParallelForState final : public State {
+private:
+	std::string m_iterName;
+	Expr* m_rangeFromExpr;
+	Expr* m_rangeToExpr;
+	Expr* m_rangeStepExpr;
+	State* m_body;
+
+public:
+	ParallelForState(
+		std::string iterName,
+		Expr* rangeFromExpr,
+		Expr* rangeToExpr,
+		Expr* rangeStepExpr,
+		State* body
+	);
+
+	void generate(ByteCodeBuilder& builder) override;
+};
\ No newline at end of file
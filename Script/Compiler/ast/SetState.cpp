@@ -1,12 +1,16 @@
 #include "SetState.h"
 
-SetState::SetState(std::string name, Field field, std::unique_ptr<Expr> expr)
-	: m_expr(std::move(expr)), m_field(field) {
-	Variable* var = g_builder.findVariable(name);
+SetState::SetState(ByteCodeBuilder& builder, std::string name, Field field, Expr* expr)
+	: m_expr(expr), m_field(field) {
+	Variable* var = builder.findVariable(name);
 	if (var == nullptr) {
 		throw QString("No such variable found: " + QString::fromStdString(name));
 	}
 
+	if (builder.isSharedWithParallelBody(*var)) {
+		throw QString("Cannot set " + QString::fromStdString(name) + ": the variables declared outside of a parallel for can only be read within it");
+	}
+
 	m_variable = *var;
 
 	BasicType varType = m_variable.type[0];
@@ -31,12 +35,12 @@ SetState::SetState(std::string name, Field field, std::unique_ptr<Expr> expr)
 	m_fieldType = varType;
 
 	if (!m_variable.isGlobal) {
-		m_variable.index = g_builder.getCurrentLocalVarLoc(m_variable.index);
+		m_variable.index = builder.getCurrentLocalVarLoc(m_variable.index);
 	}
 }
 
-void SetState::generate() {
-	m_expr->generate();
+void SetState::generate(ByteCodeBuilder& builder) {
+	m_expr->generate(builder);
 
 	uint8_t fieldPos = 0;
 
@@ -51,8 +55,8 @@ void SetState::generate() {
 	}
 
 	if (m_variable.isGlobal) {
-		g_builder.addInst(Instruction(getAccordingToType(InstructionType::STORE_GLOBAL, uint8_t(m_fieldType)), m_variable.index + fieldPos));
+		builder.addInst(Instruction(getAccordingToType(InstructionType::STORE_GLOBAL, uint8_t(m_fieldType)), m_variable.index + fieldPos));
 	} else {
-		g_builder.addInst(Instruction(getAccordingToType(InstructionType::STORE, uint8_t(m_fieldType)), m_variable.index + fieldPos));
+		builder.addInst(Instruction(getAccordingToType(InstructionType::STORE, uint8_t(m_fieldType)), m_variable.index + fieldPos));
 	}
 }
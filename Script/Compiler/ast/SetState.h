@@ -20,12 +20,12 @@ public:
 
 private:
 	Variable m_variable;
-	std::unique_ptr<Expr> m_expr;
+	Expr* m_expr;
 	Field m_field = NONE;
 	BasicType m_fieldType;
 
 public:
-	SetState(std::string name, Field field, std::unique_ptr<Expr> expr);
+	SetState(ByteCodeBuilder& builder, std::string name, Field field, Expr* expr);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 };
\ No newline at end of file
@@ -1,11 +1,14 @@
 #pragma once
 #include <cstdint>
 
+class ByteCodeBuilder;
+
 // Basic class for all the statements
+// Statements are allocated within the parser's arena and are destroyed together with it
 class State {
 public:
-	// Translates the statement into a set of instructions stored in a global state
-	virtual void generate() = 0;
+	// Translates the statement into a set of instructions stored in the builder
+	virtual void generate(ByteCodeBuilder& builder) = 0;
 
 	inline virtual bool isFunction() {
 		return false;
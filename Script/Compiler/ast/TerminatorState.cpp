@@ -2,8 +2,8 @@
 #include "../ByteCodeBuilder.h"
 #include "ValueExpr.h"
 
-TerminatorState::TerminatorState(TerminatorAdded::TerminatorType terminatorType, std::unique_ptr<Expr> arg)
-	: m_terminatorType(terminatorType), m_arg(std::move(arg)) {
+TerminatorState::TerminatorState(TerminatorAdded::TerminatorType terminatorType, Expr* arg)
+	: m_terminatorType(terminatorType), m_arg(arg) {
 	switch (m_terminatorType)	{
 	case TerminatorAdded::RETURN: break;
 	case TerminatorAdded::HALT:
@@ -20,20 +20,20 @@ TerminatorState::TerminatorState(TerminatorAdded::TerminatorType terminatorType,
 	}
 }
 
-void TerminatorState::generate() {
+void TerminatorState::generate(ByteCodeBuilder& builder) {
 	switch (m_terminatorType) {
 	case TerminatorAdded::RETURN:
-		m_arg->generate();
-		g_builder.addRetInst();
+		m_arg->generate(builder);
+		builder.addRetInst();
 		throw TerminatorAdded{ TerminatorAdded::RETURN };
 	case TerminatorAdded::HALT:
-		g_builder.addInst(Instruction(InstructionType::HALT));
+		builder.addInst(Instruction(InstructionType::HALT));
 		throw TerminatorAdded{ TerminatorAdded::HALT };
 	case TerminatorAdded::BREAK:
-		g_builder.addBreakInst(m_arg ? ((ValueExpr*)m_arg.get())->getConstNumber() : 0);
+		builder.addBreakInst(m_arg ? ((ValueExpr*)m_arg)->getConstNumber() : 0);
 		throw TerminatorAdded{ TerminatorAdded::BREAK };
 	case TerminatorAdded::CONTINUE:
-		g_builder.addContinueInst(m_arg ? ((ValueExpr*)m_arg.get())->getConstNumber() : 0);
+		builder.addContinueInst(m_arg ? ((ValueExpr*)m_arg)->getConstNumber() : 0);
 		throw TerminatorAdded{ TerminatorAdded::CONTINUE };
 	default:
 		throw QString("Unknown terminator");
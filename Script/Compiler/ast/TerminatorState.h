@@ -5,11 +5,11 @@
 // Statement for terminator instructions (flow-control: break, continue, return, halt)
 class TerminatorState final : public State {
 private:
-	std::unique_ptr<Expr> m_arg;
+	Expr* m_arg;
 	TerminatorAdded::TerminatorType m_terminatorType;
 
 public:
-	TerminatorState(TerminatorAdded::TerminatorType terminatorType, std::unique_ptr<Expr> arg);
+	TerminatorState(TerminatorAdded::TerminatorType terminatorType, Expr* arg);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 };
\ No newline at end of file
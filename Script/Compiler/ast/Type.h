@@ -1,5 +1,8 @@
 #pragma once
-#include <QList>
+#include <cassert>
+#include <cstdint>
+#include <initializer_list>
+#include <QString>
 
 enum class BasicType : uint8_t {
 	NUMBER = 0,
@@ -7,21 +10,100 @@ enum class BasicType : uint8_t {
 	COLOR
 };
 
-typedef QList<BasicType> Type;
+// The type of an expression: a single basic type or a tuple of them (e.g. function arguments)
+// Stored inline as 2-bit codes within a single 64-bit word, so it is copied and compared as an integer
+class Type final {
+public:
+	// Maximal number of basic types within a tuple
+	static constexpr uint32_t MAX_SIZE = 28;
 
-inline bool operator==(const Type& a, const Type& b) {
-	if (a.size() != b.size()) {
-		return false;
+private:
+	static constexpr uint32_t SIZE_SHIFT = 56;
+	static constexpr uint64_t TYPES_MASK = (uint64_t(1) << SIZE_SHIFT) - 1;
+
+	uint64_t m_data = 0; // Lower 56 bits are the basic types, higher 8 bits are the size
+
+public:
+	// Allows to iterate over the basic types
+	class Iterator final {
+	private:
+		uint64_t m_data;
+		uint32_t m_index;
+
+	public:
+		Iterator(uint64_t data, uint32_t index)
+			: m_data(data), m_index(index) {
+
+		}
+
+		inline BasicType operator*() const {
+			return BasicType((m_data >> (m_index * 2)) & 3);
+		}
+
+		inline Iterator& operator++() {
+			m_index++;
+			return *this;
+		}
+
+		inline bool operator!=(const Iterator& other) const {
+			return m_index != other.m_index;
+		}
+	};
+
+public:
+	Type() = default;
+
+	inline Type(std::initializer_list<BasicType> types) {
+		for (BasicType type : types) {
+			push_back(type);
+		}
+	}
+
+	inline size_t size() const noexcept {
+		return size_t(m_data >> SIZE_SHIFT);
 	}
 
-	for (size_t i = 0; i < a.size(); i++) {
-		if (a[i] != b[i]) {
-			return false;
+	inline bool isEmpty() const noexcept {
+		return size() == 0;
+	}
+
+	inline BasicType operator[](size_t i) const {
+		assert(i < size());
+
+		return BasicType((m_data >> (i * 2)) & 3);
+	}
+
+	inline BasicType back() const {
+		return (*this)[size() - 1];
+	}
+
+	// Appends a basic type to the tuple, throws if the tuple is too long
+	inline void push_back(BasicType type) {
+		size_t index = size();
+		if (index >= MAX_SIZE) {
+			throw QString("Too many values in a tuple, at most " + QString::number(MAX_SIZE) + " are allowed");
 		}
+
+		m_data = (m_data & TYPES_MASK) | (uint64_t(type) << (index * 2)) | (uint64_t(index + 1) << SIZE_SHIFT);
 	}
 
-	return true;
-}
+	// A unique integer representation of the type, can be used as a hash
+	inline uint64_t getSignature() const noexcept {
+		return m_data;
+	}
+
+	inline Iterator begin() const {
+		return Iterator(m_data, 0);
+	}
+
+	inline Iterator end() const {
+		return Iterator(m_data, uint32_t(size()));
+	}
+
+	inline bool operator==(const Type& other) const noexcept {
+		return m_data == other.m_data;
+	}
+};
 
 inline bool operator==(const Type& a, BasicType bb) {
 	if (a.size() != 1 || a[0] != bb) {
@@ -1,26 +1,26 @@
 #include "UnaryExpr.h"
 #include "../ByteCodeBuilder.h"
 
-UnaryExpr::UnaryExpr(TokenType op, std::unique_ptr<Expr> expr)
-	: Expr(expr->getType()), m_op(op), m_expr(std::move(expr)) {
+UnaryExpr::UnaryExpr(TokenType op, Expr* expr)
+	: Expr(expr->getType()), m_op(op), m_expr(expr) {
 	assert(op == TokenType::NOT || op == TokenType::MINUS);
 }
 
-void UnaryExpr::generate() {
-	m_expr->generate();
+void UnaryExpr::generate(ByteCodeBuilder& builder) {
+	m_expr->generate(builder);
 
 	if (m_op == TokenType::NOT) {
 		if (m_type.size() != 1 && m_type[0] != BasicType::NUMBER) {
 			throw QString("Not is only applicable to numbers!");
 		}
 
-		g_builder.addInst(Instruction(InstructionType::NOT));
+		builder.addInst(Instruction(InstructionType::NOT));
 	} else {
 		if (m_type.size() != 1) {
 			throw QString("Cannot negate a tuple");
 		}
 
-		g_builder.addInst(Instruction(getAccordingToType(InstructionType::NEG, uint8_t(m_type[0]))));
+		builder.addInst(Instruction(getAccordingToType(InstructionType::NEG, uint8_t(m_type[0]))));
 	}
 }
 
@@ -5,13 +5,13 @@
 // Unary expression (an operator with a single operand)
 class UnaryExpr final : public Expr {
 private:
-	std::unique_ptr<Expr> m_expr;
+	Expr* m_expr;
 	TokenType m_op;
 
 public:
-	UnaryExpr(TokenType op, std::unique_ptr<Expr> expr);
+	UnaryExpr(TokenType op, Expr* expr);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 
 	bool isLVal() override;
 };
\ No newline at end of file
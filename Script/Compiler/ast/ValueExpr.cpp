@@ -20,17 +20,17 @@ ValueExpr::ValueExpr(float r, float g, float b, float a)
 	m_value[3] = a;
 }
 
-void ValueExpr::generate() {
+void ValueExpr::generate(ByteCodeBuilder& builder) {
 	switch (m_type[0]) {
 		case BasicType::NUMBER:
-			g_builder.addInst(Instruction(InstructionType::PUSH, m_value[0]));
+			builder.addInst(Instruction(InstructionType::PUSH, m_value[0]));
 			return;
 		case BasicType::POINT:
-			g_builder.addInst(Instruction(InstructionType::PUSH_POINT, m_value[0], m_value[1]));
+			builder.addInst(Instruction(InstructionType::PUSH_POINT, m_value[0], m_value[1]));
 			return;
 		case BasicType::COLOR:
-			g_builder.addInst(Instruction(InstructionType::PUSH_POINT, m_value[0], m_value[1]));
-			g_builder.addInst(Instruction(InstructionType::PUSH_POINT, m_value[2], m_value[3]));
+			builder.addInst(Instruction(InstructionType::PUSH_POINT, m_value[0], m_value[1]));
+			builder.addInst(Instruction(InstructionType::PUSH_POINT, m_value[2], m_value[3]));
 			return;
 	default:
 		break;
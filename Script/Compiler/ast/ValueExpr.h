@@ -11,7 +11,7 @@ public:
 	ValueExpr(float x, float y);
 	ValueExpr(float r, float g, float b, float a);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 
 	bool isLVal() override;
 	bool isConstNumber() override;
@@ -7,10 +7,10 @@
 class VariableDeclState final : public State {
 private:
 	Variable m_variable;
-	std::unique_ptr<Expr> m_initExpr;
+	Expr* m_initExpr;
 
 public:
-	VariableDeclState(std::string name, Type type, bool isGlobal, std::unique_ptr<Expr> expr);
+	VariableDeclState(ByteCodeBuilder& builder, std::string name, Type type, bool isGlobal, Expr* expr);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 };
\ No newline at end of file
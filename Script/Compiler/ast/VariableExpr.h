@@ -8,9 +8,9 @@ private:
 	bool m_isGlobal;
 
 public:
-	VariableExpr(std::string name);
+	VariableExpr(ByteCodeBuilder& builder, std::string name);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 
 	bool isLVal() override;
 };
\ No newline at end of file
@@ -5,11 +5,11 @@
 // Statement for the while cycle
 class WhileState final : public State {
 private:
-	std::unique_ptr<State> m_body;
-	std::unique_ptr<Expr> m_condition;
+	State* m_body;
+	Expr* m_condition;
 
 public:
-	WhileState(std::unique_ptr<State> body, std::unique_ptr<Expr> condition);
+	WhileState(State* body, Expr* condition);
 
-	void generate() override;
+	void generate(ByteCodeBuilder& builder) override;
 };
\ No newline at end of file
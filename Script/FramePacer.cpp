@@ -0,0 +1,99 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <cmath>
+
+constexpr int64_t NS_PER_SECOND = 1'000'000'000;
+constexpr int64_t NS_PER_MS = 1'000'000;
+
+// The frame rates above it are not distinguishable by the timers anyway
+constexpr float MAX_FRAME_RATE = 1000.f;
+
+QString FramePacingReport::toText() const {
+    return "Frame rate: " + QString::number(frameRate)
+        + "\nFrames shown: " + QString::number(framesCount)
+        + "\nTicks missed: " + QString::number(missedTicksCount)
+        + "\nFrame time, ms: median " + QString::number(medianFrameTime, 'f', 2)
+        + ", 90% " + QString::number(p90FrameTime, 'f', 2)
+        + ", 99% " + QString::number(p99FrameTime, 'f', 2)
+        + ", max " + QString::number(maxFrameTime, 'f', 2);
+}
+
+void FramePacer::setFrameRate(float frameRate) {
+    float newFrameRate = frameRate > 0 ? std::min(frameRate, MAX_FRAME_RATE) : 0; // NaN is 0 as well
+    if (newFrameRate == m_frameRate) {
+        return;
+    }
+
+    m_frameTimesNs.clear();
+    m_missedTicksCount = 0;
+    m_lastFrameNs = -1;
+
+    if (newFrameRate == 0) {
+        m_frameRate = 0;
+        m_periodNs = 0;
+        return;
+    }
+
+    m_frameRate = newFrameRate;
+    m_periodNs = int64_t(double(NS_PER_SECOND) / m_frameRate);
+    m_timer.start();
+}
+
+bool FramePacer::isActive() const {
+    return m_periodNs != 0;
+}
+
+int FramePacer::finishFrame() {
+    int64_t now = m_timer.nsecsElapsed();
+
+    // The first frame starts the ticks
+    if (m_lastFrameNs < 0) {
+        m_lastFrameNs = now;
+        m_nextTickNs = now + m_periodNs;
+        return 0;
+    }
+
+    int64_t shownAt = m_nextTickNs;
+    if (now > m_nextTickNs) {
+        // Too late for the tick, the frame is shown at once and the next tick is the first one not missed yet
+        int64_t missedTicks = (now - m_nextTickNs) / m_periodNs;
+        m_missedTicksCount += uint32_t(missedTicks + 1);
+        m_nextTickNs += (missedTicks + 1) * m_periodNs;
+        shownAt = now;
+    } else {
+        m_nextTickNs += m_periodNs;
+    }
+
+    m_frameTimesNs.push_back(shownAt - m_lastFrameNs);
+    m_lastFrameNs = shownAt;
+
+    // Rounded up, so that the timer never fires before the tick
+    return int((shownAt - now + NS_PER_MS - 1) / NS_PER_MS);
+}
+
+FramePacingReport FramePacer::getReport() const {
+    FramePacingReport report;
+    report.frameRate = m_frameRate;
+    report.framesCount = uint32_t(m_frameTimesNs.size()) + (m_lastFrameNs < 0 ? 0 : 1);
+    report.missedTicksCount = m_missedTicksCount;
+
+    if (m_frameTimesNs.empty()) {
+        return report;
+    }
+
+    std::vector<int64_t> sorted = m_frameTimesNs;
+    std::sort(sorted.begin(), sorted.end());
+
+    // The nearest-rank percentile
+    auto getPercentile = [&](double percent) {
+        size_t rank = size_t(std::ceil(percent / 100 * sorted.size()));
+        return float(sorted[std::clamp(rank, size_t(1), sorted.size()) - 1]) / NS_PER_MS;
+    };
+
+    report.medianFrameTime = getPercentile(50);
+    report.p90FrameTime = getPercentile(90);
+    report.p99FrameTime = getPercentile(99);
+    report.maxFrameTime = float(sorted.back()) / NS_PER_MS;
+
+    return report;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <QElapsedTimer>
+#include <QString>
+
+// The statistics of the frames shown by an animation
+struct FramePacingReport {
+	float frameRate = 0;
+	uint32_t framesCount = 0;
+	uint32_t missedTicksCount = 0; // The ticks passed while a frame was late, no frame is skipped for them
+
+	// The times between the shown frames, in milliseconds
+	float medianFrameTime = 0;
+	float p90FrameTime = 0;
+	float p99FrameTime = 0;
+	float maxFrameTime = 0;
+
+	QString toText() const;
+};
+
+// Keeps an animation at a steady frame rate, like a display's vertical sync does
+// The frames are shown on the ticks of a fixed period counted from the first frame, so the errors do not add up
+// A frame finished after its tick is shown at once (none are skipped to catch up), and the ticks it has missed are counted
+class FramePacer final {
+private:
+	QElapsedTimer m_timer;
+
+	int64_t m_periodNs = 0;
+	int64_t m_nextTickNs = 0;
+	int64_t m_lastFrameNs = -1; // No frame was shown yet
+
+	float m_frameRate = 0;
+	uint32_t m_missedTicksCount = 0;
+	std::vector<int64_t> m_frameTimesNs;
+
+public:
+	// Starts pacing anew with the frame rate, a non-positive one stops it
+	// Setting the rate already set changes nothing, so that the statistics are kept if a script sets it in its loop
+	void setFrameRate(float frameRate);
+
+	bool isActive() const;
+
+	// Called once a frame is drawn, returns the milliseconds to wait for the tick the frame is to be shown on
+	int finishFrame();
+
+	FramePacingReport getReport() const;
+};
@@ -68,7 +68,13 @@ uint8_t getInstructionArgsSize(InstructionType type) {
 	case InstructionType::DRAW_CIRCLE:
 	case InstructionType::FILL_RECT:
 	case InstructionType::FILL_CIRCLE:
+	case InstructionType::FILL_IMAGE:
+	case InstructionType::BLEND_IMAGE:
+	case InstructionType::INVERT_IMAGE:
+	case InstructionType::THRESHOLD_IMAGE:
+	case InstructionType::MULTIPLY_IMAGE:
 	case InstructionType::SLEEP:
+	case InstructionType::SET_FRAME_RATE:
 	case InstructionType::ABS:
 	case InstructionType::ROUND:
 	case InstructionType::FLOOR:
@@ -102,12 +108,15 @@ uint8_t getInstructionArgsSize(InstructionType type) {
 	case InstructionType::GOTO:
 	case InstructionType::GOTO_IF_NOT:
 	case InstructionType::CALL:
+	case InstructionType::PARALLEL_FOR:
 	case InstructionType::SET_IMAGE:
+	case InstructionType::COPY_RECT:
 	case InstructionType::MIN:
 	case InstructionType::MAX:
 	case InstructionType::SUM:
 		return 1;
 	case InstructionType::COPY_IMAGE:
+	case InstructionType::FILL_POLYGON:
 	case InstructionType::PUSH_POINT:
 		return 2;
 	default:
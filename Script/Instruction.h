@@ -120,6 +120,7 @@ enum class InstructionType : uint8_t {
 	// Built-ins
 	INIT_RANGE, // sorts three values on the stack to be used as (from, to, step)
 	CHECK_RANGE, // checks whether the iter-variable is out of range (and thus the cycle is finished)
+	PARALLEL_FOR, // runs the code till the value's position for each value in the range on the stack, the value is added as a local variable
 
 	PUSH_WIDTH,
 	PUSH_HEIGHT,
@@ -139,8 +140,18 @@ enum class InstructionType : uint8_t {
 
 	FILL_RECT,
 	FILL_CIRCLE,
+	FILL_POLYGON, // the number of points on the stack and the fill rule
+
+	// Bulk image instructions, executed with the native pixel kernels
+	FILL_IMAGE,
+	BLEND_IMAGE,
+	INVERT_IMAGE,
+	THRESHOLD_IMAGE,
+	MULTIPLY_IMAGE,
+	COPY_RECT, // copies a rect from the image buffer of the value to the current image
 
 	SLEEP,
+	SET_FRAME_RATE, // from then on the update waits for the next frame's tick instead of returning at once
 
 	ABS,
 	MIN,
@@ -0,0 +1,159 @@
+#pragma once
+#include <cstdint>
+#include "../Image/Color.h"
+#include "../Utils/MathUtils.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define PACKED_VALUES_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// The VM's color and point values packed into a single register, so that an operation on them is a single instruction
+// They are kept on the VM's stacks as 4 and 2 consecutive floats, and are loaded from there and stored back at once
+
+// A color value: the red, green, blue and alpha channels
+struct Float4 {
+	static constexpr uint32_t SIZE = 4;
+
+#ifdef PACKED_VALUES_USE_SSE2
+	__m128 value;
+
+	static inline Float4 load(const float* from) {
+		return { _mm_loadu_ps(from) };
+	}
+
+	static inline Float4 splat(float number) {
+		return { _mm_set1_ps(number) };
+	}
+
+	inline void store(float* to) const {
+		_mm_storeu_ps(to, value);
+	}
+
+	inline Float4 operator+(Float4 other) const { return { _mm_add_ps(value, other.value) }; }
+	inline Float4 operator-(Float4 other) const { return { _mm_sub_ps(value, other.value) }; }
+	inline Float4 operator*(Float4 other) const { return { _mm_mul_ps(value, other.value) }; }
+	inline Float4 operator/(Float4 other) const { return { _mm_div_ps(value, other.value) }; }
+
+	inline Float4 operator-() const {
+		return { _mm_xor_ps(value, _mm_set1_ps(-0.f)) }; // Flips the sign bits only, as the scalar negation does
+	}
+
+	inline bool operator==(Float4 other) const {
+		return _mm_movemask_ps(_mm_cmpeq_ps(value, other.value)) == 0xf;
+	}
+
+	// Clamps the channels to [0, 255] (NaN to 0, since maxps takes the second operand then) and truncates them to integers
+	// The conversion gives 0x80000000 for the values out of int's range, so the packs alone would turn them into 0
+	inline Color toColor() const {
+		__m128 clamped = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(255));
+		__m128i channels = _mm_cvttps_epi32(clamped);
+		channels = _mm_packs_epi32(channels, channels);
+		channels = _mm_packus_epi16(channels, channels);
+
+		uint32_t rgba = uint32_t(_mm_cvtsi128_si32(channels));
+		return Color(uint8_t(rgba), uint8_t(rgba >> 8), uint8_t(rgba >> 16), uint8_t(rgba >> 24));
+	}
+#else
+	float value[4];
+
+	static inline Float4 load(const float* from) {
+		return { { from[0], from[1], from[2], from[3] } };
+	}
+
+	static inline Float4 splat(float number) {
+		return { { number, number, number, number } };
+	}
+
+	inline void store(float* to) const {
+		for (uint32_t i = 0; i < SIZE; i++) {
+			to[i] = value[i];
+		}
+	}
+
+	inline Float4 operator+(Float4 other) const { return { { value[0] + other.value[0], value[1] + other.value[1], value[2] + other.value[2], value[3] + other.value[3] } }; }
+	inline Float4 operator-(Float4 other) const { return { { value[0] - other.value[0], value[1] - other.value[1], value[2] - other.value[2], value[3] - other.value[3] } }; }
+	inline Float4 operator*(Float4 other) const { return { { value[0] * other.value[0], value[1] * other.value[1], value[2] * other.value[2], value[3] * other.value[3] } }; }
+	inline Float4 operator/(Float4 other) const { return { { value[0] / other.value[0], value[1] / other.value[1], value[2] / other.value[2], value[3] / other.value[3] } }; }
+
+	inline Float4 operator-() const {
+		return { { -value[0], -value[1], -value[2], -value[3] } };
+	}
+
+	inline bool operator==(Float4 other) const {
+		return value[0] == other.value[0] && value[1] == other.value[1] && value[2] == other.value[2] && value[3] == other.value[3];
+	}
+
+	// Clamps the channels to [0, 255] (NaN to 0) before truncating them, the values out of int's range cannot be converted
+	static inline uint8_t toChannel(float channel) {
+		return channel >= 0 ? uint8_t(utils::min(channel, 255.f)) : 0;
+	}
+
+	inline Color toColor() const {
+		return Color(toChannel(value[0]), toChannel(value[1]), toChannel(value[2]), toChannel(value[3]));
+	}
+#endif
+};
+
+// A point value: the x and y coordinates
+// With SSE2 it takes the lower half of a register, loaded and stored as a single 64-bit value
+struct Float2 {
+	static constexpr uint32_t SIZE = 2;
+
+#ifdef PACKED_VALUES_USE_SSE2
+	__m128 value;
+
+	static inline Float2 load(const float* from) {
+		return { _mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)from)) };
+	}
+
+	static inline Float2 splat(float number) {
+		return { _mm_set1_ps(number) };
+	}
+
+	inline void store(float* to) const {
+		_mm_storel_epi64((__m128i*)to, _mm_castps_si128(value));
+	}
+
+	inline Float2 operator+(Float2 other) const { return { _mm_add_ps(value, other.value) }; }
+	inline Float2 operator-(Float2 other) const { return { _mm_sub_ps(value, other.value) }; }
+	inline Float2 operator*(Float2 other) const { return { _mm_mul_ps(value, other.value) }; }
+	inline Float2 operator/(Float2 other) const { return { _mm_div_ps(value, other.value) }; }
+
+	inline Float2 operator-() const {
+		return { _mm_xor_ps(value, _mm_set1_ps(-0.f)) };
+	}
+
+	inline bool operator==(Float2 other) const {
+		return (_mm_movemask_ps(_mm_cmpeq_ps(value, other.value)) & 0x3) == 0x3;
+	}
+#else
+	float value[2];
+
+	static inline Float2 load(const float* from) {
+		return { { from[0], from[1] } };
+	}
+
+	static inline Float2 splat(float number) {
+		return { { number, number } };
+	}
+
+	inline void store(float* to) const {
+		to[0] = value[0];
+		to[1] = value[1];
+	}
+
+	inline Float2 operator+(Float2 other) const { return { { value[0] + other.value[0], value[1] + other.value[1] } }; }
+	inline Float2 operator-(Float2 other) const { return { { value[0] - other.value[0], value[1] - other.value[1] } }; }
+	inline Float2 operator*(Float2 other) const { return { { value[0] * other.value[0], value[1] * other.value[1] } }; }
+	inline Float2 operator/(Float2 other) const { return { { value[0] / other.value[0], value[1] / other.value[1] } }; }
+
+	inline Float2 operator-() const {
+		return { { -value[0], -value[1] } };
+	}
+
+	inline bool operator==(Float2 other) const {
+		return value[0] == other.value[0] && value[1] == other.value[1];
+	}
+#endif
+};
@@ -0,0 +1,146 @@
+#include "Allocation.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace utils;
+
+// The ALIGNED and PAGES allocations are preceded by a header of ALLOCATION_ALIGNMENT bytes,
+// so that the data stays aligned, and the memory can be freed and reallocated knowing the pointer only
+struct AllocationHeader {
+	size_t size; // The usable bytes after the header
+	bool isMapped; // Whether the block is mapped pages rather than an aligned heap block
+};
+
+static_assert(sizeof(AllocationHeader) <= ALLOCATION_ALIGNMENT);
+
+static AllocationHeader* getHeader(void* data) {
+	return (AllocationHeader*)((uint8_t*)data - ALLOCATION_ALIGNMENT);
+}
+
+static void* allocateAligned(size_t size, bool isZeroed) {
+	size_t fullSize = ALLOCATION_ALIGNMENT + size;
+#ifdef _WIN32
+	uint8_t* block = (uint8_t*)_aligned_malloc(fullSize, ALLOCATION_ALIGNMENT);
+#else
+	// aligned_alloc requires the size to be a multiple of the alignment
+	fullSize = (fullSize + ALLOCATION_ALIGNMENT - 1) / ALLOCATION_ALIGNMENT * ALLOCATION_ALIGNMENT;
+	uint8_t* block = (uint8_t*)std::aligned_alloc(ALLOCATION_ALIGNMENT, fullSize);
+#endif
+	if (block == nullptr) {
+		return nullptr;
+	}
+
+	if (isZeroed) {
+		std::memset(block + ALLOCATION_ALIGNMENT, 0, size);
+	}
+
+	*(AllocationHeader*)block = AllocationHeader{ size, false };
+	return block + ALLOCATION_ALIGNMENT;
+}
+
+static void* allocatePages(size_t size) {
+	size_t fullSize = ALLOCATION_ALIGNMENT + size;
+#ifdef _WIN32
+	// Large pages require a privilege the editor does not have, so these are usual ones
+	uint8_t* block = (uint8_t*)VirtualAlloc(nullptr, fullSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (block == nullptr) {
+		return nullptr;
+	}
+#else
+	uint8_t* block = (uint8_t*)mmap(nullptr, fullSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (block == MAP_FAILED) {
+		return nullptr;
+	}
+
+#ifdef MADV_HUGEPAGE
+	madvise(block, fullSize, MADV_HUGEPAGE); // Just a hint, so the result does not matter
+#endif
+#endif
+
+	*(AllocationHeader*)block = AllocationHeader{ size, true };
+	return block + ALLOCATION_ALIGNMENT;
+}
+
+static void freeBlock(void* data) {
+	AllocationHeader* header = getHeader(data);
+	if (!header->isMapped) {
+#ifdef _WIN32
+		_aligned_free(header);
+#else
+		std::free(header);
+#endif
+		return;
+	}
+
+#ifdef _WIN32
+	VirtualFree(header, 0, MEM_RELEASE);
+#else
+	munmap(header, ALLOCATION_ALIGNMENT + header->size);
+#endif
+}
+
+void* utils::allocateMemory(size_t size, bool isZeroed, AllocationPolicy policy) {
+	switch (policy) {
+		case AllocationPolicy::HEAP:
+			return isZeroed ? std::calloc(size, 1) : std::malloc(size);
+		case AllocationPolicy::ALIGNED:
+			return allocateAligned(size, isZeroed);
+		case AllocationPolicy::PAGES:
+			return size < HUGE_PAGE_THRESHOLD ? allocateAligned(size, isZeroed) : allocatePages(size);
+		default:
+			return nullptr;
+	}
+}
+
+void* utils::reallocateMemory(void* data, size_t size, AllocationPolicy policy) {
+	if (policy == AllocationPolicy::HEAP) {
+		return std::realloc(data, size);
+	}
+
+	if (data == nullptr) {
+		return allocateMemory(size, false, policy);
+	}
+
+	AllocationHeader* header = getHeader(data);
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+	// The pages are moved rather than copied, and the new ones are zero pages mapped lazily
+	if (header->isMapped && size >= HUGE_PAGE_THRESHOLD) {
+		void* block = mremap(header, ALLOCATION_ALIGNMENT + header->size, ALLOCATION_ALIGNMENT + size, MREMAP_MAYMOVE);
+		if (block == MAP_FAILED) {
+			return nullptr;
+		}
+
+		((AllocationHeader*)block)->size = size;
+		return (uint8_t*)block + ALLOCATION_ALIGNMENT;
+	}
+#endif
+
+	void* result = allocateMemory(size, false, policy);
+	if (result == nullptr) {
+		return nullptr;
+	}
+
+	std::memcpy(result, data, header->size < size ? header->size : size);
+	freeBlock(data);
+
+	return result;
+}
+
+void utils::freeMemory(void* data, AllocationPolicy policy) {
+	if (data == nullptr) {
+		return;
+	}
+
+	if (policy == AllocationPolicy::HEAP) {
+		std::free(data);
+	} else {
+		freeBlock(data);
+	}
+}
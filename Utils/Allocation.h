@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace utils {
+	// The alignment of the memory allocated with the ALIGNED and PAGES policies
+	// A cache line, which is enough for any SIMD load up to AVX-512
+	constexpr size_t ALLOCATION_ALIGNMENT = 64;
+
+	// The allocations starting from this size are backed by huge pages where the system supports it
+	constexpr size_t HUGE_PAGE_THRESHOLD = size_t(2) << 20;
+
+	// How a Buffer gets its memory
+	enum class AllocationPolicy : uint8_t {
+		// malloc/calloc/realloc, aligned by alignof(max_align_t) only
+		HEAP = 0,
+
+		// Aligned by ALLOCATION_ALIGNMENT, so that the SIMD loads of the first elements are aligned
+		ALIGNED,
+
+		// Fresh pages mapped from the system, aligned by ALLOCATION_ALIGNMENT as well
+		// The pages are zero already, so zero-initialized memory is zeroed lazily on the first touch instead of by memset,
+		// and the large blocks are backed by transparent huge pages, which reduces the TLB misses of the passes over them
+		// Small blocks, where a whole page would be a waste, fall back to ALIGNED
+		PAGES
+	};
+
+	// Allocate size bytes (zero ones if isZeroed) with the policy, return nullptr on failure
+	void* allocateMemory(size_t size, bool isZeroed, AllocationPolicy policy);
+
+	// Resizes the memory allocated with the same policy to size bytes, keeping its contents
+	// Returns nullptr on failure, the memory is not freed then
+	void* reallocateMemory(void* data, size_t size, AllocationPolicy policy);
+
+	// Frees the memory allocated with the same policy, nullptr is ignored
+	void freeMemory(void* data, AllocationPolicy policy);
+}
@@ -0,0 +1,58 @@
+#include "Arena.h"
+
+using namespace utils;
+
+Arena::~Arena() {
+	clear();
+}
+
+void Arena::clear() {
+	while (m_lastDestructor != nullptr) {
+		m_lastDestructor->destroy(m_lastDestructor->object);
+		m_lastDestructor = m_lastDestructor->prev;
+	}
+
+	while (m_lastBlock != nullptr) {
+		Block* prev = m_lastBlock->prev;
+		free(m_lastBlock);
+		m_lastBlock = prev;
+	}
+
+	m_pos = nullptr;
+	m_end = nullptr;
+	m_allocatedBytes = 0;
+}
+
+size_t Arena::getAllocatedBytes() const noexcept {
+	return m_allocatedBytes;
+}
+
+void* Arena::allocateSlow(size_t size, size_t alignment) {
+	// Enough space for the chunk itself and for aligning it
+	size_t blockSize = sizeof(Block) + size + alignment;
+	if (blockSize < BLOCK_SIZE) {
+		blockSize = BLOCK_SIZE;
+	}
+
+	Block* block = (Block*)malloc(blockSize);
+	if (block == nullptr) {
+		throw std::bad_alloc();
+	}
+
+	block->prev = m_lastBlock;
+	m_lastBlock = block;
+	m_allocatedBytes += blockSize;
+
+	uint8_t* blockData = (uint8_t*)(block + 1);
+	uint8_t* result = (uint8_t*)((uintptr_t(blockData) + alignment - 1) & ~uintptr_t(alignment - 1));
+
+	// Large chunks get a dedicated block, so the rest of the current one is not wasted
+	if (blockSize > BLOCK_SIZE && m_pos != nullptr) {
+		return result;
+	}
+
+	m_pos = result + size;
+	m_end = (uint8_t*)block + blockSize;
+
+	return result;
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <type_traits>
+#include <utility>
+
+namespace utils {
+	// A fixed-size array living within an Arena
+	// Does not own the memory, so it is freed together with the arena
+	template<typename T>
+	class ArenaArray final {
+	private:
+		T* m_data = nullptr;
+		size_t m_size = 0;
+
+	public:
+		ArenaArray() = default;
+		ArenaArray(T* data, size_t size)
+			: m_data(data), m_size(size) {
+
+		}
+
+		T* begin() const noexcept {
+			return m_data;
+		}
+
+		T* end() const noexcept {
+			return m_data + m_size;
+		}
+
+		T& operator[](size_t i) const {
+			assert(i < m_size);
+
+			return m_data[i];
+		}
+
+		size_t size() const noexcept {
+			return m_size;
+		}
+
+		bool isEmpty() const noexcept {
+			return m_size == 0;
+		}
+	};
+
+	// Bump allocator: places objects one after another within large blocks
+	// All the memory is released at once on the arena's destruction
+	// Destructors of non-trivially destructible objects are called then as well, in reverse order of creation
+	// Non-copiable and non-movable, since objects within it are referred by raw pointers
+	class Arena final {
+	public:
+		// The size of a usual block, larger allocations get a block of their own
+		static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	private:
+		struct Block {
+			Block* prev;
+		};
+
+		// A record to call the destructor of an object on the arena's destruction
+		struct Destructor {
+			Destructor* prev;
+			void (*destroy)(void*);
+			void* object;
+		};
+
+		Block* m_lastBlock = nullptr;
+		uint8_t* m_pos = nullptr;
+		uint8_t* m_end = nullptr;
+		Destructor* m_lastDestructor = nullptr;
+
+		size_t m_allocatedBytes = 0; // Total size of the blocks allocated
+
+	public:
+		Arena() = default;
+		Arena(const Arena&) = delete;
+		Arena(Arena&&) = delete;
+
+		void operator=(const Arena&) = delete;
+		void operator=(Arena&&) = delete;
+
+		~Arena();
+
+		// Returns a memory chunk of -size- bytes aligned to -alignment-
+		// Throws std::bad_alloc on allocation failure, same as the operator new
+		inline void* allocate(size_t size, size_t alignment) {
+			uint8_t* result = (uint8_t*)((uintptr_t(m_pos) + alignment - 1) & ~uintptr_t(alignment - 1));
+			if (m_pos == nullptr || result + size > m_end) {
+				return allocateSlow(size, alignment);
+			}
+
+			m_pos = result + size;
+			return result;
+		}
+
+		// Creates an object of type T within the arena
+		template<typename T, typename... Args>
+		T* make(Args&&... args) {
+			T* result = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+			// The destructor is registered only after the object is successfully constructed
+			if constexpr (!std::is_trivially_destructible_v<T>) {
+				Destructor* destructor = (Destructor*)allocate(sizeof(Destructor), alignof(Destructor));
+				destructor->prev = m_lastDestructor;
+				destructor->destroy = [](void* object) { ((T*)object)->~T(); };
+				destructor->object = result;
+				m_lastDestructor = destructor;
+			}
+
+			return result;
+		}
+
+		// Moves the values into an array within the arena
+		template<typename T>
+		ArenaArray<T> makeArray(std::vector<T>& values) {
+			static_assert(std::is_trivially_destructible_v<T>, "Arena arrays can contain trivially destructible values only");
+
+			if (values.empty()) {
+				return ArenaArray<T>();
+			}
+
+			T* data = (T*)allocate(sizeof(T) * values.size(), alignof(T));
+			for (size_t i = 0; i < values.size(); i++) {
+				new(data + i) T(std::move(values[i]));
+			}
+
+			return ArenaArray<T>(data, values.size());
+		}
+
+		// Destroys all the objects and frees all the memory
+		void clear();
+
+		// Returns the total size of the blocks allocated by the arena
+		size_t getAllocatedBytes() const noexcept;
+
+	private:
+		// Allocates a new block and returns a chunk from it
+		void* allocateSlow(size_t size, size_t alignment);
+	};
+}
\ No newline at end of file
@@ -1,10 +1,12 @@
 #pragma once
 #include "Result.h"
+#include "Allocation.h"
 
 namespace utils {
 	// Buffer is a type used to contain raw buffers (dynamic arrays)
+	// The memory is got with the Policy, see AllocationPolicy
 	// Non-copiable
-	template<typename T>
+	template<typename T, AllocationPolicy Policy = AllocationPolicy::HEAP>
 	class Buffer {
 	public:
 		// Byte-size of a single element
@@ -23,6 +25,11 @@ namespace utils {
 
 		void operator=(const Buffer&) = delete;
 		void operator=(Buffer&& other) noexcept {
+			if (this == &other) {
+				return;
+			}
+
+			freeMemory(m_data, Policy); // The previously contained memory would leak otherwise
 			m_data = other.m_data;
 			other.m_data = nullptr;
 		}
@@ -30,9 +37,9 @@ namespace utils {
 		// Instead of constructors static functions are used
 
 		// Returns a buffer with -size- zero-initialized -T-s or a Failure
-		static Result<Buffer<T>> alloc(size_t size) {
-			Buffer<T> result;
-			if ((result.m_data = (T*)calloc(size, ElemSize)) == nullptr) {
+		static Result<Buffer> alloc(size_t size) {
+			Buffer result;
+			if ((result.m_data = (T*)allocateMemory(size * ElemSize, true, Policy)) == nullptr) {
 				return Failure("Failed to allocate memory: " + QString::number(size * ElemSize) + " bytes");
 			}
 
@@ -40,9 +47,9 @@ namespace utils {
 		}
 
 		// Returns a buffer with -size- non-initialized -T-s or a Failure
-		static Result<Buffer<T>> allocNonInitialized(size_t size) {
-			Buffer<T> result;
-			if ((result.m_data = (T*)malloc(size * ElemSize)) == nullptr) {
+		static Result<Buffer> allocNonInitialized(size_t size) {
+			Buffer result;
+			if ((result.m_data = (T*)allocateMemory(size * ElemSize, false, Policy)) == nullptr) {
 				return Failure("Failed to allocate memory: " + QString::number(size * ElemSize) + " bytes");
 			}
 
@@ -52,14 +59,14 @@ namespace utils {
 		// Frees the memory
 		~Buffer() {
 			if (m_data != nullptr) {
-				free(m_data);
+				freeMemory(m_data, Policy);
 				m_data = nullptr;
 			}
 		}
 
 		// Tries to reallocate the contained memory for -size- elements and returns either Success or Failure
 		Result<Void> realloc(size_t size) {
-			if (T* data = (T*)::realloc(m_data, size * ElemSize); data != nullptr) {
+			if (T* data = (T*)reallocateMemory(m_data, size * ElemSize, Policy); data != nullptr) {
 				m_data = data;
 				return Success();
 			}
@@ -87,13 +94,13 @@ namespace utils {
 	};
 
 	// A Buffer with a size field
-	template<typename T>
-	class SizedBuffer : public Buffer<T> {
-		using Buffer<T>::m_data; // Needed because C++ cannot see base class fields in case of templates
+	template<typename T, AllocationPolicy Policy = AllocationPolicy::HEAP>
+	class SizedBuffer : public Buffer<T, Policy> {
+		using Buffer<T, Policy>::m_data; // Needed because C++ cannot see base class fields in case of templates
 
 	public:
 		// Byte-size of a single element
-		static constexpr size_t ElemSize = Buffer<T>::ElemSize;
+		static constexpr size_t ElemSize = Buffer<T, Policy>::ElemSize;
 
 	protected:
 		size_t m_size = 0;
@@ -101,13 +108,13 @@ namespace utils {
 	public:
 		SizedBuffer() = default;
 		SizedBuffer(SizedBuffer&& other) noexcept
-			: Buffer<T>(static_cast<Buffer<T>&&>(other)) {
+			: Buffer<T, Policy>(static_cast<Buffer<T, Policy>&&>(other)) {
 			m_size = other.m_size;
 			other.m_size = 0;
 		}
 
 		void operator=(SizedBuffer&& other) noexcept {
-			Buffer<T>::operator=(static_cast<Buffer<T>&&>(other));
+			Buffer<T, Policy>::operator=(static_cast<Buffer<T, Policy>&&>(other));
 			m_size = other.m_size;
 			other.m_size = 0;
 		}
@@ -115,9 +122,9 @@ namespace utils {
 		// Instead of constructors static functions are used
 
 		// Returns a buffer with -size- zero-initialized -T-s or a Failure
-		static Result<SizedBuffer<T>> alloc(size_t size) {
-			SizedBuffer<T> result;
-			if ((result.m_data = (T*)calloc(size, ElemSize)) == nullptr) {
+		static Result<SizedBuffer> alloc(size_t size) {
+			SizedBuffer result;
+			if ((result.m_data = (T*)allocateMemory(size * ElemSize, true, Policy)) == nullptr) {
 				return Failure("Failed to allocate memory: " + QString::number(size * ElemSize) + " bytes");
 			}
 
@@ -126,9 +133,9 @@ namespace utils {
 		}
 
 		// Returns a buffer with -size- non-initialized -T-s or a Failure
-		static Result<SizedBuffer<T>> allocNonInitialized(size_t size) {
-			SizedBuffer<T> result;
-			if ((result.m_data = (T*)malloc(size * ElemSize)) == nullptr) {
+		static Result<SizedBuffer> allocNonInitialized(size_t size) {
+			SizedBuffer result;
+			if ((result.m_data = (T*)allocateMemory(size * ElemSize, false, Policy)) == nullptr) {
 				return Failure("Failed to allocate memory: " + QString::number(size * ElemSize) + " bytes");
 			}
 
@@ -138,7 +145,7 @@ namespace utils {
 
 		// Tries to reallocate the contained memory for -size- elements and returns either Success or Failure
 		Result<Void> realloc(size_t size) {
-			if (T* data = (T*)::realloc(this->m_data, size * ElemSize); data != nullptr) {
+			if (T* data = (T*)reallocateMemory(this->m_data, size * ElemSize, Policy); data != nullptr) {
 				m_size = size;
 				m_data = data;
 				return Success();
@@ -177,111 +184,134 @@ namespace utils {
 		}
 	};
 
-	// A sized buffer for a dynamic array of fixed-size dynamic arrays
+	// A sized buffer for a dynamic array of fixed-size dynamic arrays, e.g. the rows of an image
+	// Takes a single allocation: the row pointers go first, then the rows one after another,
+	// each starting at a multiple of ALLOCATION_ALIGNMENT bytes (the pitch), so that the rows are aligned for SIMD loads
+	// The row pointers can be passed where T** is expected, e.g. to libpng
 	template<typename T>
-	class SizedBuffer2D final : public SizedBuffer<T*> {
-		using Buffer<T*>::m_data; // Needed because C++ cannot see base class fields in case of templates
-		using SizedBuffer<T*>::m_size; // Needed because C++ cannot see base class fields in case of templates
-
+	class SizedBuffer2D final {
 	public:
 		// Byte-size of a single element
 		static constexpr size_t ElemSize = sizeof(T);
 
 	private:
-		size_t m_subarraySize = 0; // The size of the allocated arrays
+		Buffer<uint8_t, AllocationPolicy::PAGES> m_memory;
+		size_t m_size = 0; // The number of the arrays
+		size_t m_subarraySize = 0; // The size of the arrays
+		size_t m_pitch = 0; // The bytes from the start of an array to the start of the next one
 
 	public:
 		SizedBuffer2D() = default;
 		SizedBuffer2D(SizedBuffer2D&& other) noexcept
-			: SizedBuffer<T*>(static_cast<SizedBuffer<T*>&&>(other)) {
-			m_subarraySize = other.m_subarraySize;
+			: m_memory(std::move(other.m_memory)), m_size(other.m_size), m_subarraySize(other.m_subarraySize), m_pitch(other.m_pitch) {
+			other.m_size = 0;
 			other.m_subarraySize = 0;
+			other.m_pitch = 0;
 		}
 
 		void operator=(SizedBuffer2D&& other) noexcept {
-			SizedBuffer<T*>::operator=(static_cast<SizedBuffer<T*>&&>(other));
+			m_memory = std::move(other.m_memory);
+			m_size = other.m_size;
 			m_subarraySize = other.m_subarraySize;
+			m_pitch = other.m_pitch;
+			other.m_size = 0;
 			other.m_subarraySize = 0;
-		}
-
-		~SizedBuffer2D() {
-			if (m_data != nullptr) {
-				for (size_t i = 0; i < m_size; i++) {
-					if (m_data[i] != nullptr) {
-						free(m_data[i]);
-						m_data[i] = nullptr;
-					}
-				}
-
-				m_data = nullptr;
-			}
+			other.m_pitch = 0;
 		}
 
 		// Instead of constructors static functions are used
-		static Result<SizedBuffer<T*>> alloc(size_t size) = delete;
-		static Result<SizedBuffer<T*>> allocNonInitialized(size_t size) = delete;
 
 		// Returns a buffer with -size1- zero-initialized arrays the size of -size2- or a Failure
 		static Result<SizedBuffer2D<T>> alloc(size_t size1, size_t size2) {
-			SizedBuffer2D<T> result;
-			if ((result.m_data = (T**)malloc(size1 * sizeof(T*))) == nullptr) {
-				return Failure("Failed to allocate memory: " + QString::number(size1 * (size2 + 1) * ElemSize) + " bytes");
-			}
-
-			result.m_size = size1;
-			result.m_subarraySize = size2;
-			for (size_t i = 0; i < size1; i++) {
-				if ((result.at(i) = (T*)calloc(size2, ElemSize)) == nullptr) {
-					return Failure("Failed to allocate memory: " + QString::number(size1 * (size2 + 1) * ElemSize) + " bytes");
-				}
-			}
-
-			return std::move(result);
+			return allocate(size1, size2, true);
 		}
 
-		// Returns a buffer with -size- non-initialized arrays the size of -size2- or a Failure
+		// Returns a buffer with -size1- non-initialized arrays the size of -size2- or a Failure
 		static Result<SizedBuffer2D<T>> allocNonInitialized(size_t size1, size_t size2) {
-			SizedBuffer2D<T> result;
-			if ((result.m_data = (T**)malloc(size1 * sizeof(T*))) == nullptr) {
-				return Failure("Failed to allocate memory: " + QString::number(size1 * (size2 + 1) * ElemSize) + " bytes");
-			}
+			return allocate(size1, size2, false);
+		}
 
-			result.m_size = size1;
-			result.m_subarraySize = size2;
-			for (size_t i = 0; i < size1; i++) {
-				if ((result.at(i) = (T*)malloc(size2 * ElemSize)) == nullptr) {
-					return Failure("Failed to allocate memory: " + QString::number(size1 * (size2 + 1) * ElemSize) + " bytes");
-				}
-			}
+		bool isEmpty() const noexcept {
+			return m_memory.isEmpty();
+		}
 
-			return std::move(result);
+		// Returns the pointers to the arrays
+		T** data() {
+			return (T**)m_memory.data();
 		}
 
-		// No realloc for this buffer
-		Result<Void> realloc(size_t size) = delete;
+		// Returns the pointers to the arrays as constant
+		const T* const* data() const {
+			return (const T* const*)m_memory.data();
+		}
 
-		// Safe element access
-		T*& operator[](size_t i) {
+		// Safe array access
+		T* operator[](size_t i) {
 			assert(i < m_size);
-			return m_data[i];
+			return data()[i];
 		}
 
-		// Safe const element access
-		const T*& operator[](size_t i) const {
+		// Safe const array access
+		const T* operator[](size_t i) const {
 			assert(i < m_size);
-			return m_data[i];
+			return data()[i];
 		}
 
-		// Quick element access, but without index check
+		// Quick array access, but without index check
 		// Must not be used unless absolutely necessary
-		T*& at(size_t i) {
-			return m_data[i];
+		T* at(size_t i) {
+			return data()[i];
 		}
 
-		// Quick const element access, but without index check
+		// Quick const array access, but without index check
 		// Must not be used unless absolutely necessary
-		const T*& at(size_t i) const {
-			return m_data[i];
+		const T* at(size_t i) const {
+			return data()[i];
+		}
+
+		// Returns the number of arrays contained
+		size_t size() const noexcept {
+			return m_size;
+		}
+
+		// Returns the number of elements in each array
+		size_t subarraySize() const noexcept {
+			return m_subarraySize;
+		}
+
+		// Returns the byte distance between the starts of two neighbouring arrays
+		size_t pitch() const noexcept {
+			return m_pitch;
+		}
+
+	private:
+		static size_t alignUp(size_t bytes) {
+			return (bytes + ALLOCATION_ALIGNMENT - 1) / ALLOCATION_ALIGNMENT * ALLOCATION_ALIGNMENT;
+		}
+
+		static Result<SizedBuffer2D<T>> allocate(size_t size1, size_t size2, bool isZeroed) {
+			size_t pitch = alignUp(size2 * ElemSize);
+			size_t pointersSize = alignUp(size1 * sizeof(T*));
+			size_t bytes = pointersSize + size1 * pitch;
+
+			SizedBuffer2D<T> result;
+			if (auto memory = isZeroed ? Buffer<uint8_t, AllocationPolicy::PAGES>::alloc(bytes)
+				: Buffer<uint8_t, AllocationPolicy::PAGES>::allocNonInitialized(bytes); !memory.isOk()) {
+				return memory.extractError();
+			} else {
+				result.m_memory = memory.extract();
+			}
+
+			result.m_size = size1;
+			result.m_subarraySize = size2;
+			result.m_pitch = pitch;
+
+			uint8_t* rows = result.m_memory.data() + pointersSize;
+			for (size_t i = 0; i < size1; i++) {
+				result.data()[i] = (T*)(rows + i * pitch);
+			}
+
+			return std::move(result);
 		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include "Buffer.h"
+
+namespace utils {
+	// A stack that never grows beyond the capacity set beforehand, none of its operations check the bounds
+	// Supposed to be used where the largest size is proven in advance, like in the VM running the verified bytecode
+	// Has the same names of the operations as QList, so that it can replace one
+	// Non-copiable, the contents can be copied with copyFrom()
+	template<typename T>
+	class FixedStack final {
+	private:
+		Buffer<T> m_buffer;
+		T* m_data = nullptr; // The buffer's memory, so that it is not asserted on each access
+		size_t m_size = 0;
+		size_t m_capacity = 0;
+
+	public:
+		FixedStack() = default;
+		FixedStack(const FixedStack&) = delete;
+		FixedStack(FixedStack&& other) noexcept
+			: m_buffer(std::move(other.m_buffer)), m_data(other.m_data), m_size(other.m_size), m_capacity(other.m_capacity) {
+			other.m_data = nullptr;
+			other.m_size = 0;
+			other.m_capacity = 0;
+		}
+
+		void operator=(const FixedStack&) = delete;
+		void operator=(FixedStack&& other) noexcept {
+			m_buffer = std::move(other.m_buffer);
+			m_data = std::exchange(other.m_data, nullptr);
+			m_size = std::exchange(other.m_size, 0);
+			m_capacity = std::exchange(other.m_capacity, 0);
+		}
+
+		// Reallocates the memory for -capacity- elements, the elements beyond it are dropped
+		Result<Void> setCapacity(size_t capacity) {
+			// At least a single element, so that the memory is always there
+			if (auto result = m_buffer.realloc(std::max(capacity, size_t(1))); !result.isOk()) {
+				return result.extractError();
+			}
+
+			m_data = m_buffer.data();
+			m_capacity = capacity;
+			m_size = std::min(m_size, capacity);
+
+			return Success();
+		}
+
+		size_t capacity() const noexcept {
+			return m_capacity;
+		}
+
+		// The other stack's elements must fit into the capacity
+		void copyFrom(const FixedStack& other) {
+			assert(other.m_size <= m_capacity);
+
+			std::copy(other.m_data, other.m_data + other.m_size, m_data);
+			m_size = other.m_size;
+		}
+
+		inline void push_back(const T& value) {
+			m_data[m_size++] = value;
+		}
+
+		inline void pop_back() {
+			m_size--;
+		}
+
+		inline T& back() {
+			return m_data[m_size - 1];
+		}
+
+		inline T& operator[](size_t index) {
+			return m_data[index];
+		}
+
+		inline const T& operator[](size_t index) const {
+			return m_data[index];
+		}
+
+		// Only the elements that were already there are kept, the new ones are not initialized
+		inline void resize(size_t size) {
+			m_size = size;
+		}
+
+		inline void clear() {
+			m_size = 0;
+		}
+
+		inline size_t size() const noexcept {
+			return m_size;
+		}
+
+		inline bool isEmpty() const noexcept {
+			return m_size == 0;
+		}
+
+		inline T* begin() {
+			return m_data;
+		}
+
+		inline T* end() {
+			return m_data + m_size;
+		}
+	};
+}
@@ -0,0 +1,110 @@
+#include "MappedFile.h"
+#include <cassert>
+#include <QDir>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+using namespace utils;
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: m_file(std::move(other.m_file)), m_data(other.m_data), m_size(other.m_size) {
+	other.m_data = nullptr;
+	other.m_size = 0;
+}
+
+MappedFile::~MappedFile() {
+	release();
+}
+
+void MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this == &other) {
+		return;
+	}
+
+	release(); // The previously mapped file would stay otherwise
+	m_file = std::move(other.m_file);
+	m_data = other.m_data;
+	m_size = other.m_size;
+	other.m_data = nullptr;
+	other.m_size = 0;
+}
+
+Result<MappedFile> MappedFile::createScratch(const QString& directory, size_t size) {
+	MappedFile result;
+	if (size == 0) { // QFile fails to map zero bytes
+		return std::move(result);
+	}
+
+	result.m_file = std::make_unique<QTemporaryFile>(QDir(directory).filePath("image_XXXXXX.scratch"));
+	if (!result.m_file->open()) {
+		return Failure("Failed to create a scratch file in " + directory);
+	}
+
+	// The file is extended without writing, so on most file systems the space is taken only once the pages are written
+	if (!result.m_file->resize(qint64(size))) {
+		return Failure("Failed to extend the scratch file to " + QString::number(size) + " bytes: " + result.m_file->fileName());
+	}
+
+	if ((result.m_data = result.m_file->map(0, qint64(size))) == nullptr) {
+		return Failure("Failed to map the scratch file: " + result.m_file->fileName());
+	}
+
+	result.m_size = size;
+	return std::move(result);
+}
+
+void MappedFile::advise(Access access) const {
+	if (m_data == nullptr) {
+		return;
+	}
+
+#ifdef Q_OS_UNIX
+	int advice = MADV_NORMAL;
+	switch (access) {
+		case Access::SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+		case Access::RANDOM: advice = MADV_RANDOM; break;
+		default: break;
+	}
+
+	// QFile maps the files with page-aligned addresses when the offset is 0, just a hint, so the result does not matter
+	madvise(m_data, m_size, advice);
+#else
+	(void)access;
+#endif
+}
+
+bool MappedFile::isEmpty() const noexcept {
+	return m_data == nullptr;
+}
+
+uint8_t* MappedFile::data() {
+	assert(m_data != nullptr && "No file mapped: cannot return");
+
+	return m_data;
+}
+
+const uint8_t* MappedFile::data() const {
+	assert(m_data != nullptr && "No file mapped: cannot return");
+
+	return m_data;
+}
+
+size_t MappedFile::size() const noexcept {
+	return m_size;
+}
+
+QString MappedFile::getFileName() const {
+	return m_file ? m_file->fileName() : "";
+}
+
+void MappedFile::release() {
+	if (m_data != nullptr) {
+		m_file->unmap(m_data);
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	m_file.reset(); // QTemporaryFile removes the file
+}
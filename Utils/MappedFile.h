@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <QTemporaryFile>
+#include "Result.h"
+
+namespace utils {
+	// A scratch file mapped into memory: its contents are paged in and out by the system,
+	// so it can be larger than RAM, and it is removed once the MappedFile is destroyed
+	// Non-copiable
+	class MappedFile final {
+	public:
+		// How the mapped memory is going to be accessed, used as a hint for the system's paging
+		enum class Access : uint8_t {
+			NORMAL = 0,
+			SEQUENTIAL, // From start to end once: read ahead aggressively, the passed pages can be dropped
+			RANDOM // Without any order: no read ahead
+		};
+
+	private:
+		std::unique_ptr<QTemporaryFile> m_file;
+		uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		~MappedFile();
+
+		void operator=(const MappedFile&) = delete;
+		void operator=(MappedFile&& other) noexcept;
+
+		// Instead of constructors static functions are used
+
+		// Creates a scratch file of -size- zero bytes in the directory and maps it, or returns a Failure
+		// An empty mapping is returned for zero bytes, since there is nothing to map
+		static Result<MappedFile> createScratch(const QString& directory, size_t size);
+
+		// Gives the system a hint on how the whole mapping is accessed from now on
+		// Ignored where such hints are not supported
+		void advise(Access access) const;
+
+		bool isEmpty() const noexcept;
+
+		uint8_t* data();
+		const uint8_t* data() const;
+		size_t size() const noexcept;
+		QString getFileName() const;
+
+	private:
+		// Unmaps and removes the file
+		void release();
+	};
+}
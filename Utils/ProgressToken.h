@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+
+namespace utils {
+	// Connects a long operation running in background with the ones waiting for it
+	// The operation reports its progress to the token and stops as soon as it notices the token is cancelled
+	// Can be used from any thread, each operation has a token of its own
+	class ProgressToken final {
+	private:
+		std::atomic<int> m_progress = 0; // In percents
+		std::atomic<bool> m_isCancelled = false;
+
+	public:
+		ProgressToken() = default;
+		ProgressToken(const ProgressToken&) = delete;
+
+		void operator=(const ProgressToken&) = delete;
+
+		inline void setProgress(int percents) noexcept {
+			m_progress.store(percents, std::memory_order_relaxed);
+		}
+
+		// Sets the progress as the part of the steps done, e.g. of the rows or the files
+		inline void setProgress(uint64_t done, uint64_t total) noexcept {
+			setProgress(total == 0 ? 100 : int(done * 100 / total));
+		}
+
+		inline int getProgress() const noexcept {
+			return m_progress.load(std::memory_order_relaxed);
+		}
+
+		// Asks the operation to stop
+		inline void cancel() noexcept {
+			m_isCancelled.store(true, std::memory_order_relaxed);
+		}
+
+		inline bool isCancelled() const noexcept {
+			return m_isCancelled.load(std::memory_order_relaxed);
+		}
+	};
+}
\ No newline at end of file
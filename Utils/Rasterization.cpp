@@ -1,4 +1,6 @@
 #include "Rasterization.h"
+#include <algorithm>
+#include <cmath>
 
 using namespace utils;
 
@@ -176,30 +178,159 @@ uint32_t utils::RectRasterizer::rowLength() {
 	return m_rowLength;
 }
 
-utils::CircleRasterizer::CircleRasterizer(QPoint center, float radius)
-	: m_center(center), m_radiusSqr((radius + 0.5) * (radius + 0.5)) {
+// The number of span tables each thread keeps
+constexpr uint32_t CIRCLE_SPAN_CACHE_SIZE = 8;
+
+// The radius the circles are clamped to, so that the rows' half-widths fit into int
+constexpr float CIRCLE_RADIUS_MAX = float(1u << 30);
+
+// The huge circles' rows are clamped to it, so that their lengths fit into int as the strokes require
+constexpr int64_t CIRCLE_X_MAX = INT32_MAX / 2;
+
+// The rows of the circles larger than the image are walked from one another while they differ by no more than this
+constexpr int64_t CIRCLE_WALK_STEPS_MAX = 8;
+
+// Integer square root, the largest x such that x^2 <= value, with Newton's method on integers only
+// The guess is one (e.g. the previous row's) to start from, the first step brings it to the root or above it,
+// from where the iterations go down to the root
+static int64_t floorSqrt(int64_t value, int64_t guess) {
+	if (value <= 0) {
+		return 0;
+	}
+
+	int64_t x = utils::max(guess, int64_t(1));
+	x = (x + value / x) / 2;
+	for (int64_t next = (x + value / x) / 2; next < x; next = (x + value / x) / 2) {
+		x = next;
+	}
+
+	return x;
+}
+
+// Builds the table with the midpoint-like walk: going down from the center's row x only decreases,
+// so it is enough to decrement it until the point gets inside the circle
+static std::vector<int32_t> buildCircleSpanTable(int64_t radiusSqr) {
+	int64_t x = floorSqrt(radiusSqr, 1);
+
+	std::vector<int32_t> spans(size_t(x) + 1);
+	int64_t yDistSqr = 0;
+	for (int64_t y = 0; y < int64_t(spans.size()); y++) {
+		while (x * x + yDistSqr > radiusSqr) {
+			x--;
+		}
+
+		spans[y] = int32_t(x);
+		yDistSqr += 2 * y + 1; // (y + 1)^2
+	}
+
+	return spans;
+}
+
+utils::CircleSpanTable utils::getCircleSpanTable(int64_t radiusSqr) {
+	struct CacheEntry {
+		int64_t radiusSqr = -1;
+		CircleSpanTable spans;
+	};
+
+	thread_local CacheEntry s_cache[CIRCLE_SPAN_CACHE_SIZE];
+	thread_local uint32_t s_nextEntry = 0;
+
+	for (CacheEntry& entry : s_cache) {
+		if (entry.radiusSqr == radiusSqr) {
+			return entry.spans;
+		}
+	}
+
+	CacheEntry& entry = s_cache[s_nextEntry];
+	s_nextEntry = (s_nextEntry + 1) % CIRCLE_SPAN_CACHE_SIZE;
+
+	entry.radiusSqr = radiusSqr;
+	entry.spans = std::make_shared<const std::vector<int32_t>>(buildCircleSpanTable(radiusSqr));
+
+	return entry.spans;
+}
+
+utils::CircleRasterizer::CircleRasterizer(QPoint center, float radius, uint32_t height)
+	: m_center(center) {
 	radius += 0.5;
-	m_y = utils::max(0, int(ceil(center.y() - radius)));
-	m_endY = int(center.y() + radius);
+	if (radius > CIRCLE_RADIUS_MAX) {
+		radius = CIRCLE_RADIUS_MAX;
+	}
+
+	// Only the rows within the image are walked, which there are none of for the inner circles of thin rings
+	double fromY = ceil(center.y() - double(radius));
+	double toY = utils::min(floor(center.y() + double(radius)), double(height) - 1);
+	if (!(radius >= 0) || toY < 0 || fromY > toY) {
+		m_y = 1;
+		m_endY = 0; // So that hasMore() would return false right away
+		m_xOffset = 0;
+		return;
+	}
+
+	m_y = uint32_t(utils::max(0.0, fromY));
+	m_endY = uint32_t(toY);
+	m_radiusSqr = int64_t(double(radius) * radius);
 
-	float yDistSqr = (m_y - m_center.y()) * (m_y - m_center.y());
-	m_xOffset = int(sqrt(m_radiusSqr - yDistSqr));
+	// The table has a row for each row of the radius, so only the circles that fit into the image's height have one,
+	// the rows of the larger ones are computed one by one
+	if (radius <= height) {
+		m_spans = getCircleSpanTable(m_radiusSqr);
+	}
+
+	m_xOffset = getXOffset();
 }
 
 void utils::CircleRasterizer::nextRow() {
 	m_y++;
 
 	// Updating internal data
-	float yDistSqr = (m_y - m_center.y()) * (m_y - m_center.y());
-	m_xOffset = int(sqrt(m_radiusSqr - yDistSqr));
+	m_xOffset = getXOffset();
+}
+
+int utils::CircleRasterizer::getXOffset() {
+	int64_t yDist = int64_t(m_y) - m_center.y();
+	int64_t index = yDist < 0 ? -yDist : yDist;
+
+	// The rows outside the circle (may happen on its very edge due to rounding) are a single pixel
+	if (m_spans != nullptr) {
+		return index < int64_t(m_spans->size()) ? (*m_spans)[index] : 0;
+	}
+
+	// The half-width is walked from the previous row's one as in the table's building, going towards the center's row it only increases
+	// Near the circle's top and bottom the rows differ by a lot, so there it is found with the integer square root from the previous one
+	int64_t rowSqr = m_radiusSqr - index * index;
+	if (rowSqr < 0) {
+		m_rowX = 0;
+		return 0;
+	}
+
+	for (int64_t steps = 0; m_rowX * m_rowX > rowSqr; steps++) {
+		if (steps == CIRCLE_WALK_STEPS_MAX) {
+			m_rowX = floorSqrt(rowSqr, m_rowX);
+			break;
+		}
+
+		m_rowX--;
+	}
+
+	for (int64_t steps = 0; (m_rowX + 1) * (m_rowX + 1) <= rowSqr; steps++) {
+		if (steps == CIRCLE_WALK_STEPS_MAX) {
+			m_rowX = floorSqrt(rowSqr, m_rowX);
+			break;
+		}
+
+		m_rowX++;
+	}
+
+	return int(m_rowX);
 }
 
 uint32_t utils::CircleRasterizer::leftX() {
-	return utils::max(0, m_center.x() - m_xOffset);
+	return uint32_t(utils::clamp(int64_t(m_center.x()) - m_xOffset, int64_t(0), CIRCLE_X_MAX));
 }
 
 uint32_t utils::CircleRasterizer::rightX() {
-	return utils::max(0, m_center.x() + m_xOffset);
+	return uint32_t(utils::clamp(int64_t(m_center.x()) + m_xOffset, int64_t(0), CIRCLE_X_MAX));
 }
 
 uint32_t utils::CircleRasterizer::rowLength() {
@@ -209,14 +340,15 @@ uint32_t utils::CircleRasterizer::rowLength() {
 utils::DoubleRasterizer<CircleRasterizer, CircleRasterizer> utils::RingRasterizer(
 	QPoint center,
 	float radius,
-	float lineWidth
+	float lineWidth,
+	uint32_t height
 ) {
 	float innerRadius = radius - lineWidth / 2;
 	float outerRadius = radius + lineWidth / 2;
 
 	return DoubleRasterizer<CircleRasterizer, CircleRasterizer>(
-		CircleRasterizer(center, innerRadius), 
-		CircleRasterizer(center, outerRadius)
+		CircleRasterizer(center, innerRadius, height), 
+		CircleRasterizer(center, outerRadius, height)
 	);
 }
 
@@ -237,3 +369,363 @@ utils::DoubleRasterizer<RectRasterizer, RectRasterizer> utils::HollowRectRasteri
 		RectRasterizer(outerFrom, outerTo)
 	);
 }
+
+
+// The first row (or column) with the pixels' centers at or after the coordinate, within [0, limit]
+static inline uint32_t ceilToPixel(double value, uint32_t limit) {
+	if (!(value > 0)) {
+		return 0;
+	}
+
+	double result = std::ceil(value);
+	return result >= limit ? limit : uint32_t(result);
+}
+
+utils::PolygonRasterizer::PolygonRasterizer(std::span<const QPointF> points, FillRule rule, uint32_t width, uint32_t height)
+	: m_rule(rule), m_width(width) {
+	m_y = 1; // Empty until there are edges within the image
+	m_endY = 0;
+
+	for (const QPointF& point : points) {
+		if (!std::isfinite(point.x()) || !std::isfinite(point.y())) {
+			return;
+		}
+	}
+
+	m_edges.reserve(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		QPointF from = points[i];
+		QPointF to = points[(i + 1) % points.size()];
+
+		int32_t winding = 1;
+		if (from.y() > to.y()) {
+			std::swap(from, to);
+			winding = -1;
+		}
+
+		// The horizontal edges, the ones outside of the image and the ones between two rows cross no row
+		uint32_t fromY = ceilToPixel(from.y(), height);
+		uint32_t toY = ceilToPixel(to.y(), height);
+		if (fromY >= toY) {
+			continue;
+		}
+
+		m_edges.push_back(Edge{ from, (to.x() - from.x()) / (to.y() - from.y()), fromY, toY, winding, 0 });
+		m_endY = max(m_endY, toY - 1);
+	}
+
+	if (m_edges.empty()) {
+		return;
+	}
+
+	std::sort(m_edges.begin(), m_edges.end(), [](const Edge& a, const Edge& b) { return a.fromY < b.fromY; });
+
+	m_y = m_edges.front().fromY;
+	m_activeEdges.reserve(m_edges.size());
+	rasterizeRow();
+}
+
+void utils::PolygonRasterizer::rasterizeRow() {
+	// Updating the active edge table: the edges that ended are removed, the ones that start at this row are added
+	std::erase_if(m_activeEdges, [this](uint32_t edge) { return m_edges[edge].toY <= m_y; });
+	while (m_nextEdge < m_edges.size() && m_edges[m_nextEdge].fromY <= m_y) {
+		m_activeEdges.push_back(uint32_t(m_nextEdge++));
+	}
+
+	for (uint32_t edge : m_activeEdges) {
+		Edge& e = m_edges[edge];
+		e.x = e.top.x() + (m_y - e.top.y()) * e.xOffset;
+	}
+
+	// Insertion sort, since the order only changes where the edges cross or start, it is almost sorted
+	for (size_t i = 1; i < m_activeEdges.size(); i++) {
+		uint32_t edge = m_activeEdges[i];
+		size_t j = i;
+		for (; j > 0 && m_edges[m_activeEdges[j - 1]].x > m_edges[edge].x; j--) {
+			m_activeEdges[j] = m_activeEdges[j - 1];
+		}
+
+		m_activeEdges[j] = edge;
+	}
+
+	// Going from left to right, a span starts where the row enters the polygon and ends where it leaves it
+	m_spans.clear();
+
+	int32_t winding = 0;
+	double spanFromX = 0;
+	for (uint32_t edge : m_activeEdges) {
+		const Edge& e = m_edges[edge];
+		int32_t prevWinding = winding;
+		winding = m_rule == FillRule::EVEN_ODD ? (winding ^ 1) : winding + e.winding;
+
+		if (prevWinding == 0 && winding != 0) {
+			spanFromX = e.x;
+		} else if (prevWinding != 0 && winding == 0) {
+			uint32_t fromX = ceilToPixel(spanFromX, m_width);
+			uint32_t toX = ceilToPixel(e.x, m_width);
+			if (fromX >= toX) {
+				continue;
+			}
+
+			if (!m_spans.empty() && m_spans.back().x + m_spans.back().length == fromX) { // Touching spans are merged
+				m_spans.back().length += toX - fromX;
+			} else {
+				m_spans.push_back(RowSpan{ fromX, toX - fromX });
+			}
+		}
+	}
+}
+
+void utils::PolygonRasterizer::nextRow() {
+	m_y++;
+	if (m_y <= m_endY) {
+		rasterizeRow();
+	}
+}
+
+std::span<const utils::RowSpan> utils::PolygonRasterizer::spans() const {
+	return m_spans;
+}
+
+
+// Converts a coordinate to a pixel index, keeping it within the int range for the far-away shapes
+static inline int floorToPixel(double x) {
+	return int(utils::clamp(floor(x), -1e9, 1e9));
+}
+
+static inline int ceilToPixel(double x) {
+	return int(utils::clamp(ceil(x), -1e9, 1e9));
+}
+
+// Half of the width of a circle's row that is dy away from the center, or -1 if the row does not cross the circle
+static inline double getRowHalfWidth(double radius, double dy) {
+	if (radius < 0 || radius * radius < dy * dy) {
+		return -1;
+	}
+
+	return sqrt(radius * radius - dy * dy);
+}
+
+// The pixels whose centers are within the row's half width from the center
+static inline utils::CoverageRasterizer::ExactInterval getRowInterval(double centerX, double halfWidth, bool isCovered) {
+	if (halfWidth < 0) {
+		return { 0, -1, isCovered };
+	}
+
+	return { ceilToPixel(centerX - halfWidth), floorToPixel(centerX + halfWidth), isCovered };
+}
+
+// Finds the X's for which lower <= k * X + c <= upper
+// Returns false if there are none, the interval is infinite if k is 0
+static bool solveSlab(double k, double c, double lower, double upper, double& from, double& to) {
+	if (lower > upper) {
+		return false;
+	}
+
+	if (std::abs(k) < 1e-12) {
+		from = -1e18;
+		to = 1e18;
+		return c >= lower && c <= upper;
+	}
+
+	from = (lower - c) / k;
+	to = (upper - c) / k;
+	if (from > to) {
+		std::swap(from, to);
+	}
+
+	return true;
+}
+
+utils::CoverageRasterizer::CoverageRasterizer(uint32_t width)
+	: m_width(width) {
+
+}
+
+void utils::CoverageRasterizer::nextRow() {
+	m_y++;
+
+	if (hasMore()) {
+		rasterizeRow();
+	}
+}
+
+std::span<const CoverageSpan> utils::CoverageRasterizer::spans() const {
+	return std::span<const CoverageSpan>(m_spans, m_spansCount);
+}
+
+void utils::CoverageRasterizer::buildRow(int fromX, int toX, std::initializer_list<ExactInterval> exactIntervals) {
+	m_spansCount = 0;
+
+	fromX = utils::max(fromX, 0);
+	toX = int(utils::min(int64_t(toX), int64_t(m_width) - 1));
+	if (toX < fromX) {
+		return;
+	}
+
+	// Allocated for the whole row beforehand, so that the spans can point to it
+	if (m_coverage.size() < size_t(toX - fromX + 1)) {
+		m_coverage.resize(size_t(toX - fromX + 1));
+	}
+
+	auto addPartialSpan = [&](int from, int to) {
+		if (from > to) {
+			return;
+		}
+
+		uint8_t* coverage = &m_coverage[from - fromX];
+		for (int x = from; x <= to; x++) {
+			coverage[x - from] = uint8_t(utils::clamp(coverageAt(x), 0.0, 1.0) * 255 + 0.5);
+		}
+
+		assert(m_spansCount < MAX_SPANS);
+		m_spans[m_spansCount++] = { uint32_t(from), uint32_t(to - from + 1), coverage };
+	};
+
+	int x = fromX;
+	for (const ExactInterval& interval : exactIntervals) {
+		int from = utils::max(interval.from, x);
+		int to = utils::min(interval.to, toX);
+		if (from > to) {
+			continue;
+		}
+
+		addPartialSpan(x, from - 1);
+		if (interval.isCovered) {
+			assert(m_spansCount < MAX_SPANS);
+			m_spans[m_spansCount++] = { uint32_t(from), uint32_t(to - from + 1), nullptr };
+		}
+
+		x = to + 1;
+	}
+
+	addPartialSpan(x, toX);
+}
+
+utils::AntialiasedCircleRasterizer::AntialiasedCircleRasterizer(QPointF center, float radius, uint32_t width)
+	: CoverageRasterizer(width), m_center(center), m_radius(radius + 0.5) {
+	if (m_radius < 0 || center.y() + m_radius + 0.5 < 0) { // Nothing to rasterize
+		m_y = 1;
+		m_endY = 0; // So that hasMore() would return false right away
+		return;
+	}
+
+	m_y = utils::max(0, ceilToPixel(center.y() - m_radius - 0.5));
+	m_endY = floorToPixel(center.y() + m_radius + 0.5);
+
+	rasterizeRow();
+}
+
+void utils::AntialiasedCircleRasterizer::rasterizeRow() {
+	double dy = m_y - m_center.y();
+
+	// The pixels touched by the circle and the fully covered ones
+	ExactInterval touched = getRowInterval(m_center.x(), getRowHalfWidth(m_radius + 0.5, dy), false);
+	ExactInterval covered = getRowInterval(m_center.x(), getRowHalfWidth(m_radius - 0.5, dy), true);
+
+	buildRow(touched.from, touched.to, { covered });
+}
+
+double utils::AntialiasedCircleRasterizer::coverageAt(int x) const {
+	return m_radius + 0.5 - utils::distance(QPointF(x, m_y), m_center);
+}
+
+utils::AntialiasedRingRasterizer::AntialiasedRingRasterizer(QPointF center, float radius, float lineWidth, uint32_t width)
+	: CoverageRasterizer(width), m_center(center), m_innerRadius(radius - lineWidth / 2 + 0.5), m_outerRadius(radius + lineWidth / 2 + 0.5) {
+	if (m_outerRadius < 0 || center.y() + m_outerRadius + 0.5 < 0) { // Nothing to rasterize
+		m_y = 1;
+		m_endY = 0; // So that hasMore() would return false right away
+		return;
+	}
+
+	m_y = utils::max(0, ceilToPixel(center.y() - m_outerRadius - 0.5));
+	m_endY = floorToPixel(center.y() + m_outerRadius + 0.5);
+
+	rasterizeRow();
+}
+
+void utils::AntialiasedRingRasterizer::rasterizeRow() {
+	double dy = m_y - m_center.y();
+
+	ExactInterval touched = getRowInterval(m_center.x(), getRowHalfWidth(m_outerRadius + 0.5, dy), false);
+	ExactInterval outerCovered = getRowInterval(m_center.x(), getRowHalfWidth(m_outerRadius - 0.5, dy), true);
+	ExactInterval innerTouched = getRowInterval(m_center.x(), getRowHalfWidth(m_innerRadius + 0.5, dy), false);
+	ExactInterval innerCovered = getRowInterval(m_center.x(), getRowHalfWidth(m_innerRadius - 0.5, dy), false);
+
+	if (innerTouched.from > innerTouched.to) { // The row does not cross the hole
+		buildRow(touched.from, touched.to, { outerCovered });
+		return;
+	}
+
+	// The fully covered pixels are the ones around the hole, and there are none within the hole itself
+	ExactInterval leftCovered = { outerCovered.from, utils::min(outerCovered.to, innerTouched.from - 1), true };
+	ExactInterval rightCovered = { utils::max(outerCovered.from, innerTouched.to + 1), outerCovered.to, true };
+
+	buildRow(touched.from, touched.to, { leftCovered, innerCovered, rightCovered });
+}
+
+double utils::AntialiasedRingRasterizer::coverageAt(int x) const {
+	double distance = utils::distance(QPointF(x, m_y), m_center);
+	double outerCoverage = utils::clamp(m_outerRadius + 0.5 - distance, 0.0, 1.0);
+	double innerCoverage = utils::clamp(m_innerRadius + 0.5 - distance, 0.0, 1.0);
+
+	return outerCoverage - innerCoverage;
+}
+
+utils::AntialiasedLineRasterizer::AntialiasedLineRasterizer(QPointF from, QPointF to, float lineWidth, uint32_t width)
+	: CoverageRasterizer(width), m_from(from), m_length(utils::distance(from, to)), m_halfWidth(utils::max(lineWidth, 1.f) / 2) {
+	m_direction = m_length > 0 ? (to - from) / m_length : QPointF(1, 0);
+	m_normal = QPointF(-m_direction.y(), m_direction.x());
+
+	// The rectangle's corners are at most half of the width (and a pixel for the coverage) away from the ends
+	double upperY = utils::min(from.y(), to.y()) - m_halfWidth - 1;
+	double lowerY = utils::max(from.y(), to.y()) + m_halfWidth + 1;
+	if (lowerY < 0) { // Nothing to rasterize
+		m_y = 1;
+		m_endY = 0; // So that hasMore() would return false right away
+		return;
+	}
+
+	m_y = utils::max(0, ceilToPixel(upperY));
+	m_endY = floorToPixel(lowerY);
+
+	rasterizeRow();
+}
+
+void utils::AntialiasedLineRasterizer::rasterizeRow() {
+	double dy = m_y - m_from.y();
+
+	// The pixels of the row for which the distance to the line's axis is within halfWidth
+	// and the projection onto the axis is within [0, length], with the extra half a pixel for the partially covered ones
+	auto getInterval = [&](double extra, bool isCovered) -> ExactInterval {
+		double acrossFrom, acrossTo, alongFrom, alongTo;
+		if (!solveSlab(m_normal.x(), m_normal.y() * dy, -m_halfWidth - extra, m_halfWidth + extra, acrossFrom, acrossTo)
+			|| !solveSlab(m_direction.x(), m_direction.y() * dy, -extra, m_length + extra, alongFrom, alongTo)) {
+			return { 0, -1, isCovered };
+		}
+
+		double from = utils::max(acrossFrom, alongFrom);
+		double to = utils::min(acrossTo, alongTo);
+		if (from > to) {
+			return { 0, -1, isCovered };
+		}
+
+		return { ceilToPixel(m_from.x() + from), floorToPixel(m_from.x() + to), isCovered };
+	};
+
+	ExactInterval touched = getInterval(0.5, false);
+	ExactInterval covered = getInterval(-0.5, true);
+
+	buildRow(touched.from, touched.to, { covered });
+}
+
+double utils::AntialiasedLineRasterizer::coverageAt(int x) const {
+	QPointF offset = QPointF(x, m_y) - m_from;
+	double across = std::abs(offset.x() * m_normal.x() + offset.y() * m_normal.y());
+	double along = offset.x() * m_direction.x() + offset.y() * m_direction.y();
+
+	double acrossCoverage = utils::clamp(m_halfWidth + 0.5 - across, 0.0, 1.0);
+	double alongCoverage = utils::clamp(utils::min(along, m_length - along) + 0.5, 0.0, 1.0);
+
+	return acrossCoverage * alongCoverage;
+}
@@ -1,5 +1,8 @@
 #pragma once
 #include <concepts>
+#include <memory>
+#include <span>
+#include <vector>
 #include <QPoint>
 #include "MathUtils.h"
 
@@ -118,16 +121,30 @@ namespace utils {
 		uint32_t rowLength() override; // Current row's width
 	};
 
+	// Half-widths of a circle's rows, indexed by the row's distance from the center's row
+	// The half-width of a row dy is the largest x such that x^2 + dy^2 <= r^2 (r^2 rounded down to an integer),
+	// it is computed incrementally with integer arithmetics only
+	// Tables are cached per thread for a few last radii, so drawing the same circle many times (e.g. with a pen) computes it once
+	// A table has a row for each row of the radius, so the rasterizer only builds them for the circles that fit into the image's height
+	using CircleSpanTable = std::shared_ptr<const std::vector<int32_t>>;
+
+	CircleSpanTable getCircleSpanTable(int64_t radiusSqr);
+
 	// Allows to get all the pairs of left-most and right-most pairs of pixel positions for every row
 	// For a circle
 	class CircleRasterizer final : public SingleRasterizer {
 	private:
 		QPoint m_center;
-		double m_radiusSqr;
+		CircleSpanTable m_spans; // Null for the circles larger than the image, their rows are walked from one another
+		int64_t m_radiusSqr = 0;
+		int64_t m_rowX = 0; // The last row's half-width, if there is no table
 		int m_xOffset;
 
+		int getXOffset(); // For the current row
+
 	public:
-		CircleRasterizer(QPoint center, float radius);
+		// The rows are limited to the image's height
+		CircleRasterizer(QPoint center, float radius, uint32_t height);
 
 		void nextRow() override;
 
@@ -261,9 +278,173 @@ namespace utils {
 
 	// Creates a double rasterizer for a ring
 	// Allows to get all the pairs of left-most and right-most pairs of pixel positions for every row
-	DoubleRasterizer<CircleRasterizer, CircleRasterizer> RingRasterizer(QPoint center, float radius, float lineWidth);
+	DoubleRasterizer<CircleRasterizer, CircleRasterizer> RingRasterizer(QPoint center, float radius, float lineWidth, uint32_t height);
 
 	// Creates a double rasterizer for a hollow rect
 	// Allows to get all the pairs of left-most and right-most pairs of pixel positions for every row
 	DoubleRasterizer<RectRasterizer, RectRasterizer> HollowRectRasterizer(QPoint from, QPoint to, float lineWidth);
+
+
+	// The rule deciding which parts of a self-intersecting polygon are inside of it
+	enum class FillRule : uint8_t {
+		NON_ZERO = 0, // Inside are the points the polygon winds around at least once in total
+		EVEN_ODD // Inside are the points with an odd number of edges to their left
+	};
+
+	// A piece of a row, all of its pixels are filled
+	struct RowSpan {
+		uint32_t x = 0;
+		uint32_t length = 0;
+	};
+
+	// Allows to get all the spans of a filled polygon for every row, the polygon can be concave and self-intersecting
+	// Works with an edge table sorted by the top Y and an active edge table of the edges crossing the current row
+	// A pixel is filled if its center (x, y) is inside of the polygon, the pixels exactly on the left and top edges are filled,
+	// the ones on the right and bottom edges are not, so that the polygons sharing an edge do not overlap
+	// The rows and spans are clipped to the image (width x height)
+	// Usage example:
+	//		while (rast.hasMore()) {
+	//			for (const RowSpan& span : rast.spans()) {
+	//				drawXStroke(span.x, rast.getY(), span.length, color);
+	//			}
+	//
+	//			rast.nextRow();
+	//		}
+	class PolygonRasterizer final : public BasicRasterizer {
+	private:
+		struct Edge {
+			QPointF top;
+			double xOffset; // dx/dy
+			uint32_t fromY; // The first row crossing the edge
+			uint32_t toY; // The row after the last one
+			int32_t winding; // 1 if the edge goes down, -1 otherwise
+			double x; // For the current row
+		};
+
+		std::vector<Edge> m_edges; // Sorted by fromY
+		size_t m_nextEdge = 0; // The first edge that is not active yet
+		std::vector<uint32_t> m_activeEdges; // Indices of the edges, sorted by the current row's X
+		std::vector<RowSpan> m_spans;
+
+		FillRule m_rule;
+		uint32_t m_width;
+
+		void rasterizeRow();
+
+	public:
+		// The polygon is closed, i.e. the last point is connected to the first one
+		PolygonRasterizer(std::span<const QPointF> points, FillRule rule, uint32_t width, uint32_t height);
+
+		void nextRow() override;
+
+		std::span<const RowSpan> spans() const; // Current row's spans, sorted by X
+	};
+
+
+	// A piece of a row of an anti-aliased shape
+	struct CoverageSpan {
+		uint32_t x = 0;
+		uint32_t length = 0;
+		const uint8_t* coverage = nullptr; // The covered part of each pixel (0 - 255), nullptr if all the pixels are covered fully
+	};
+
+	// Basic class for the anti-aliased rasterizers
+	// Splits some shape into rows of spans: the pixels on the shape's edges get the part of them covered by the shape,
+	// the ones inside of the shape form solid spans, so that they can be filled at once
+	// The covered part of a pixel is estimated by the distance from its center to the edge,
+	// which is exact for the edges along the axes and very close to the area for the rest
+	// The X is guaranteed to be within the image width, but the rows can be out of image height, this should be handled outside
+	// Usage example:
+	//		while (rast.hasMore()) {
+	//			for (const CoverageSpan& span : rast.spans()) {
+	//				span.coverage == nullptr ? fillStroke(span.x, rast.getY(), span.length) : blendStroke(...);
+	//			}
+	//
+	//			rast.nextRow();
+	//		}
+	class CoverageRasterizer : public BasicRasterizer {
+	public:
+		// A part of the current row, all the pixels of which are either fully covered or not covered at all
+		struct ExactInterval {
+			int from = 0;
+			int to = -1; // Inclusive
+			bool isCovered = false;
+		};
+
+	private:
+		static constexpr uint32_t MAX_SPANS = 8;
+
+		CoverageSpan m_spans[MAX_SPANS];
+		uint32_t m_spansCount = 0;
+		std::vector<uint8_t> m_coverage; // For the current row's spans
+		uint32_t m_width; // The image's one, the pixels beyond it are not computed
+
+	public:
+		CoverageRasterizer(uint32_t width);
+		virtual ~CoverageRasterizer() = default;
+
+		void nextRow() override;
+
+		std::span<const CoverageSpan> spans() const; // Current row's spans
+
+	protected:
+		// Called for each row, must call buildRow()
+		virtual void rasterizeRow() = 0;
+
+		// The covered part of the current row's pixel, 0 to 1
+		virtual double coverageAt(int x) const = 0;
+
+		// Splits the current row's pixels from fromX to toX (inclusive) into spans, the ones out of the image are skipped
+		// The exact intervals must be sorted and must not intersect, the rest of the pixels are computed with coverageAt()
+		void buildRow(int fromX, int toX, std::initializer_list<ExactInterval> exactIntervals);
+	};
+
+	// Allows to get all the spans of an anti-aliased filled circle for every row
+	// Has the same size as CircleRasterizer's circle of the same radius
+	class AntialiasedCircleRasterizer final : public CoverageRasterizer {
+	private:
+		QPointF m_center;
+		double m_radius;
+
+	public:
+		AntialiasedCircleRasterizer(QPointF center, float radius, uint32_t width);
+
+	protected:
+		void rasterizeRow() override;
+		double coverageAt(int x) const override;
+	};
+
+	// Allows to get all the spans of an anti-aliased ring for every row
+	// Has the same size as RingRasterizer's ring of the same radius and line width
+	class AntialiasedRingRasterizer final : public CoverageRasterizer {
+	private:
+		QPointF m_center;
+		double m_innerRadius;
+		double m_outerRadius;
+
+	public:
+		AntialiasedRingRasterizer(QPointF center, float radius, float lineWidth, uint32_t width);
+
+	protected:
+		void rasterizeRow() override;
+		double coverageAt(int x) const override;
+	};
+
+	// Allows to get all the spans of an anti-aliased line for every row
+	// The line is a rectangle with the ends at from and to, the thin lines are drawn 1 pixel wide
+	class AntialiasedLineRasterizer final : public CoverageRasterizer {
+	private:
+		QPointF m_from;
+		QPointF m_direction; // Normalized
+		QPointF m_normal;
+		double m_length;
+		double m_halfWidth;
+
+	public:
+		AntialiasedLineRasterizer(QPointF from, QPointF to, float lineWidth, uint32_t width);
+
+	protected:
+		void rasterizeRow() override;
+		double coverageAt(int x) const override;
+	};
 }
\ No newline at end of file
@@ -0,0 +1,139 @@
+#include "Trace.h"
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <QFile>
+#include <QTextStream>
+
+using namespace utils::trace;
+
+// A finished scope
+struct Event {
+	const char* name;
+	int64_t startNs;
+	int64_t durationNs;
+};
+
+// The events of a single thread, only that thread writes to it
+struct ThreadBuffer {
+	uint32_t threadIndex;
+	std::unique_ptr<Event[]> events = std::make_unique<Event[]>(EVENTS_PER_THREAD);
+	std::atomic<uint64_t> eventsCount = 0; // Recorded since the start, the event i is at i % EVENTS_PER_THREAD
+	std::atomic<bool> isWriting = false; // Set while an event is being written, so the events are not read or reset meanwhile
+};
+
+// The buffers are kept till the program exits, since the threads may finish before the events are written
+static std::mutex s_buffersMutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+static thread_local ThreadBuffer* t_buffer = nullptr;
+
+// Set before the tracing is enabled, so the threads that see it enabled see the new one
+static std::atomic<std::chrono::steady_clock::rep> s_startTime = 0;
+
+static ThreadBuffer& getThreadBuffer() {
+	if (t_buffer == nullptr) {
+		std::lock_guard lock(s_buffersMutex);
+		s_buffers.push_back(std::make_unique<ThreadBuffer>());
+		t_buffer = s_buffers.back().get();
+		t_buffer->threadIndex = uint32_t(s_buffers.size() - 1);
+	}
+
+	return *t_buffer;
+}
+
+int64_t detail::now() noexcept {
+	std::chrono::steady_clock::duration sinceStart =
+		std::chrono::steady_clock::now().time_since_epoch() - std::chrono::steady_clock::duration(s_startTime.load(std::memory_order_acquire));
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(sinceStart).count();
+}
+
+// Waits for the events being written to be finished, the tracing must be stopped already so that no new ones are started
+// The writers set their flag before checking whether the tracing is enabled and it is stopped before the flags are checked,
+// so any writer either sees it stopped and drops its event or is waited for here
+static void waitForWriters() {
+	for (auto& buffer : s_buffers) {
+		while (buffer->isWriting.load(std::memory_order_seq_cst)) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void detail::record(const char* name, int64_t startNs) noexcept {
+	int64_t endNs = now();
+
+	ThreadBuffer& buffer = getThreadBuffer();
+	buffer.isWriting.store(true, std::memory_order_seq_cst);
+
+	// The tracing was stopped while in the scope, the events may be being written already
+	if (!detail::isRecording.load(std::memory_order_seq_cst)) {
+		buffer.isWriting.store(false, std::memory_order_release);
+		return;
+	}
+
+	uint64_t index = buffer.eventsCount.load(std::memory_order_relaxed);
+	buffer.events[index % EVENTS_PER_THREAD] = Event{ name, startNs, endNs - startNs };
+	buffer.eventsCount.store(index + 1, std::memory_order_release);
+	buffer.isWriting.store(false, std::memory_order_release);
+}
+
+utils::Result<Void> utils::trace::start() {
+#ifdef CW2_NO_TRACING
+	return utils::Failure("The tracing is compiled out, the program must be built without CW2_NO_TRACING");
+#else
+	detail::isRecording.store(false, std::memory_order_seq_cst);
+
+	{
+		std::lock_guard lock(s_buffersMutex);
+		waitForWriters();
+		for (auto& buffer : s_buffers) {
+			buffer->eventsCount.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	s_startTime.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_release);
+	detail::isRecording.store(true, std::memory_order_seq_cst);
+
+	return utils::Success();
+#endif
+}
+
+utils::Result<Void> utils::trace::stopAndWrite(const QString& fileName) {
+	detail::isRecording.store(false, std::memory_order_seq_cst);
+
+	QFile file(fileName);
+	if (!file.open(QFile::WriteOnly | QFile::Text)) {
+		return utils::Failure("Failed to open file: " + fileName);
+	}
+
+	// The complete events ("ph": "X") with the times in microseconds, the names are the functions' ones and need no escaping
+	QTextStream out(&file);
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+	bool isFirst = true;
+	std::lock_guard lock(s_buffersMutex);
+	waitForWriters();
+	for (const auto& buffer : s_buffers) {
+		uint64_t eventsCount = buffer->eventsCount.load(std::memory_order_acquire);
+		uint64_t from = eventsCount > EVENTS_PER_THREAD ? eventsCount - EVENTS_PER_THREAD : 0;
+
+		for (uint64_t i = from; i < eventsCount; i++) {
+			const Event& event = buffer->events[i % EVENTS_PER_THREAD];
+			out << (isFirst ? "\n" : ",\n")
+				<< "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->threadIndex
+				<< ", \"ts\": " << QString::number(event.startNs / 1e3, 'f', 3)
+				<< ", \"dur\": " << QString::number(event.durationNs / 1e3, 'f', 3) << "}";
+
+			isFirst = false;
+		}
+	}
+
+	out << "\n]}\n";
+	out.flush();
+
+	if (out.status() != QTextStream::Ok) {
+		return utils::Failure("Failed to write the file: " + fileName);
+	}
+
+	return utils::Success();
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <QString>
+#include "Result.h"
+#include "Void.h"
+
+// Tracing of the hot paths
+// The scopes marked with trace_scope record the time they took as events to a ring buffer of the thread they run on,
+// so the threads never wait for each other and the latest events of each thread are kept however long the tracing goes
+// The events are written as Chrome trace-event JSON, which chrome://tracing and Perfetto show as a timeline
+// While the tracing is stopped a scope costs a single check, with CW2_NO_TRACING defined the scopes are compiled out completely
+// Usage example:
+//		void Image::fillRect(...) {
+//			trace_scope("Image::fillRect");
+//			...
+//		}
+namespace utils::trace {
+	// The number of the latest events kept for each thread
+	constexpr uint32_t EVENTS_PER_THREAD = 1 << 16;
+
+	namespace detail {
+		inline std::atomic<bool> isRecording = false;
+
+		// The time since the tracing was started
+		int64_t now() noexcept;
+
+		// Adds the event to the calling thread's buffer
+		void record(const char* name, int64_t startNs) noexcept;
+	}
+
+	// Starts recording the events, the ones recorded before are dropped
+	// Fails if the tracing is compiled out
+	utils::Result<Void> start();
+
+	// Stops recording and writes the events recorded since the start to the file
+	utils::Result<Void> stopAndWrite(const QString& fileName);
+
+	inline bool isEnabled() noexcept {
+		return detail::isRecording.load(std::memory_order_acquire);
+	}
+
+	// Records the time from its construction to its destruction as an event with the name
+	// The name is kept as a pointer, so it must be a string literal
+	class Scope final {
+	private:
+		const char* m_name;
+		int64_t m_startNs; // -1 if the tracing was stopped on entering the scope
+
+	public:
+		inline Scope(const char* name) noexcept
+			: m_name(name), m_startNs(isEnabled() ? detail::now() : -1) {
+
+		}
+
+		Scope(const Scope&) = delete;
+		void operator=(const Scope&) = delete;
+
+		inline ~Scope() {
+			if (m_startNs >= 0) {
+				detail::record(m_name, m_startNs);
+			}
+		}
+	};
+}
+
+#ifdef CW2_NO_TRACING
+#define trace_scope(name)
+#else
+// Generating a name for the scope's timer
+#define GEN_TRACE_NAME_(id, LINE) id ## LINE
+#define GEN_TRACE_NAME(LINE) GEN_TRACE_NAME_(TRACE__, LINE)
+
+// Records the time the rest of the current scope takes as an event with the name
+#define trace_scope(name) utils::trace::Scope GEN_TRACE_NAME(__LINE__)(name)
+#endif
@@ -0,0 +1,111 @@
+#include "WorkStealing.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace utils;
+
+// The number of chunks each worker's part is split into, the smaller chunks spread the work better but cost more to take
+constexpr uint32_t CHUNKS_PER_WORKER = 16;
+
+// What is left of a worker's part: the begin in the lower half and the end in the upper one,
+// so that the owner taking a chunk from the front and a thief taking the back half cannot take the same iterations
+// Each one is on a cache line of its own, so the workers do not slow each other down while taking the chunks
+struct alignas(64) WorkRange {
+	std::atomic<uint64_t> range;
+};
+
+static inline uint64_t packRange(uint32_t from, uint32_t to) {
+	return uint64_t(to) << 32 | from;
+}
+
+static inline uint32_t getFrom(uint64_t range) {
+	return uint32_t(range);
+}
+
+static inline uint32_t getTo(uint64_t range) {
+	return uint32_t(range >> 32);
+}
+
+// Takes up to -grain- iterations from the front of the range, returns false if it is empty
+static bool takeChunk(WorkRange& work, uint32_t grain, uint32_t& from, uint32_t& to) {
+	uint64_t range = work.range.load(std::memory_order_acquire);
+	while (getFrom(range) < getTo(range)) {
+		uint32_t next = getFrom(range) + std::min(grain, getTo(range) - getFrom(range));
+		if (work.range.compare_exchange_weak(range, packRange(next, getTo(range)), std::memory_order_acq_rel)) {
+			from = getFrom(range);
+			to = next;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Moves the back half of the largest range to the thief's one, returns false if all the ranges are empty
+static bool steal(WorkRange* works, uint32_t workersCount, uint32_t thief) {
+	while (true) {
+		uint32_t victim = thief;
+		uint32_t victimSize = 0;
+		for (uint32_t i = 0; i < workersCount; i++) {
+			uint64_t range = works[i].range.load(std::memory_order_relaxed);
+			if (i != thief && getTo(range) > getFrom(range) && getTo(range) - getFrom(range) > victimSize) {
+				victim = i;
+				victimSize = getTo(range) - getFrom(range);
+			}
+		}
+
+		if (victim == thief) {
+			return false;
+		}
+
+		uint64_t range = works[victim].range.load(std::memory_order_acquire);
+		if (getFrom(range) >= getTo(range)) {
+			continue; // Taken by the owner while looking for it
+		}
+
+		// A single iteration left is taken as well, the owner is busy with another one then
+		uint32_t middle = getFrom(range) + (getTo(range) - getFrom(range)) / 2;
+		if (works[victim].range.compare_exchange_strong(range, packRange(getFrom(range), middle), std::memory_order_acq_rel)) {
+			// No one else changes an empty range, so it is safe to just store the stolen part
+			works[thief].range.store(packRange(middle, getTo(range)), std::memory_order_release);
+			return true;
+		}
+	}
+}
+
+void utils::runWorkStealing(QThreadPool& pool, uint32_t count, uint32_t workersCount, const WorkChunkTask& task) {
+	if (count == 0) {
+		return;
+	}
+
+	workersCount = std::clamp(workersCount, 1u, count);
+	if (workersCount == 1) {
+		task(0, 0, count);
+		return;
+	}
+
+	std::unique_ptr<WorkRange[]> works(new WorkRange[workersCount]);
+	for (uint32_t i = 0; i < workersCount; i++) {
+		works[i].range.store(packRange(uint32_t(uint64_t(count) * i / workersCount), uint32_t(uint64_t(count) * (i + 1) / workersCount)));
+	}
+
+	uint32_t grain = std::max(count / (workersCount * CHUNKS_PER_WORKER), 1u);
+	auto work = [&](uint32_t worker) {
+		uint32_t from, to;
+		do {
+			while (takeChunk(works[worker], grain, from, to)) {
+				task(worker, from, to);
+			}
+		} while (steal(works.get(), workersCount, worker));
+	};
+
+	for (uint32_t i = 1; i < workersCount; i++) {
+		pool.start([&work, i]() {
+			work(i);
+		});
+	}
+
+	work(0);
+	pool.waitForDone();
+}
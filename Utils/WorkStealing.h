@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <QThreadPool>
+
+namespace utils {
+	// Called for a chunk [from, to) of the range by the worker with the index, workers never share a call
+	using WorkChunkTask = std::function<void(uint32_t worker, uint32_t from, uint32_t to)>;
+
+	// Runs the task over the range [0, count) on the pool's threads and the calling one, returns once the whole range is done
+	// The range is split evenly between the workers, and each one goes through its part chunk by chunk from the front
+	// A worker out of its part steals the back half of what is left of the largest other part,
+	// so the parts that turned out to be more costly are still shared between all the workers
+	void runWorkStealing(QThreadPool& pool, uint32_t count, uint32_t workersCount, const WorkChunkTask& task);
+}
@@ -1,6 +1,10 @@
 #include "GUI/CW2_GraphicalEditor.h"
 #include <QtWidgets/QApplication>
-#include "Image/Color.h"
+#include <QTextStream>
+#include "Script/Compiler.h"
+#include "Benchmarks/Benchmark.h"
+#include "Utils/ScopeExit.h"
+#include "Utils/Trace.h"
 
 /*
 * Changelog (and some notes):
@@ -29,12 +33,90 @@
 
 // TODOs: tIME and other info, square areas, eraser, image cropping, image rotation, finish CW2 script language
 
+// Command line mode: --compile [--no-cache] script1.cw2 script2.cw2 ...
+// Compiles the scripts without opening the editor, returns the number of failed scripts
+int compileScripts(const QStringList& args) {
+    QTextStream err(stderr);
+    bool useCache = true;
+    int failed = 0;
+
+    for (const QString& arg : args) {
+        if (arg == "--no-cache") {
+            useCache = false;
+            continue;
+        }
+
+        if (auto result = Compiler(useCache).compile(arg); !result.isOk()) {
+            err << arg << ": " << result.error() << "\n";
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
 int main(int argc, char *argv[]) {
-    Color::initColorModule(); // Getting ready to use own graphics
+    // Command line option: --trace file [the mode and its arguments]
+    // Records the hot paths while the program runs and writes them to the file as Chrome trace events once it exits
+    QString traceFileName;
+    if (argc > 2 && QString(argv[1]) == "--trace") {
+        traceFileName = argv[2];
+
+        // The rest of the arguments are handled as if there were no option
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+
+        if (auto result = utils::trace::start(); !result.isOk()) {
+            QTextStream(stderr) << result.error() << "\n";
+            return 1;
+        }
+    }
+
+    at_scope_exit {
+        if (traceFileName.isEmpty()) {
+            return;
+        }
+
+        if (auto result = utils::trace::stopAndWrite(traceFileName); !result.isOk()) {
+            QTextStream(stderr) << result.error() << "\n";
+        }
+    };
+
+    // Command line mode: --benchmark [--json file] [group1 group2 ...]
+    // Measures the editor's internals without opening it, returns the number of unknown groups
+    if (argc > 1 && QString(argv[1]) == "--benchmark") {
+        QCoreApplication a(argc, argv);
+        return bench::runBenchmarks(a.arguments().mid(2));
+    }
+
+    // Command line mode: --golden [--update] [--scratch directory] [file]
+    // Checks that the drawing functions draw the same pixels as recorded, returns the number of the images that differ
+    if (argc > 1 && QString(argv[1]) == "--golden") {
+        QCoreApplication a(argc, argv);
+        return bench::runGoldenImages(a.arguments().mid(2));
+    }
+
+    if (argc > 1 && QString(argv[1]) == "--compile") {
+        QCoreApplication a(argc, argv);
+        return compileScripts(a.arguments().mid(2));
+    }
+
+    // Editor option: --scratch directory
+    // Keeps the pixels of the images created and opened in the editor in scratch files in the directory, so they can be larger than RAM
+    QString scratchDirectory;
+    if (argc > 2 && QString(argv[1]) == "--scratch") {
+        scratchDirectory = argv[2];
+
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
 
     // The standard Qt project's main function content
     QApplication a(argc, argv);
     CW2_GraphicalEditor w;
+    w.setScratchDirectory(scratchDirectory);
     w.show();
 
     return a.exec();